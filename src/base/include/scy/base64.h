@@ -0,0 +1,312 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+// This file uses the public domain libb64 library: http://libb64.sourceforge.net/
+//
+
+
+#ifndef SCY_Base64_H
+#define SCY_Base64_H
+
+
+#include "scy/interface.h"
+#include "scy/logger.h" 
+#include "scy/types.h"
+#include <iostream>
+#include <memory>
+
+
+namespace scy {
+namespace base64 {
+
+
+const int BUFFER_SIZE = 16384;
+const int LINE_LENGTH = 72;
+
+
+//
+// Instruction Sets
+//
+// Whole groups are coded with SSSE3 or AVX2 instructions selected 
+// at runtime by CPU feature, with a portable scalar fallback. All
+// of the encoders and decoders below share the same code path.
+//
+
+
+enum Mode
+{
+	Scalar = 0,
+	SSSE3,
+	AVX2
+};
+
+
+Mode detectMode();
+	// Returns the fastest mode supported by the CPU and build.
+
+Mode mode();
+	// Returns the active mode.
+
+void setMode(Mode mode);
+	// Sets the active mode, which is mostly useful for testing and
+	// benchmarks. Modes which are not supported are clamped to
+	// detectMode(). This function is not thread-safe.
+
+const char* modeString(Mode mode);
+	// Returns the name of the given mode.
+
+
+//
+// Base64 Encoder
+//
+	
+
+namespace internal {
+
+
+typedef enum
+{
+	step_A, step_B, step_C
+} encodestep;
+
+typedef struct
+{
+	encodestep step;
+	char result;
+	int stepcount;
+	int linelength; // added
+	int nullptrlterminate; // added
+} encodestate;
+
+void init_encodestate(internal::encodestate* state_in);
+
+char encode_value(char value_in);
+
+int encode_block(const char* readbuf_in, int length_in, char* code_out, internal::encodestate* state_in);
+
+int encode_blockend(char* code_out, internal::encodestate* state_in);
+
+
+} // namespace internal
+
+
+struct Encoder: public basic::Encoder
+{
+	Encoder(int buffersize = BUFFER_SIZE) : 
+		_buffersize(buffersize)
+	{
+		internal::init_encodestate(&_state);
+	}
+
+	void encode(std::istream& istrm, std::ostream& ostrm)
+	{
+		const int N = _buffersize;
+		char* readbuf = new char[N];
+		char* encbuf = new char[2*N];
+		int nread;
+		int enclen;
+
+		do
+		{
+			istrm.read(readbuf, N);
+			nread = static_cast<int>(istrm.gcount());			
+			enclen = encode(readbuf, nread, encbuf);
+			ostrm.write(encbuf, enclen);
+		}
+		while (istrm.good() && nread > 0);
+
+		enclen = finalize(encbuf);
+		ostrm.write(encbuf, enclen);
+
+		internal::init_encodestate(&_state);
+
+		delete [] encbuf;
+		delete [] readbuf;
+	}
+		
+	void encode(const std::string& in, std::string& out)
+	{
+		char* encbuf = new char[in.length() * 2];
+		int enclen = encode(in.c_str(), in.length(), encbuf);
+		out.append(encbuf, enclen);
+
+		enclen = finalize(encbuf);
+		out.append(encbuf, enclen);
+
+		internal::init_encodestate(&_state);
+
+		delete [] encbuf;
+	}
+
+	std::size_t encode(const char* inbuf, std::size_t nread, char* outbuf)
+	{
+		return internal::encode_block(inbuf, nread, outbuf, &_state);
+	}
+
+	std::size_t finalize(char* outbuf)
+	{		
+		return internal::encode_blockend(outbuf, &_state);
+	}
+	
+	void setLineLength(int lineLength)
+	{
+		_state.linelength = lineLength;
+	}
+
+	void reset()
+		// Discards any partial group so the encoder 
+		// can start a new message.
+	{
+		int lineLength = _state.linelength;
+		internal::init_encodestate(&_state);
+		_state.linelength = lineLength;
+	}
+
+	internal::encodestate _state;
+	int _buffersize;
+};
+
+
+std::size_t encodedLength(std::size_t nread, int lineLength = 0);
+	// Returns the maximum number of characters encode() writes
+	// for the given input size, including padding and line feeds.
+
+std::size_t encode(const char* inbuf, std::size_t nread, char* outbuf, int lineLength = 0);
+	// Encodes a whole message into a caller supplied buffer which 
+	// must hold at least encodedLength(nread, lineLength) bytes.
+	// Returns the number of characters written.
+
+
+template<typename T>
+inline std::string encode(const T& bytes, int lineLength = LINE_LENGTH)
+	// Converts a STL container to Base64.
+{	
+	std::string res(encodedLength(bytes.size(), lineLength), '\0');
+	if (!bytes.empty())
+		res.resize(encode(reinterpret_cast<const char*>(&bytes[0]), bytes.size(), &res[0], lineLength));
+	return res;
+}
+
+
+//
+// Base64 Decoder
+//
+
+
+namespace internal {
+
+
+typedef enum
+{
+	step_a, step_b, step_c, step_d
+} decodestep;
+
+typedef struct
+{
+	decodestep step;
+	char plainchar;
+} decodestate;
+
+void init_decodestate(internal::decodestate* state_in);
+
+int decode_value(char value_in);
+
+int decode_block(const char* inbuf, const int nread, char* outbuf, internal::decodestate* state_in);
+
+
+} // namespace internal
+
+
+struct Decoder : public basic::Decoder
+{
+	Decoder(int buffersize = BUFFER_SIZE) : 
+		_buffersize(buffersize)
+	{
+		internal::init_decodestate(&_state);
+	}
+
+	int decode(char value_in)
+	{
+		return internal::decode_value(value_in);
+	}
+
+	std::size_t decode(const char* inbuf, std::size_t nread, char* outbuf)
+	{
+		return internal::decode_block(inbuf, nread, outbuf, &_state);
+	}
+
+	void reset()
+		// Discards any partial group so the decoder 
+		// can start a new message.
+	{
+		internal::init_decodestate(&_state);
+	}
+
+	void decode(std::istream& istrm, std::ostream& ostrm)
+	{
+		const int N = _buffersize;
+		char* decbuf = new char[N];
+		char* readbuf = new char[N];
+		int declen;
+		int nread;
+
+		do
+		{
+			istrm.read((char*)decbuf, N);
+			declen = static_cast<int>(istrm.gcount());
+			nread = decode(decbuf, declen, readbuf);
+			ostrm.write((const char*)readbuf, nread);
+		}
+		while (istrm.good() && declen > 0);
+
+		internal::init_decodestate(&_state);
+
+		delete [] decbuf;
+		delete [] readbuf;
+	}
+
+	internal::decodestate _state;
+	int _buffersize;
+};
+
+
+std::size_t decodedLength(std::size_t nread);
+	// Returns the maximum number of bytes decode() writes
+	// for the given input size.
+
+std::size_t decode(const char* inbuf, std::size_t nread, char* outbuf);
+	// Decodes a whole message into a caller supplied buffer which 
+	// must hold at least decodedLength(nread) bytes. Line feeds and 
+	// other invalid characters are skipped. Returns the number of 
+	// bytes written.
+
+
+template<typename T>
+inline std::string decode(const T& bytes)
+	/// Decodes a STL container from Base64.
+{	
+	std::string res(decodedLength(bytes.size()), '\0');
+	if (!bytes.empty())
+		res.resize(decode(reinterpret_cast<const char*>(&bytes[0]), bytes.size(), &res[0]));
+	return res;
+}
+
+
+} } // namespace scy::base64
+
+
+#endif // SCY_Base64_H
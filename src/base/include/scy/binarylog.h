@@ -0,0 +1,143 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#ifndef SCY_BinaryLog_H
+#define SCY_BinaryLog_H
+
+
+#include "scy/logger.h"
+#include <unordered_map>
+#include <vector>
+
+
+namespace scy {
+
+
+//
+// Binary File Channel
+//
+
+
+class BinaryFileChannel: public LogChannel
+	/// BinaryFileChannel writes log records to memory mapped files in
+	/// a compact binary format. Rather than formatting each message it
+	/// records the format site, timestamp and encoded argument values;
+	/// the text is produced offline by BinaryLogReader.
+	///
+	/// Files are preallocated to the given size and rotated when full.
+	/// When maxFiles is set the oldest files of the channel are removed
+	/// on rotation so no more than maxFiles files are kept.
+{	
+public:
+	BinaryFileChannel(
+		const std::string& name,
+		const std::string& dir,
+		LogLevel level = LTrace, 
+		std::size_t fileSize = 16 * 1024 * 1024,
+		const std::string& extension = "blog",
+		int maxFiles = 0);
+	virtual ~BinaryFileChannel();
+	
+	virtual void write(const LogStream& stream);
+	virtual bool binary() const { return true; };
+
+	virtual void rotate();
+		// Closes the current file and opens the next one.
+
+	std::string dir() const { return _dir; };
+	std::string path() const { return _path; };
+		// Returns the path of the current file.
+
+	std::size_t fileSize() const { return _fileSize; };
+
+	int maxFiles() const { return _maxFiles; };
+		// Returns the number of files which are kept,
+		// or zero if files are never removed.
+
+protected:
+	virtual void open();
+	virtual void close();
+
+	virtual void purge();
+		// Removes the oldest files written by channels of the
+		// same name and extension until at most maxFiles remain.
+		// Files of previous runs in the directory are included.
+
+	UInt32 siteID(const std::string& realm, int line);
+		// Returns the ID of the given format site, and writes
+		// the site record if it has not been written to the
+		// current file.
+
+	char* reserve(char type, std::size_t size);
+		// Reserves a record in the current file and returns
+		// the record payload. The caller ensures there is room.
+
+	typedef std::vector<std::pair<int, UInt32>> SiteLines;
+	typedef std::unordered_map<std::string, SiteLines> SiteMap;
+
+	std::string _dir;
+	std::string _path;
+	std::string _extension;
+	std::size_t _fileSize;
+	int         _maxFiles;
+	std::size_t _offset;
+	char*       _data;
+#ifdef WIN32
+	void*       _file;
+	void*       _mapping;
+#else
+	int         _fd;
+#endif
+	SiteMap     _sites;
+	UInt32      _nextSite;
+	int         _sequence;
+};
+
+
+//
+// Binary Log Reader
+//
+
+
+class BinaryLogReader
+	/// BinaryLogReader decodes files written by BinaryFileChannel
+	/// to the text format written by the other log channels.
+{	
+public:
+	BinaryLogReader(const char* timeFormat = "%H:%M:%S");
+	
+	std::size_t read(const std::string& path, std::ostream& ost);
+		// Decodes the given file and returns the number of messages.
+		// Throws std::runtime_error if the file is not a binary log.
+
+	std::size_t read(const char* data, std::size_t size, std::ostream& ost);
+		// Decodes a binary log image and returns the number of messages.
+		// Throws std::runtime_error if the image is not a binary log.
+
+protected:
+	LogChannel _formatter;
+	std::unordered_map<UInt32, std::pair<std::string, int>> _sites;
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_BinaryLog_H
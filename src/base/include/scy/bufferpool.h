@@ -0,0 +1,258 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_BufferPool_H
+#define SCY_BufferPool_H
+
+
+#include "scy/types.h"
+#include "scy/mutex.h"
+#include "scy/memory.h"
+#include "scy/buffer.h"
+#include "scy/uv/uvpp.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+
+namespace scy {
+
+
+class BufferPool;
+struct BufferSlab;
+
+
+//
+// Pooled Buffer
+//
+
+
+class PooledBuffer: public SharedObject
+	/// PooledBuffer is a reference counted, fixed capacity block of
+	/// memory which is owned by a BufferPool.
+	///
+	/// Blocks are handed out with a reference count of one. Any holder
+	/// which needs the data to outlive the current scope should call
+	/// duplicate(), and release() when done. The block is returned
+	/// to its pool when the last reference is released.
+{
+public:
+	char* data() const { return _data; }
+		// Returns the block data pointer.
+
+	std::size_t capacity() const { return _capacity; }
+		// Returns the fixed block capacity in bytes.
+
+	std::size_t size() const { return _size; }
+		// Returns the number of valid bytes in the block.
+
+	void setSize(std::size_t size) { assert(size <= _capacity); _size = size; }
+		// Sets the number of valid bytes in the block.
+
+	MutableBuffer buffer() const { return MutableBuffer(_data, _size); }
+		// Returns a non-owning buffer view of the valid bytes.
+
+	bool contains(const void* data, std::size_t size) const
+		// Returns true if the given memory range lies inside this block.
+	{
+		const char* p = reinterpret_cast<const char*>(data);
+		return p >= _data && p + size <= _data + _capacity;
+	}
+
+	BufferPool* pool() const { return _pool; }
+		// Returns the owning pool.
+
+protected:
+	PooledBuffer(BufferPool* pool, BufferSlab* slab, char* data, std::size_t capacity);
+	virtual ~PooledBuffer();
+
+	virtual void freeMemory();
+		// Returns the block to the owning pool instead of deleting it.
+
+	friend class BufferPool;
+
+	BufferPool* _pool;
+	BufferSlab* _slab;
+	char* _data;
+	std::size_t _capacity;
+	std::size_t _size;
+};
+
+
+//
+// Buffer Pool
+//
+
+
+class BufferPool: public SharedObject
+	/// BufferPool is a slab allocator for fixed size, reference counted
+	/// PooledBuffer blocks. Memory is allocated in slabs of blocks which
+	/// are recycled through a free list, so steady state receive paths
+	/// perform no heap allocations.
+	///
+	/// A pool may have several size classes, so small writes such as
+	/// STUN messages do not pin a block sized for a full socket read.
+	///
+	/// Blocks may be released from any thread. Each outstanding block
+	/// holds a reference to the pool, so the pool will not be freed
+	/// until all of its blocks have been returned.
+	///
+	/// Slabs whose blocks are all free are given back to the system
+	/// once the pool holds more than maxFree() bytes of free blocks,
+	/// so a burst does not pin its peak memory for good.
+{
+public:
+	BufferPool(std::size_t blockSize = 65536, std::size_t blocksPerSlab = 16);
+		// Creates a pool of blockSize blocks, allocating
+		// blocksPerSlab blocks each time the free list runs dry.
+
+	BufferPool(const std::vector<std::size_t>& blockSizes, std::size_t slabSize = 1024 * 1024);
+		// Creates a pool with a size class for each of the given
+		// block sizes. Each class allocates slabs of about slabSize
+		// bytes, and at least one block.
+
+	PooledBuffer* acquire(std::size_t size = 0);
+		// Returns a free block from the smallest size class which
+		// holds the given number of bytes, with a reference count of
+		// one and a size of zero. The caller owns the reference.
+		// Returns nullptr if size exceeds the largest block size.
+
+	PooledBuffer* retain(const void* data, std::size_t size);
+		// If the given memory range lies inside an outstanding block
+		// owned by this pool, duplicates and returns that block.
+		// Returns nullptr otherwise. Takes constant time.
+		//
+		// Asynchronous writers use this to keep pooled data alive
+		// until the write completes.
+
+	std::size_t blockSize() const;
+		// Returns the capacity of the largest blocks.
+
+	std::size_t numSlabs() const;
+		// Returns the number of slabs allocated so far.
+
+	std::size_t numFree() const;
+		// Returns the number of blocks on the free list.
+
+	std::size_t numBlocks() const;
+		// Returns the total number of blocks owned by the pool.
+
+	void setMaxFree(std::size_t bytes);
+		// Sets the number of free bytes the pool may hold before
+		// releasing idle slabs. Defaults to four megabytes.
+
+	std::size_t maxFree() const;
+
+	std::size_t trim();
+		// Releases every slab whose blocks are all free, regardless
+		// of maxFree(). Returns the number of bytes released.
+
+	static BufferPool* forLoop(uv::Loop* loop);
+		// Returns the shared pool for the given event loop, creating
+		// it on first use. The returned pointer is not duplicated;
+		// holders which may outlive shutdown() should call duplicate().
+
+	static void shutdown();
+		// Releases the shared per-loop pools. Pools are freed once
+		// their remaining holders and blocks have been released.
+
+	static void shutdown(uv::Loop* loop);
+		// Releases the shared pool for the given loop, if any.
+
+protected:
+	virtual ~BufferPool();
+
+	void recycle(PooledBuffer* block);
+		// Returns a released block to the free list.
+
+	struct SizeClass
+	{
+		std::size_t blockSize;
+		std::size_t blocksPerSlab;
+		std::vector<PooledBuffer*> free;
+	};
+
+	void allocateSlab(std::size_t cls);
+	void freeSlab(BufferSlab* slab);
+		// Must be called with the mutex locked.
+
+	friend class PooledBuffer;
+
+	mutable Mutex _mutex;
+	std::vector<SizeClass> _classes;	// In ascending block size
+	std::vector<BufferSlab*> _slabs;
+	std::unordered_map<std::uintptr_t, BufferSlab*> _index;	// Slabs by page
+	std::size_t _freeBytes;
+	std::size_t _maxFree;
+};
+
+
+//
+// Receive Buffer
+//
+
+
+class ReceiveBuffer
+	/// ReceiveBuffer manages the pooled block a socket reads into.
+	/// Blocks are taken from the pool's smallest size class which 
+	/// holds blockSize bytes.
+	///
+	/// Reads fill the block from front to back. While receivers hold
+	/// on to earlier data, the next read goes into the free tail of the
+	/// same block, and a fresh block is only taken once the tail is
+	/// smaller than minSpace. A block nobody else holds is reused from
+	/// the start.
+	///
+	/// All work happens in prepare() and commit(), before received
+	/// data is dispatched, so a receiver may safely close or destroy
+	/// the owning socket from its callback.
+{
+public:
+	ReceiveBuffer(BufferPool* pool, std::size_t blockSize, std::size_t minSpace);
+	~ReceiveBuffer();
+
+	MutableBuffer prepare();
+		// Returns the space the next read should go into.
+
+	MutableBuffer commit(std::size_t size);
+		// Marks the first size bytes of the prepared space as
+		// received and returns them.
+
+	PooledBuffer* block() const;
+		// Returns the block holding the last received data,
+		// or nullptr if nothing was prepared yet.
+
+protected:
+	ReceiveBuffer(const ReceiveBuffer&); // = delete;
+	ReceiveBuffer& operator = (const ReceiveBuffer&); // = delete;
+
+	BufferPool* _pool;
+	PooledBuffer* _block;
+	std::size_t _blockSize;
+	std::size_t _minSpace;
+	std::size_t _offset;		// Start of the prepared space
+	std::size_t _end;			// End of the last received data
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_BufferPool_H
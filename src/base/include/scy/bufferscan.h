@@ -0,0 +1,78 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_BufferScan_H
+#define SCY_BufferScan_H
+
+
+#include <cstddef>
+
+
+namespace scy {
+namespace scan {
+
+
+//
+// Buffer Scanning
+//
+// Byte scanning primitives used by BitReader and the text protocol
+// parsers. SSE2 and AVX2 implementations are selected at runtime by
+// CPU feature, with a portable scalar fallback.
+//
+
+
+enum Mode
+{
+	Scalar = 0,
+	SSE2,
+	AVX2
+};
+
+
+Mode detectMode();
+	// Returns the fastest mode supported by the CPU and build.
+
+Mode mode();
+	// Returns the active mode.
+
+void setMode(Mode mode);
+	// Sets the active mode, which is mostly useful for testing and
+	// benchmarks. Modes which are not supported are clamped to
+	// detectMode(). This function is not thread-safe.
+
+const char* modeString(Mode mode);
+	// Returns the name of the given mode.
+
+std::size_t findChar(const char* data, std::size_t len, char c);
+	// Returns the index of the first occurrence of c,
+	// or len if not found.
+
+std::size_t findNotChar(const char* data, std::size_t len, char c);
+	// Returns the index of the first byte which is not c,
+	// or len if all bytes match.
+
+std::size_t findWordEnd(const char* data, std::size_t len);
+	// Returns the index of the first space, tab, carriage
+	// return or line feed, or len if not found.
+
+
+} } // namespace scy::scan
+
+
+#endif // SCY_BufferScan_H
@@ -0,0 +1,192 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+// This file uses the public domain libb64 library: http://libb64.sourceforge.net/
+//
+
+
+#ifndef SCY_Hex_H
+#define SCY_Hex_H
+
+
+#include "scy/interface.h"
+#include "scy/exception.h"
+#include "scy/logger.h"
+#include <iostream>
+#include <assert.h>
+#include <cstring>
+
+
+namespace scy {
+namespace hex {
+	
+
+//
+// Hex Encoder
+//
+
+
+std::size_t encode(const char* inbuf, std::size_t nread, char* outbuf, bool uppercase = false);
+	// Encodes a buffer into 2 * nread characters without line feeds,
+	// using SSSE3 or AVX2 instructions where the CPU supports them.
+	// Returns the number of characters written.
+
+
+struct Encoder: public basic::Encoder
+{	
+	Encoder() : 
+		_linePos(0),
+		_lineLength(72),
+		_uppercase(0)
+	{
+	}
+	
+	virtual std::size_t encode(const char* inbuf, std::size_t nread, char* outbuf)
+	{
+		std::size_t nwrite = 0;
+		while (nread > 0) {
+
+			// Encode up to the end of the current line
+			std::size_t n = nread;
+			if (_lineLength > 0) {
+				int remaining = (_lineLength - _linePos + 1) / 2;
+				if (remaining < 1)
+					remaining = 1;
+				if (n > static_cast<std::size_t>(remaining))
+					n = remaining;
+			}
+			nwrite += hex::encode(inbuf, n, outbuf + nwrite, _uppercase != 0);
+			inbuf += n;
+			nread -= n;
+			if (_lineLength > 0 && (_linePos += static_cast<int>(n) * 2) >= _lineLength) {
+				_linePos = 0;
+				outbuf[nwrite++] = '\n';
+			}
+		}
+
+		return nwrite;
+	}
+
+	virtual std::size_t finalize(char* /* outbuf */)
+	{
+		return 0;
+	}
+
+	void setUppercase(bool flag)
+	{
+		_uppercase = flag ? 16 : 0;
+	}
+	
+	void setLineLength(int lineLength)
+	{
+		_lineLength = lineLength;
+	}
+	
+	int _linePos;
+	int _lineLength;
+	int _uppercase;
+};
+
+
+template<typename T>
+inline std::string encode(const T& bytes)
+	// Converts the STL container to Hex.
+{
+	std::string res(bytes.size() * 2, '\0');
+	if (!bytes.empty())
+		encode(reinterpret_cast<const char*>(&bytes[0]), bytes.size(), &res[0]);
+	return res;
+}
+	
+
+//
+// Hex Decoder
+//
+
+
+struct Decoder: public basic::Decoder
+{		
+	Decoder() : lastbyte('\0') {}
+	virtual ~Decoder() {} 
+
+	virtual std::size_t decode(const char* inbuf, std::size_t nread, char* outbuf)
+	{
+		int n;
+		char c;
+		std::size_t rpos = 0;
+		std::size_t nwrite = 0;	
+		while (rpos < nread)
+		{
+			if (readnext(inbuf, nread, rpos, c))
+				n = (nybble(c) << 4);
+
+			else if (rpos >= nread) {	
+				// Store the last byte to be
+				// prepended on next decode()
+				if (!iswspace(inbuf[rpos - 1]))
+					std::memcpy(&lastbyte, &inbuf[rpos - 1], 1); 	
+				break;
+			}
+			
+			readnext(inbuf, nread, rpos, c);
+			n = n | nybble(c);
+			std::memcpy(outbuf + nwrite++, &n, 1);
+		}
+		return nwrite;
+	}
+
+	virtual std::size_t finalize(char* /* outbuf */)
+	{
+		return 0;
+	}
+	
+	bool readnext(const char* inbuf, std::size_t nread, std::size_t& rpos, char& c)
+	{
+		if (rpos == 0 && lastbyte != '\0') {
+			assert(!iswspace(lastbyte));
+			c = lastbyte;
+			lastbyte = '\0';
+		}
+		else {
+			c = inbuf[rpos++];
+			while (iswspace(c) && rpos < nread)
+				c = inbuf[rpos++];
+		}
+		return rpos < nread;
+	}
+
+	int nybble(const int n)
+	{
+		if      (n >= '0' && n <= '9') return n - '0';
+		else if (n >= 'A' && n <= 'F') return n - ('A' - 10);
+		else if (n >= 'a' && n <= 'f') return n - ('a' - 10);
+		else throw std::runtime_error("Invalid hex format");
+	}
+
+	bool iswspace(const char c)
+	{
+		return c == ' ' || c == '\r' || c == '\t' || c == '\n';
+	}
+
+	char lastbyte;
+};
+
+
+} } // namespace scy::hex
+
+
+#endif // SCY_Hex_H
\ No newline at end of file
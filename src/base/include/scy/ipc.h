@@ -0,0 +1,194 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef SCY_IPC_H
+#define SCY_IPC_H
+
+
+#include "scy/mutex.h"
+#include "scy/synccontext.h"
+
+#include <string>
+#include <deque>
+#include <atomic>
+
+
+namespace scy {
+namespace ipc {
+
+
+struct Action
+	/// Default action type for executing synchronized callbacks.
+{
+	typedef std::function<void(const Action&)> callback_t;
+	callback_t target;
+	void* arg;
+	std::string data;
+		
+	Action(callback_t target, void* arg = nullptr, const std::string& data = "") :
+		target(target), arg(arg), data(data) {} 
+};
+
+
+template<typename TAction = ipc::Action> 
+class Queue
+	/// IPC queue is for safely passing templated   
+	/// actions between threads and processes.
+	///
+	/// See SyncDispatcher for posting closures to an 
+	/// event loop without allocating actions.
+{
+public:	
+	Queue() : 
+		_pushed(0),
+		_synced(0),
+		_waiting(0)
+	{
+	}
+
+	virtual ~Queue() 
+	{
+		TAction* next = nullptr;
+		while ((next = pop()))
+			delete next;
+	}
+
+	virtual void push(TAction* action)
+	{
+		{
+			Mutex::ScopedLock lock(_mutex);
+			_actions.push_back(action);
+			_pushed++;
+		}
+		post();
+	}
+
+	virtual TAction* pop()
+	{
+		Mutex::ScopedLock lock(_mutex);
+		if (_actions.empty()) 
+			return nullptr;
+		TAction* next = _actions.front();
+		_actions.pop_front();
+		return next;
+	}
+	
+	virtual void runSync()
+	{
+		TAction* next = nullptr;
+		UInt64 count = 0;
+		while ((next = pop())) {
+			next->target(*next);
+			delete next;
+			count++;
+		}
+
+		Mutex::ScopedLock lock(_mutex);
+		_synced += count;
+		if (_waiting)
+			_cond.broadcast();
+	}
+
+	virtual void close()
+	{
+	}
+	
+	virtual void post()
+	{
+	}
+
+	void waitForSync()
+		// Blocks until all actions pushed before the call have run.
+		// Must not be called from the thread which runs the actions.
+	{
+		Mutex::ScopedLock lock(_mutex);
+		UInt64 target = _pushed;
+		_waiting++;
+		while (_synced < target)
+			_cond.wait(_mutex);
+		_waiting--;
+	}
+
+protected:	
+	mutable Mutex _mutex;
+	Condition _cond;
+	std::deque<TAction*> _actions;
+	UInt64 _pushed;
+	UInt64 _synced;
+	int _waiting;
+};
+
+
+template<typename TAction = ipc::Action> 
+class SyncQueue: public Queue<TAction>
+	/// IPC synchronization queue is for passing templated 
+	/// actions between threads and the event loop we are 
+	/// synchronizing with.
+	///
+	/// Wakeups are coalesced, so a burst of pushes results
+	/// in a single uv_async_send.
+{
+public:	
+	SyncQueue(uv::Loop* loop = uv::defaultLoop()) : 
+		_sync(loop, std::bind(&Queue<TAction>::runSync, this)),
+		_pending(false)
+	{
+	}
+
+	virtual ~SyncQueue() 
+	{
+	}
+
+	virtual void runSync()
+	{
+		// Clear the flag before running so actions 
+		// pushed meanwhile schedule another wakeup
+		_pending.store(false);
+		Queue<TAction>::runSync();
+	}
+
+	virtual void close()
+	{
+		_sync.close();
+	}
+	
+	virtual void post()
+	{
+		if (!_pending.load() && !_pending.exchange(true))
+			_sync.post();
+	}
+	
+	virtual SyncContext& sync()
+	{
+		return _sync;
+	}
+
+protected:	
+	SyncContext _sync;
+	std::atomic<bool> _pending;
+};
+
+
+typedef ipc::Queue<ipc::Action> ActionQueue;
+typedef ipc::SyncQueue<ipc::Action> ActionSyncQueue;
+
+
+} } // namespace scy::ipc
+
+
+#endif
\ No newline at end of file
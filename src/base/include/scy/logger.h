@@ -0,0 +1,714 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef SCY_Logger_H
+#define SCY_Logger_H
+
+
+#include "scy/base.h"
+#include "scy/mutex.h"
+#include "scy/thread.h"
+#include "scy/exception.h"
+#include "scy/singleton.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <deque>
+#include <map>
+#include <vector>
+#include <ctime>
+//#include <time.h>
+#include <string.h>
+#include <atomic>
+
+
+namespace scy {
+
+
+enum LogLevel
+{
+	LTrace	= 0,
+	LDebug	= 1,
+	LInfo	= 2,
+	LWarn	= 3,
+	LError	= 4,
+	LFatal	= 5,
+};
+
+
+inline LogLevel getLogLevelFromString(const char* level)
+{
+    if (strcmp(level, "trace") == 0)
+        return LTrace;
+    if (strcmp(level, "debug") == 0)
+        return LDebug;
+    if (strcmp(level, "info") == 0)
+        return LInfo;
+    if (strcmp(level, "warn") == 0)
+        return LWarn;
+    if (strcmp(level, "error") == 0)
+        return LError;
+    if (strcmp(level, "fatal") == 0)
+        return LFatal;
+    return LDebug;
+}
+
+
+inline const char* getStringFromLogLevel(LogLevel level) 
+{
+	switch(level)
+	{
+		case LTrace:	return "trace";
+		case LDebug:	return "debug";
+		case LInfo:		return "info";
+		case LWarn:		return "warn";
+		case LError:	return "error";
+		case LFatal:	return "fatal";
+	}
+	return "debug";
+}
+
+
+//
+// Compile-time Log Level
+//
+// Log statements below SCY_LOG_FLOOR are removed by the compiler.
+// Defining SCY_DISABLE_LOGGING raises the floor above LFatal.
+//
+
+
+#ifndef SCY_LOG_FLOOR
+#ifdef SCY_DISABLE_LOGGING
+#define SCY_LOG_FLOOR 6
+#else
+#define SCY_LOG_FLOOR 0
+#endif
+#endif
+
+#define SCY_LOG_ENABLED(level) ((level) >= SCY_LOG_FLOOR && scy::Logger::enabled(level))
+
+
+struct LogStream;
+class LogChannel;
+
+
+//
+// Default Log Writer
+//
+
+
+class LogWriter
+{
+public:	
+	LogWriter();
+	virtual ~LogWriter();
+
+	virtual void write(LogStream* stream);
+		// Writes the given log message stream.
+};
+
+
+//
+// Asynchronous Log Writer
+//
+
+
+class AsyncLogWriter: public LogWriter, public async::Runnable
+	/// AsyncLogWriter queues messages in a preallocated lock-free ring
+	/// and writes them from a separate thread. The thread sleeps until
+	/// messages are queued, and writes each batch of messages with one
+	/// LogChannel::writeBatch() call per channel.
+{
+public:	
+	enum Overflow
+	{
+		Drop,   // Drop messages while the ring is full.
+		Block   // Block the logging thread until there is room.
+	};
+
+	AsyncLogWriter(std::size_t capacity = 8192, Overflow overflow = Drop);
+		// The capacity is rounded up to a power of two.
+
+	virtual ~AsyncLogWriter();
+
+	virtual void write(LogStream* stream);
+		// Queues the given log message stream.
+	
+	void flush();
+		// Blocks until queued messages have been written.
+
+	void run();
+		// Writes queued messages asynchronously.
+
+	virtual void cancel(bool flag = true);
+		// Cancels the writer and wakes the writer thread.
+
+	void clear();
+		// Clears all queued messages.
+		// Must not be called while the writer thread is running.
+
+	UInt64 dropped() const;
+		// Returns the number of messages dropped because the ring was full.
+
+	static const std::size_t kMaxBatch = 256;
+		// The maximum number of messages written per batch.
+	
+protected:	
+	bool push(LogStream* stream);
+	LogStream* pop();
+	bool full() const;
+	bool empty() const;
+
+	std::size_t writeBatch();
+		// Writes the next batch of queued messages.
+		// Returns the number of messages written.
+
+	void waitForMessages();
+	void waitForSpace();
+	void wakeup();
+
+	struct Slot
+	{
+		std::atomic<std::size_t> sequence;
+		LogStream* stream;
+	};
+
+	Thread _thread;
+	Slot* _ring;
+	std::size_t _mask;
+	Overflow _overflow;
+	std::atomic<std::size_t> _enqueuePos;
+	std::size_t _dequeuePos;
+	std::atomic<std::size_t> _written;
+	std::atomic<UInt64> _dropped;
+	std::atomic<int> _waiters;
+	std::atomic<unsigned long> _writerID;
+	std::atomic<bool> _sleeping;
+	std::vector<LogStream*> _batch;
+	mutable Mutex _mutex;
+	Condition _cond;
+	Condition _drained;
+};
+
+
+//
+// Logger
+//
+
+
+class Logger
+{
+public:
+	Logger();
+	~Logger();
+
+	static Logger& instance();
+		// Returns the default logger singleton.
+		// Logger instances may be created separately as needed.
+
+	static void setInstance(Logger* logger, bool freeExisting = true);
+		// Sets the default logger singleton instance.
+
+	static void destroy();
+		// Destroys the default logger singleton instance.
+
+	void add(LogChannel* channel);
+		// Adds the given log channel.
+
+	void remove(const std::string& name, bool freePointer = true);
+		// Removes the given log channel by name, 
+		// and optionally frees the pointer.
+
+	LogChannel* get(const std::string& name, bool whiny = true) const;
+		// Returns the specified log channel. 
+		// Throws an exception if the channel doesn't exist.
+	
+	void setDefault(const std::string& name);
+		// Sets the default log to the specified log channel.
+
+	void setWriter(LogWriter* writer);
+		// Sets the log writer instance.
+
+	LogChannel* getDefault() const;
+		// Returns the default log channel, or the nullptr channel
+		// if no default channel has been set.
+	
+	void write(const LogStream& stream);
+		// Writes the given message to the default log channel.
+		// The message will be copied.
+	
+	void write(LogStream* stream);
+		// Writes the given message to the default log channel.
+		// The stream pointer will be deleted when appropriate.
+	
+	LogStream& send(const char* level = "debug", const char* realm = "", 
+		const void* ptr = nullptr, const char* channel = nullptr) const;
+		// Sends to the default log using the given class instance.
+		// Recommend using write(LogStream&) to avoid copying data.
+
+	static bool enabled(LogLevel level)
+		// Returns true if any channel of the default logger accepts
+		// messages of the given level. Log statements check this 
+		// before a LogStream is allocated or formatted.
+	{
+		return level >= _threshold.load(std::memory_order_relaxed);
+	}
+
+	static bool binary()
+		// Returns true if the default logger has a binary channel,
+		// in which case log statements encode their arguments.
+	{
+		return _binary.load(std::memory_order_relaxed);
+	}
+
+	void updateThreshold();
+		// Updates enabled() and binary() from the channels if this 
+		// is the default logger. Called when channels are added or
+		// removed, or when a channel level changes.
+
+protected:
+	// Non-copyable and non-movable
+	Logger(const Logger&); // = delete;
+	Logger(Logger&&); // = delete;
+	Logger& operator=(const Logger&); // = delete;
+	Logger& operator=(Logger&&); // = delete;
+
+	typedef std::map<std::string, LogChannel*> LogChannelMap;
+	
+	friend class Singleton<Logger>;
+	friend class Thread;
+		
+	mutable Mutex _mutex;
+	LogChannelMap _channels;
+	LogChannel*   _defaultChannel;
+	LogWriter*    _writer;
+
+	static std::atomic<int> _threshold;
+	static std::atomic<bool> _binary;
+};
+
+
+//
+// Log Arguments
+//
+// Binary encoding of log statement arguments. LogStream encodes its
+// arguments rather than formatting them when a binary channel is
+// registered, so formatting is deferred until the log is read.
+//
+
+
+namespace logarg {
+
+
+enum Type
+{
+	Int     = 'i',
+	UInt    = 'u',
+	Double  = 'd',
+	Bool    = 'b',
+	Char    = 'c',
+	String  = 's',
+	Pointer = 'p'
+};
+
+
+bool encode(std::string& buf, bool val);
+bool encode(std::string& buf, char val);
+bool encode(std::string& buf, signed char val);
+bool encode(std::string& buf, unsigned char val);
+bool encode(std::string& buf, short val);
+bool encode(std::string& buf, unsigned short val);
+bool encode(std::string& buf, int val);
+bool encode(std::string& buf, unsigned int val);
+bool encode(std::string& buf, long val);
+bool encode(std::string& buf, unsigned long val);
+bool encode(std::string& buf, long long val);
+bool encode(std::string& buf, unsigned long long val);
+bool encode(std::string& buf, float val);
+bool encode(std::string& buf, double val);
+bool encode(std::string& buf, const void* val);
+bool encode(std::string& buf, const char* val);
+bool encode(std::string& buf, const std::string& val);
+
+	// Encodes a value to the argument buffer.
+	// Returns false if the value can't be encoded.
+
+bool formatted(const std::ios& ios);
+	// Returns true if the stream formatting state differs 
+	// from the state of a newly constructed stream.
+
+template<typename T>
+bool encode(std::string& buf, const T& val)
+	// Types without a binary encoding are formatted as text.
+	// Manipulators such as std::setw() change the formatting 
+	// state rather than writing output, so they can't be 
+	// encoded and false is returned.
+{
+	std::ostringstream ss;
+	ss << val;
+	if (formatted(ss))
+		return false;
+	return encode(buf, ss.str());
+}
+
+bool decode(const char* data, std::size_t size, std::ostream& ost);
+	// Formats encoded arguments as the text message would have been.
+	// Returns false if the data is malformed.
+
+
+} // namespace logarg
+
+
+//
+// Log Stream
+//
+
+
+struct LogStream
+{
+	LogLevel level;
+	int line;
+	std::string realm;              // depreciate - encode in message
+	std::string address;            // depreciate - encode in message
+	std::ostringstream message;
+	std::time_t ts;
+	LogChannel* channel;
+	bool enabled;                   // false for the null() stream
+	bool binary;                    // arguments are encoded to args
+	std::string args;               // encoded arguments in binary mode
+
+	LogStream(LogLevel level = LDebug, const char* realm = "", int line = 0, const void* ptr = nullptr, const char* channel = nullptr);
+	LogStream(LogLevel level, const char* realm = "", const std::string& address = "");
+	LogStream(const LogStream& that); 
+	~LogStream(); 
+
+	static LogStream& null();
+		// Returns a shared stream which discards all input.
+		// Returned by the stream accessors for disabled levels.
+
+	LogStream& operator << (const LogLevel data) {
+#ifndef SCY_DISABLE_LOGGING
+		if (enabled)
+			level = data;
+#endif
+		return *this;
+	}
+
+	LogStream& operator << (LogChannel* data) {
+#ifndef SCY_DISABLE_LOGGING
+		if (enabled)
+			channel = data;
+#endif
+		return *this;
+	}
+
+	template<typename T>
+	LogStream& operator << (const T& data) {
+#ifndef SCY_DISABLE_LOGGING
+		if (enabled) {
+			if (binary && !logarg::encode(args, data))
+				text();
+			if (!binary)
+				message << data;
+		}
+#endif
+		return *this;
+	}
+
+	LogStream& operator << (std::ios_base&(*f)(std::ios_base&)) 
+		// Handle formatting flags such as std::hex.
+		// The flags apply to the following arguments, so the
+		// message is formatted as text in binary mode.
+	{
+#ifndef SCY_DISABLE_LOGGING
+		if (enabled) {
+			text();
+			message << f;
+		}
+#endif
+		return *this;
+	}
+
+	void text();
+		// Switches a binary mode stream to text mode by formatting
+		// the encoded arguments to the message. Used for messages 
+		// which depend on the stream formatting state.
+
+	LogStream& operator << (std::ostream&(*f)(std::ostream&)) 
+		// Handle std::endl flags.
+		// This method flushes the log message and queues it for write.
+		// WARNING: After using std::endl to flush the message pointer 
+		// should not be accessed.
+	{
+		if (!enabled)
+			return *this;
+#ifndef SCY_DISABLE_LOGGING		
+		if (!binary)
+			message << f;
+		else if (f == static_cast<std::ostream&(*)(std::ostream&)>(std::endl))
+			logarg::encode(args, '\n');
+
+		// Send to default channel
+		// Channel flag or stream operation
+		Logger::instance().write(this);
+#else
+		// Free the pointer
+		delete this;
+#endif
+		return *this;
+	}
+};
+
+
+struct LogVoidify
+	/// Converts a log statement to void so the log macros 
+	/// can skip disabled statements with a conditional.
+{
+	void operator & (LogStream&) {}
+};
+
+
+//
+// Inline stream accessors
+//
+// Disabled levels return the null() stream, so nothing
+// is allocated and operands are not formatted.
+//
+
+
+// Default output
+inline LogStream& traceL(const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LTrace) ? *new LogStream(LTrace, realm, 0, ptr) : LogStream::null(); }
+
+inline LogStream& debugL(const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LDebug) ? *new LogStream(LDebug, realm, 0, ptr) : LogStream::null(); }
+
+inline LogStream& infoL(const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LInfo) ? *new LogStream(LInfo, realm, 0, ptr) : LogStream::null(); }
+
+inline LogStream& warnL(const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LWarn) ? *new LogStream(LWarn, realm, 0, ptr) : LogStream::null(); }
+
+inline LogStream& errorL(const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LError) ? *new LogStream(LError, realm, 0, ptr) : LogStream::null(); }
+
+inline LogStream& fatalL(const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LFatal) ? *new LogStream(LFatal, realm, 0, ptr) : LogStream::null(); }
+
+
+// Channel output
+inline LogStream& traceC(const char* channel, const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LTrace) ? *new LogStream(LTrace, realm, 0, ptr, channel) : LogStream::null(); }
+
+inline LogStream& debugC(const char* channel, const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LDebug) ? *new LogStream(LDebug, realm, 0, ptr, channel) : LogStream::null(); }
+
+inline LogStream& infoC(const char* channel, const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LInfo) ? *new LogStream(LInfo, realm, 0, ptr, channel) : LogStream::null(); }
+
+inline LogStream& warnC(const char* channel, const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LWarn) ? *new LogStream(LWarn, realm, 0, ptr, channel) : LogStream::null(); }
+
+inline LogStream& errorC(const char* channel, const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LError) ? *new LogStream(LError, realm, 0, ptr, channel) : LogStream::null(); }
+
+inline LogStream& fatalC(const char* channel, const char* realm = "", const void* ptr = nullptr) 
+	{ return SCY_LOG_ENABLED(LFatal) ? *new LogStream(LFatal, realm, 0, ptr, channel) : LogStream::null(); }
+
+
+// Level output
+inline LogStream& printL(const char* level = "debug", const char* realm = "", const void* ptr = nullptr, const char* channel = nullptr) 
+	{ LogLevel l = getLogLevelFromString(level); return SCY_LOG_ENABLED(l) ? *new LogStream(l, realm, 0, ptr, channel) : LogStream::null(); }
+
+inline LogStream& printL(const char* level, const void* ptr, const char* realm = "", const char* channel = nullptr) 
+	{ LogLevel l = getLogLevelFromString(level); return SCY_LOG_ENABLED(l) ? *new LogStream(l, realm, 0, ptr, channel) : LogStream::null(); }
+
+
+// Macros for debug logging 
+//
+// Other useful macros for debug logging: __FILE__, __FUNCTION__, __LINE__
+// KLUDGE: Need a way to shorten __FILE__  which prints the entire relative path
+// __FUNCTION__ might need a fallback on some platforms
+//
+// Disabled statements cost a single branch; the stream is not 
+// allocated and the operands are not evaluated.
+#define SCY_LOG_IF(level) !SCY_LOG_ENABLED(level) ? (void)0 : scy::LogVoidify() & 
+#define TraceL SCY_LOG_IF(LTrace) *new LogStream(LTrace, __FUNCTION__, __LINE__)
+#define TraceLS(self) SCY_LOG_IF(LTrace) *new LogStream(LTrace, __FUNCTION__, __LINE__, self)
+#define DebugL SCY_LOG_IF(LDebug) *new LogStream(LDebug, __FUNCTION__, __LINE__)
+#define DebugLS(self) SCY_LOG_IF(LDebug) *new LogStream(LDebug, __FUNCTION__, __LINE__, self)
+#define InfoL SCY_LOG_IF(LInfo) *new LogStream(LInfo, __FUNCTION__, __LINE__)
+#define InfoLS(self) SCY_LOG_IF(LInfo) *new LogStream(LInfo, __FUNCTION__, __LINE__, self)
+#define WarnL SCY_LOG_IF(LWarn) *new LogStream(LWarn, __FUNCTION__, __LINE__)
+#define WarnLS(self) SCY_LOG_IF(LWarn) *new LogStream(LWarn, __FUNCTION__, __LINE__, self)
+#define ErrorL SCY_LOG_IF(LError) *new LogStream(LError, __FUNCTION__, __LINE__)
+#define ErrorLS(self) SCY_LOG_IF(LError) *new LogStream(LError, __FUNCTION__, __LINE__, self)
+
+
+//
+// Log Channel
+//
+
+
+class LogChannel
+{
+public:	
+	LogChannel(const std::string& name, LogLevel level = LDebug, const char* timeFormat = "%H:%M:%S");
+	virtual ~LogChannel() {}; 
+	
+	virtual void write(const LogStream& stream);
+	virtual void write(const std::string& message, LogLevel level = LDebug, 
+		const char* realm = "", const void* ptr = nullptr);
+	virtual void format(const LogStream& stream, std::ostream& ost);
+
+	virtual void writeBatch(const LogStream* const* streams, std::size_t count);
+		// Writes a batch of messages. The default implementation 
+		// writes each message in turn. The file and console channels
+		// format the batch into one buffer and write it at once.
+
+	virtual bool binary() const { return false; };
+		// Returns true if the channel records encoded arguments
+		// rather than formatted text.
+
+	std::string	name() const { return _name; };
+	LogLevel level() const { return _level; };
+	const char* timeFormat() const { return _timeFormat; };
+	
+	void setLevel(LogLevel level);
+	void setDateFormat(const char* format) { _timeFormat = format; };
+
+protected:
+	std::string _name;
+	std::atomic<LogLevel> _level;
+	const char* _timeFormat;
+};
+
+
+//
+// Console Channel
+//
+
+
+class ConsoleChannel: public LogChannel
+{		
+public:
+	ConsoleChannel(const std::string& name, LogLevel level = LDebug, const char* timeFormat = "%H:%M:%S");
+	virtual ~ConsoleChannel() {}; 
+		
+	virtual void write(const LogStream& stream);
+	virtual void writeBatch(const LogStream* const* streams, std::size_t count);
+};
+
+
+//
+// File Channel
+//
+
+
+class FileChannel: public LogChannel
+{	
+public:
+	FileChannel(
+		const std::string& name,
+		const std::string& path,
+		LogLevel level = LDebug, 
+		const char* timeFormat = "%H:%M:%S");
+	virtual ~FileChannel();
+	
+	virtual void write(const LogStream& stream);
+	virtual void writeBatch(const LogStream* const* streams, std::size_t count);
+	
+	void setPath(const std::string& path);
+	std::string	path() const;
+
+protected:
+	virtual void open();
+	virtual void close();
+
+protected:
+	std::ofstream	_fstream;
+	std::string		_path;
+};
+
+
+//
+// Rotating File Channel
+//
+
+
+class RotatingFileChannel: public LogChannel
+{	
+public:
+	RotatingFileChannel(
+		const std::string& name,
+		const std::string& dir,
+		LogLevel level = LDebug, 
+		const std::string& extension = "log", 
+		int rotationInterval = 12 * 3600, 
+		const char* timeFormat = "%H:%M:%S");
+	virtual ~RotatingFileChannel();
+	
+	virtual void write(const LogStream& stream);
+	virtual void writeBatch(const LogStream* const* streams, std::size_t count);
+	virtual void rotate();
+
+	std::string dir() const { return _dir; };
+	std::string filename() const { return _filename; };
+	int rotationInterval() const { return _rotationInterval; };
+	
+	void setDir(const std::string& dir) { _dir = dir; };
+	void setExtension(const std::string& ext) { _extension = ext; };
+	void setRotationInterval(int interval) { _rotationInterval = interval; };
+
+protected:
+	std::ofstream* _fstream;
+	std::string    _dir;
+	std::string    _filename;
+	std::string    _extension;
+	int            _rotationInterval;    // The log rotation interval in seconds
+	time_t         _rotatedAt;           // The time the log was last rotated
+};
+
+
+#if 0
+class EventedFileChannel: public FileChannel
+{	
+public:
+	EventedFileChannel(
+		const std::string& name,
+		const std::string& dir,
+		LogLevel level = LDebug, 
+		const std::string& extension = "log", 
+		int rotationInterval = 12 * 3600, 
+		const char* timeFormat = "%H:%M:%S");
+	virtual ~EventedFileChannel();
+	
+	virtual void write(const std::string& message, LogLevel level = LDebug, 
+		const char* realm = "", const void* ptr = nullptr);
+	virtual void write(const LogStream& stream);
+
+	Signal3<const std::string&, LogLevel&, const Polymorphic*&> OnLogStream;
+};
+#endif
+
+
+} // namespace scy
+
+
+#endif
\ No newline at end of file
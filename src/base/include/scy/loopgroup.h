@@ -0,0 +1,140 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_LoopGroup_H
+#define SCY_LoopGroup_H
+
+
+#include "scy/application.h"
+#include "scy/syncdispatcher.h"
+#include "scy/thread.h"
+#include "scy/mutex.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+namespace scy {
+
+
+class LoopGroup
+	/// LoopGroup runs a fixed set of event loops, each on its own
+	/// thread and driven by its own Application, so a server can
+	/// spread its connections over every core of the machine.
+	///
+	/// Handles and sockets belong to the loop they were created on
+	/// and must only be used from that loop's thread. Work is handed
+	/// to a specific loop with post(), which goes through the loop's
+	/// shared SyncDispatcher. Each loop takes part in garbage 
+	/// collection, so deleteLater() frees pointers on the loop
+	/// which retired them.
+	///
+	/// Connections accepted by a TCPSocket can be spread over the
+	/// group with TCPSocket::setAcceptGroup().
+	///
+	/// The accessors below may be called from any thread while the
+	/// group is running, but not concurrently with start() or stop().
+{
+public:
+	LoopGroup(int size = 0, bool pinThreads = true);
+		// Creates a group of the given number of loops, or one loop
+		// per CPU core if size is zero. When pinThreads is set each
+		// loop thread is pinned to a core, where supported.
+
+	virtual ~LoopGroup();
+		// Stops the group if it is still running.
+
+	void start();
+		// Starts the loop threads and waits until every loop
+		// is ready to accept posted work.
+
+	void stop();
+		// Stops the loops and joins their threads. Must not be
+		// called from a group loop. Sockets and other handles
+		// created on the group loops should be closed first;
+		// loops which still own handles are leaked with a warning.
+
+	bool running() const;
+
+	std::size_t size() const;
+		// Returns the number of loops in the group.
+
+	uv::Loop* loop(std::size_t index) const;
+		// Returns the loop at the given index.
+
+	uv::Loop* next();
+		// Returns the next loop in round-robin order.
+		// May be called from any thread.
+
+	uv::Loop* select(std::size_t hash) const;
+		// Returns the loop owning the given hash, so related work
+		// such as connections from the same peer shares a loop.
+
+	uv::Loop* current() const;
+		// Returns the group loop run by the calling thread,
+		// or nullptr if called from outside the group.
+
+	int indexOf(uv::Loop* loop) const;
+		// Returns the index of the given loop, or -1.
+
+	void post(std::size_t index, Closure fn);
+		// Runs a closure on the loop at the given index.
+		// May be called from any thread.
+
+	SyncDispatcher& dispatcher(std::size_t index) const;
+		// Returns the dispatcher for the loop at the given index.
+
+	static int numCores();
+		// Returns the number of CPU cores, or 1 if unknown.
+
+protected:
+	LoopGroup(const LoopGroup&); // = delete;
+	LoopGroup& operator = (const LoopGroup&); // = delete;
+
+	struct Worker
+	{
+		int index;
+		int cpu;						// Core to pin to, or -1
+		uv::Loop* loop;
+		SyncDispatcher* dispatcher;
+		SyncContext* keepAlive;			// Keeps the loop alive until stopped
+		unsigned long tid;
+		std::unique_ptr<Thread> thread;
+	};
+
+	void runWorker(Worker* worker);
+		// Thread entry point for each loop.
+
+	std::vector<Worker*> _workers;
+	std::atomic<std::size_t> _next;
+	int _size;
+	bool _pinThreads;
+	bool _running;
+	bool _stopping;
+	int _ready;
+	mutable Mutex _mutex;
+	Condition _cond;
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_LoopGroup_H
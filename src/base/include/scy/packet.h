@@ -0,0 +1,448 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Packet_H
+#define SCY_Packet_H
+
+
+#include "scy/types.h"
+#include "scy/bitwise.h"
+#include "scy/interface.h"
+#include "scy/buffer.h"
+#include "scy/bufferpool.h"
+#include "scy/packetpool.h"
+#include "scy/logger.h"
+
+#include <list>
+#include <cstring> // memcpy
+#include <stdexcept>
+
+
+namespace scy {
+	
+	
+struct IPacketInfo
+	// An abstract interface for packet sources to
+	// provide extra information about packets.
+{ 
+	IPacketInfo() {}; 
+	virtual ~IPacketInfo() {}; 
+
+	virtual IPacketInfo* clone() const = 0;
+};
+
+
+class IPacket: public basic::Polymorphic
+	// The basic packet type which is passed around the LibSourcey system.
+	// IPacket can be extended for each protocol to enable polymorphic
+	// processing and callbacks using PacketStream and friends.
+{ 
+public:
+	IPacket(void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr, unsigned flags = 0) : 
+		source(source), opaque(opaque), info(info), flags(flags) {}
+	
+	IPacket(const IPacket& r) : 
+		source(r.source),
+		opaque(r.opaque),
+		info(r.info ? r.info->clone() : nullptr),
+		flags(r.flags)
+	{
+	}
+		
+	IPacket& operator = (const IPacket& r) 
+	{
+		source = r.source;
+		opaque = r.opaque;
+		info = (r.info ? r.info->clone() : nullptr);
+		flags = r.flags;
+		return *this;
+	}
+	
+	virtual IPacket* clone() const = 0;	
+
+	virtual ~IPacket() 
+	{
+		if (info) delete info;
+	}
+
+	void* source;
+		// Packet source pointer reference which enables processors
+		// along the signal chain can determine the packet origin.
+		// Often a subclass of PacketStreamSource.
+
+	void* opaque;
+		// Optional client data pointer.
+		// This pointer is not managed by the packet.
+
+	IPacketInfo* info;
+		// Optional extra information about the packet.
+		// This pointer is managed by the packet.
+
+	Bitwise flags;
+		// Provides basic information about the packet.	
+		
+	virtual std::size_t read(const ConstBuffer&) = 0;
+		// Read/parse to the packet from the given input buffer.
+		// The number of bytes read is returned.
+	
+	virtual void write(Buffer&) const = 0;
+		// Copy/generate to the packet given output buffer.
+		// The number of bytes written can be obtained from the buffer.
+
+	virtual std::size_t write(MutableBuffer& buf) const
+		// Copy/generate the packet into the given fixed size buffer,
+		// which should hold at least size() bytes.
+		// Returns the number of bytes written, or zero if the buffer
+		// is too small, in which case the buffer is left untouched.
+		//
+		// The default implementation copies the output of write(Buffer&),
+		// so packet types should override this method to avoid the
+		// temporary allocation.
+	{
+		Buffer tmp;
+		write(tmp);
+		if (tmp.size() > buf.size())
+			return 0;
+		std::memcpy(buf.data(), tmp.data(), tmp.size());
+		return tmp.size();
+	}
+
+	virtual void write(BufferChain& chain) const
+		// Generates the packet as a chain of buffer segments for
+		// scatter-gather output. Implementations may reference their
+		// own payload memory rather than copying it, so the packet
+		// must outlive the chain.
+		//
+		// The default implementation copies the output of write(Buffer&).
+	{
+		Buffer buf;
+		write(buf);
+		chain.write(buf.data(), buf.size());
+	}
+
+	virtual std::size_t size() const { return 0; };
+		// The size of the packet in bytes.
+		//
+		// This is the exact number of bytes that will be written on a 
+		// call to write(), but may not be the number of bytes that will 
+		// be consumed by read().
+	
+	virtual bool hasData() const { return data() != nullptr; }
+	virtual char* data() const { return nullptr; }
+		// The packet data pointer for buffered packets.
+
+	virtual const char* className() const = 0;
+	virtual void print(std::ostream& os) const { os << className() << std::endl; }
+	
+    friend std::ostream& operator << (std::ostream& stream, const IPacket& p) 
+	{
+		p.print(stream);
+		return stream;
+    }
+};
+
+
+class RawPacket: public IPacket 
+	/// RawPacket is the default data packet type which consists
+	/// of an optionally managed char pointer and a size value.
+	///
+	/// A RawPacket may also reference a slice of a PooledBuffer, in
+	/// which case copies of the packet share the block by reference
+	/// rather than copying the data.
+{	
+public:
+	RawPacket(char* data = nullptr, std::size_t size = 0, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr) : 
+		IPacket(source, opaque, info, flags), _data(data), _size(size), _free(false), _pooled(nullptr), _allocated(false)
+	{
+	}
+
+	RawPacket(const char* data, std::size_t size = 0, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr) : 
+		IPacket(source, opaque, info, flags), _data(nullptr), _size(size), _free(true), _pooled(nullptr), _allocated(false)
+	{
+		copyData(data, size); // copy const data
+	}
+
+	RawPacket(PooledBuffer* block, char* data, std::size_t size, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr) : 
+		IPacket(source, opaque, info, flags), _data(nullptr), _size(0), _free(false), _pooled(nullptr), _allocated(false)
+		// Creates a packet which references the given slice of a 
+		// pooled block. The block is retained for the packet lifetime.
+	{
+		setPooledData(block, data, size);
+	}
+
+	RawPacket(const RawPacket& that) : 
+		IPacket(that), _data(nullptr), _size(0), _free(false), _pooled(nullptr), _allocated(false)
+	{		
+		// Pooled data is shared by reference, 
+		// otherwise copy the data and take ownership.
+		if (that._pooled)
+			setPooledData(that._pooled, that._data, that._size);
+		else {
+			assignDataOwnership();
+			copyData(that._data, that._size);
+		}
+	}
+	
+	virtual ~RawPacket() 
+	{
+		freeData();
+	}
+
+	static void* operator new(std::size_t size) { return PacketPool::allocate(size); }
+	static void operator delete(void* ptr) { PacketPool::deallocate(ptr); }
+		// Packets and their copied data are allocated from the
+		// PacketPool, so clone() avoids the system allocator.
+
+	virtual IPacket* clone() const 
+	{
+		return new RawPacket(*this);
+	}
+
+	virtual void setData(char* data, std::size_t size) 
+	{
+		assert(size > 0);
+
+		// Copy data if reuqests
+		if (_free)
+			copyData(data, size);
+
+		// Otherwise just assign the pointer
+		else {
+			releasePooledData();
+			_data = data;
+			_size = size; 
+		}
+	}
+
+	virtual void setPooledData(PooledBuffer* block, char* data, std::size_t size) 
+		// Reference the given slice of a pooled block without copying.
+	{
+		assert(block && block->contains(data, size));
+		block->duplicate();
+		freeData();
+		_pooled = block;
+		_data = data;
+		_size = size;
+		_free = false;
+	}
+
+	virtual void copyData(const char* data, std::size_t size) 
+	{
+		//traceL("RawPacket", this) << "Cloning: " << size << std::endl;
+
+		//assert(_free);
+		assert(size > 0);
+		freeData();
+		_size = size;
+		_data = reinterpret_cast<char*>(PacketPool::allocate(size));
+		_free = true;
+		_allocated = true;
+		std::memcpy(_data, data, size);
+	}	
+	
+	virtual std::size_t read(const ConstBuffer& buf) 
+	{ 
+		copyData(bufferCast<const char*>(buf), buf.size());
+		return true;
+	}
+
+	// Old Read API
+	//
+	// virtual bool read(const ConstBuffer& buf) 
+	// { 
+	//	 return true;
+	// }
+	
+	virtual void write(Buffer& buf) const 
+	{	
+		buf.insert(buf.end(), _data, _data + _size); 
+		//buf.insert(a.end(), b.begin(), b.end());
+		//buf.append(_data, _size); 
+	}
+
+	virtual void write(BufferChain& chain) const 
+	{	
+		chain.append(_data, _size); 
+	}
+	
+	virtual std::size_t write(MutableBuffer& buf) const 
+	{	
+		if (_size > buf.size())
+			return 0;
+		std::memcpy(buf.data(), _data, _size);
+		return _size;
+	}
+
+	virtual char* data() const 
+	{ 
+		return _data; 
+	}
+
+	virtual std::size_t size() const 
+	{ 
+		return _size; 
+	}
+	
+	virtual const char* className() const 
+	{ 
+		return "RawPacket"; 
+	}
+
+	virtual bool ownsBuffer() const
+	{
+		return _free;
+	}
+	
+	virtual void assignDataOwnership()
+	{
+		_free = true;
+	}
+
+	PooledBuffer* pooledBuffer() const
+		// Returns the referenced pooled block, if any.
+	{
+		return _pooled;
+	}
+	
+	char* _data;
+	size_t _size;
+	bool _free;
+	PooledBuffer* _pooled;
+
+protected:
+	void releasePooledData()
+	{
+		if (_pooled) {
+			_pooled->release();
+			_pooled = nullptr;
+		}
+	}
+
+	void freeData()
+	{
+		releasePooledData();
+		if (_data && _free) {
+			if (_allocated)
+				PacketPool::deallocate(_data);
+			else
+				delete [] _data;
+		}
+		_data = nullptr;
+		_allocated = false;
+	}
+
+	bool _allocated; // data was allocated by PacketPool
+};
+
+
+//
+// Buffer Chain Packet
+//
+
+
+class BufferChainPacket: public IPacket 
+	/// BufferChainPacket carries a BufferChain so that framed output,
+	/// such as protocol headers around a payload, can be emitted as a
+	/// single packet and sent with one scatter-gather write.
+	///
+	/// Referenced segments are not owned by the packet, so clone()
+	/// returns a RawPacket holding a flat copy of the chain.
+{	
+public:
+	BufferChainPacket(unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr) : 
+		IPacket(source, opaque, info, flags)
+	{
+	}
+	
+	virtual ~BufferChainPacket() 
+	{
+	}
+
+	virtual IPacket* clone() const 
+	{
+		std::size_t len = chain.size();
+		char* data = new char[len];
+		chain.copyTo(data, len);
+		auto packet = new RawPacket(data, len, flags.data, source, opaque, info ? info->clone() : nullptr);
+		packet->assignDataOwnership();
+		return packet;
+	}
+
+	virtual std::size_t read(const ConstBuffer& buf) 
+	{
+		chain.write(bufferCast<const char*>(buf), buf.size());
+		return buf.size();
+	}
+	
+	virtual void write(Buffer& buf) const 
+	{	
+		chain.flatten(buf);
+	}
+
+	virtual void write(BufferChain& chain) const 
+	{	
+		chain.append(this->chain);
+	}
+
+	virtual std::size_t write(MutableBuffer& buf) const 
+	{	
+		if (chain.size() > buf.size())
+			return 0;
+		return chain.copyTo(bufferCast<char*>(buf), buf.size());
+	}
+
+	virtual std::size_t size() const 
+	{ 
+		return chain.size(); 
+	}
+	
+	virtual const char* className() const 
+	{ 
+		return "BufferChainPacket"; 
+	}
+
+	BufferChain chain;
+};
+
+
+inline RawPacket rawPacket(const MutableBuffer& buf, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr)
+{
+	return RawPacket(bufferCast<char*>(buf), buf.size(), flags, source, opaque, info);
+}
+
+inline RawPacket rawPacket(const ConstBuffer& buf, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr)
+{		
+	return RawPacket(bufferCast<const char*>(buf), buf.size(), flags, source, opaque, info);  // copy const data
+}
+
+inline RawPacket rawPacket(char* data = nullptr, std::size_t size = 0, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr)
+{	
+	return RawPacket(data, size, flags, source, opaque, info);
+}
+
+inline RawPacket rawPacket(const char* data = nullptr, std::size_t size = 0, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr)
+{	
+	return RawPacket(data, size, flags, source, opaque, info);  // copy const data
+}
+
+
+} // namespace scy
+
+
+#endif // SCY_Packet_H
@@ -0,0 +1,86 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_PacketPool_H
+#define SCY_PacketPool_H
+
+
+#include "scy/types.h"
+
+#include <cstddef>
+
+
+namespace scy {
+
+
+class PacketPool
+	/// PacketPool is a size-classed block allocator for packet objects
+	/// and packet data, so that cloning packets into queues does not hit
+	/// the system allocator in the steady state.
+	///
+	/// Blocks are grouped into power of two size classes. Each thread
+	/// keeps a bounded free list per size class, and surplus blocks are
+	/// moved to a shared free list from which other threads refill.
+	/// This suits producer/consumer queues, where packets are cloned
+	/// on one thread and freed on another. The shared lists are bounded
+	/// too, and blocks beyond their limit are freed to the system.
+	///
+	/// Blocks may be freed from any thread. Requests larger than the
+	/// largest size class are passed to the system allocator.
+{
+public:
+	struct Stats
+	{
+		UInt64 hits;
+			// Allocations served from a free list.
+
+		UInt64 misses;
+			// Allocations which required a new block.
+
+		UInt64 oversized;
+			// Allocations too large to be pooled.
+
+		UInt64 released;
+			// Freed blocks given back to the system 
+			// because the shared free lists were full.
+	};
+
+	static void* allocate(std::size_t size);
+		// Returns a block of at least size bytes.
+		// Throws std::bad_alloc if memory cannot be allocated.
+
+	static void deallocate(void* ptr);
+		// Returns a block obtained from allocate() to the pool.
+		// Null pointers are ignored.
+
+	static Stats stats();
+		// Returns the allocation counters.
+
+	static void resetStats();
+		// Resets the allocation counters to zero.
+
+	static const std::size_t kMaxBlockSize = 256 * 1024;
+		// The largest pooled block size, including the block header.
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_PacketPool_H
@@ -0,0 +1,170 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_PacketQueue_H
+#define SCY_PacketQueue_H
+
+
+#include "scy/packetstream.h"
+#include "scy/synccontext.h"
+
+
+namespace scy {
+	
+
+//
+// Synchronization Packet Queue
+//
+
+
+class SyncPacketQueue: public SyncQueue<IPacket>, public PacketProcessor
+{
+public:
+	SyncPacketQueue(uv::Loop* loop, int maxSize = 1024);
+	SyncPacketQueue(int maxSize = 1024);
+	virtual ~SyncPacketQueue();
+
+	virtual void process(IPacket& packet);
+	virtual bool threadSafe() const { return true; };
+
+	PacketSignal emitter;
+
+protected:	
+	virtual void dispatch(IPacket& packet);
+
+	virtual bool dispatchNext();
+		// Emits waiting packets as a batch.
+
+	virtual bool droppable(const IPacket& packet) const;
+
+	virtual void onStreamStateChange(const PacketStreamState&);
+};
+
+
+//
+// Asynchronous Packet Queue
+//
+
+
+class AsyncPacketQueue: public AsyncQueue<IPacket>, public PacketProcessor
+{
+public:
+	AsyncPacketQueue(int maxSize = 1024);
+	virtual ~AsyncPacketQueue();
+
+	virtual void process(IPacket& packet);
+	virtual bool threadSafe() const { return true; };
+	
+	PacketSignal emitter;
+
+protected:	
+	virtual void dispatch(IPacket& packet);
+
+	virtual bool dispatchNext();
+		// Emits waiting packets as a batch.
+
+	virtual bool droppable(const IPacket& packet) const;
+
+	virtual void onStreamStateChange(const PacketStreamState&);
+};
+
+
+//
+// Packet Stage Queue
+//
+
+
+class PacketStageQueue: public PacketProcessor
+	/// PacketStageQueue links two stages of a pipelined PacketStream.
+	///
+	/// Packets processed by the previous stage are cloned onto a bounded
+	/// single producer, single consumer ring, and emitted to the next 
+	/// stage from a dedicated worker thread in the order they were 
+	/// received. When the ring is full the producing stage blocks until 
+	/// the worker makes room, so a slow stage throttles its upstream 
+	/// stages rather than dropping packets.
+	///
+	/// Stream states are passed to the queue before the next stage.
+	/// The queue drains its worker first, so processors of the next
+	/// stage never see a state while they are processing a packet.
+	///
+	/// See PacketStream::attachStage()
+{
+public:
+	PacketStageQueue(int capacity = 64);
+	virtual ~PacketStageQueue();
+
+	virtual void process(IPacket& packet);
+		// Pushes a packet onto the ring, blocking while it is full.
+		// Must only be called from one thread at a time.
+
+	void flush();
+		// Blocks until the worker has emitted all queued packets.
+
+	void cancel();
+		// Stops the worker thread. Queued packets are discarded.
+
+	bool cancelled() const;
+
+	std::size_t size() const;
+		// Returns the number of queued packets.
+
+	std::function<void(const std::exception&)> onerror;
+		// Called from the worker thread when a processor of the 
+		// next stage throws. Must be set before packets are queued.
+
+	PacketSignal emitter;
+
+protected:
+	virtual void run();
+		// Emits queued packets until the queue is cancelled.
+
+	virtual void onStreamStateChange(const PacketStreamState&);
+
+	bool worker() const;
+		// Returns true if called from the worker thread.
+
+	void join();
+		// Joins the worker thread once, unless called from it.
+
+	void waitForPackets();
+		// Blocks the worker until a packet is queued.
+
+	void wait(const std::function<bool()>& ready);
+		// Blocks a producer or flushing thread until ready() 
+		// returns true or the queue is cancelled.
+
+	SPSCQueue<IPacket*> _ring;
+	std::atomic<int> _pending;          // queued packets and the packet being emitted
+	std::atomic<int> _waiters;          // threads blocked in wait()
+	std::atomic<bool> _sleeping;        // the worker is blocked in waitForPackets()
+	std::atomic<bool> _cancelled;
+	std::atomic<unsigned long> _workerID;
+	std::atomic<bool> _joined;
+	mutable Mutex _mutex;
+	Condition _packets;
+	Condition _space;
+	Thread _thread;
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_PacketQueue_H
\ No newline at end of file
@@ -0,0 +1,1072 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Queue_H
+#define SCY_Queue_H
+
+
+#include "scy/interface.h"
+#include "scy/thread.h"
+#include "scy/platform.h"
+#include "scy/synccontext.h"
+#include "scy/datetime.h"
+#include "scy/packetpool.h"
+#include "scy/signal.h"
+#include <queue>
+#include <atomic>
+#include <cstdint>
+
+
+namespace scy {
+
+	
+template<typename T>
+class Queue
+	/// Implements a thread-safe queue container.
+	/// TODO: Iterators
+{
+private:
+    std::queue<T> _queue;
+	mutable Mutex _mutex;
+
+public:
+    void push(const T& data)
+    {
+		Mutex::ScopedLock lock(_mutex);
+        _queue.push(data);
+    }
+
+    bool empty() const
+    {
+		//Mutex::ScopedLock lock(_mutex);
+        return _queue.empty();
+    }
+
+    T& front()
+    {
+		Mutex::ScopedLock lock(_mutex);
+        return _queue.front();
+    }
+    
+    T const& front() const
+    {
+		Mutex::ScopedLock lock(_mutex);
+        return _queue.front();
+    }
+
+    T& back()
+    {
+		Mutex::ScopedLock lock(_mutex);
+        return _queue.back();
+    }
+    
+    T const& back() const
+    {
+		Mutex::ScopedLock lock(_mutex);
+        return _queue.back();
+    }
+
+    void pop()
+    {
+		Mutex::ScopedLock lock(_mutex);
+        _queue.pop();
+    }
+
+    void popFront()
+    {
+		Mutex::ScopedLock lock(_mutex);
+        _queue.pop_front();
+    }
+};
+
+
+//
+// MPSC Queue
+//
+
+
+template<typename T>
+class MPSCQueue
+	/// MPSCQueue is an unbounded lock-free FIFO queue for multiple
+	/// producers and a single consumer, based on Dmitry Vyukov's 
+	/// MPSC node queue.
+	///
+	/// push() may be called from any thread and never blocks.
+	/// pop() and empty() must only be called from one consumer
+	/// thread at a time. Nodes are allocated from the PacketPool.
+{
+public:
+	MPSCQueue() : 
+		_head(&_stub), 
+		_tail(&_stub)
+	{
+		_stub.next.store(nullptr);
+	}
+
+	~MPSCQueue()
+	{
+		T value;
+		while (pop(value))
+			;
+		if (_tail != &_stub)
+			freeNode(_tail);
+	}
+
+	void push(const T& value)
+		// Pushes a value onto the queue.
+	{
+		link(new (PacketPool::allocate(sizeof(Node))) Node(value));
+	}
+
+	void push(T&& value)
+		// Pushes a value onto the queue by moving it.
+	{
+		link(new (PacketPool::allocate(sizeof(Node))) Node(std::move(value)));
+	}
+
+	bool pop(T& value)
+		// Pops the oldest value from the queue.
+		// Returns false if the queue is empty.
+	{
+		Node* tail = _tail;
+		Node* next = tail->next.load();
+		if (!next)
+			return false;
+
+		// The popped node becomes the new stub
+		value = std::move(next->value);
+		_tail = next;
+		if (tail != &_stub)
+			freeNode(tail);
+		return true;
+	}
+
+	bool empty() const
+		// Returns true if no pushed value is visible to the consumer.
+	{
+		return _tail->next.load() == nullptr;
+	}
+
+protected:
+	MPSCQueue(const MPSCQueue&); // = delete;
+	MPSCQueue& operator = (const MPSCQueue&); // = delete;
+
+	struct Node
+	{
+		std::atomic<Node*> next;
+		T value;
+
+		Node() : next(nullptr), value() {}
+		Node(const T& value) : next(nullptr), value(value) {}
+		Node(T&& value) : next(nullptr), value(std::move(value)) {}
+	};
+
+	void link(Node* node)
+	{
+		Node* prev = _head.exchange(node);
+		prev->next.store(node);
+	}
+
+	static void freeNode(Node* node)
+	{
+		node->~Node();
+		PacketPool::deallocate(node);
+	}
+
+	std::atomic<Node*> _head;
+	Node* _tail;
+	Node _stub;
+};
+
+
+//
+// SPSC Queue
+//
+
+
+template<typename T>
+class SPSCQueue
+	/// SPSCQueue is a bounded lock-free FIFO ring buffer for a
+	/// single producer and a single consumer.
+	///
+	/// push() must only be called from one producer thread at a time,
+	/// and pop() from one consumer thread at a time. The capacity is
+	/// rounded up to a power of two.
+{
+public:
+	SPSCQueue(std::size_t capacity) : 
+		_head(0), 
+		_tail(0)
+	{
+		std::size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		_mask = size - 1;
+		_ring = new T[size];
+	}
+
+	~SPSCQueue()
+	{
+		delete [] _ring;
+	}
+
+	bool push(const T& value)
+		// Pushes a value onto the queue.
+		// Returns false if the queue is full.
+	{
+		std::size_t head = _head.load(std::memory_order_relaxed);
+		if (head - _tail.load(std::memory_order_acquire) > _mask)
+			return false;
+		_ring[head & _mask] = value;
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& value)
+		// Pops the oldest value from the queue.
+		// Returns false if the queue is empty.
+	{
+		std::size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail == _head.load(std::memory_order_acquire))
+			return false;
+		value = _ring[tail & _mask];
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const
+	{
+		return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+	}
+
+	bool full() const
+	{
+		return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire) > _mask;
+	}
+
+	std::size_t size() const
+	{
+		return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+	}
+
+	std::size_t capacity() const
+	{
+		return _mask + 1;
+	}
+
+protected:
+	SPSCQueue(const SPSCQueue&); // = delete;
+	SPSCQueue& operator = (const SPSCQueue&); // = delete;
+
+	T* _ring;
+	std::size_t _mask;
+	std::atomic<std::size_t> _head;     // written by the producer
+	char _pad[64];                      // keeps the indexes on separate cache lines
+	std::atomic<std::size_t> _tail;     // written by the consumer
+};
+
+
+//
+// MPMC Queue
+//
+
+
+template<typename T>
+class MPMCQueue
+	/// MPMCQueue is a bounded lock-free FIFO ring buffer for multiple
+	/// producers and multiple consumers, based on Dmitry Vyukov's 
+	/// bounded MPMC queue.
+	///
+	/// push() and pop() may be called from any thread. Each cell
+	/// carries a sequence number which tells producers and consumers
+	/// whether it is free or holds a value for the current lap.
+	/// The capacity is rounded up to a power of two.
+{
+public:
+	MPMCQueue(std::size_t capacity) : 
+		_head(0), 
+		_tail(0)
+	{
+		std::size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		_mask = size - 1;
+		_ring = new Cell[size];
+		for (std::size_t i = 0; i < size; i++)
+			_ring[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	~MPMCQueue()
+	{
+		delete [] _ring;
+	}
+
+	bool push(const T& value)
+		// Pushes a value onto the queue.
+		// Returns false if the queue is full.
+	{
+		Cell* cell;
+		std::size_t pos = _head.load(std::memory_order_relaxed);
+		for (;;) {
+			cell = &_ring[pos & _mask];
+			std::intptr_t diff = static_cast<std::intptr_t>(cell->seq.load(std::memory_order_acquire)) - 
+				static_cast<std::intptr_t>(pos);
+			if (diff == 0) {
+				if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = _head.load(std::memory_order_relaxed);
+		}
+		cell->value = value;
+		cell->seq.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& value)
+		// Pops the oldest value from the queue.
+		// Returns false if the queue is empty, or if the oldest
+		// value is still being written by its producer.
+	{
+		Cell* cell;
+		std::size_t pos = _tail.load(std::memory_order_relaxed);
+		for (;;) {
+			cell = &_ring[pos & _mask];
+			std::intptr_t diff = static_cast<std::intptr_t>(cell->seq.load(std::memory_order_acquire)) - 
+				static_cast<std::intptr_t>(pos + 1);
+			if (diff == 0) {
+				if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = _tail.load(std::memory_order_relaxed);
+		}
+		value = cell->value;
+		cell->seq.store(pos + _mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	std::size_t capacity() const
+	{
+		return _mask + 1;
+	}
+
+protected:
+	MPMCQueue(const MPMCQueue&); // = delete;
+	MPMCQueue& operator = (const MPMCQueue&); // = delete;
+
+	struct Cell
+	{
+		std::atomic<std::size_t> seq;
+		T value;
+	};
+
+	Cell* _ring;
+	std::size_t _mask;
+	std::atomic<std::size_t> _head;     // written by producers
+	char _pad[64];                      // keeps the indexes on separate cache lines
+	std::atomic<std::size_t> _tail;     // written by consumers
+};
+
+
+//
+// Runnable Queue
+//
+
+
+enum OverflowPolicy
+	/// Determines how a bounded RunnableQueue behaves when items
+	/// are pushed faster than the consumer can dispatch them.
+{
+	DropOldest = 0,     // Discard the oldest queued items (default).
+	DropNewest,         // Discard the item being pushed.
+	DropNonKeyframe,    // Discard droppable items being pushed, and all following
+	                    // droppable items until the next non-droppable item or
+	                    // until the queue drains to the low watermark. Behaves
+	                    // as DropOldest until a non-droppable item is pushed.
+	BlockProducer       // Block the producer until the consumer makes room or the
+	                    // block timeout expires, then discard the item being pushed.
+};
+
+
+template<class T>
+class RunnableQueue: public async::Runnable
+	// RunnableQueue dispatches items which are pushed from any
+	// thread to the single thread which calls run().
+	//
+	// push() is lock-free. A limited queue keeps its items in a
+	// bounded MPMCQueue, so producers can evict the oldest items
+	// without locking out the consumer. When run() has no timeout the consumer 
+	// blocks on a condition while the queue is empty, and is woken 
+	// by the next push() or by cancel().
+	//
+	// When a limit is set the OverflowPolicy decides which items are
+	// discarded once the limit is reached. Producers may listen to the
+	// HighWatermark and LowWatermark signals to throttle themselves
+	// before items are dropped.
+{
+public:
+	RunnableQueue(int limit = 2048, int timeout = 0) :
+		_limit(limit), 
+		_timeout(timeout),
+		_policy(DropOldest),
+		_blockTimeout(0),
+		_highWatermark(limit),
+		_lowWatermark(limit / 2),
+		_size(0),
+		_blocked(0),
+		_dropped(0),
+		_sleeping(false),
+		_overflowed(false),
+		_skipping(false),
+		_keyed(false),
+		_ring(limit > 0 ? new MPMCQueue<T*>(2 * limit) : nullptr)
+	{
+	}
+
+	virtual ~RunnableQueue() 
+	{
+		clear();
+		delete _ring;
+	}
+
+	std::function<void(T&)> ondispatch;
+		// The default dispatch function.
+		// Must be set before the queue is running.
+
+	NullSignal HighWatermark;
+		// Signals when the queue size reaches the high watermark.
+		// Emitted from the producer thread which pushed the item.
+
+	NullSignal LowWatermark;
+		// Signals when the queue has drained to the low watermark
+		// after reaching the high watermark.
+		// Emitted from the consumer thread.
+		
+	virtual void dispatch(T& item)
+		// Dispatch a single item to listeners.
+	{
+		if (ondispatch)
+			ondispatch(item);
+	}
+	
+	virtual void push(T* item)
+		// Push an item onto the queue.
+		// The queue takes ownership of the item pointer.
+		// If the limit is reached the item may be discarded,
+		// or the caller blocked, depending on the OverflowPolicy.
+	{
+		if (_limit > 0 && !admit(item))
+			return;
+		if (!enqueue(item))
+			return;
+
+		// Count the item once it is linked, so the consumer 
+		// never waits on an item which it can not pop yet
+		int size = _size.fetch_add(1) + 1;
+		if (_limit > 0 && size > _limit && evicts())
+			size = evictOldest();
+		wakeup();
+		if (_highWatermark > 0 && size >= _highWatermark)
+			raiseWatermark(size);
+	}
+	
+	virtual void flush()
+		// Flushes all outgoing items.
+	{
+		do {
+			// scy::sleep(1);
+		}
+		while (dispatchNext());			
+	}
+	
+	void clear()
+		// Clears all queued items.
+		// Must not be called while another thread is dispatching.
+	{
+		T* item;
+		while (dequeue(item)) {
+			_size.fetch_sub(1);
+			delete item;
+		}
+		wakeProducers();
+	}
+	
+	bool empty()
+	{
+		return _size.load() <= 0;
+	}
+	
+	std::size_t size()
+	{
+		int size = _size.load();
+		return size > 0 ? static_cast<std::size_t>(size) : 0;
+	}
+	
+	virtual void run()
+		// Called asynchronously to dispatch queued items.
+		// If not timeout is set this method blocks until cancel()
+		// is called, otherwise runTimeout() will be called.
+		// Pseudo protected for std::bind compatability.
+	{
+		if (_timeout) {
+			runTimeout();
+		}
+		else {
+			while (!cancelled()) {
+				if (!dispatchNext())
+					waitForItems();
+			}
+		}
+	}
+	
+	virtual void runTimeout()
+		// Called asynchronously to dispatch queued items
+		// until the queue is empty or the timeout expires.
+		// Pseudo protected for std::bind compatability.
+	{
+		Stopwatch sw;
+		sw.start();
+		do {
+			// scy::sleep(1);
+		}
+		while (!cancelled() && sw.elapsedMilliseconds() < _timeout && dispatchNext());
+	}
+	
+	virtual void cancel(bool flag = true)
+		// Cancels the queue and wakes the consumer
+		// and any blocked producers.
+	{
+		async::Runnable::cancel(flag);
+		Mutex::ScopedLock lock(_mutex);
+		_cond.signal();
+		_space.broadcast();
+	}
+	
+	int timeout()	
+	{
+		Mutex::ScopedLock lock(_mutex);
+		return _timeout;
+	}
+	
+	void setTimeout(int miliseconds)
+	{
+		Mutex::ScopedLock lock(_mutex);
+		assert(empty() && "queue must not be active");
+		_timeout = miliseconds;
+	}
+
+	int limit() const
+	{
+		return _limit;
+	}
+
+	void setOverflowPolicy(OverflowPolicy policy, int blockTimeout = 100)
+		// Sets the policy which is applied when the limit is reached.
+		// The blockTimeout is the maximum number of milliseconds a 
+		// producer is blocked by the BlockProducer policy, or zero
+		// to block until there is room or the queue is cancelled.
+		// Must be set before the queue is active.
+	{
+		Mutex::ScopedLock lock(_mutex);
+		assert(empty() && "queue must not be active");
+		_policy = policy;
+		_blockTimeout = blockTimeout;
+	}
+
+	OverflowPolicy overflowPolicy() const
+	{
+		return _policy;
+	}
+
+	void setWatermarks(int high, int low)
+		// Sets the queue sizes at which the HighWatermark and 
+		// LowWatermark signals are emitted. A high watermark of
+		// zero disables the signals. The defaults are the limit
+		// and half the limit.
+		// Must be set before the queue is active.
+	{
+		Mutex::ScopedLock lock(_mutex);
+		assert(empty() && "queue must not be active");
+		assert(low < high || high == 0);
+		_highWatermark = high;
+		_lowWatermark = low;
+	}
+
+	int highWatermark() const
+	{
+		return _highWatermark;
+	}
+
+	int lowWatermark() const
+	{
+		return _lowWatermark;
+	}
+
+	UInt64 dropped() const
+		// Returns the total number of items discarded
+		// by the overflow policy.
+	{
+		return _dropped.load();
+	}
+
+	bool overflowed() const
+		// Returns true if the queue has reached the high watermark
+		// and not yet drained to the low watermark.
+	{
+		return _overflowed.load();
+	}
+	
+protected:	
+	RunnableQueue(const RunnableQueue&);
+	RunnableQueue& operator = (const RunnableQueue&);
+
+	virtual bool droppable(const T& /* item */) const
+		// Returns true if the item may be discarded by the 
+		// DropNonKeyframe policy. Items which following items
+		// depend on, such as video key frames, return false.
+		// Called from producer threads.
+	{
+		return true;
+	}
+
+	bool admit(T* item)
+		// Applies the overflow policy to an item before it is pushed.
+		// Returns false if the item was discarded.
+	{
+		switch (_policy) {
+		case DropOldest:
+			// The oldest items are evicted by push() once the item is counted
+			break;
+
+		case DropNewest:
+			if (_size.load() >= _limit) {
+				drop(item);
+				return false;
+			}
+			break;
+
+		case DropNonKeyframe:
+			if (!droppable(*item)) {
+				_keyed.store(true);
+				_skipping.store(false);
+				break;
+			}
+
+			// Streams which never flag a key frame would be 
+			// skipped forever, so evict the oldest items instead
+			if (!_keyed.load())
+				break;
+
+			// Once an item is dropped the items which follow it
+			// are useless until the next non-droppable item.
+			// Skipping ends early once the consumer has drained
+			// the queue, so a stream with rare key frames recovers.
+			if (_skipping.load() && _size.load() <= _lowWatermark)
+				_skipping.store(false);
+			if (_skipping.load() || _size.load() >= _limit) {
+				_skipping.store(true);
+				drop(item);
+				return false;
+			}
+			break;
+
+		case BlockProducer:
+			if (_size.load() >= _limit && !waitForSpace()) {
+				drop(item);
+				return false;
+			}
+			break;
+		}
+		return true;
+	}
+
+	void drop(T* item)
+		// Discards an item which was rejected by the overflow policy.
+	{
+		_dropped.fetch_add(1);
+		delete item;
+	}
+
+	bool evicts() const
+		// Returns true if producers evict the oldest items
+		// when the limit is reached.
+	{
+		return _policy == DropOldest || 
+			(_policy == DropNonKeyframe && !_keyed.load());
+	}
+
+	bool enqueue(T* item)
+		// Links an item into the underlying queue. If the ring of 
+		// a limited queue is full the oldest item is evicted, unless
+		// the policy discards new items.
+		// Returns false if the item was discarded.
+	{
+		if (!_ring) {
+			_queue.push(item);
+			return true;
+		}
+
+		T* oldest;
+		while (!_ring->push(item)) {
+			if (_policy == DropNewest || _policy == BlockProducer || !_ring->pop(oldest)) {
+				drop(item);
+				return false;
+			}
+			_size.fetch_sub(1);
+			drop(oldest);
+		}
+		return true;
+	}
+
+	bool dequeue(T*& item)
+		// Pops the oldest item from the underlying queue.
+		// Only the ring of a limited queue may be popped by 
+		// producers, the MPSCQueue is popped by the consumer.
+	{
+		return _ring ? _ring->pop(item) : _queue.pop(item);
+	}
+
+	int evictOldest()
+		// Discards the oldest items until the queue is within the
+		// limit, so a stalled consumer can not grow the queue
+		// without bound. Called by producers when evicts() is true,
+		// after the pushed item was counted.
+		// Returns the queue size including the pushed item.
+	{
+		T* oldest;
+		int size = _size.load();
+		while (size > _limit && _ring->pop(oldest)) {
+			size = _size.fetch_sub(1) - 1;
+			drop(oldest);
+		}
+		return size;
+	}
+
+	virtual T* popNext()
+		// Pops the next waiting item.
+		// Must only be called from the consumer thread.
+	{
+		T* next;
+		if (!dequeue(next))
+			return nullptr;
+
+		int size = _size.fetch_sub(1) - 1;
+		if (_blocked.load() > 0)
+			wakeProducers();
+		if (size <= _lowWatermark && _overflowed.load())
+			lowerWatermark();
+		return next;
+	}
+	
+	std::size_t popBatch(std::vector<T*>& items, std::size_t max)
+		// Pops up to max waiting items onto the given vector.
+		// Returns the number of items popped.
+		// Must only be called from the consumer thread.
+	{
+		std::size_t count = 0;
+		T* next;
+		while (count < max && (next = popNext()) != nullptr) {
+			items.push_back(next);
+			count++;
+		}
+		return count;
+	}
+	
+	virtual bool dispatchNext()
+		// Pops and dispatches the next waiting item.
+	{
+		T* next = popNext();	
+		if (next) {
+			dispatch(*next);
+			delete next;
+			return true;
+		}
+		return false;
+	}
+
+	virtual void waitForItems()
+		// Blocks the consumer until an item is pushed
+		// or the queue is cancelled. Items are counted
+		// once they are linked, so the counted size is checked.
+	{
+		Mutex::ScopedLock lock(_mutex);
+		_sleeping.store(true);
+		while (empty() && !cancelled())
+			_cond.wait(_mutex);
+		_sleeping.store(false);
+	}
+
+	void wakeup()
+		// Wakes the consumer if it is waiting for items.
+		// The consumer publishes its sleeping state before 
+		// checking the queue, so either it sees the new item 
+		// or we see it sleeping.
+	{
+		if (_sleeping.load()) {
+			Mutex::ScopedLock lock(_mutex);
+			_cond.signal();
+		}
+	}
+
+	bool waitForSpace()
+		// Blocks a producer until the queue is below the limit,
+		// the block timeout expires or the queue is cancelled.
+		// Returns true if there is room for the item.
+		// Producers register as blocked before checking the size,
+		// so either the consumer sees them blocked or they see
+		// the new size.
+	{
+		Stopwatch sw;
+		sw.start();
+		Mutex::ScopedLock lock(_mutex);
+		_blocked.fetch_add(1);
+		while (_size.load() >= _limit && !cancelled()) {
+			if (_blockTimeout <= 0) {
+				_space.wait(_mutex);
+				continue;
+			}
+			long remaining = _blockTimeout - sw.elapsedMilliseconds();
+			if (remaining <= 0 || !_space.tryWait(_mutex, remaining))
+				break;
+		}
+		_blocked.fetch_sub(1);
+		return _size.load() < _limit;
+	}
+
+	void wakeProducers()
+		// Wakes producers blocked by the BlockProducer policy.
+	{
+		Mutex::ScopedLock lock(_mutex);
+		_space.broadcast();
+	}
+
+	void raiseWatermark(int size)
+	{
+		bool expected = false;
+		if (_overflowed.compare_exchange_strong(expected, true)) {
+			warnL("RunnableQueue", this) << "High watermark: " 
+				<< size << ": Dropped " << dropped() << std::endl;
+			HighWatermark.emit(this);
+		}
+	}
+
+	void lowerWatermark()
+	{
+		bool expected = true;
+		if (_overflowed.compare_exchange_strong(expected, false)) {
+			debugL("RunnableQueue", this) << "Low watermark: " 
+				<< size() << ": Dropped " << dropped() << std::endl;
+			LowWatermark.emit(this);
+		}
+	}
+	
+	int _limit;
+	int _timeout;
+	OverflowPolicy _policy;
+	int _blockTimeout;
+	int _highWatermark;
+	int _lowWatermark;
+	MPSCQueue<T*> _queue;
+	std::atomic<int> _size;
+	std::atomic<int> _blocked;
+	std::atomic<UInt64> _dropped;
+	std::atomic<bool> _sleeping;
+	std::atomic<bool> _overflowed;
+	std::atomic<bool> _skipping;
+	std::atomic<bool> _keyed;
+	MPMCQueue<T*>* _ring;             // holds the items of a limited queue
+	mutable Mutex _mutex;
+	Condition _cond;
+	Condition _space;
+};
+
+
+//
+// Synchronization Queue
+//
+
+
+template<class T>
+class SyncQueue: public RunnableQueue<T>
+	// SyncQueue extends SyncContext to implement a synchronized FIFO
+	// queue which receives T objects from any thread and synchronizes
+	// them for safe consumption by the associated event loop.
+{
+public:
+	SyncQueue(uv::Loop* loop, int limit = 2048, int timeout = 20) :
+		RunnableQueue<T>(limit, timeout), 
+		// Note: The SyncQueue instance must not be destroyed
+		// while the RunnableQueue is still dispatching items.
+		_sync(loop, std::bind(&SyncQueue::run, this))
+	{
+	}
+
+	virtual ~SyncQueue() 
+		// Destruction is deferred to allow enough    
+		// time for all callbacks to return.
+	{
+	}
+	
+	virtual void push(T* item)
+		// Pushes an item onto the queue.
+		// Item pointers are now managed by the SyncQueue.		
+	{
+		RunnableQueue<T>::push(item);
+		_sync.post();
+	}
+
+	virtual void run()
+		// Called from the event loop to dispatch queued items.
+		// The event loop must never block, so items are dispatched 
+		// until the queue is empty or the timeout expires, and the
+		// remainder are rescheduled for the next loop iteration.
+	{
+		if (this->_timeout)
+			this->runTimeout();
+		else
+			this->flush();
+		if (!this->cancelled() && !this->empty())
+			_sync.post();
+	}
+	
+	virtual void cancel()
+	{
+		RunnableQueue<T>::cancel();
+		_sync.cancel();
+
+		// Call uv_close on the handle if calling from  
+		// the event loop thread or we deadlock.
+		if (Thread::currentID() == _sync.tid())
+			_sync.close();
+	}
+	
+	SyncContext& sync()
+	{
+		return _sync;
+	}	
+
+protected:
+	SyncContext _sync;
+};
+
+
+//
+// Asynchronous Queue
+//
+
+
+template<class T>
+class AsyncQueue: public RunnableQueue<T>
+	// AsyncQueue is a thread-based queue which receives packets  
+	// from any thread source and dispatches them asynchronously.
+	//
+	// This queue is useful for deferring load from operation 
+	// critical system devices before performing long running tasks.
+	//
+	// The thread will call the RunnableQueue's run() method to
+	// constantly flush outgoing packets until cancel() is called. 
+{
+public:
+	AsyncQueue(int limit = 2048) : 
+		RunnableQueue<T>(limit),
+		_thread(std::bind(&AsyncQueue::run, this))
+	{
+	}	
+	
+	virtual void cancel()
+	{
+		RunnableQueue<T>::cancel();
+		_thread.cancel();
+	}
+
+protected:
+	virtual ~AsyncQueue() 
+	{
+	}
+
+	Thread _thread;
+};
+
+
+#if 0
+//
+// Concurrent Queue
+//
+// TODO: Re-implement Condition class from libuv primitives
+//
+
+template<typename T>
+class ConcurrentQueue
+	// Implements a simple thread-safe multiple producer, 
+	// multiple consumer queue. 
+{
+private:
+    std::queue<T> _queue;
+	mutable Mutex _mutex;
+	Poco::Condition _condition;
+
+public:
+    void push(T const& data)
+    {
+		Mutex::ScopedLock lock(_mutex);
+        _queue.push(data);
+        lock.unlock();
+        _condition.signal();
+    }
+
+    bool empty() const
+    {
+		Mutex::ScopedLock lock(_mutex);
+        return _queue.empty();
+    }
+
+    bool tryPop(T& out)
+    {
+		Mutex::ScopedLock lock(_mutex);
+        if (_queue.empty())
+            return false;
+        
+        out = _queue.front();
+        _queue.pop();
+        return true;
+    }
+
+    void waitAndPop(T& out)
+    {
+		Mutex::ScopedLock lock(_mutex);
+        while (_queue.empty())
+			_cond.wait(_mutex);
+        
+        out = _queue.front();
+        _queue.pop();
+    }
+};
+#endif
+
+
+} // namespace scy
+
+
+
+#endif // SCY_Queue_H
\ No newline at end of file
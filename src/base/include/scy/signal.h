@@ -0,0 +1,367 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Signal_H
+#define SCY_Signal_H
+
+
+#include "scy/types.h"
+#include "scy/delegate.h"
+#include "scy/util.h"
+#include "scy/mutex.h"
+#include <vector>
+#include <list>
+#include <atomic>
+#include <assert.h>
+
+
+namespace scy {
+
+
+class StopPropagation: public std::exception
+	/// This exception is used to break out of a Signal callback scope.
+{
+public:
+	virtual ~StopPropagation() throw() {};
+};
+
+
+template <class DelegateT, DelegateDefaultArgs>
+class SignalBase 
+	/// This class implements a thread-safe signal which
+	/// broadcasts arbitrary data to multiple receiver delegates.
+	///
+	/// Active delegates are published as an immutable, priority
+	/// ordered snapshot array. attach() and detach() build a new
+	/// snapshot under the mutex and swap it in (copy-on-write), so
+	/// emit() only loads an atomic pointer and never locks or
+	/// allocates. Replaced snapshots and detached delegates are
+	/// reclaimed once no emit() is in progress, which allows
+	/// delegates to detach themselves or others during emission.
+{
+public:
+	typedef std::list<DelegateT*>				  DelegateList;
+	typedef typename DelegateList::iterator       Iterator;
+	typedef typename DelegateList::const_iterator ConstIterator;
+
+	SignalBase() : 
+		_snapshot(nullptr),
+		_readers(0),
+		_enabled(true), 
+		_pending(false),
+		_retired(nullptr),
+		_count(0)
+	{
+	}	
+
+	virtual ~SignalBase() 
+	{ 
+		clear();
+	}
+
+	void operator += (const DelegateT& delegate) { attach(delegate); }	
+	void operator -= (const DelegateT& delegate) { detach(delegate); }	
+	void operator -= (const void* klass) { detach(klass); }
+
+	void attach(const DelegateT& delegate) 
+		// Attaches a delegate to the signal. If the delegate 
+		// already exists it will overwrite the previous delegate.
+	{
+		Mutex::ScopedLock lock(_mutex);
+		Snapshot* current = _snapshot.load();
+		Snapshot* next = new Snapshot;
+		DelegateT* added = delegate.clone();
+		if (current) {
+			next->delegates.reserve(current->delegates.size() + 1);
+			for (auto d : current->delegates) {
+				if (delegate.equals(d))
+					retire(d);
+				else
+					next->delegates.push_back(d);
+			}
+		}
+
+		// Insert after delegates of equal or higher priority
+		auto it = next->delegates.begin();
+		while (it != next->delegates.end() && 
+			!DelegateT::ComparePrioroty(added, *it))
+			++it;
+		next->delegates.insert(it, added);
+		publish(next);
+	}
+
+	bool detach(const DelegateT& delegate) 
+		// Detaches a delegate from the signal.
+		// Returns true if the delegate was detached, false otherwise.
+	{
+		Mutex::ScopedLock lock(_mutex);
+		Snapshot* current = _snapshot.load();
+		if (!current)
+			return false;
+		for (std::size_t i = 0; i < current->delegates.size(); i++) {
+			if (delegate.equals(current->delegates[i])) {
+				Snapshot* next = new Snapshot;
+				next->delegates = current->delegates;
+				next->delegates.erase(next->delegates.begin() + i);
+				retire(current->delegates[i]);
+				publish(next);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void detach(const void* klass) 
+		// Detaches all delegates associated with the given class instance.
+	{
+		Mutex::ScopedLock lock(_mutex);
+		Snapshot* current = _snapshot.load();
+		if (!current)
+			return;
+		Snapshot* next = nullptr;
+		for (auto d : current->delegates) {
+			if (klass == d->object()) {
+				if (!next) {
+					next = new Snapshot;
+					next->delegates.reserve(current->delegates.size());
+					for (auto prev : current->delegates) {
+						if (prev == d)
+							break;
+						next->delegates.push_back(prev);
+					}
+				}
+				retire(d);
+			}
+			else if (next)
+				next->delegates.push_back(d);
+		}
+		if (next)
+			publish(next);
+	}
+
+	void cleanup() 
+		// Deletes detached delegates and replaced snapshots
+		// if no emit() is in progress. This is also done
+		// automatically when the last emit() returns.
+	{
+		Mutex::ScopedLock lock(_mutex);
+		reclaim();
+	}
+
+	void obtain(DelegateList& active) 
+		// Retrieves a list of active delegates.
+		// The delegates are only guaranteed to remain valid
+		// while the signal is not modified.
+	{
+		if (!_enabled.load()) // skip if disabled
+			return;
+		Mutex::ScopedLock lock(_mutex);
+		Snapshot* current = _snapshot.load();
+		if (current)
+			active.insert(active.end(), current->delegates.begin(), current->delegates.end());
+	}
+
+	virtual void emit(void* sender) 
+	{
+		void* empty = nullptr;
+		emit(sender, (P)empty, (P2)empty, (P3)empty, (P4)empty);
+	}
+
+	virtual void emit(void* sender, P arg) 
+	{
+		void* empty = nullptr;
+		emit(sender, arg, (P2)empty, (P3)empty, (P4)empty);
+	}
+
+	virtual void emit(void* sender, P arg, P2 arg2) 
+	{
+		void* empty = nullptr;
+		emit(sender, arg, arg2, (P3)empty, (P4)empty);
+	}	
+
+	virtual void emit(void* sender, P arg, P2 arg2, P3 arg3) 
+	{
+		void* empty = nullptr;
+		emit(sender, arg, arg2, arg3, (P4)empty);
+	}
+
+	virtual void emit(void* sender, P arg, P2 arg2, P3 arg3, P4 arg4) 
+	{
+		if (!_enabled.load(std::memory_order_relaxed))
+			return;
+
+		// The snapshot and its delegates stay valid while the
+		// reader count is held, even if they are detached.
+		ReadGuard guard(*this);
+		Snapshot* current = _snapshot.load();
+		if (!current)
+			return;
+		try {
+			DelegateT* const* it = current->delegates.data();
+			DelegateT* const* end = it + current->delegates.size();
+			for (; it != end; ++it) {
+				if ((*it)->accepts(sender, arg, arg2, arg3, arg4))
+					(*it)->emit(sender, arg, arg2, arg3, arg4); 
+			}
+		}
+		catch (StopPropagation&) {
+		}
+	}
+
+	void clear() 
+	{
+		Mutex::ScopedLock lock(_mutex);
+		Snapshot* current = _snapshot.load();
+		if (current) {
+			for (auto d : current->delegates)
+				retire(d);
+			publish(nullptr);
+		}
+	}
+
+	void enable(bool flag = true) 
+	{
+		_enabled.store(flag);
+	}
+
+	bool enabled() const
+	{
+		return _enabled.load();
+	}
+
+	DelegateList delegates() const 
+	{
+		Mutex::ScopedLock lock(_mutex);
+		DelegateList list;
+		Snapshot* current = _snapshot.load();
+		if (current)
+			list.assign(current->delegates.begin(), current->delegates.end());
+		return list;
+	}
+	
+	int ndelegates() const 
+		// Returns the number of delegates connected to the signal.
+	{
+		Mutex::ScopedLock lock(_mutex);
+		return _count;
+	}
+		
+protected:
+	struct Snapshot
+	{
+		std::vector<DelegateT*> delegates;
+		Snapshot* next; // retired list
+	};
+
+	struct ReadGuard
+	{
+		SignalBase& signal;
+		ReadGuard(SignalBase& signal) : signal(signal) { signal._readers.fetch_add(1); }
+		~ReadGuard() 
+		{ 
+			// The last reader out reclaims retired memory
+			if (signal._readers.fetch_sub(1) == 1 && signal._pending.load()) {
+				Mutex::ScopedLock lock(signal._mutex);
+				signal.reclaim();
+			}
+		}
+	};
+
+	void retire(DelegateT* delegate)
+		// Cancels a detached delegate and schedules it for deletion.
+		// Must be called with the mutex locked.
+	{
+		delegate->cancel();
+		_garbage.push_back(delegate);
+	}
+
+	void publish(Snapshot* next)
+		// Swaps in the next snapshot and retires the current one.
+		// Must be called with the mutex locked.
+	{
+		Snapshot* prev = _snapshot.exchange(next);
+		if (prev) {
+			prev->next = _retired;
+			_retired = prev;
+		}
+		_count = next ? static_cast<int>(next->delegates.size()) : 0;
+		_pending.store(true);
+		reclaim();
+	}
+
+	void reclaim()
+		// Frees retired snapshots and delegates if no emit() is 
+		// in progress. Readers increment the reader count before 
+		// loading the snapshot pointer, so a zero count means no 
+		// reader can hold retired memory.
+		// Must be called with the mutex locked.
+	{
+		if (!_pending.load() || _readers.load() != 0)
+			return;
+		while (_retired) {
+			Snapshot* snapshot = _retired;
+			_retired = snapshot->next;
+			delete snapshot;
+		}
+		for (auto d : _garbage)
+			delete d;
+		_garbage.clear();
+		_pending.store(false);
+	}
+
+	std::atomic<Snapshot*> _snapshot;
+	std::atomic<int> _readers;
+	std::atomic<bool> _enabled;	
+	std::atomic<bool> _pending;
+	Snapshot* _retired;
+	std::vector<DelegateT*> _garbage;
+	int _count;
+
+	mutable Mutex	_mutex;
+};
+
+
+//
+// Signal Types
+//
+
+
+class NullSignal: public SignalBase<DelegateBase<>> {};
+
+
+template <typename P>
+class Signal: public SignalBase<DelegateBase<P>, P> {};
+
+
+template <typename P, typename P2>
+class Signal2: public SignalBase<DelegateBase<P, P2>, P, P2> {};
+
+
+template <typename P, typename P2, typename P3>
+class Signal3: public SignalBase<DelegateBase<P, P2, P3>, P, P2, P3> {};
+
+
+template <typename P, typename P2, typename P3, typename P4>
+class Signal4: public SignalBase<DelegateBase<P, P2, P3, P4>, P, P2, P3, P4> {};
+
+
+} // namespace scy
+
+
+#endif // SCY_Signal_H
\ No newline at end of file
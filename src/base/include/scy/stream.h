@@ -0,0 +1,322 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Net_Stream_H
+#define SCY_Net_Stream_H
+
+
+#include "scy/uv/uvpp.h"
+#include "scy/memory.h"
+
+#include "scy/signal.h"
+#include "scy/buffer.h"
+#include "scy/bufferpool.h"
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+
+namespace scy {
+namespace net {
+		
+
+class Stream: public uv::Handle
+{
+ public:  
+	Stream(uv::Loop* loop = uv::defaultLoop(), void* stream = nullptr) :
+		uv::Handle(loop, stream), 
+		_pool(BufferPool::forLoop(loop)),
+		_recvBuffer(_pool, 65536, 16384)
+	{
+		_pool->duplicate();
+	}
+	
+	void close()
+		// Closes and resets the stream handle.
+		// This will close the active socket/pipe
+		// and destroy the uv_stream_t handle.
+		//
+		// If the stream is already closed this call
+		// will have no side-effects.
+	{
+		TraceL << "Close: " << ptr() << std::endl;
+		if (active())
+			readStop();
+		uv::Handle::close();
+	}
+	
+	bool shutdown()
+		// Sends a shutdown packet to the connected peer.
+		// Returns true if the shutdown packet was sent.
+	{
+		assertTID();
+
+		TraceL << "Send shutdown" << std::endl;
+		if (!active()) {
+			WarnL << "Attempted shutdown on closed stream" << std::endl;
+			return false;
+		}
+
+		// XXX: Sending shutdown causes an eof error to be  
+		// returned via handleRead() which sets the stream 
+		// to error state. This is not really an error,
+		// perhaps it should be handled differently?
+		int r = uv_shutdown(new uv_shutdown_t, ptr<uv_stream_t>(), [](uv_shutdown_t* req, int) {
+			delete req;
+		});
+
+		return r == 0;
+	}
+
+	bool write(const char* data, std::size_t len)
+		// Writes data to the stream.
+		//
+		// Returns false if the underlying socket is closed.
+		// This method does not throw an exception.
+	{		
+		assertTID();
+
+		//if (closed())
+		//	throw std::runtime_error("IO error: Cannot write to closed stream");
+		if (!active())
+			return false;
+
+		int r; 		
+		uv_write_t* req = new uv_write_t;
+		uv_buf_t buf = uv_buf_init((char*)data, len);
+		uv_stream_t* stream = this->ptr<uv_stream_t>();
+		bool isIPC = stream->type == UV_NAMED_PIPE && 
+			reinterpret_cast<uv_pipe_t*>(stream)->ipc;
+
+		// Keep pooled data alive until the write completes
+		req->data = _pool->retain(data, len);
+
+		if (!isIPC) {
+			r = uv_write(req, stream, &buf, 1, Stream::afterWrite);
+		}
+		else {
+			r = uv_write2(req, stream, &buf, 1, nullptr, Stream::afterWrite);
+		}
+
+		if (r) {
+			afterWrite(req, r);
+			//setAndThrowError(r, "Stream write error");
+		}
+		return r == 0;
+	}
+
+	bool write(const BufferChain& chain)
+		// Writes all segments of the given chain to the stream
+		// with a single scatter-gather write.
+		//
+		// The chain is copied into the write request, so copied
+		// segments may be discarded by the caller. Copying does not
+		// allocate for chains within the BufferChain inline capacity.
+		// Referenced segments must remain valid until the write 
+		// completes, as with the raw pointer overload.
+		//
+		// Returns false if the underlying socket is closed.
+		// This method does not throw an exception.
+	{		
+		assertTID();
+
+		if (!active())
+			return false;
+
+		return writeChain(new ChainWriteRequest(chain));
+	}
+
+	bool write(BufferChain&& chain)
+		// Moves the given chain into the write request and writes it 
+		// as above, avoiding the copy of any heap storage.
+	{		
+		assertTID();
+
+		if (!active())
+			return false;
+
+		return writeChain(new ChainWriteRequest(std::move(chain)));
+	}
+	
+	PooledBuffer* recvBuffer()
+		// Returns the pooled block which receives incoming data.
+		//
+		// Inside the Read callback this block holds the data being
+		// dispatched. Receivers which need the data after the callback
+		// returns should duplicate() the block and release() it when
+		// done, rather than copying the data. Later reads go into the
+		// free tail of a retained block, or into a new block.
+	{ 
+		assertTID();
+		return _recvBuffer.block();
+	}
+
+	virtual bool closed() const
+		// Returns true if the native socket handle is closed.
+	{
+		return uv::Handle::closed();
+	}
+
+	Signal2<const char*, const int&> Read;
+		// Signals when data can be read from the stream.
+
+ protected:	
+	bool readStart()
+	{
+		//TraceL << "Read start: " << ptr() << std::endl;
+		int r = uv_read_start(this->ptr<uv_stream_t>(), Stream::allocReadBuffer, handleRead);
+		if (r) setUVError("Stream read error", r);	
+		return r == 0;
+	}
+
+	bool readStop()
+	{		
+		//TraceL << "Read stop: " << ptr() << std::endl;
+		int r = uv_read_stop(ptr<uv_stream_t>());
+		if (r) setUVError("Stream read error", r);
+		return r == 0;
+	}
+
+	virtual void onRead(const char* data, std::size_t len)
+	{
+		//TraceL << "On read: " << len << std::endl;
+		Read.emit(self(), data, len);
+	}
+
+	static void handleReadCommon(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf, uv_handle_type pending) 
+	{	
+		auto self = reinterpret_cast<Stream*>(handle->data);
+		//TraceL << "Handle read: " << nread << std::endl;
+		
+		if (nread >= 0) {
+			// The stream may be destroyed by the callback,
+			// so it must not be touched afterwards.
+			if (nread > 0)
+				self->_recvBuffer.commit(nread);
+			self->onRead(buf->base, nread);
+		}
+		else {
+			// The stream was closed in error
+			// The value of nread is the error number 
+			// ie. UV_ECONNRESET or UV_EOF etc ...
+			self->setUVError("Stream error", nread);
+		}
+	}
+
+	virtual ~Stream() 
+	{	
+		_pool->release();
+	}
+	
+	virtual void* self() 
+	{ 
+		return this;
+	}	
+
+	
+	//
+	// UV callbacks
+	//
+	
+	static void handleRead(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf) 
+	{
+		handleReadCommon(handle, nread, buf, UV_UNKNOWN_HANDLE);
+	}
+	
+	static void handleRead2(uv_pipe_t* handle, ssize_t nread, const uv_buf_t* buf, uv_handle_type pending) 
+	{
+		handleReadCommon((uv_stream_t*)handle, nread, buf, pending);
+	}
+	
+	static void afterWrite(uv_write_t* req, int) 
+	{
+		if (req->data)
+			reinterpret_cast<PooledBuffer*>(req->data)->release();
+		delete req;
+	}
+	
+	static void allocReadBuffer(uv_handle_t *handle, size_t suggested_size, uv_buf_t* buf)
+	{
+		auto self = reinterpret_cast<Stream*>(handle->data);
+
+		// Read into the free space of the current pooled block
+		MutableBuffer space = self->_recvBuffer.prepare();
+		buf->base = bufferCast<char*>(space);
+		buf->len = space.size();
+	}
+
+	struct ChainWriteRequest 
+	{
+		uv_write_t req;
+		BufferChain chain;
+
+		ChainWriteRequest(const BufferChain& chain) : chain(chain) { req.data = this; }
+		ChainWriteRequest(BufferChain&& chain) : chain(std::move(chain)) { req.data = this; }
+	};
+
+	bool writeChain(ChainWriteRequest* req)
+		// Writes the segments of the request chain and
+		// takes ownership of the request.
+	{
+		int r; 		
+
+		// Build the iovec array; libuv copies it into the request
+		const std::size_t nbufs = req->chain.count();
+		uv_buf_t bufsml[16];
+		std::vector<uv_buf_t> bufvec;
+		uv_buf_t* bufs = bufsml;
+		if (nbufs > 16) {
+			bufvec.resize(nbufs);
+			bufs = bufvec.data();
+		}
+		for (std::size_t i = 0; i < nbufs; i++) {
+			ConstBuffer seg = req->chain.segment(i);
+			bufs[i] = uv_buf_init((char*)bufferCast<const char*>(seg), seg.size());
+		}
+
+		uv_stream_t* stream = this->ptr<uv_stream_t>();
+		bool isIPC = stream->type == UV_NAMED_PIPE && 
+			reinterpret_cast<uv_pipe_t*>(stream)->ipc;
+
+		if (!isIPC) {
+			r = uv_write(&req->req, stream, bufs, nbufs, [](uv_write_t* req, int) {
+				delete reinterpret_cast<ChainWriteRequest*>(req->data);
+			});
+		}
+		else {
+			r = uv_write2(&req->req, stream, bufs, nbufs, nullptr, [](uv_write_t* req, int) {
+				delete reinterpret_cast<ChainWriteRequest*>(req->data);
+			});
+		}
+
+		if (r) {
+			delete req;
+		}
+		return r == 0;
+	}
+
+	BufferPool* _pool;
+	ReceiveBuffer _recvBuffer;
+};
+
+
+} } // namespace scy::net
+
+
+#endif // SCY_Net_Stream_H
\ No newline at end of file
@@ -0,0 +1,234 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#ifndef SCY_SyncDispatcher_H
+#define SCY_SyncDispatcher_H
+
+
+#include "scy/synccontext.h"
+#include "scy/queue.h"
+#include "scy/mutex.h"
+
+#include <atomic>
+#include <type_traits>
+
+
+namespace scy {
+
+
+//
+// Closure
+//
+
+
+class Closure
+	/// Closure is a move only void() callable which stores callables
+	/// of up to InlineSize bytes inline, so posting small lambdas and 
+	/// binds doesn't allocate. Larger callables are stored on the heap.
+{
+public:
+	static const std::size_t InlineSize = 6 * sizeof(void*);
+
+	Closure() : _ops(nullptr) 
+	{
+	}
+
+	template<class F, class = typename std::enable_if<
+		!std::is_same<typename std::decay<F>::type, Closure>::value>::type>
+	Closure(F&& fn) : _ops(nullptr)
+	{
+		typedef typename std::decay<F>::type Fn;
+		if (IsInline<Fn>::value) {
+			new (&_storage) Fn(std::forward<F>(fn));
+			_ops = &InlineOps<Fn>::ops;
+		}
+		else {
+			*reinterpret_cast<Fn**>(&_storage) = new Fn(std::forward<F>(fn));
+			_ops = &HeapOps<Fn>::ops;
+		}
+	}
+
+	Closure(Closure&& r) : _ops(r._ops)
+	{
+		if (_ops) {
+			_ops->move(&_storage, &r._storage);
+			r._ops = nullptr;
+		}
+	}
+
+	~Closure()
+	{
+		reset();
+	}
+
+	Closure& operator = (Closure&& r)
+	{
+		if (this != &r) {
+			reset();
+			_ops = r._ops;
+			if (_ops) {
+				_ops->move(&_storage, &r._storage);
+				r._ops = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	void operator () ()
+	{
+		assert(_ops);
+		_ops->invoke(&_storage);
+	}
+
+	explicit operator bool () const
+	{
+		return _ops != nullptr;
+	}
+
+	void reset()
+	{
+		if (_ops) {
+			_ops->destroy(&_storage);
+			_ops = nullptr;
+		}
+	}
+
+protected:
+	Closure(const Closure&); // = delete;
+	Closure& operator = (const Closure&); // = delete;
+
+	typedef std::aligned_storage<InlineSize>::type Storage;
+
+	struct Ops
+	{
+		void (*invoke)(void* storage);
+		void (*move)(void* dst, void* src);
+		void (*destroy)(void* storage);
+	};
+
+	template<class Fn>
+	struct IsInline
+	{
+		static const bool value = sizeof(Fn) <= sizeof(Storage) && 
+			std::alignment_of<Storage>::value % std::alignment_of<Fn>::value == 0;
+	};
+
+	template<class Fn>
+	struct InlineOps
+	{
+		static void invoke(void* s) { (*static_cast<Fn*>(s))(); }
+		static void move(void* d, void* s) { new (d) Fn(std::move(*static_cast<Fn*>(s))); static_cast<Fn*>(s)->~Fn(); }
+		static void destroy(void* s) { static_cast<Fn*>(s)->~Fn(); }
+		static const Ops ops;
+	};
+
+	template<class Fn>
+	struct HeapOps
+	{
+		static void invoke(void* s) { (**static_cast<Fn**>(s))(); }
+		static void move(void* d, void* s) { *static_cast<Fn**>(d) = *static_cast<Fn**>(s); }
+		static void destroy(void* s) { delete *static_cast<Fn**>(s); }
+		static const Ops ops;
+	};
+
+	Storage _storage;
+	const Ops* _ops;
+};
+
+
+template<class Fn> const Closure::Ops Closure::InlineOps<Fn>::ops = { 
+	&Closure::InlineOps<Fn>::invoke, &Closure::InlineOps<Fn>::move, &Closure::InlineOps<Fn>::destroy };
+template<class Fn> const Closure::Ops Closure::HeapOps<Fn>::ops = { 
+	&Closure::HeapOps<Fn>::invoke, &Closure::HeapOps<Fn>::move, &Closure::HeapOps<Fn>::destroy };
+
+
+//
+// Synchronization Dispatcher
+//
+
+
+class SyncDispatcher
+	/// SyncDispatcher runs closures posted from any thread on its event
+	/// loop, in the order they were posted.
+	///
+	/// Closures are pushed onto a lock-free MPSC queue of pooled nodes,
+	/// and wakeups are coalesced so a burst of posts from any number of 
+	/// threads costs a single uv_async_send. Each wakeup runs up to 
+	/// MaxBatch closures before yielding to the loop.
+	///
+	/// The dispatcher doesn't keep its event loop alive.
+{
+public:
+	SyncDispatcher(uv::Loop* loop = uv::defaultLoop());
+	virtual ~SyncDispatcher();
+		// Pending closures are destroyed without being run.
+
+	void post(Closure fn);
+		// Queues a closure to run on the event loop.
+		// May be called from any thread.
+
+	void waitForSync();
+		// Blocks until all closures posted before the call have run.
+		// If called from the event loop thread the pending closures 
+		// are run immediately.
+
+	void close();
+		// Closes the async handle. Must be called 
+		// from the event loop thread.
+
+	uv::Loop* loop() const;
+
+	static SyncDispatcher& forLoop(uv::Loop* loop = uv::defaultLoop());
+		// Returns the shared dispatcher for the given event loop,
+		// creating it on first use. The first call should be made 
+		// from the loop thread.
+
+	static void shutdown();
+		// Destroys the shared per-loop dispatchers.
+
+	static void shutdown(uv::Loop* loop);
+		// Destroys the shared dispatcher for the given loop, if any.
+		// Must be called from the thread running the loop.
+
+	static const int MaxBatch = 1024;
+
+protected:
+	SyncDispatcher(const SyncDispatcher&); // = delete;
+	SyncDispatcher& operator = (const SyncDispatcher&); // = delete;
+
+	virtual void run();
+		// Runs queued closures on the event loop.
+	
+	uv::Loop* _loop;
+	MPSCQueue<Closure> _queue;
+	SyncContext _sync;
+	std::atomic<bool> _pending;		// A wakeup is outstanding.
+	std::atomic<UInt64> _posted;
+	std::atomic<UInt64> _completed;
+	std::atomic<int> _waiting;
+	Mutex _mutex;
+	Condition _cond;
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_SyncDispatcher_H
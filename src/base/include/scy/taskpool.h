@@ -0,0 +1,117 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#ifndef SCY_TaskPool_H
+#define SCY_TaskPool_H
+
+
+#include "scy/taskrunner.h"
+#include "scy/thread.h"
+#include "scy/mutex.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <vector>
+
+
+namespace scy {
+
+
+class TaskPool: public TaskRunner
+	/// TaskPool is a TaskRunner which runs tasks on a pool of
+	/// worker threads, so CPU bound tasks run in parallel.
+	///
+	/// The TaskRunner thread keeps the deadline heap and hands due
+	/// tasks to the workers in turn. Each worker has its own task
+	/// queue, and idle workers steal tasks from the back of busy 
+	/// workers' queues. Tasks which must always run on the same
+	/// thread are started with a worker affinity, and are never
+	/// stolen.
+	///
+	/// A task only runs on one thread at a time, and is queued 
+	/// again once it has run, so repeating tasks don't need to be
+	/// thread safe themselves. Signals such as Idle are sent from
+	/// the TaskRunner thread.
+{
+public:
+	TaskPool(int numWorkers = 0);
+		// Creates the pool with the given number of worker threads.
+		// Zero uses one worker per CPU core.
+
+	virtual ~TaskPool();
+
+	virtual bool start(Task* task);
+		// Starts a task which may run on any worker.
+
+	virtual bool start(Task* task, int worker);
+		// Starts a task which always runs on the given worker.
+
+	int numWorkers() const;
+		// Returns the number of worker threads.
+
+	virtual const char* className() const { return "TaskPool"; }
+
+protected:
+	struct Worker
+	{
+		Thread thread;
+		Mutex mutex;
+		std::deque<Task*> tasks;       // may be stolen by other workers
+		std::deque<Task*> pinned;      // tasks with affinity to this worker
+		std::atomic<int> numPinned;
+	};
+
+	virtual void run();
+		// Hands due tasks to the workers.
+
+	virtual void work(int index);
+		// Runs queued tasks until the pool is stopped.
+
+	bool dispatch(Task* task);
+		// Queues a due task on a worker. Returns false if the task
+		// was destroyed and removed, in which case the caller deletes
+		// it once the pool mutex is unlocked.
+		// Must be called with the pool mutex locked.
+
+	Task* take(int index);
+		// Takes the next task for the given worker, stealing
+		// from other workers if it has none of its own.
+
+	void execute(Task* task);
+		// Runs a task on the current worker thread.
+
+	Mutex _poolMutex;
+	Mutex _workMutex;
+	Condition _work;
+	std::vector<std::unique_ptr<Worker>> _workers;
+	std::unordered_set<Task*> _running;             // tasks dispatched to workers
+	std::unordered_map<Task*, int> _affinity;
+	std::atomic<int> _numQueued;                    // stealable queued tasks
+	std::atomic<bool> _stopping;
+	int _nextWorker;
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_TaskPool_H
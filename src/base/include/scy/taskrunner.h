@@ -0,0 +1,251 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_TaskRunner_H
+#define SCY_TaskRunner_H
+
+
+#include "scy/uv/uvpp.h"
+#include "scy/memory.h"
+#include "scy/interface.h"
+#include "scy/signal.h"
+#include "scy/taskrunner.h"
+#include "scy/idler.h"
+#include "scy/timer.h"
+#include "scy/mutex.h"
+#include <unordered_map>
+#include <deque>
+#include <vector>
+
+
+namespace scy {
+
+	
+class TaskRunner;
+class TaskPool;
+
+
+class Task: public async::Runnable
+	/// This class is for implementing any kind 
+	/// async task that is compatible with a TaskRunner.
+{
+public:	
+	Task(bool repeat = false);
+	
+	virtual void destroy();
+		// Sets the task to destroyed state.
+
+	virtual bool destroyed() const;
+		// Signals that the task should be disposed of.
+
+	virtual bool repeating() const;
+		// Signals that the task's should be called
+		// repeatedly by the TaskRunner.
+		// If this returns false the task will be cancelled()
+
+	virtual UInt32 id() const;
+		// Unique task ID.
+
+	virtual Int64 remaining() const;
+		// Returns the milliseconds remaining until the task is due
+		// to run. The TaskRunner sleeps until the earliest due task,
+		// so periodic tasks should return the time until their next
+		// run. The default returns 0; repeating tasks which are 
+		// always due are polled once per millisecond.
+	
+	// Inherits async::Runnable:
+	//
+	// virtual void run();
+	// virtual void cancel();
+	// virtual bool cancelled() const;
+	
+protected:
+	Task(const Task& task);
+	Task& operator=(Task const&);
+
+	virtual ~Task();
+		// Should remain protected.
+
+	virtual void run() = 0;	
+		// Called by the TaskRunner to run the task.
+		// Override this method to implement task action.
+		// Returning true means the true should be called again,
+		// and false will cause the task to be destroyed.
+		// The task will similarly be destroyed id destroy()
+		// was called during the current task iteration.
+
+	friend class TaskRunner;
+	friend class TaskPool;
+		// Tasks belong to a TaskRunner instance.
+
+	UInt32 _id;
+	bool _repeating;
+	bool _destroyed;
+};
+
+	
+class TaskRunner: public async::Runnable
+	// The TaskRunner is an asynchronous event loop in 
+	// charge of running one or many tasks. 
+	//
+	// Tasks are indexed by ID, and queued on a deadline heap 
+	// by the time remaining until they are due. See Task::remaining()
+	// Due tasks are moved to a ready queue and run in order.
+	//
+	// Thread based runners block until the next task is due or
+	// a task is added. Event loop runners return to the loop; a
+	// SyncContext runner is woken by a uv timer when the next task
+	// is due, and by the async handle when a task is added.
+{
+public:
+	TaskRunner(async::Runner::Ptr runner = nullptr);
+	virtual ~TaskRunner();
+	
+	virtual bool start(Task* task);
+		// Starts a task, adding it if it doesn't exist.
+
+	virtual bool cancel(Task* task);
+		// Cancels a task.
+		// The task reference will be managed the TaskRunner
+		// until the task is destroyed.
+
+	virtual bool destroy(Task* task);
+		// Queues a task for destruction.
+
+	virtual bool exists(Task* task) const;
+		// Returns weather or not a task exists.
+
+	virtual Task* get(UInt32 id) const;
+		// Returns the task pointer matching the given ID, 
+		// or nullptr if no task exists.
+
+	virtual void setRunner(async::Runner::Ptr runner);
+		// Set the asynchronous context for packet processing.
+		// This may be a Thread or another derivative of Async.
+		// Must be set before the stream is activated.
+
+	static TaskRunner& getDefault();
+		// Returns the default TaskRunner singleton, although
+		// TaskRunner instances may be initialized individually.
+		// The default runner should be kept for short running
+		// tasks such as timers in order to maintain performance.
+	
+	NullSignal Idle;	
+		// Fires after completing an iteration of all tasks.
+
+	NullSignal Shutdown;
+		// Fires when the TaskRunner is shutting down.
+	
+	virtual const char* className() const { return "TaskRunner"; }
+		
+protected:
+	struct Deferred {};
+
+	TaskRunner(Deferred);
+		// Creates the runner without an async context, for derived
+		// classes which must call setRunner() once constructed.
+
+	virtual void run();
+		// Called by the async context to run due tasks.
+		// Thread based runners keep running until cancelled.
+	
+	virtual bool add(Task* task);
+		// Adds a task to the runner.
+	
+	virtual bool remove(Task* task);
+		// Removes a task from the runner.
+
+	virtual Task* next();
+		// Removes and returns the next due task from the ready
+		// queue, or nullptr if no task is due.
+
+	virtual void requeue(Task* task);
+		// Queues a task which has run to run again when it is due.
+		// Cancelled tasks are kept until destroyed, but not queued.
+
+	virtual bool wait();
+		// Blocks a thread based runner until the next task is due, 
+		// or arms the wake up timer of an event loop runner.
+		// Returns false when the runner should return.
+
+	void queue(Task* task, Int64 remaining);
+		// Queues a task to be due after the given milliseconds.
+		// Must be called with the mutex locked.
+
+	void wakeUp();
+		// Wakes the runner after a task was queued.
+	
+	virtual void clear();
+		// Destroys and clears all manages tasks.
+		
+	virtual void onAdd(Task* task);
+		// Called after a task is added.
+		
+	virtual void onStart(Task* task);
+		// Called after a task is started.
+		
+	virtual void onCancel(Task* task);
+		// Called after a task is cancelled.
+	
+	virtual void onRemove(Task* task);
+		// Called after a task is removed.
+	
+	virtual void onRun(Task* task);
+		// Called after a task has run.
+
+	void onTimeout(void*);
+		// Runs due tasks when the wake up timer fires.
+
+protected:
+	struct TaskEntry
+	{
+		Task* task;
+		UInt32 generation;  // incremented when queued, so stale queue entries are skipped
+	};
+
+	struct QueuedTask
+	{
+		UInt64 due;         // due time in milliseconds
+		UInt64 sequence;    // preserves queue order for equal due times
+		UInt32 id;
+		UInt32 generation;
+
+		bool operator > (const QueuedTask& r) const
+		{
+			return due > r.due || (due == r.due && sequence > r.sequence);
+		}
+	};
+
+	typedef std::unordered_map<UInt32, TaskEntry> TaskMap;
+	
+	mutable Mutex	_mutex;
+	Condition		_wakeUp;
+	TaskMap			_tasks;
+	std::deque<QueuedTask> _ready;         // due tasks in run order
+	std::vector<QueuedTask> _deadlines;    // min heap of waiting tasks
+	UInt64			_sequence;
+	std::unique_ptr<Timer> _timer;        // wakes SyncContext runners
+	async::Runner::Ptr _runner;
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_TaskRunner_H
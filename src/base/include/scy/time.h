@@ -0,0 +1,115 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef SCY_Time_H
+#define SCY_Time_H
+
+
+#include "scy/types.h"
+#include <string>
+#include <ctime>
+
+
+namespace scy {
+namespace time {
+
+
+static const char* ISO8601Format = "%Y-%m-%dT%H:%M:%SZ";
+		// The date/time format defined in the ISO 8601 standard.
+		// This is the default format used throughout the library for consistency.
+		//
+		// Examples: 
+		//   2005-01-01T12:00:00+01:00
+		//   2005-01-01T11:00:00Z
+
+static const char* RFC1123Format = "%a, %d %b %Y %H:%M:%S GMT";
+		// The date/time format defined in RFC 1123, which is used 
+		// by HTTP Date headers. Times must be printed as UTC.
+		//
+		// Example: 
+		//   Sat, 01 Jan 2005 12:00:00 GMT
+		   
+std::time_t now();
+	// Returns the number of UTC milliseconds since epoch.
+
+double clockSecs();
+	// Returns the current process time in decimal seconds.
+
+std::string print(const std::tm& dt, const char* fmt = ISO8601Format);
+	// Cross-platform time formatting.
+
+std::string printLocal(const char* fmt = ISO8601Format);
+	// Prints the current local time using the given format.
+
+std::string printUTC(const char* fmt = ISO8601Format);
+	// Prints the current UTC time using the given format.
+
+std::tm toLocal(const std::time_t& time);
+	// Converts the given time value to local time.
+	// Uses thread-safe native functions.
+
+std::tm toUTC(const std::time_t& time);
+	// Converts the given time value to UTC time.
+	// Uses thread-safe native functions.
+
+std::string getLocal();
+	// Returns a local ISO8601 formatted date time string.
+
+std::string getUTC();
+	// Returns a UTC ISO8601 formatted date time string.
+
+UInt64 ticks();
+	// Returns a coarse monotonic clock in milliseconds. It is cheaper 
+	// to read than uv_hrtime(), but may lag by a few milliseconds, so
+	// use it for timeouts and rate limits rather than for measuring.
+
+
+//
+// Cached Formatting
+//
+// Log records and HTTP responses print the current time far more 
+// often than once per second. These functions keep the formatted
+// text per thread and format, and only reformat when the given time
+// changes, so most calls cost a comparison.
+//
+// Each thread caches up to eight formats. The returned reference is
+// valid until this thread formats a different time with the same 
+// format, or until the format is evicted by eight other formats.
+// Day and month names always use the classic "C" locale.
+//
+
+const std::string& formatLocal(std::time_t time, const char* fmt = ISO8601Format);
+	// Returns the given time formatted as local time.
+
+const std::string& formatUTC(std::time_t time, const char* fmt = ISO8601Format);
+	// Returns the given time formatted as UTC time.
+
+
+#if 0
+UInt64 hrtime();
+	// Returns the current high-resolution real time in nanoseconds.
+
+UInt64 getTimeMS();
+	// Returns the current high-resolution real time in milliseconds.
+#endif
+
+
+} } // namespace scy::time
+
+
+#endif // SCY_Time_H
@@ -0,0 +1,192 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#ifndef SCY_TimerWheel_H
+#define SCY_TimerWheel_H
+
+
+#include "scy/uv/uvpp.h"
+#include "scy/types.h"
+
+#include <functional>
+
+
+namespace scy {
+
+
+class TimerWheel
+	/// TimerWheel is a hierarchical timing wheel which multiplexes any
+	/// number of timeouts onto a single event loop timer.
+	///
+	/// Timeouts are held in four levels of 256 slots. Each tick expires 
+	/// the current slot of the first level, and slots of the outer levels 
+	/// are cascaded inwards as the inner levels wrap, so scheduling and 
+	/// cancelling are O(1) regardless of the number of pending timeouts.
+	/// The loop timer is only armed for the next occupied slot, and is
+	/// stopped while the wheel is empty.
+	///
+	/// Timeouts are Entry objects which are designed to be embedded in 
+	/// their owners; the wheel performs no allocations of its own.
+	///
+	/// TimerWheel is not thread safe; entries must be started, cancelled 
+	/// and destroyed on the thread which runs the wheel's event loop.
+{
+public:
+	struct Link
+		/// Intrusive list node for slot lists.
+	{
+		Link* prev;
+		Link* next;
+	};
+
+	class Entry: protected Link
+		/// Entry is a single timeout scheduled on a TimerWheel.
+		///
+		/// The callback is run from the event loop once the timeout 
+		/// expires. It may restart, cancel or destroy the entry.
+		///
+		/// Copying an entry copies its callback and expiry time, but
+		/// the copy is not scheduled. Moving a scheduled entry moves 
+		/// its place in the wheel. Since std::vector copies elements
+		/// when it grows, objects holding running entries should be
+		/// stored in node based containers such as std::list.
+	{
+	public:
+		Entry(std::function<void()> callback = nullptr);
+		Entry(const Entry& r);
+		Entry(Entry&& r);
+		~Entry();
+
+		Entry& operator = (const Entry& r);
+		Entry& operator = (Entry&& r);
+
+		void start(TimerWheel& wheel, Int64 timeout);
+			// Schedules the callback to run after timeout milliseconds.
+			// A running entry is rescheduled.
+
+		void restart();
+			// Restarts the entry with its last timeout.
+			// Does nothing if the entry has never been started.
+
+		void cancel();
+			// Cancels the entry if it is running.
+
+		bool active() const;
+			// Returns true while the entry is scheduled.
+
+		bool expired() const;
+			// Returns true once the entry has been started
+			// and its timeout has elapsed.
+
+		Int64 remaining() const;
+			// Returns the number of milliseconds until the entry expires,
+			// or zero if it has expired or has never been started.
+
+		Int64 timeout() const;
+			// Returns the timeout the entry was last started with.
+
+		TimerWheel* wheel() const;
+			// Returns the wheel the entry was last started on.
+
+		std::function<void()> callback;
+			// The expiry callback.
+
+	protected:
+		void unlink();
+		void replace(Entry& r);
+
+		friend class TimerWheel;
+
+		TimerWheel* _wheel;
+		Int64 _timeout;
+		Int64 _expires;		// Absolute expiry time in wheel ticks.
+	};
+
+	TimerWheel(uv::Loop* loop = uv::defaultLoop());
+	~TimerWheel();
+
+	void schedule(Entry& entry, Int64 timeout);
+		// Schedules an entry to expire after timeout milliseconds.
+		// Same as entry.start(*this, timeout).
+
+	void cancel(Entry& entry);
+		// Cancels a scheduled entry.
+
+	Int64 now() const;
+		// Returns the loop time in milliseconds.
+
+	std::size_t size() const;
+		// Returns the number of scheduled entries.
+
+	uv::Loop* loop() const;
+
+	uv::Handle& handle();
+		// Returns the loop timer handle, which is unref'd by default.
+
+	static TimerWheel& forLoop(uv::Loop* loop = uv::defaultLoop());
+		// Returns the shared wheel for the given event loop, 
+		// creating it on first use.
+
+	static void shutdown();
+		// Destroys the shared per-loop wheels. Outstanding entries
+		// are detached and will not fire.
+		// Must be called from the thread running each loop.
+
+	static void shutdown(uv::Loop* loop);
+		// Destroys the shared wheel for the given loop, if any.
+		// Must be called from the thread running the loop.
+
+	static const int NumLevels = 4;
+	static const int LevelBits = 8;
+	static const int LevelSize = 1 << LevelBits;
+	static const int LevelMask = LevelSize - 1;
+
+protected:
+	TimerWheel(const TimerWheel&); // = delete;
+	TimerWheel& operator = (const TimerWheel&); // = delete;
+
+	void insert(Entry& entry, Int64 earliest);
+		// Links the entry into the slot for its expiry time,
+		// or for the earliest tick if it is overdue.
+
+	void advance(Int64 now);
+		// Expires all entries due at or before the given tick.
+
+	void cascade(int level);
+		// Redistributes the current slot of the given level.
+
+	void arm();
+		// Arms the loop timer for the next occupied slot,
+		// or stops it if the wheel is empty.
+
+	void onTick();
+
+	uv::Handle _handle;
+	Link _slots[NumLevels][LevelSize];
+	Int64 _current;		// The last tick which has been expired.
+	Int64 _due;			// The tick the loop timer is armed for, or -1.
+	std::size_t _size;
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_TimerWheel_H
@@ -0,0 +1,596 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_VariadicSignal_H
+#define SCY_VariadicSignal_H
+
+
+#include "scy/types.h"
+#include "scy/mutex.h"
+#include "scy/signal.h"
+
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <utility>
+#include <type_traits>
+
+
+namespace scy {
+
+
+//
+// Variadic Delegate
+//
+
+
+template <typename... Args>
+class VariadicDelegate
+	/// VariadicDelegate is a value type callback for VariadicSignal.
+	///
+	/// Member function and functor targets are stored inline in a small
+	/// buffer, so delegates can be copied into signals without a heap
+	/// allocation. Functors larger than the buffer are heap allocated.
+	/// Invocation is a single indirect call with the real arity of the
+	/// signal; there is no virtual dispatch or argument padding.
+{
+public:
+	static const std::size_t kInlineSize = 4 * sizeof(void*);
+		// Targets up to this size are stored inline.
+
+	VariadicDelegate() :
+		_invoke(nullptr),
+		_manage(nullptr),
+		_object(nullptr),
+		_priority(0),
+		_comparable(false)
+	{
+	}
+
+	template <class C>
+	VariadicDelegate(C* object, void (C::*method)(Args...), int priority = 0) :
+		_object(object),
+		_priority(priority),
+		_comparable(true)
+		// Creates a delegate for a member function without a sender.
+	{
+		typedef MemberTarget<C, void (C::*)(Args...)> TargetT;
+		init(TargetT(object, method), &TargetT::invoke);
+	}
+
+	template <class C>
+	VariadicDelegate(C* object, void (C::*method)(void*, Args...), int priority = 0) :
+		_object(object),
+		_priority(priority),
+		_comparable(true)
+		// Creates a delegate for a member function with a sender.
+	{
+		typedef MemberTarget<C, void (C::*)(void*, Args...)> TargetT;
+		init(TargetT(object, method), &TargetT::invokeWithSender);
+	}
+
+	template <class Fn, class = typename std::enable_if<
+		!std::is_same<typename std::decay<Fn>::type, VariadicDelegate>::value>::type>
+	VariadicDelegate(Fn&& fn, int priority = 0) :
+		_object(nullptr),
+		_priority(priority),
+		_comparable(false)
+		// Creates a delegate for a lambda or other functor taking
+		// the signal arguments. Functor delegates never compare
+		// equal, so detach them by the id returned from attach().
+	{
+		initFunctor<typename std::decay<Fn>::type>(std::forward<Fn>(fn));
+	}
+
+	VariadicDelegate(const VariadicDelegate& r) :
+		_invoke(r._invoke),
+		_manage(r._manage),
+		_object(r._object),
+		_priority(r._priority),
+		_comparable(r._comparable)
+	{
+		copyStorage(r);
+	}
+
+	VariadicDelegate& operator = (const VariadicDelegate& r)
+	{
+		if (this != &r) {
+			destroyStorage();
+			_invoke = r._invoke;
+			_manage = r._manage;
+			_object = r._object;
+			_priority = r._priority;
+			_comparable = r._comparable;
+			copyStorage(r);
+		}
+		return *this;
+	}
+
+	~VariadicDelegate()
+	{
+		destroyStorage();
+	}
+
+	void operator () (void* sender, Args... args) const
+		// Invokes the target.
+	{
+		_invoke(&_storage, sender, args...);
+	}
+
+	void invoke(void* sender, Args&... args) const
+		// Invokes the target without copying arguments.
+	{
+		_invoke(&_storage, sender, args...);
+	}
+
+	bool equals(const VariadicDelegate& r) const
+		// Returns true if both delegates call the same
+		// member function on the same object.
+	{
+		return _comparable && r._comparable &&
+			_invoke == r._invoke &&
+			std::memcmp(&_storage, &r._storage, sizeof(MemberTargetSize)) == 0;
+	}
+
+	bool valid() const { return _invoke != nullptr; }
+	void* object() const { return _object; }
+	int priority() const { return _priority; }
+
+protected:
+	typedef void (*InvokeFn)(const void*, void*, Args&...);
+	typedef void (*ManageFn)(void*, const void*);
+		// Copies src into dst, or destroys dst if src is null.
+		// Null for trivially copyable inline targets.
+
+	struct MemberTargetSize { void* object; void (MemberTargetSize::*method)(); };
+	typedef typename std::aligned_storage<kInlineSize,
+		std::alignment_of<MemberTargetSize>::value>::type Storage;
+
+	template <class C, class MethodT>
+	struct MemberTarget
+	{
+		C* object;
+		MethodT method;
+
+		MemberTarget(C* object, MethodT method) : object(object), method(method) {}
+
+		static void invoke(const void* storage, void*, Args&... args)
+		{
+			const MemberTarget* self = static_cast<const MemberTarget*>(storage);
+			(self->object->*self->method)(args...);
+		}
+
+		static void invokeWithSender(const void* storage, void* sender, Args&... args)
+		{
+			const MemberTarget* self = static_cast<const MemberTarget*>(storage);
+			(self->object->*self->method)(sender, args...);
+		}
+	};
+
+	template <class Fn>
+	struct FunctorTarget
+	{
+		Fn fn;
+
+		FunctorTarget(const Fn& f) : fn(f) {}
+		FunctorTarget(Fn&& f) : fn(std::move(f)) {}
+
+		static void invoke(const void* storage, void*, Args&... args)
+		{
+			const FunctorTarget* self = inlined() ?
+				static_cast<const FunctorTarget*>(storage) :
+				*static_cast<FunctorTarget* const*>(storage);
+			const_cast<FunctorTarget*>(self)->fn(args...);
+		}
+
+		static void manage(void* dst, const void* src)
+		{
+			if (inlined()) {
+				if (src)
+					new (dst) FunctorTarget(*static_cast<const FunctorTarget*>(src));
+				else
+					static_cast<FunctorTarget*>(dst)->~FunctorTarget();
+			}
+			else {
+				if (src)
+					*static_cast<FunctorTarget**>(dst) =
+						new FunctorTarget(**static_cast<FunctorTarget* const*>(src));
+				else
+					delete *static_cast<FunctorTarget**>(dst);
+			}
+		}
+
+		static bool inlined()
+		{
+			return sizeof(FunctorTarget) <= sizeof(Storage) &&
+				std::alignment_of<FunctorTarget>::value <= std::alignment_of<Storage>::value;
+		}
+	};
+
+	template <class C, class MethodT>
+	void init(const MemberTarget<C, MethodT>& target, InvokeFn invoke)
+	{
+		static_assert(sizeof(target) <= sizeof(Storage), "member target too large");
+		std::memset(&_storage, 0, sizeof(_storage));
+		new (&_storage) MemberTarget<C, MethodT>(target);
+		_invoke = invoke;
+		_manage = nullptr;
+	}
+
+	template <class Fn, class F>
+	void initFunctor(F&& fn)
+	{
+		typedef FunctorTarget<Fn> TargetT;
+		if (TargetT::inlined())
+			new (&_storage) TargetT(std::forward<F>(fn));
+		else
+			*reinterpret_cast<TargetT**>(&_storage) = new TargetT(std::forward<F>(fn));
+		_invoke = &TargetT::invoke;
+		_manage = &TargetT::manage;
+	}
+
+	void copyStorage(const VariadicDelegate& r)
+	{
+		if (_manage)
+			_manage(&_storage, &r._storage);
+		else
+			std::memcpy(&_storage, &r._storage, sizeof(_storage));
+	}
+
+	void destroyStorage()
+	{
+		if (_manage)
+			_manage(&_storage, nullptr);
+	}
+
+	Storage _storage;
+	InvokeFn _invoke;
+	ManageFn _manage;
+	void* _object;
+	int _priority;
+	bool _comparable;
+};
+
+
+template <class C, typename... Args>
+VariadicDelegate<Args...> vdelegate(C* object, void (C::*method)(Args...), int priority = 0)
+	// Creates a variadic delegate for a member function without a sender.
+{
+	return VariadicDelegate<Args...>(object, method, priority);
+}
+
+
+template <class C, typename... Args>
+VariadicDelegate<Args...> svdelegate(C* object, void (C::*method)(void*, Args...), int priority = 0)
+	// Creates a variadic delegate for a member function with a sender.
+{
+	return VariadicDelegate<Args...>(object, method, priority);
+}
+
+
+//
+// Variadic Signal
+//
+
+
+template <typename... Args>
+class VariadicSignal
+	/// VariadicSignal is a thread-safe signal with real arity which
+	/// stores its delegates by value.
+	///
+	/// Like SignalBase, active delegates are published as an immutable,
+	/// priority ordered snapshot which attach() and detach() replace
+	/// under the mutex, so emit() neither locks nor allocates. Delegates
+	/// are stored contiguously inside the snapshot, so emission is a
+	/// linear walk over an array of inline callbacks.
+	///
+	/// VariadicSignal interoperates with the Signal family:
+	///
+	///   - emit(sender, args...) has the same shape as Signal::emit, so
+	///     a VariadicSignal can be attached to a Signal with sdelegate():
+	///       signal += sdelegate(&vsignal, &VariadicSignal<int&>::emit);
+	///   - forward() attaches any signal with a matching emit(), such as
+	///     Signal<>, Signal2<> or PacketSignal, as a receiver.
+{
+public:
+	typedef VariadicDelegate<Args...> DelegateT;
+
+	VariadicSignal() :
+		_snapshot(nullptr),
+		_readers(0),
+		_enabled(true),
+		_pending(false),
+		_retired(nullptr),
+		_nextId(0),
+		_count(0)
+	{
+	}
+
+	~VariadicSignal()
+	{
+		clear();
+	}
+
+	void operator += (const DelegateT& delegate) { attach(delegate); }
+	void operator -= (const DelegateT& delegate) { detach(delegate); }
+	void operator -= (const void* klass) { detach(klass); }
+
+	int attach(const DelegateT& delegate)
+		// Attaches a delegate to the signal. If an equal delegate
+		// already exists it will be replaced.
+		// Returns an id which can be passed to detach(int).
+	{
+		Mutex::ScopedLock lock(_mutex);
+		Snapshot* current = _snapshot.load();
+		Snapshot* next = new Snapshot;
+		if (current) {
+			next->slots.reserve(current->slots.size() + 1);
+			for (auto& slot : current->slots) {
+				if (delegate.equals(slot.delegate))
+					cancel(slot.id);
+				else
+					next->slots.push_back(slot);
+			}
+		}
+
+		// Insert after delegates of equal or higher priority
+		auto it = next->slots.begin();
+		while (it != next->slots.end() && it->delegate.priority() >= delegate.priority())
+			++it;
+		int id = ++_nextId;
+		next->slots.insert(it, Slot(delegate, id));
+		publish(next);
+		return id;
+	}
+
+	template <class C>
+	int attach(C* object, void (C::*method)(Args...), int priority = 0)
+		// Attaches a member function without a sender.
+	{
+		return attach(DelegateT(object, method, priority));
+	}
+
+	template <class C>
+	int attach(C* object, void (C::*method)(void*, Args...), int priority = 0)
+		// Attaches a member function with a sender.
+	{
+		return attach(DelegateT(object, method, priority));
+	}
+
+	template <class SignalT>
+	int forward(SignalT& target, int priority = 0)
+		// Attaches a signal which will be emitted with the sender
+		// and arguments of this signal. Use this to forward into
+		// the Signal family, or into another VariadicSignal.
+		// The target can be detached with detach(&target).
+	{
+		return attach(DelegateT(&target, 
+			static_cast<void (SignalT::*)(void*, Args...)>(&SignalT::emit), priority));
+	}
+
+	bool detach(const DelegateT& delegate)
+		// Detaches a delegate from the signal.
+		// Returns true if the delegate was detached, false otherwise.
+	{
+		return detachIf([&](const Slot& slot) {
+			return delegate.equals(slot.delegate);
+		}) > 0;
+	}
+
+	bool detach(int id)
+		// Detaches the delegate with the id returned from attach().
+	{
+		return detachIf([&](const Slot& slot) {
+			return slot.id == id;
+		}) > 0;
+	}
+
+	void detach(const void* klass)
+		// Detaches all delegates associated with the given class instance.
+	{
+		detachIf([&](const Slot& slot) {
+			return slot.delegate.object() == klass;
+		});
+	}
+
+	void emit(void* sender, Args... args)
+		// Invokes all delegates in priority order.
+		// A delegate may throw StopPropagation to break the loop.
+	{
+		if (!_enabled.load(std::memory_order_relaxed))
+			return;
+
+		ReadGuard guard(*this);
+		Snapshot* current = _snapshot.load();
+		if (!current)
+			return;
+		try {
+			const Slot* it = current->slots.data();
+			const Slot* end = it + current->slots.size();
+			for (; it != end; ++it) {
+				if (!it->cancelled.load(std::memory_order_relaxed))
+					it->delegate.invoke(sender, args...);
+			}
+		}
+		catch (StopPropagation&) {
+		}
+	}
+
+	void clear()
+	{
+		Mutex::ScopedLock lock(_mutex);
+		Snapshot* current = _snapshot.load();
+		if (current) {
+			for (auto& slot : current->slots)
+				cancel(slot.id);
+			publish(nullptr);
+		}
+	}
+
+	void enable(bool flag = true)
+	{
+		_enabled.store(flag);
+	}
+
+	bool enabled() const
+	{
+		return _enabled.load();
+	}
+
+	int ndelegates() const
+		// Returns the number of delegates connected to the signal.
+	{
+		Mutex::ScopedLock lock(_mutex);
+		return _count;
+	}
+
+protected:
+	VariadicSignal(const VariadicSignal&); // = delete;
+	VariadicSignal& operator = (const VariadicSignal&); // = delete;
+
+	struct Slot
+	{
+		DelegateT delegate;
+		int id;
+		std::atomic<bool> cancelled;
+
+		Slot(const DelegateT& delegate, int id) :
+			delegate(delegate), id(id), cancelled(false) {}
+
+		Slot(const Slot& r) :
+			delegate(r.delegate), id(r.id), cancelled(r.cancelled.load()) {}
+
+		Slot& operator = (const Slot& r)
+		{
+			delegate = r.delegate;
+			id = r.id;
+			cancelled.store(r.cancelled.load());
+			return *this;
+		}
+	};
+
+	struct Snapshot
+	{
+		std::vector<Slot> slots;
+		Snapshot* next; // retired list
+	};
+
+	struct ReadGuard
+	{
+		VariadicSignal& signal;
+		ReadGuard(VariadicSignal& signal) : signal(signal) { signal._readers.fetch_add(1); }
+		~ReadGuard()
+		{
+			// The last reader out reclaims retired snapshots
+			if (signal._readers.fetch_sub(1) == 1 && signal._pending.load()) {
+				Mutex::ScopedLock lock(signal._mutex);
+				signal.reclaim();
+			}
+		}
+	};
+
+	template <class Predicate>
+	int detachIf(Predicate pred)
+	{
+		Mutex::ScopedLock lock(_mutex);
+		Snapshot* current = _snapshot.load();
+		if (!current)
+			return 0;
+		int removed = 0;
+		Snapshot* next = new Snapshot;
+		next->slots.reserve(current->slots.size());
+		for (auto& slot : current->slots) {
+			if (pred(slot)) {
+				cancel(slot.id);
+				removed++;
+			}
+			else
+				next->slots.push_back(slot);
+		}
+		if (removed)
+			publish(next);
+		else
+			delete next;
+		return removed;
+	}
+
+	void cancel(int id)
+		// Marks the delegate as cancelled in every snapshot which
+		// may still be in use by emit(), so it is skipped for the
+		// remainder of any emission in progress.
+		// Must be called with the mutex locked.
+	{
+		if (Snapshot* current = _snapshot.load())
+			cancel(current, id);
+		for (Snapshot* s = _retired; s; s = s->next)
+			cancel(s, id);
+	}
+
+	void cancel(Snapshot* snapshot, int id)
+	{
+		for (auto& slot : snapshot->slots) {
+			if (slot.id == id)
+				slot.cancelled.store(true);
+		}
+	}
+
+	void publish(Snapshot* next)
+		// Swaps in the next snapshot and retires the current one.
+		// Must be called with the mutex locked.
+	{
+		Snapshot* prev = _snapshot.exchange(next);
+		if (prev) {
+			prev->next = _retired;
+			_retired = prev;
+		}
+		_count = next ? static_cast<int>(next->slots.size()) : 0;
+		_pending.store(true);
+		reclaim();
+	}
+
+	void reclaim()
+		// Frees retired snapshots if no emit() is in progress.
+		// Must be called with the mutex locked.
+	{
+		if (!_pending.load() || _readers.load() != 0)
+			return;
+		while (_retired) {
+			Snapshot* snapshot = _retired;
+			_retired = snapshot->next;
+			delete snapshot;
+		}
+		_pending.store(false);
+	}
+
+	std::atomic<Snapshot*> _snapshot;
+	std::atomic<int> _readers;
+	std::atomic<bool> _enabled;
+	std::atomic<bool> _pending;
+	Snapshot* _retired;
+	int _nextId;
+	int _count;
+
+	mutable Mutex _mutex;
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_VariadicSignal_H
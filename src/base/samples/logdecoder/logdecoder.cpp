@@ -0,0 +1,41 @@
+#include "scy/binarylog.h"
+
+#include <iostream>
+
+
+using namespace scy;
+
+
+// Decodes binary log files written by BinaryFileChannel
+// to the text format written by the other log channels.
+//
+// Usage: logdecoder <file> [<file>...] [--time-format <format>]
+//
+int main(int argc, char** argv)
+{
+	std::vector<std::string> files;
+	const char* timeFormat = "%H:%M:%S";
+	for (int i = 1; i < argc; i++) {
+		std::string arg(argv[i]);
+		if (arg == "--time-format" && i + 1 < argc)
+			timeFormat = argv[++i];
+		else
+			files.push_back(arg);
+	}
+	if (files.empty()) {
+		std::cerr << "Usage: " << argv[0] << " <file> [<file>...] [--time-format <format>]" << std::endl;
+		return 1;
+	}
+
+	BinaryLogReader reader(timeFormat);
+	for (auto& file : files) {
+		try {
+			reader.read(file, std::cout);
+		}
+		catch (std::exception& exc) {
+			std::cerr << file << ": " << exc.what() << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,630 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+// This file uses the public domain libb64 library: http://libb64.sourceforge.net/
+//
+
+
+#include "scy/base64.h"
+#include "scy/platform.h"
+#include <cstring>
+
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCY_BASE64_SIMD 1
+#include <immintrin.h>
+#endif
+
+#if defined(SCY_BASE64_SIMD) && defined(__GNUC__)
+#define SCY_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define SCY_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SCY_TARGET_SSSE3
+#define SCY_TARGET_AVX2
+#endif
+
+
+namespace scy {
+namespace base64 {
+namespace internal {
+	
+	
+//
+// Encoder
+//
+
+
+void init_encodestate(encodestate* state_in)
+{
+	state_in->step = step_A;
+	state_in->result = 0;
+	state_in->stepcount = 0;
+	state_in->linelength = LINE_LENGTH; // added: set 0 for no line feeds
+	state_in->nullptrlterminate = 0;  // added: set 1 for nullptrl terminated output string
+}
+
+
+char encode_value(char value_in)
+{
+	static const char* encoding = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	if (value_in > 63) return '=';
+	return encoding[(int)value_in];
+}
+
+
+static int encode_block_scalar(const char* plaintext_in, int length_in, char* code_out, encodestate* state_in)
+{
+	const char* plainchar = plaintext_in;
+	const char* const plaintextend = plaintext_in + length_in;
+	char* codechar = code_out;
+	char result;
+	char fragment;
+
+	result = state_in->result;
+
+	switch (state_in->step)
+	{
+		while (1)
+		{
+	case step_A:
+		if (plainchar == plaintextend)
+		{
+			state_in->result = result;
+			state_in->step = step_A;
+			return codechar - code_out;
+		}
+		fragment = *plainchar++;
+		result = (fragment & 0x0fc) >> 2;
+		*codechar++ = encode_value(result);
+		result = (fragment & 0x003) << 4;
+	case step_B:
+		if (plainchar == plaintextend)
+		{
+			state_in->result = result;
+			state_in->step = step_B;
+			return codechar - code_out;
+		}
+		fragment = *plainchar++;
+		result |= (fragment & 0x0f0) >> 4;
+		*codechar++ = encode_value(result);
+		result = (fragment & 0x00f) << 2;
+	case step_C:
+		if (plainchar == plaintextend)
+		{
+			state_in->result = result;
+			state_in->step = step_C;
+			return codechar - code_out;
+		}
+		fragment = *plainchar++;
+		result |= (fragment & 0x0c0) >> 6;
+		*codechar++ = encode_value(result);
+		result  = (fragment & 0x03f) >> 0;
+		*codechar++ = encode_value(result);
+
+		if (state_in->linelength) { // added
+			++(state_in->stepcount);
+			if (state_in->stepcount == state_in->linelength/4)
+			{
+				*codechar++ = '\n';
+				state_in->stepcount = 0;
+			}
+		}
+		}
+	}
+	/* control should not reach here */
+	return codechar - code_out;
+}
+
+
+
+int encode_blockend(char* code_out, encodestate* state_in)
+{
+	char* codechar = code_out;
+
+	switch (state_in->step)
+	{
+	case step_B:
+		*codechar++ = encode_value(state_in->result);
+		*codechar++ = '=';
+		*codechar++ = '=';
+		break;
+	case step_C:
+		*codechar++ = encode_value(state_in->result);
+		*codechar++ = '=';
+		break;
+	case step_A:
+		break;
+	}
+	if (state_in->nullptrlterminate)
+		*codechar++ = '\n';
+
+	return codechar - code_out;
+}
+
+
+//
+// Decoder
+//
+
+
+int decode_value(char value_in)
+{
+	static const char decoding[] = {62,-1,-1,-1,63,52,53,54,55,56,57,58,59,60,61,-1,-1,-1,-2,-1,-1,-1,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,-1,-1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47,48,49,50,51};
+	static const char decoding_size = sizeof(decoding);
+	value_in -= 43;
+	if (value_in < 0 || value_in >= decoding_size) return -1;
+	return decoding[(int)value_in];
+}
+
+
+void init_decodestate(decodestate* state_in)
+{
+	state_in->step = step_a;
+	state_in->plainchar = 0;
+}
+
+
+static int decode_block_scalar(const char* code_in, const int length_in, char* plaintext_out, decodestate* state_in)
+{
+	const char* codechar = code_in;
+	char* plainchar = plaintext_out;
+	char fragment;
+
+	*plainchar = state_in->plainchar;
+
+	switch (state_in->step)
+	{
+		while (1)
+		{
+	case step_a:
+		do {
+			if (codechar == code_in+length_in)
+			{
+				state_in->step = step_a;
+				state_in->plainchar = *plainchar;
+				return plainchar - plaintext_out;
+			}
+			fragment = (char)decode_value(*codechar++);
+		} while (fragment < 0);
+		*plainchar    = (fragment & 0x03f) << 2;
+	case step_b:
+		do {
+			if (codechar == code_in+length_in)
+			{
+				state_in->step = step_b;
+				state_in->plainchar = *plainchar;
+				return plainchar - plaintext_out;
+			}
+			fragment = (char)decode_value(*codechar++);
+		} while (fragment < 0);
+		*plainchar++ |= (fragment & 0x030) >> 4;
+		*plainchar    = (fragment & 0x00f) << 4;
+	case step_c:
+		do {
+			if (codechar == code_in+length_in)
+			{
+				state_in->step = step_c;
+				state_in->plainchar = *plainchar;
+				return plainchar - plaintext_out;
+			}
+			fragment = (char)decode_value(*codechar++);
+		} while (fragment < 0);
+		*plainchar++ |= (fragment & 0x03c) >> 2;
+		*plainchar    = (fragment & 0x003) << 6;
+	case step_d:
+		do {
+			if (codechar == code_in+length_in)
+			{
+				state_in->step = step_d;
+				state_in->plainchar = *plainchar;
+				return plainchar - plaintext_out;
+			}
+			fragment = (char)decode_value(*codechar++);
+		} while (fragment < 0);
+		*plainchar++   |= (fragment & 0x03f);
+		}
+	}
+	/* control should not reach here */
+	return plainchar - plaintext_out;
+}
+
+
+//
+// Group coders
+//
+// Whole groups of 3 bytes and 4 characters are coded in bulk, and 
+// the libb64 coders above only handle line feeds, padding and 
+// partial groups. The vector coders follow Wojciech Mula's base64 
+// algorithms: bytes are split into 6-bit indices with multiplies 
+// and mapped to characters by adding an offset chosen per range.
+//
+
+
+static const char encoding_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+static void encodeScalar(const unsigned char* in, std::size_t groups, char* out)
+{
+	for (std::size_t i = 0; i < groups; i++, in += 3, out += 4) {
+		unsigned int v = (in[0] << 16) | (in[1] << 8) | in[2];
+		out[0] = encoding_table[(v >> 18) & 0x3f];
+		out[1] = encoding_table[(v >> 12) & 0x3f];
+		out[2] = encoding_table[(v >> 6) & 0x3f];
+		out[3] = encoding_table[v & 0x3f];
+	}
+}
+
+
+static std::size_t decodeScalar(const char* in, std::size_t len, char* out)
+{
+	std::size_t i = 0;
+	for (; i + 4 <= len; i += 4, out += 3) {
+		int a = decode_value(in[i]);
+		int b = decode_value(in[i + 1]);
+		int c = decode_value(in[i + 2]);
+		int d = decode_value(in[i + 3]);
+		if ((a | b | c | d) < 0)
+			break;
+		out[0] = static_cast<char>((a << 2) | (b >> 4));
+		out[1] = static_cast<char>((b << 4) | (c >> 2));
+		out[2] = static_cast<char>((c << 6) | d);
+	}
+	return i;
+}
+
+
+#ifdef SCY_BASE64_SIMD
+
+// The 16 byte block coders are inlined into both vector coders, 
+// so the AVX2 coders handle their tails without mixing in legacy
+// SSE instructions, which stall after 256 bit operations.
+
+SCY_TARGET_SSSE3
+static inline void encodeBlockSSSE3(const unsigned char* in, char* out)
+{
+	// Reads 16 bytes and encodes the first 12
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+	v = _mm_shuffle_epi8(v, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+	__m128i hi = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+	__m128i lo = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+	__m128i indices = _mm_or_si128(hi, lo);
+
+	__m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+	__m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+	range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+	const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, 
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range)));
+}
+
+SCY_TARGET_SSSE3
+static inline bool decodeBlockSSSE3(const char* in, char* out)
+{
+	// Decodes 16 characters into 12 bytes, unless the block 
+	// contains padding, a line feed or another invalid character
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+	__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+	__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+	__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+	__m128i plus = _mm_cmpeq_epi8(v, _mm_set1_epi8('+'));
+	__m128i slash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+	__m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+	if (_mm_movemask_epi8(valid) != 0xffff)
+		return false;
+
+	__m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-65));
+	shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(-71)));
+	shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(4)));
+	shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(19)));
+	shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(16)));
+	__m128i values = _mm_add_epi8(v, shift);
+
+	// Merge four 6-bit values into each 24-bit word 
+	__m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+	__m128i bytes = _mm_shuffle_epi8(_mm_madd_epi16(merged, _mm_set1_epi32(0x00011000)), 
+		_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(out), bytes);
+	int tail = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+	std::memcpy(out + 8, &tail, 4);
+	return true;
+}
+
+SCY_TARGET_SSSE3
+static void encodeSSSE3(const unsigned char* in, std::size_t groups, char* out)
+{
+	std::size_t i = 0;
+	for (; i + 6 <= groups; i += 4)
+		encodeBlockSSSE3(in + i * 3, out + i * 4);
+	encodeScalar(in + i * 3, groups - i, out + i * 4);
+}
+
+SCY_TARGET_SSSE3
+static std::size_t decodeSSSE3(const char* in, std::size_t len, char* out)
+{
+	std::size_t i = 0;
+	for (; i + 16 <= len && decodeBlockSSSE3(in + i, out); i += 16)
+		out += 12;
+	return i + decodeScalar(in + i, len - i, out);
+}
+
+SCY_TARGET_AVX2
+static void encodeAVX2(const unsigned char* in, std::size_t groups, char* out)
+{
+	const __m256i shuffle = _mm256_setr_epi8(
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const __m256i offsets = _mm256_setr_epi8(
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, 
+		'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, 
+		'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+	// Each step reads 12 bytes into each lane and encodes 24 bytes
+	std::size_t i = 0;
+	for (; i + 10 <= groups; i += 8) {
+		const unsigned char* p = in + i * 3;
+		__m256i v = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))), 
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+		v = _mm256_shuffle_epi8(v, shuffle);
+		__m256i hi = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+		__m256i lo = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+		__m256i indices = _mm256_or_si256(hi, lo);
+
+		__m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+		__m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+		range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 4), 
+			_mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range)));
+	}
+	for (; i + 6 <= groups; i += 4)
+		encodeBlockSSSE3(in + i * 3, out + i * 4);
+	encodeScalar(in + i * 3, groups - i, out + i * 4);
+}
+
+SCY_TARGET_AVX2
+static std::size_t decodeAVX2(const char* in, std::size_t len, char* out)
+{
+	const __m256i pack = _mm256_setr_epi8(
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+	// Each step decodes 32 characters into 24 bytes
+	std::size_t i = 0;
+	for (; i + 32 <= len; i += 32, out += 24) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+		__m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+		__m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), v));
+		__m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+		__m256i plus = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('+'));
+		__m256i slash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'));
+		__m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(_mm256_or_si256(digit, plus), slash));
+		if (_mm256_movemask_epi8(valid) != -1)
+			break;
+
+		__m256i shift = _mm256_and_si256(upper, _mm256_set1_epi8(-65));
+		shift = _mm256_or_si256(shift, _mm256_and_si256(lower, _mm256_set1_epi8(-71)));
+		shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(4)));
+		shift = _mm256_or_si256(shift, _mm256_and_si256(plus, _mm256_set1_epi8(19)));
+		shift = _mm256_or_si256(shift, _mm256_and_si256(slash, _mm256_set1_epi8(16)));
+		__m256i values = _mm256_add_epi8(v, shift);
+
+		// Pack each lane into 12 bytes, then close the gap between lanes
+		__m256i merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+		__m256i bytes = _mm256_shuffle_epi8(_mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000)), pack);
+		bytes = _mm256_permutevar8x32_epi32(bytes, lanes);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(bytes));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + 16), _mm256_extracti128_si256(bytes, 1));
+	}
+	for (; i + 16 <= len && decodeBlockSSSE3(in + i, out); i += 16)
+		out += 12;
+	return i + decodeScalar(in + i, len - i, out);
+}
+
+#endif // SCY_BASE64_SIMD
+
+
+struct Functions
+{
+	Mode mode;
+	void (*encode)(const unsigned char*, std::size_t, char*);
+		// Encodes whole groups of 3 bytes.
+	std::size_t (*decode)(const char*, std::size_t, char*);
+		// Decodes whole groups of 4 characters up to the first 
+		// padding or invalid character, and returns the number
+		// of characters read.
+};
+
+
+static Functions functionsFor(Mode mode)
+{
+	Functions fn;
+	fn.mode = mode;
+	switch (mode) {
+#ifdef SCY_BASE64_SIMD
+	case AVX2:
+		fn.encode = encodeAVX2;
+		fn.decode = decodeAVX2;
+		break;
+	case SSSE3:
+		fn.encode = encodeSSSE3;
+		fn.decode = decodeSSSE3;
+		break;
+#endif
+	default:
+		fn.mode = Scalar;
+		fn.encode = encodeScalar;
+		fn.decode = decodeScalar;
+		break;
+	}
+	return fn;
+}
+
+
+static Functions& active()
+{
+	static Functions fn = functionsFor(detectMode());
+	return fn;
+}
+
+
+int encode_block(const char* plaintext_in, int length_in, char* code_out, encodestate* state_in)
+{
+	const Functions& fn = active();
+	const char* plainchar = plaintext_in;
+	char* codechar = code_out;
+	while (length_in > 0) {
+		if (state_in->step == step_A && length_in >= 3) {
+
+			// Encode whole groups up to the end of the current line
+			int groups = length_in / 3;
+			int perline = state_in->linelength / 4;
+			if (perline > 0 && state_in->stepcount < perline && 
+				groups > perline - state_in->stepcount)
+				groups = perline - state_in->stepcount;
+
+			fn.encode(reinterpret_cast<const unsigned char*>(plainchar), groups, codechar);
+			plainchar += groups * 3;
+			codechar += groups * 4;
+			length_in -= groups * 3;
+			if (perline > 0 && (state_in->stepcount += groups) == perline) {
+				*codechar++ = '\n';
+				state_in->stepcount = 0;
+			}
+		}
+		else {
+
+			// Complete a partial group, or keep the tail in the state
+			int n = state_in->step == step_A ? length_in : state_in->step == step_B ? 2 : 1;
+			if (n > length_in)
+				n = length_in;
+			codechar += encode_block_scalar(plainchar, n, codechar, state_in);
+			plainchar += n;
+			length_in -= n;
+		}
+	}
+	return codechar - code_out;
+}
+
+
+int decode_block(const char* code_in, const int length_in, char* plaintext_out, decodestate* state_in)
+{
+	const Functions& fn = active();
+	const char* codechar = code_in;
+	const char* const codeend = code_in + length_in;
+	char* plainchar = plaintext_out;
+	while (codechar < codeend) {
+		if (state_in->step == step_a) {
+			std::size_t n = fn.decode(codechar, codeend - codechar, plainchar);
+			codechar += n;
+			plainchar += n / 4 * 3;
+			if (codechar == codeend)
+				break;
+
+			// Skip line feeds between whole groups
+			if (decode_value(*codechar) < 0) {
+				codechar++;
+				continue;
+			}
+		}
+
+		// Let the scalar decoder skip line feeds and padding, and
+		// carry partial groups over to the next call
+		plainchar += decode_block_scalar(codechar++, 1, plainchar, state_in);
+	}
+	return plainchar - plaintext_out;
+}
+
+
+} // namespace internal
+
+
+//
+// Buffer codecs
+//
+
+
+Mode detectMode()
+{
+#ifdef SCY_BASE64_SIMD
+	static const Mode best = hasAVX2() ? AVX2 : hasSSSE3() ? SSSE3 : Scalar;
+	return best;
+#else
+	return Scalar;
+#endif
+}
+
+
+Mode mode()
+{
+	return internal::active().mode;
+}
+
+
+void setMode(Mode mode)
+{
+	if (mode > detectMode())
+		mode = detectMode();
+	internal::active() = internal::functionsFor(mode);
+}
+
+
+const char* modeString(Mode mode)
+{
+	switch (mode) {
+	case Scalar: return "Scalar";
+	case SSSE3: return "SSSE3";
+	case AVX2: return "AVX2";
+	}
+	return "Unknown";
+}
+
+
+std::size_t encodedLength(std::size_t nread, int lineLength)
+{
+	std::size_t groups = (nread + 2) / 3;
+	std::size_t perline = lineLength > 0 ? lineLength / 4 : 0;
+	return groups * 4 + (perline > 0 ? groups / perline : 0);
+}
+
+
+std::size_t encode(const char* inbuf, std::size_t nread, char* outbuf, int lineLength)
+{
+	internal::encodestate state;
+	internal::init_encodestate(&state);
+	state.linelength = lineLength;
+	std::size_t n = internal::encode_block(inbuf, static_cast<int>(nread), outbuf, &state);
+	return n + internal::encode_blockend(outbuf + n, &state);
+}
+
+
+std::size_t decodedLength(std::size_t nread)
+{
+	return (nread + 3) / 4 * 3;
+}
+
+
+std::size_t decode(const char* inbuf, std::size_t nread, char* outbuf)
+{
+	internal::decodestate state;
+	internal::init_decodestate(&state);
+	return internal::decode_block(inbuf, static_cast<int>(nread), outbuf, &state);
+}
+
+
+} } // namespace scy::base64
@@ -0,0 +1,420 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/binarylog.h"
+#include "scy/filesystem.h"
+#include "scy/datetime.h"
+#include "scy/util.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <assert.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace scy {
+
+
+namespace internal {
+
+	// File layout:
+	//
+	//   header:  magic[8] UInt32 version UInt32 byteOrder
+	//   record:  UInt8 type UInt32 size payload[size]
+	//
+	// A zero record type marks the end of the written data, since
+	// files are preallocated and zero filled.
+	//
+	// Site record 'S':    UInt32 id, Int32 line, realm
+	// Message record 'M': UInt32 site, UInt8 level, Int64 time,
+	//                     UInt16 addressLen, address, encoded args
+	//
+	const char kMagic[8] = { 'S', 'C', 'Y', 'B', 'L', 'O', 'G', '\0' };
+	const UInt32 kVersion = 1;
+	const UInt32 kByteOrder = 0x01020304;
+	const std::size_t kHeaderSize = sizeof(kMagic) + 8;
+	const std::size_t kRecordHeaderSize = 5;
+	const char kSiteRecord = 'S';
+	const char kMessageRecord = 'M';
+
+	template<typename T>
+	inline char* put(char* data, T val)
+	{
+		std::memcpy(data, &val, sizeof(val));
+		return data + sizeof(val);
+	}
+
+	template<typename T>
+	inline bool get(const char*& data, const char* end, T& val)
+	{
+		if (static_cast<std::size_t>(end - data) < sizeof(val))
+			return false;
+		std::memcpy(&val, data, sizeof(val));
+		data += sizeof(val);
+		return true;
+	}
+
+}
+
+
+//
+// Binary File Channel
+//
+
+
+BinaryFileChannel::BinaryFileChannel(const std::string& name,
+									 const std::string& dir,
+									 LogLevel level,
+									 std::size_t fileSize,
+									 const std::string& extension,
+									 int maxFiles) : 
+	LogChannel(name, level),
+	_dir(dir),
+	_extension(extension),
+	_fileSize(fileSize),
+	_maxFiles(maxFiles),
+	_offset(0),
+	_data(nullptr),
+#ifdef WIN32
+	_file(nullptr),
+	_mapping(nullptr),
+#else
+	_fd(-1),
+#endif
+	_nextSite(0),
+	_sequence(0)
+{
+	if (_fileSize < internal::kHeaderSize + 1024)
+		throw std::runtime_error("Binary log file size is too small.");
+}
+
+
+BinaryFileChannel::~BinaryFileChannel()
+{
+	close();
+}
+
+
+void BinaryFileChannel::write(const LogStream& stream)
+{
+	if (this->level() > stream.level)
+		return;
+
+	if (!_data)
+		open();
+
+	// Streams written before binary mode was enabled carry
+	// their preformatted message as a single argument
+	std::string text;
+	if (!stream.binary)
+		logarg::encode(text, stream.message.str());
+	const std::string& args = stream.binary ? stream.args : text;
+	std::size_t addressLen = std::min<std::size_t>(stream.address.size(), 0xFFFF);
+
+	std::size_t size = 4 + 1 + 8 + 2 + addressLen + args.size();
+
+	// Make room for the message and its site record, leaving room for 
+	// the end marker. Records larger than a file are dropped; channels
+	// can't log errors themselves since they are written to under the 
+	// logger lock.
+	std::size_t required = internal::kRecordHeaderSize * 2 + 8 + stream.realm.size() + size + 1;
+	if (internal::kHeaderSize + required > _fileSize)
+		return;
+	if (_offset + required > _fileSize)
+		rotate();
+
+	UInt32 site = siteID(stream.realm, stream.line);
+	char* data = reserve(internal::kMessageRecord, size);
+	data = internal::put(data, site);
+	data = internal::put(data, static_cast<UInt8>(stream.level));
+	data = internal::put(data, static_cast<Int64>(stream.ts));
+	data = internal::put(data, static_cast<UInt16>(addressLen));
+	std::memcpy(data, stream.address.data(), addressLen);
+	std::memcpy(data + addressLen, args.data(), args.size());
+}
+
+
+UInt32 BinaryFileChannel::siteID(const std::string& realm, int line)
+{
+	SiteLines& lines = _sites[realm];
+	for (auto& kv : lines) {
+		if (kv.first == line)
+			return kv.second;
+	}
+
+	UInt32 id = _nextSite++;
+	lines.push_back(std::make_pair(line, id));
+
+	char* data = reserve(internal::kSiteRecord, 4 + 4 + realm.size());
+	data = internal::put(data, id);
+	data = internal::put(data, static_cast<Int32>(line));
+	std::memcpy(data, realm.data(), realm.size());
+	return id;
+}
+
+
+char* BinaryFileChannel::reserve(char type, std::size_t size)
+{
+	assert(_offset + internal::kRecordHeaderSize + size < _fileSize);
+	char* data = _data + _offset;
+	data = internal::put(data, static_cast<UInt8>(type));
+	data = internal::put(data, static_cast<UInt32>(size));
+	_offset += internal::kRecordHeaderSize + size;
+	return data;
+}
+
+
+void BinaryFileChannel::rotate()
+{
+	close();
+	open();
+}
+
+
+void BinaryFileChannel::open()
+{
+	close();
+
+	fs::mkdirr(_dir, 0755);
+	_path = _dir;
+	fs::addnode(_path, util::format("%s_%ld_%d.%s", _name.c_str(), 
+		static_cast<long>(Timestamp().epochTime()), _sequence++, _extension.c_str()));
+
+#ifdef WIN32
+	HANDLE file = ::CreateFileA(_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, 
+		nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open binary log file: " + _path);
+	ULARGE_INTEGER size;
+	size.QuadPart = _fileSize;
+	HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READWRITE, size.HighPart, size.LowPart, nullptr);
+	void* data = mapping ? ::MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, _fileSize) : nullptr;
+	if (!data) {
+		if (mapping)
+			::CloseHandle(mapping);
+		::CloseHandle(file);
+		throw std::runtime_error("Failed to map binary log file: " + _path);
+	}
+	_file = file;
+	_mapping = mapping;
+#else
+	int fd = ::open(_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		throw std::runtime_error("Failed to open binary log file: " + _path);
+	void* data = MAP_FAILED;
+	if (::ftruncate(fd, static_cast<off_t>(_fileSize)) == 0)
+		data = ::mmap(nullptr, _fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		::close(fd);
+		throw std::runtime_error("Failed to map binary log file: " + _path);
+	}
+	_fd = fd;
+#endif
+
+	_data = static_cast<char*>(data);
+	char* header = _data;
+	std::memcpy(header, internal::kMagic, sizeof(internal::kMagic));
+	header = internal::put(header + sizeof(internal::kMagic), internal::kVersion);
+	internal::put(header, internal::kByteOrder);
+	_offset = internal::kHeaderSize;
+	_sites.clear();
+
+	if (_maxFiles > 0)
+		purge();
+}
+
+
+void BinaryFileChannel::purge()
+{
+	// Channels can't log errors themselves, so files which
+	// can't be listed or removed are left in place
+	std::vector<std::string> names;
+	try {
+		fs::readdir(_dir, names);
+	}
+	catch (std::exception&) {
+		return;
+	}
+
+	// File names are <name>_<epoch>_<sequence>.<extension>
+	std::string prefix(_name + "_");
+	std::string suffix("." + _extension);
+	std::vector<std::pair<std::pair<long, long>, std::string>> files;
+	for (auto& name : names) {
+		if (name.size() <= prefix.size() + suffix.size() ||
+			name.compare(0, prefix.size(), prefix) != 0 ||
+			name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+			continue;
+		long epoch, sequence;
+		char sep;
+		std::istringstream istr(name.substr(prefix.size(), name.size() - prefix.size() - suffix.size()));
+		if (!(istr >> epoch >> sep >> sequence) || sep != '_' || istr.peek() != EOF)
+			continue;
+		files.push_back(std::make_pair(std::make_pair(epoch, sequence), name));
+	}
+	if (files.size() <= static_cast<std::size_t>(_maxFiles))
+		return;
+
+	std::sort(files.begin(), files.end());
+	std::size_t excess = files.size() - _maxFiles;
+	for (std::size_t i = 0; i < excess; i++) {
+		std::string path(_dir);
+		fs::addnode(path, files[i].second);
+		if (path == _path)
+			continue;
+		try {
+			fs::unlink(path);
+		}
+		catch (std::exception&) {
+		}
+	}
+}
+
+
+void BinaryFileChannel::close()
+{
+	if (!_data)
+		return;
+
+	// Terminate the written data and trim the unused tail
+	_data[_offset] = 0;
+	std::size_t size = _offset + 1;
+
+#ifdef WIN32
+	::UnmapViewOfFile(_data);
+	::CloseHandle(static_cast<HANDLE>(_mapping));
+	LARGE_INTEGER pos;
+	pos.QuadPart = size;
+	::SetFilePointerEx(static_cast<HANDLE>(_file), pos, nullptr, FILE_BEGIN);
+	::SetEndOfFile(static_cast<HANDLE>(_file));
+	::CloseHandle(static_cast<HANDLE>(_file));
+	_file = nullptr;
+	_mapping = nullptr;
+#else
+	::munmap(_data, _fileSize);
+	if (::ftruncate(_fd, static_cast<off_t>(size)) != 0) {
+		// The zero filled tail is ignored by the reader
+	}
+	::close(_fd);
+	_fd = -1;
+#endif
+	_data = nullptr;
+	_offset = 0;
+}
+
+
+//
+// Binary Log Reader
+//
+
+
+BinaryLogReader::BinaryLogReader(const char* timeFormat) : 
+	_formatter("decoder", LTrace, timeFormat)
+{
+}
+
+
+std::size_t BinaryLogReader::read(const std::string& path, std::ostream& ost)
+{
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("Failed to open binary log file: " + path);
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return read(data.data(), data.size(), ost);
+}
+
+
+std::size_t BinaryLogReader::read(const char* data, std::size_t size, std::ostream& ost)
+{
+	const char* end = data + size;
+	UInt32 version, byteOrder;
+	if (size < internal::kHeaderSize || 
+		std::memcmp(data, internal::kMagic, sizeof(internal::kMagic)) != 0)
+		throw std::runtime_error("Not a binary log file.");
+	data += sizeof(internal::kMagic);
+	internal::get(data, end, version);
+	internal::get(data, end, byteOrder);
+	if (version != internal::kVersion || byteOrder != internal::kByteOrder)
+		throw std::runtime_error("Unsupported binary log version or byte order.");
+
+	// Site IDs are scoped to a file
+	_sites.clear();
+	std::size_t messages = 0;
+	while (data < end) {
+		UInt8 type;
+		UInt32 length;
+		if (!internal::get(data, end, type) || type == 0)
+			break;
+		if (!internal::get(data, end, length) || 
+			static_cast<std::size_t>(end - data) < length)
+			throw std::runtime_error("Truncated binary log record.");
+		const char* next = data + length;
+
+		if (type == internal::kSiteRecord) {
+			UInt32 id;
+			Int32 line;
+			if (!internal::get(data, next, id) || 
+				!internal::get(data, next, line))
+				throw std::runtime_error("Invalid binary log site record.");
+			_sites[id] = std::make_pair(std::string(data, next), static_cast<int>(line));
+		}
+		else if (type == internal::kMessageRecord) {
+			UInt32 site;
+			UInt8 level;
+			Int64 ts;
+			UInt16 addressLen;
+			if (!internal::get(data, next, site) || 
+				!internal::get(data, next, level) || 
+				!internal::get(data, next, ts) ||
+				!internal::get(data, next, addressLen) ||
+				static_cast<std::size_t>(next - data) < addressLen)
+				throw std::runtime_error("Invalid binary log message record.");
+
+			LogStream stream(static_cast<LogLevel>(level), "", 0);
+			stream.ts = static_cast<std::time_t>(ts);
+			stream.address.assign(data, addressLen);
+			stream.binary = true;
+			stream.args.assign(data + addressLen, next);
+			auto it = _sites.find(site);
+			if (it != _sites.end()) {
+				stream.realm = it->second.first;
+				stream.line = it->second.second;
+			}
+			_formatter.format(stream, ost);
+			ost << '\n';
+			messages++;
+		}
+		// Unknown record types are skipped
+		data = next;
+	}
+	return messages;
+}
+
+
+} // namespace scy
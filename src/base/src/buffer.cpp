@@ -0,0 +1,822 @@
+//
+// LibSourcey
+// Copyright(C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or(at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/buffer.h"
+#include "scy/util.h"
+#include "scy/logger.h"
+#include "scy/byteorder.h"
+#include "scy/bufferscan.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace scy {
+
+
+//
+// Bit Reader
+//
+
+
+BitReader::BitReader(const ConstBuffer& pod, ByteOrder order)
+{
+	init(bufferCast<const char*>(pod), pod.size(), order); // copied
+}
+
+
+BitReader::BitReader(const Buffer& buf, ByteOrder order)
+{
+	init(buf.data(), buf.size(), order);
+}
+
+
+BitReader::BitReader(const char* bytes, std::size_t size, ByteOrder order)
+{
+	init(bytes, size, order);
+}
+
+
+void BitReader::init(const char* bytes, std::size_t size, ByteOrder order) 
+{
+	//_mark = 0;
+	_position = 0;
+	//_capacity = size;
+	_limit = size;
+	_order = order;
+	_bytes = bytes;
+	//_free = false;
+}
+
+
+BitReader::~BitReader() 
+{
+}
+
+
+void BitReader::seek(std::size_t val)
+{ 
+	if (val > _limit)
+		throw std::out_of_range("index out of range");
+
+	_position = val;
+}
+
+
+void BitReader::skip(std::size_t val) 
+{
+	if (val > _limit)
+		throw std::out_of_range("index out of range");
+
+	_position += val;
+}
+
+
+std::string BitReader::toString() 
+{
+	return std::string(current(), position()); 
+}
+
+
+size_t BitReader::available() const 
+{
+	return _limit - _position;
+}
+
+
+size_t BitReader::limit() const
+{ 
+	return _limit; 
+} 
+
+
+//
+// Get methods
+//
+
+void BitReader::getU8(UInt8& val)
+{
+	get(reinterpret_cast<char*>(&val), 1);
+}
+
+
+void BitReader::getU16(UInt16& val)
+{
+	UInt16 v;
+	get(reinterpret_cast<char*>(&v), 2);
+	val = (_order == ByteOrder::Network) ? networkToHost16(v) : v;
+}
+
+
+void BitReader::getU24(UInt32& val)
+{
+	UInt32 v = 0;
+	char* target = reinterpret_cast<char*>(&v);
+	if (_order == ByteOrder::Network || isBigEndian())
+		++target;
+
+	get(target, 3);
+	val = (_order == ByteOrder::Network) ? networkToHost32(v) : v;
+}
+
+
+void BitReader::getU32(UInt32& val)
+{
+	UInt32 v;
+	get(reinterpret_cast<char*>(&v), 4);
+	val = (_order == ByteOrder::Network) ? networkToHost32(v) : v;
+}
+
+
+void BitReader::getU64(UInt64& val)
+{
+	UInt64 v;
+	get(reinterpret_cast<char*>(&v), 8);
+	val = (_order == ByteOrder::Network) ? networkToHost64(v) : v;
+}
+
+
+void BitReader::get(std::string& val, std::size_t len)
+{
+	if (len > limit())
+		throw std::out_of_range("index out of range");
+
+	val.append(_bytes + _position, len);
+	_position += len;
+}
+
+
+void BitReader::get(char* val, std::size_t len)
+{
+	if (len > limit())
+		throw std::out_of_range("index out of range");
+
+	memcpy(val, _bytes + _position, len);
+	_position += len;
+}
+
+
+//
+// String parsing
+//
+
+int BitReader::skipToChar(char c) 
+{
+	size_t len = scan::findChar(_bytes + _position, available(), c);
+	_position += len;
+	return len;
+}
+
+
+int BitReader::skipWhitespace() 
+{
+	size_t len = scan::findNotChar(_bytes + _position, available(), ' ');
+	_position += len;
+	return len;
+}
+
+	
+int BitReader::skipToNextLine() 
+{
+	size_t len = scan::findChar(_bytes + _position, available(), '\n');
+	len++; // advance past newline
+	if (_limit > _position + len)
+		_position += len;
+	else
+		_position = _limit;
+	return len;
+}
+
+
+int BitReader::skipNextWord() 
+{	
+	skipWhitespace();
+	size_t len = scan::findWordEnd(_bytes + _position, available());
+	_position += len;
+	return len;
+}
+
+
+int BitReader::readToNext(std::string& val, char c) 
+{
+	size_t len = scan::findChar(_bytes + _position, available(), c);
+	val.append(_bytes + _position, len);
+	_position += len;
+	return len;
+}
+
+
+int BitReader::readNextWord(std::string& val) 
+{	
+	skipWhitespace();
+	size_t len = scan::findWordEnd(_bytes + _position, available());
+	val.append(_bytes + _position, len);
+	_position += len;
+	return len;
+}
+
+
+int BitReader::readNextNumber(unsigned int& val) 
+{	
+	skipWhitespace();
+	size_t len = scan::findWordEnd(_bytes + _position, available());
+	val = util::strtoi<UInt32>(std::string(_bytes + _position, len));
+	_position += len;
+	return len;
+}
+
+
+int BitReader::readLine(std::string& val)
+{	
+	size_t len = scan::findChar(_bytes + _position, available(), '\n');
+	val.append(_bytes + _position, len);
+	len++; // advance past newline
+	if (_limit > _position + len)
+		_position += len;
+	else
+		_position = _limit;
+	return len;
+}
+
+
+//
+// Buffer Chain
+//
+
+
+BufferChain::BufferChain() :
+	_bytes(_inlineBytes),
+	_numBytes(0),
+	_byteCapacity(InlineBytes),
+	_segments(_inlineSegments),
+	_count(0),
+	_segmentCapacity(InlineSegments),
+	_size(0)
+{
+}
+
+
+BufferChain::BufferChain(const BufferChain& that) :
+	_bytes(_inlineBytes),
+	_numBytes(0),
+	_byteCapacity(InlineBytes),
+	_segments(_inlineSegments),
+	_count(0),
+	_segmentCapacity(InlineSegments),
+	_size(0)
+{
+	assign(that);
+}
+
+
+BufferChain::BufferChain(BufferChain&& that) :
+	_bytes(_inlineBytes),
+	_numBytes(0),
+	_byteCapacity(InlineBytes),
+	_segments(_inlineSegments),
+	_count(0),
+	_segmentCapacity(InlineSegments),
+	_size(0)
+{
+	take(that);
+}
+
+
+BufferChain::~BufferChain()
+{
+	freeHeap();
+}
+
+
+BufferChain& BufferChain::operator = (const BufferChain& that)
+{
+	if (this != &that) {
+		clear();
+		assign(that);
+	}
+	return *this;
+}
+
+
+BufferChain& BufferChain::operator = (BufferChain&& that)
+{
+	if (this != &that) {
+		clear();
+		take(that);
+	}
+	return *this;
+}
+
+
+void BufferChain::assign(const BufferChain& that)
+{
+	// Must be called on an empty chain
+	if (that._numBytes > 0)
+		std::memcpy(addBytes(that._numBytes), that._bytes, that._numBytes);
+	for (std::size_t i = 0; i < that._count; i++)
+		addSegment() = that._segments[i];
+	_size = that._size;
+}
+
+
+void BufferChain::take(BufferChain& that)
+{
+	// Must be called on an empty chain. Heap storage is stolen,
+	// inline storage is copied.
+	if (that._bytes != that._inlineBytes) {
+		freeHeap(); // clear() keeps heap storage for reuse
+		_bytes = that._bytes;
+		_byteCapacity = that._byteCapacity;
+		_numBytes = that._numBytes;
+		that._bytes = that._inlineBytes;
+		that._byteCapacity = InlineBytes;
+	}
+	else if (that._numBytes > 0)
+		std::memcpy(addBytes(that._numBytes), that._bytes, that._numBytes);
+
+	if (that._segments != that._inlineSegments) {
+		if (_segments != _inlineSegments)
+			delete [] _segments;
+		_segments = that._segments;
+		_segmentCapacity = that._segmentCapacity;
+		_count = that._count;
+		that._segments = that._inlineSegments;
+		that._segmentCapacity = InlineSegments;
+	}
+	else {
+		for (std::size_t i = 0; i < that._count; i++)
+			addSegment() = that._segments[i];
+	}
+	_size = that._size;
+	that.clear();
+}
+
+
+void BufferChain::freeHeap()
+{
+	if (_bytes != _inlineBytes) {
+		delete [] _bytes;
+		_bytes = _inlineBytes;
+		_byteCapacity = InlineBytes;
+	}
+	if (_segments != _inlineSegments) {
+		delete [] _segments;
+		_segments = _inlineSegments;
+		_segmentCapacity = InlineSegments;
+	}
+}
+
+
+BufferChain::Segment& BufferChain::addSegment()
+{
+	if (_count == _segmentCapacity) {
+		std::size_t capacity = _segmentCapacity * 2;
+		Segment* segments = new Segment[capacity];
+		std::memcpy(segments, _segments, _count * sizeof(Segment));
+		if (_segments != _inlineSegments)
+			delete [] _segments;
+		_segments = segments;
+		_segmentCapacity = capacity;
+	}
+	return _segments[_count++];
+}
+
+
+char* BufferChain::addBytes(std::size_t len)
+{
+	if (_numBytes + len > _byteCapacity) {
+		std::size_t capacity = std::max<std::size_t>(_byteCapacity * 2, _numBytes + len);
+		char* bytes = new char[capacity];
+		std::memcpy(bytes, _bytes, _numBytes);
+		if (_bytes != _inlineBytes)
+			delete [] _bytes;
+		_bytes = bytes;
+		_byteCapacity = capacity;
+	}
+	char* p = _bytes + _numBytes;
+	_numBytes += len;
+	return p;
+}
+
+
+void BufferChain::write(const char* data, std::size_t len)
+{
+	if (len == 0)
+		return;
+
+	// Coalesce with the previous segment if it ends at the storage tail
+	if (_count > 0) {
+		Segment& last = _segments[_count - 1];
+		if (!last.data && last.offset + last.len == _numBytes) {
+			std::memcpy(addBytes(len), data, len);
+			last.len += len;
+			_size += len;
+			return;
+		}
+	}
+
+	const std::size_t offset = _numBytes;
+	std::memcpy(addBytes(len), data, len);
+	Segment& seg = addSegment();
+	seg.data = nullptr;
+	seg.offset = offset;
+	seg.len = len;
+	_size += len;
+}
+
+
+void BufferChain::write(const std::string& data)
+{
+	write(data.data(), data.size());
+}
+
+
+void BufferChain::append(const char* data, std::size_t len)
+{
+	if (len == 0)
+		return;
+
+	Segment& seg = addSegment();
+	seg.data = data;
+	seg.offset = 0;
+	seg.len = len;
+	_size += len;
+}
+
+
+void BufferChain::append(const ConstBuffer& buf)
+{
+	append(bufferCast<const char*>(buf), buf.size());
+}
+
+
+void BufferChain::append(const BufferChain& chain)
+{
+	// Copy the count first, the chain may be appended to itself
+	const std::size_t count = chain._count;
+	for (std::size_t i = 0; i < count; i++) {
+		const Segment seg = chain._segments[i];
+		if (seg.data)
+			append(seg.data, seg.len);
+		else if (&chain != this)
+			write(chain._bytes + seg.offset, seg.len);
+		else {
+			Buffer copy(_bytes + seg.offset, _bytes + seg.offset + seg.len);
+			write(copy.data(), copy.size());
+		}
+	}
+}
+
+
+bool BufferChain::update(const char* data, std::size_t len, std::size_t pos)
+{
+	std::size_t start = 0;
+	for (std::size_t i = 0; i < _count; i++) {
+		const Segment& seg = _segments[i];
+		if (pos < start + seg.len) {
+			std::size_t off = pos - start;
+			if (seg.data || off + len > seg.len)
+				return false;
+			std::memcpy(_bytes + seg.offset + off, data, len);
+			return true;
+		}
+		start += seg.len;
+	}
+	return false;
+}
+
+
+std::size_t BufferChain::size() const
+{
+	return _size;
+}
+
+
+std::size_t BufferChain::count() const
+{
+	return _count;
+}
+
+
+bool BufferChain::empty() const
+{
+	return _size == 0;
+}
+
+
+ConstBuffer BufferChain::segment(std::size_t index) const
+{
+	if (index >= _count)
+		throw std::out_of_range("Buffer chain segment out of range");
+	const Segment& seg = _segments[index];
+	return ConstBuffer(seg.data ? seg.data : _bytes + seg.offset, seg.len);
+}
+
+
+void BufferChain::flatten(Buffer& buf) const
+{
+	buf.reserve(buf.size() + _size);
+	for (std::size_t i = 0; i < _count; i++) {
+		ConstBuffer seg = segment(i);
+		const char* data = bufferCast<const char*>(seg);
+		buf.insert(buf.end(), data, data + seg.size());
+	}
+}
+
+
+std::size_t BufferChain::copyTo(char* data, std::size_t len) const
+{
+	std::size_t copied = 0;
+	for (std::size_t i = 0; i < _count && copied < len; i++) {
+		ConstBuffer seg = segment(i);
+		std::size_t n = std::min<std::size_t>(seg.size(), len - copied);
+		std::memcpy(data + copied, bufferCast<const char*>(seg), n);
+		copied += n;
+	}
+	return copied;
+}
+
+
+std::string BufferChain::toString() const
+{
+	std::string str;
+	str.reserve(_size);
+	for (std::size_t i = 0; i < _count; i++) {
+		ConstBuffer seg = segment(i);
+		str.append(bufferCast<const char*>(seg), seg.size());
+	}
+	return str;
+}
+
+
+void BufferChain::clear()
+{
+	// Heap storage is kept for reuse
+	_count = 0;
+	_numBytes = 0;
+	_size = 0;
+}
+
+
+//
+// Bit Writer
+//
+
+
+BitWriter::BitWriter(MutableBuffer& pod, ByteOrder order)
+{
+	init(bufferCast<char*>(pod), pod.size(), order); // copied
+}
+
+
+BitWriter::BitWriter(char* bytes, std::size_t size, ByteOrder order)
+{
+	init(bytes, size, order);
+}
+
+
+BitWriter::BitWriter(Buffer& buf, ByteOrder order)
+{
+	init(buf.data(), buf.size(), order);
+	_buffer = &buf;
+}
+
+
+BitWriter::BitWriter(BufferChain& chain, ByteOrder order)
+{
+	init(nullptr, 0, order);
+	_chain = &chain;
+	_position = chain.size();
+	_limit = _position;
+}
+
+
+void BitWriter::init(char* bytes, std::size_t size, ByteOrder order) 
+{
+
+	//_vector = nullptr;
+	_buffer = nullptr;
+	_chain = nullptr;
+	_position = 0;
+	_limit = size;
+	//_capacity = size;
+	_order = order;
+	_bytes = bytes;
+	//_free = false;
+}
+
+
+BitWriter::~BitWriter() 
+{
+}
+
+
+void BitWriter::skip(std::size_t val) 
+{
+	if (_position + val > _limit)
+		throw std::out_of_range("index out of range");
+	
+	_position += val;
+}
+
+
+void BitWriter::seek(std::size_t val)
+{ 
+	if (val > _limit)
+		throw std::out_of_range("index out of range");
+
+	_position = val;
+}
+
+
+std::string BitWriter::toString() 
+{
+	if (_chain)
+		return _chain->toString();
+	return std::string(begin(), position()); 
+}
+
+
+size_t BitWriter::available() const 
+{
+	return _limit - _position;
+}
+
+
+size_t BitWriter::limit() const
+{ 
+	return _limit; 
+} 
+
+
+//
+// Write functions
+//
+
+void BitWriter::putU8(UInt8 val)
+{
+	put(reinterpret_cast<const char*>(&val), 1);
+}
+
+
+void BitWriter::putU16(UInt16 val) 
+{
+	UInt16 v = (_order == ByteOrder::Network) ? hostToNetwork16(val) : val;
+	put(reinterpret_cast<const char*>(&v), 2);
+}
+
+
+void BitWriter::putU24(UInt32 val)
+{
+	UInt32 v = (_order == ByteOrder::Network) ? hostToNetwork32(val) : val;
+	char* start = reinterpret_cast<char*>(&v);
+	if (_order == ByteOrder::Network || isBigEndian())
+		++start;
+
+	put(start, 3);
+}
+
+
+void BitWriter::putU32(UInt32 val) 
+{
+	UInt32 v = (_order == ByteOrder::Network) ? hostToNetwork32(val) : val;
+	put(reinterpret_cast<const char*>(&v), 4);
+}
+
+
+void BitWriter::putU64(UInt64 val) 
+{
+	UInt64 v = (_order == ByteOrder::Network) ? hostToNetwork64(val) : val;
+	put(reinterpret_cast<const char*>(&v), 8);
+}
+
+
+void BitWriter::put(const std::string& val) 
+{
+	put(val.c_str(), val.size());
+}
+
+
+void BitWriter::put(const char* val, std::size_t len) 
+{		
+	// Write to buffer chain
+	if (_chain) {
+		_chain->write(val, len);
+		_limit = _chain->size();
+		_position += len;
+	}
+
+	// Write to dynamic buffer
+	else if (_buffer) {
+		//_buffer->resize(std::max<std::size_t>(3 * len / 2, 2048));	
+		_buffer->insert(_buffer->end(), val, val + len); 
+		_bytes = _buffer->data();		
+		_limit = _buffer->size();	
+		_position += len;	
+	}
+	
+	// Write to fixed size buffer
+	else {
+		if ((_position + len) > _limit)
+			throw std::out_of_range("insufficient buffer capacity");
+
+		memcpy(_bytes + _position, val, len);
+		_position += len;
+	}
+}
+
+
+void BitWriter::putRef(const char* val, std::size_t len) 
+{
+	// Reference the bytes if writing to a buffer chain
+	if (_chain) {
+		_chain->append(val, len);
+		_limit = _chain->size();
+		_position += len;
+	}
+	else
+		put(val, len);
+}
+
+
+//
+// Update functions
+//
+
+
+bool BitWriter::updateU8(UInt8 val, std::size_t pos) 
+{
+	return update(reinterpret_cast<const char*>(&val), 1, pos);
+}
+
+
+bool BitWriter::updateU16(UInt16 val, std::size_t pos) 
+{
+	UInt16 v = (_order == ByteOrder::Network) ? hostToNetwork16(val) : val;
+	return update(reinterpret_cast<const char*>(&v), 2, pos);
+}
+
+
+bool BitWriter::updateU24(UInt32 val, std::size_t pos) 
+{
+	UInt32 v = (_order == ByteOrder::Network) ? hostToNetwork32(val) : val;
+	char* start = reinterpret_cast<char*>(&v);
+	if (_order == ByteOrder::Network || isBigEndian())
+		++start;
+
+	return update(start, 3, pos);
+}
+
+
+bool BitWriter::updateU32(UInt32 val, std::size_t pos) 
+{
+	UInt32 v = (_order == ByteOrder::Network) ? hostToNetwork32(val) : val;
+	return update(reinterpret_cast<const char*>(&v), 4, pos);
+}
+
+
+bool BitWriter::updateU64(UInt64 val, std::size_t pos) 
+{
+	UInt64 v = (_order == ByteOrder::Network) ? hostToNetwork64(val) : val;
+	return update(reinterpret_cast<const char*>(&v), 8, pos);
+}
+
+
+bool BitWriter::update(const std::string& val, std::size_t pos) 
+{
+	return update(val.c_str(), val.size(), pos);
+}
+
+
+bool BitWriter::update(const char* val, std::size_t len, std::size_t pos) 
+{	
+	if (_chain)
+		return _chain->update(val, len, pos);
+
+	if ((pos + len) > available())
+		return false;
+
+	memcpy(_bytes + pos, val, len);
+	return true;
+}
+
+
+} // namespace scy
\ No newline at end of file
@@ -0,0 +1,412 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/bufferpool.h"
+
+#include <algorithm>
+#include <map>
+
+
+namespace scy {
+
+
+//
+// Buffer Slab
+//
+
+
+struct BufferSlab
+{
+	char* memory;						// As allocated
+	char* data;							// Page aligned start of the first block
+	std::size_t cls;					// Index of the owning size class
+	std::size_t numFree;
+	std::vector<PooledBuffer*> blocks;	// In address order
+};
+
+
+//
+// Pooled Buffer
+//
+
+
+PooledBuffer::PooledBuffer(BufferPool* pool, BufferSlab* slab, char* data, std::size_t capacity) :
+	_pool(pool),
+	_slab(slab),
+	_data(data),
+	_capacity(capacity),
+	_size(0)
+{
+}
+
+
+PooledBuffer::~PooledBuffer()
+{
+}
+
+
+void PooledBuffer::freeMemory()
+{
+	_pool->recycle(this);
+}
+
+
+//
+// Buffer Pool
+//
+
+
+namespace internal {
+
+	static Mutex loopPoolsMutex;
+	static std::map<uv::Loop*, BufferPool*> loopPools;
+
+	// Slabs are aligned to and indexed by pages, so no
+	// page holds blocks from more than one slab
+	const std::size_t kPageSize = 4096;
+
+}
+
+
+BufferPool::BufferPool(std::size_t blockSize, std::size_t blocksPerSlab) :
+	_freeBytes(0),
+	_maxFree(4 * 1024 * 1024)
+{
+	assert(blockSize > 0);
+	assert(blocksPerSlab > 0);
+	SizeClass cls;
+	cls.blockSize = blockSize;
+	cls.blocksPerSlab = blocksPerSlab;
+	_classes.push_back(cls);
+}
+
+
+BufferPool::BufferPool(const std::vector<std::size_t>& blockSizes, std::size_t slabSize) :
+	_freeBytes(0),
+	_maxFree(4 * 1024 * 1024)
+{
+	assert(!blockSizes.empty());
+	std::vector<std::size_t> sizes(blockSizes);
+	std::sort(sizes.begin(), sizes.end());
+	for (auto size : sizes) {
+		assert(size > 0);
+		SizeClass cls;
+		cls.blockSize = size;
+		cls.blocksPerSlab = std::max<std::size_t>(1, slabSize / size);
+		_classes.push_back(cls);
+	}
+}
+
+
+BufferPool::~BufferPool()
+{
+	// All blocks hold a pool reference, so none can be outstanding here.
+	while (!_slabs.empty())
+		freeSlab(_slabs.back());
+}
+
+
+PooledBuffer* BufferPool::acquire(std::size_t size)
+{
+	std::size_t index = 0;
+	while (_classes[index].blockSize < size) {
+		if (++index == _classes.size())
+			return nullptr;
+	}
+
+	PooledBuffer* block;
+	{
+		Mutex::ScopedLock lock(_mutex);
+		SizeClass& cls = _classes[index];
+		if (cls.free.empty())
+			allocateSlab(index);
+		block = cls.free.back();
+		cls.free.pop_back();
+		block->_slab->numFree--;
+		_freeBytes -= cls.blockSize;
+	}
+
+	block->count = 1;
+	block->_size = 0;
+
+	// Outstanding blocks keep the pool alive
+	duplicate();
+	return block;
+}
+
+
+void BufferPool::recycle(PooledBuffer* block)
+{
+	assert(block->_pool == this);
+	{
+		Mutex::ScopedLock lock(_mutex);
+		BufferSlab* slab = block->_slab;
+		SizeClass& cls = _classes[slab->cls];
+		cls.free.push_back(block);
+		_freeBytes += cls.blockSize;
+
+		// Give idle slabs back once the pool holds too much free memory
+		if (++slab->numFree == cls.blocksPerSlab && _freeBytes > _maxFree)
+			freeSlab(slab);
+	}
+	release();
+}
+
+
+void BufferPool::allocateSlab(std::size_t index)
+{
+	// Must be called with the mutex locked
+	SizeClass& cls = _classes[index];
+	const std::size_t bytes = cls.blockSize * cls.blocksPerSlab;
+	auto slab = new BufferSlab;
+	slab->memory = new char[bytes + internal::kPageSize - 1];
+	slab->data = reinterpret_cast<char*>(
+		(reinterpret_cast<std::uintptr_t>(slab->memory) + internal::kPageSize - 1) & ~(internal::kPageSize - 1));
+	slab->cls = index;
+	slab->numFree = cls.blocksPerSlab;
+	slab->blocks.reserve(cls.blocksPerSlab);
+	_slabs.push_back(slab);
+	cls.free.reserve(cls.free.size() + cls.blocksPerSlab);
+	for (std::size_t i = 0; i < cls.blocksPerSlab; i++) {
+		auto block = new PooledBuffer(this, slab, slab->data + (i * cls.blockSize), cls.blockSize);
+		slab->blocks.push_back(block);
+		cls.free.push_back(block);
+	}
+	_freeBytes += bytes;
+
+	const std::uintptr_t first = reinterpret_cast<std::uintptr_t>(slab->data) / internal::kPageSize;
+	const std::uintptr_t last = (reinterpret_cast<std::uintptr_t>(slab->data) + bytes - 1) / internal::kPageSize;
+	for (std::uintptr_t page = first; page <= last; page++)
+		_index[page] = slab;
+}
+
+
+void BufferPool::freeSlab(BufferSlab* slab)
+{
+	// Must be called with the mutex locked
+	SizeClass& cls = _classes[slab->cls];
+	const std::size_t bytes = cls.blockSize * cls.blocksPerSlab;
+	assert(slab->numFree == cls.blocksPerSlab);
+	cls.free.erase(std::remove_if(cls.free.begin(), cls.free.end(), 
+		[slab](PooledBuffer* block) { return block->_slab == slab; }), cls.free.end());
+	_slabs.erase(std::find(_slabs.begin(), _slabs.end(), slab));
+	_freeBytes -= bytes;
+
+	const std::uintptr_t first = reinterpret_cast<std::uintptr_t>(slab->data) / internal::kPageSize;
+	const std::uintptr_t last = (reinterpret_cast<std::uintptr_t>(slab->data) + bytes - 1) / internal::kPageSize;
+	for (std::uintptr_t page = first; page <= last; page++)
+		_index.erase(page);
+
+	for (auto block : slab->blocks)
+		delete block;
+	delete [] slab->memory;
+	delete slab;
+}
+
+
+PooledBuffer* BufferPool::retain(const void* data, std::size_t size)
+{
+	const char* p = reinterpret_cast<const char*>(data);
+	Mutex::ScopedLock lock(_mutex);
+	auto it = _index.find(reinterpret_cast<std::uintptr_t>(p) / internal::kPageSize);
+	if (it == _index.end())
+		return nullptr;
+
+	BufferSlab* slab = it->second;
+	const std::size_t index = (p - slab->data) / _classes[slab->cls].blockSize;
+	if (index >= slab->blocks.size())
+		return nullptr;
+
+	PooledBuffer* block = slab->blocks[index];
+	if (!block->contains(data, size) || block->refCount() == 0)
+		return nullptr;
+	block->duplicate();
+	return block;
+}
+
+
+std::size_t BufferPool::blockSize() const
+{
+	return _classes.back().blockSize;
+}
+
+
+std::size_t BufferPool::numSlabs() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _slabs.size();
+}
+
+
+std::size_t BufferPool::numFree() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	std::size_t count = 0;
+	for (auto& cls : _classes)
+		count += cls.free.size();
+	return count;
+}
+
+
+std::size_t BufferPool::numBlocks() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	std::size_t count = 0;
+	for (auto slab : _slabs)
+		count += slab->blocks.size();
+	return count;
+}
+
+
+void BufferPool::setMaxFree(std::size_t bytes)
+{
+	Mutex::ScopedLock lock(_mutex);
+	_maxFree = bytes;
+}
+
+
+std::size_t BufferPool::maxFree() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _maxFree;
+}
+
+
+std::size_t BufferPool::trim()
+{
+	Mutex::ScopedLock lock(_mutex);
+	std::vector<BufferSlab*> idle;
+	for (auto slab : _slabs) {
+		if (slab->numFree == _classes[slab->cls].blocksPerSlab)
+			idle.push_back(slab);
+	}
+	std::size_t bytes = 0;
+	for (auto slab : idle) {
+		bytes += _classes[slab->cls].blockSize * _classes[slab->cls].blocksPerSlab;
+		freeSlab(slab);
+	}
+	return bytes;
+}
+
+
+BufferPool* BufferPool::forLoop(uv::Loop* loop)
+{
+	Mutex::ScopedLock lock(internal::loopPoolsMutex);
+	auto& pool = internal::loopPools[loop];
+	if (!pool) {
+		// Small classes for writes such as STUN and signalling
+		// messages, and large ones for stream and datagram reads
+		std::vector<std::size_t> sizes;
+		sizes.push_back(2048);
+		sizes.push_back(16384);
+		sizes.push_back(65536);
+		sizes.push_back(262144);
+		pool = new BufferPool(sizes);
+	}
+	return pool;
+}
+
+
+void BufferPool::shutdown()
+{
+	Mutex::ScopedLock lock(internal::loopPoolsMutex);
+	for (auto& kv : internal::loopPools)
+		kv.second->release();
+	internal::loopPools.clear();
+}
+
+
+void BufferPool::shutdown(uv::Loop* loop)
+{
+	Mutex::ScopedLock lock(internal::loopPoolsMutex);
+	auto it = internal::loopPools.find(loop);
+	if (it != internal::loopPools.end()) {
+		it->second->release();
+		internal::loopPools.erase(it);
+	}
+}
+
+
+//
+// Receive Buffer
+//
+
+
+ReceiveBuffer::ReceiveBuffer(BufferPool* pool, std::size_t blockSize, std::size_t minSpace) :
+	_pool(pool),
+	_block(nullptr),
+	_blockSize(std::min(blockSize, pool->blockSize())),
+	_minSpace(std::min(minSpace, _blockSize)),
+	_offset(0),
+	_end(0)
+{
+	_pool->duplicate();
+}
+
+
+ReceiveBuffer::~ReceiveBuffer()
+{
+	if (_block)
+		_block->release();
+	_pool->release();
+}
+
+
+MutableBuffer ReceiveBuffer::prepare()
+{
+	if (_block) {
+		if (_block->refCount() == 1) {
+			// Nobody else holds received data, start over
+			_offset = 0;
+		}
+		else {
+			// Keep retained data and continue after it
+			_offset = _end;
+			if (_block->capacity() - _offset < _minSpace) {
+				_block->release();
+				_block = nullptr;
+			}
+		}
+	}
+	if (!_block) {
+		_block = _pool->acquire(_blockSize);
+		_offset = 0;
+		_end = 0;
+	}
+	return MutableBuffer(_block->data() + _offset, _block->capacity() - _offset);
+}
+
+
+MutableBuffer ReceiveBuffer::commit(std::size_t size)
+{
+	assert(_block);
+	assert(_offset + size <= _block->capacity());
+	_end = _offset + size;
+	_block->setSize(_end);
+	return MutableBuffer(_block->data() + _offset, size);
+}
+
+
+PooledBuffer* ReceiveBuffer::block() const
+{
+	return _block;
+}
+
+
+} // namespace scy
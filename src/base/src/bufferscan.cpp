@@ -0,0 +1,314 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/bufferscan.h"
+#include "scy/platform.h"
+
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCY_SCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(SCY_SCAN_SSE2) && (defined(_MSC_VER) || defined(__GNUC__))
+#define SCY_SCAN_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(SCY_SCAN_AVX2) && defined(__GNUC__)
+#define SCY_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SCY_TARGET_AVX2
+#endif
+
+
+namespace scy {
+namespace scan {
+
+
+namespace internal {
+
+
+	//
+	// Scalar implementation
+	//
+
+	static std::size_t findCharScalar(const char* data, std::size_t len, char c)
+	{
+		std::size_t i = 0;
+		while (i < len && data[i] != c)
+			i++;
+		return i;
+	}
+
+	static std::size_t findNotCharScalar(const char* data, std::size_t len, char c)
+	{
+		std::size_t i = 0;
+		while (i < len && data[i] == c)
+			i++;
+		return i;
+	}
+
+	static std::size_t findWordEndScalar(const char* data, std::size_t len)
+	{
+		std::size_t i = 0;
+		while (i < len &&
+			data[i] != ' ' &&
+			data[i] != '\t' &&
+			data[i] != '\n' &&
+			data[i] != '\r')
+			i++;
+		return i;
+	}
+
+
+#ifdef SCY_SCAN_SSE2
+
+	static inline unsigned countTrailingZeros(unsigned mask)
+	{
+		// Mask must be non-zero
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<unsigned>(index);
+#else
+		return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+	}
+
+
+	//
+	// SSE2 implementation
+	//
+
+	static std::size_t findCharSSE2(const char* data, std::size_t len, char c)
+	{
+		const __m128i needle = _mm_set1_epi8(c);
+		std::size_t i = 0;
+		for (; i + 16 <= len; i += 16) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+			if (mask)
+				return i + countTrailingZeros(mask);
+		}
+		return i + findCharScalar(data + i, len - i, c);
+	}
+
+	static std::size_t findNotCharSSE2(const char* data, std::size_t len, char c)
+	{
+		const __m128i needle = _mm_set1_epi8(c);
+		std::size_t i = 0;
+		for (; i + 16 <= len; i += 16) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle))) ^ 0xFFFFu;
+			if (mask)
+				return i + countTrailingZeros(mask);
+		}
+		return i + findNotCharScalar(data + i, len - i, c);
+	}
+
+	static std::size_t findWordEndSSE2(const char* data, std::size_t len)
+	{
+		const __m128i space = _mm_set1_epi8(' ');
+		const __m128i tab = _mm_set1_epi8('\t');
+		const __m128i lf = _mm_set1_epi8('\n');
+		const __m128i cr = _mm_set1_epi8('\r');
+		std::size_t i = 0;
+		for (; i + 16 <= len; i += 16) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			__m128i match = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, lf), _mm_cmpeq_epi8(chunk, cr)));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(match));
+			if (mask)
+				return i + countTrailingZeros(mask);
+		}
+		return i + findWordEndScalar(data + i, len - i);
+	}
+
+#endif // SCY_SCAN_SSE2
+
+
+#ifdef SCY_SCAN_AVX2
+
+	//
+	// AVX2 implementation
+	//
+
+	SCY_TARGET_AVX2
+	static std::size_t findCharAVX2(const char* data, std::size_t len, char c)
+	{
+		const __m256i needle = _mm256_set1_epi8(c);
+		std::size_t i = 0;
+		for (; i + 32 <= len; i += 32) {
+			__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+			if (mask)
+				return i + countTrailingZeros(mask);
+		}
+		return i + findCharSSE2(data + i, len - i, c);
+	}
+
+	SCY_TARGET_AVX2
+	static std::size_t findNotCharAVX2(const char* data, std::size_t len, char c)
+	{
+		const __m256i needle = _mm256_set1_epi8(c);
+		std::size_t i = 0;
+		for (; i + 32 <= len; i += 32) {
+			__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+			unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+			if (mask)
+				return i + countTrailingZeros(mask);
+		}
+		return i + findNotCharSSE2(data + i, len - i, c);
+	}
+
+	SCY_TARGET_AVX2
+	static std::size_t findWordEndAVX2(const char* data, std::size_t len)
+	{
+		const __m256i space = _mm256_set1_epi8(' ');
+		const __m256i tab = _mm256_set1_epi8('\t');
+		const __m256i lf = _mm256_set1_epi8('\n');
+		const __m256i cr = _mm256_set1_epi8('\r');
+		std::size_t i = 0;
+		for (; i + 32 <= len; i += 32) {
+			__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+			__m256i match = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, tab)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(chunk, lf), _mm256_cmpeq_epi8(chunk, cr)));
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(match));
+			if (mask)
+				return i + countTrailingZeros(mask);
+		}
+		return i + findWordEndSSE2(data + i, len - i);
+	}
+
+#endif // SCY_SCAN_AVX2
+
+
+	struct Functions
+	{
+		Mode mode;
+		std::size_t (*findChar)(const char*, std::size_t, char);
+		std::size_t (*findNotChar)(const char*, std::size_t, char);
+		std::size_t (*findWordEnd)(const char*, std::size_t);
+	};
+
+	static Functions functionsFor(Mode mode)
+	{
+		Functions fn;
+		fn.mode = mode;
+		switch (mode) {
+#ifdef SCY_SCAN_AVX2
+		case AVX2:
+			fn.findChar = findCharAVX2;
+			fn.findNotChar = findNotCharAVX2;
+			fn.findWordEnd = findWordEndAVX2;
+			break;
+#endif
+#ifdef SCY_SCAN_SSE2
+		case SSE2:
+			fn.findChar = findCharSSE2;
+			fn.findNotChar = findNotCharSSE2;
+			fn.findWordEnd = findWordEndSSE2;
+			break;
+#endif
+		default:
+			fn.mode = Scalar;
+			fn.findChar = findCharScalar;
+			fn.findNotChar = findNotCharScalar;
+			fn.findWordEnd = findWordEndScalar;
+			break;
+		}
+		return fn;
+	}
+
+	static Functions& active()
+	{
+		// Initialized on first use so BitReader may be
+		// used during static initialization.
+		static Functions fn = functionsFor(detectMode());
+		return fn;
+	}
+
+
+} // namespace internal
+
+
+Mode detectMode()
+{
+#if defined(SCY_SCAN_AVX2)
+	static const Mode best = hasAVX2() ? AVX2 : SSE2;
+	return best;
+#elif defined(SCY_SCAN_SSE2)
+	return SSE2;
+#else
+	return Scalar;
+#endif
+}
+
+
+Mode mode()
+{
+	return internal::active().mode;
+}
+
+
+void setMode(Mode mode)
+{
+	if (mode > detectMode())
+		mode = detectMode();
+	internal::active() = internal::functionsFor(mode);
+}
+
+
+const char* modeString(Mode mode)
+{
+	switch (mode) {
+	case Scalar: return "Scalar";
+	case SSE2: return "SSE2";
+	case AVX2: return "AVX2";
+	}
+	return "Unknown";
+}
+
+
+std::size_t findChar(const char* data, std::size_t len, char c)
+{
+	return internal::active().findChar(data, len, c);
+}
+
+
+std::size_t findNotChar(const char* data, std::size_t len, char c)
+{
+	return internal::active().findNotChar(data, len, c);
+}
+
+
+std::size_t findWordEnd(const char* data, std::size_t len)
+{
+	return internal::active().findWordEnd(data, len);
+}
+
+
+} } // namespace scy::scan
@@ -0,0 +1,127 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/hex.h"
+#include "scy/platform.h"
+
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCY_HEX_SIMD 1
+#include <immintrin.h>
+#endif
+
+#if defined(SCY_HEX_SIMD) && defined(__GNUC__)
+#define SCY_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define SCY_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SCY_TARGET_SSSE3
+#define SCY_TARGET_AVX2
+#endif
+
+
+namespace scy {
+namespace hex {
+namespace internal {
+
+
+static const char digits[] = "0123456789abcdef0123456789ABCDEF";
+
+
+static void encodeScalar(const unsigned char* in, std::size_t len, char* out, const char* table)
+{
+	for (std::size_t i = 0; i < len; i++) {
+		*out++ = table[in[i] >> 4];
+		*out++ = table[in[i] & 0xF];
+	}
+}
+
+
+#ifdef SCY_HEX_SIMD
+
+SCY_TARGET_SSSE3
+static void encodeSSSE3(const unsigned char* in, std::size_t len, char* out, const char* table)
+{
+	const __m128i lookup = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table));
+	const __m128i mask = _mm_set1_epi8(0xF);
+
+	// Each step splits 16 bytes into nibbles, maps them to digits
+	// and interleaves the high and low digits of each byte
+	std::size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		__m128i hi = _mm_shuffle_epi8(lookup, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+		__m128i lo = _mm_shuffle_epi8(lookup, _mm_and_si128(v, mask));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+	encodeScalar(in + i, len - i, out + i * 2, table);
+}
+
+SCY_TARGET_AVX2
+static void encodeAVX2(const unsigned char* in, std::size_t len, char* out, const char* table)
+{
+	const __m256i lookup = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table)));
+	const __m256i mask = _mm256_set1_epi8(0xF);
+
+	// Unpacking works within each lane, so the halves are 
+	// swapped back into order before storing
+	std::size_t i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+		__m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+		__m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, mask));
+		__m256i first = _mm256_unpacklo_epi8(hi, lo);
+		__m256i second = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 2), _mm256_permute2x128_si256(first, second, 0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 2 + 32), _mm256_permute2x128_si256(first, second, 0x31));
+	}
+	encodeSSSE3(in + i, len - i, out + i * 2, table);
+}
+
+#endif // SCY_HEX_SIMD
+
+
+typedef void (*EncodeFunction)(const unsigned char*, std::size_t, char*, const char*);
+
+
+static EncodeFunction detectEncoder()
+{
+#ifdef SCY_HEX_SIMD
+	if (hasAVX2())
+		return encodeAVX2;
+	if (hasSSSE3())
+		return encodeSSSE3;
+#endif
+	return encodeScalar;
+}
+
+
+} // namespace internal
+
+
+std::size_t encode(const char* inbuf, std::size_t nread, char* outbuf, bool uppercase)
+{
+	static const internal::EncodeFunction fn = internal::detectEncoder();
+	fn(reinterpret_cast<const unsigned char*>(inbuf), nread, outbuf, 
+		internal::digits + (uppercase ? 16 : 0));
+	return nread * 2;
+}
+
+
+} } // namespace scy::hex
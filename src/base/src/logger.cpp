@@ -0,0 +1,998 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/logger.h"
+#include "scy/time.h"
+#include "scy/datetime.h"
+#include "scy/platform.h"
+#include "scy/filesystem.h"
+#include "scy/util.h"
+#include <assert.h>
+#include <cstring>
+#include <cstdint>
+
+
+using std::endl;
+
+
+namespace scy {
+
+	
+static Singleton<Logger> singleton;
+
+
+// No channels are registered until Logger::add(), 
+// so all levels start disabled.
+std::atomic<int> Logger::_threshold(LFatal + 1);
+std::atomic<bool> Logger::_binary(false);
+
+
+Logger::Logger() :
+	_defaultChannel(nullptr),
+	_writer(new LogWriter)
+{
+}
+
+
+Logger::~Logger()
+{
+	delete _writer;
+	util::clearMap(_channels);
+	_defaultChannel = nullptr;
+}
+
+
+Logger& Logger::instance() 
+{
+	return *singleton.get();
+}
+
+
+void Logger::setInstance(Logger* logger, bool freeExisting) 
+{
+	auto current = singleton.swap(logger);
+	if (current && freeExisting)
+		delete current;
+	_threshold.store(LFatal + 1);
+	_binary.store(false);
+	if (logger)
+		logger->updateThreshold();
+}
+
+	
+void Logger::destroy()
+{
+	singleton.destroy();
+	_threshold.store(LFatal + 1);
+	_binary.store(false);
+}
+
+
+void Logger::add(LogChannel* channel) 
+{
+	{
+		Mutex::ScopedLock lock(_mutex);
+		// The first channel added will be the default channel.
+		if (_defaultChannel == nullptr)
+			_defaultChannel = channel;
+		_channels[channel->name()] = channel;
+	}
+	updateThreshold();
+}
+
+
+void Logger::remove(const std::string& name, bool freePointer) 
+{
+	{
+		Mutex::ScopedLock lock(_mutex);
+		LogChannelMap::iterator it = _channels.find(name);	
+		assert(it != _channels.end());
+		if (it != _channels.end()) {
+			if (_defaultChannel == it->second)
+				_defaultChannel = nullptr;
+			if (freePointer)
+				delete it->second;	
+			_channels.erase(it);
+		}
+	}
+	updateThreshold();
+}
+
+
+LogChannel* Logger::get(const std::string& name, bool whiny) const
+{
+	Mutex::ScopedLock lock(_mutex);
+	LogChannelMap::const_iterator it = _channels.find(name);	
+	if (it != _channels.end())
+		return it->second;
+	if (whiny)
+		throw std::runtime_error("Not found: No log channel named: " + name);
+	return nullptr;
+}
+
+
+void Logger::setDefault(const std::string& name)
+{
+	Mutex::ScopedLock lock(_mutex);
+	_defaultChannel = get(name, true);
+}
+
+
+LogChannel* Logger::getDefault() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _defaultChannel;
+}
+
+
+void Logger::setWriter(LogWriter* writer)
+{
+	Mutex::ScopedLock lock(_mutex);
+	if (_writer)
+		delete _writer;
+	_writer = writer;
+}
+
+
+void Logger::write(const LogStream& stream)
+{	
+	// avoid if possible, requires extra copy
+	write(new LogStream(stream));
+}
+
+
+void Logger::write(LogStream* stream)
+{	
+	Mutex::ScopedLock lock(_mutex);	
+	if (stream->channel == nullptr)
+		stream->channel = _defaultChannel;
+
+	// Drop messages if there is no output channel
+	if (stream->channel == nullptr) {
+		delete stream;
+		return;
+	}
+	_writer->write(stream);
+}
+
+
+void Logger::updateThreshold()
+{
+	int threshold = LFatal + 1;
+	bool binary = false;
+	{
+		Mutex::ScopedLock lock(_mutex);
+		for (auto& kv : _channels) {
+			if (kv.second->level() < threshold)
+				threshold = kv.second->level();
+			if (kv.second->binary())
+				binary = true;
+		}
+	}
+
+	// Only the default logger receives messages from the log macros
+	if (singleton.get() == this) {
+		_threshold.store(threshold);
+		_binary.store(binary);
+	}
+}
+
+	
+LogStream& Logger::send(const char* level, const char* realm, const void* ptr, const char* channel) const
+{
+	return printL(level, realm, ptr, channel);
+}
+
+
+//
+// Log Writer
+//
+
+
+LogWriter::LogWriter()
+{
+}
+
+
+LogWriter::~LogWriter()
+{
+}
+
+
+void LogWriter::write(LogStream* stream)
+{
+	// TODO: Make safer; if the app exists and async stuff 
+	// is still logging we can end up with a crash here.
+	stream->channel->write(*stream);	
+	delete stream;
+}
+
+
+//
+// Asynchronous Log Writer
+//
+
+
+AsyncLogWriter::AsyncLogWriter(std::size_t capacity, Overflow overflow) :
+	_ring(nullptr),
+	_mask(0),
+	_overflow(overflow),
+	_enqueuePos(0),
+	_dequeuePos(0),
+	_written(0),
+	_dropped(0),
+	_waiters(0),
+	_writerID(0),
+	_sleeping(false)
+{
+	std::size_t size = 2;
+	while (size < capacity)
+		size <<= 1;
+	_mask = size - 1;
+	_ring = new Slot[size];
+	for (std::size_t i = 0; i < size; i++) {
+		_ring[i].sequence.store(i);
+		_ring[i].stream = nullptr;
+	}
+	_batch.reserve(kMaxBatch);
+	_thread.start(*this);
+}
+
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+	// Cancel and wait for the thread
+	cancel();
+
+	// Note: Not using join here as it is causing a deadlock
+	// when unloading shared libraries when the logger is not
+	// explicitly shutdown().
+	//while (_thread.running())
+	//	scy::sleep(10);
+	_thread.join();	
+
+	// Flush remaining items synchronously
+	flush();
+	
+	assert(empty());
+	delete [] _ring;
+}
+
+
+void AsyncLogWriter::write(LogStream* stream)
+{
+	while (!push(stream)) {
+		// Never block the writer thread, or a cancelled writer
+		if (_overflow == Drop || cancelled() || 
+			Thread::currentID() == _writerID.load()) {
+			_dropped.fetch_add(1);
+			delete stream;
+			return;
+		}
+		waitForSpace();
+	}
+	wakeup();
+}
+
+
+void AsyncLogWriter::clear()
+{
+	LogStream* next;
+	while ((next = pop()) != nullptr)
+		delete next;
+	_written.store(_dequeuePos);
+}
+
+
+void AsyncLogWriter::flush()
+{
+	if (!cancelled()) {
+
+		// Wait for the writer thread to catch up
+		if (Thread::currentID() == _writerID.load())
+			return;
+		std::size_t target = _enqueuePos.load();
+		Mutex::ScopedLock lock(_mutex);
+		_waiters.fetch_add(1);
+		while (_written.load() < target && !cancelled()) {
+			_cond.signal();
+			_drained.wait(_mutex);
+		}
+		_waiters.fetch_sub(1);
+	}
+	else {
+		while (writeBatch()) {}
+	}
+}
+
+
+void AsyncLogWriter::run()
+{
+	_writerID.store(Thread::currentID());
+	while (!cancelled()) {
+		if (!writeBatch())
+			waitForMessages();
+	}
+}
+
+
+void AsyncLogWriter::cancel(bool flag)
+{
+	async::Runnable::cancel(flag);
+	Mutex::ScopedLock lock(_mutex);
+	_cond.signal();
+	_drained.broadcast();
+}
+
+
+UInt64 AsyncLogWriter::dropped() const
+{
+	return _dropped.load();
+}
+
+
+bool AsyncLogWriter::push(LogStream* stream)
+{
+	// Bounded MPMC ring by Dmitry Vyukov. Each slot sequence equals 
+	// the position which may write it next, or position + 1 once the
+	// slot has been written and may be read.
+	std::size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+	Slot* slot;
+	for (;;) {
+		slot = &_ring[pos & _mask];
+		std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+		std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+		if (diff == 0) {
+			if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return false; // full
+		else
+			pos = _enqueuePos.load(std::memory_order_relaxed);
+	}
+	slot->stream = stream;
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+
+LogStream* AsyncLogWriter::pop()
+{
+	Slot* slot = &_ring[_dequeuePos & _mask];
+	if (slot->sequence.load(std::memory_order_acquire) != _dequeuePos + 1)
+		return nullptr;
+	LogStream* stream = slot->stream;
+
+	// Publish the free slot before producers check for space
+	slot->sequence.store(_dequeuePos + _mask + 1);
+	_dequeuePos++;
+	return stream;
+}
+
+
+bool AsyncLogWriter::full() const
+{
+	std::size_t pos = _enqueuePos.load();
+	return _ring[pos & _mask].sequence.load() != pos;
+}
+
+
+bool AsyncLogWriter::empty() const
+{
+	return _ring[_dequeuePos & _mask].sequence.load() != _dequeuePos + 1;
+}
+
+
+std::size_t AsyncLogWriter::writeBatch()
+{	
+	LogStream* next;
+	while (_batch.size() < kMaxBatch && (next = pop()) != nullptr)
+		_batch.push_back(next);
+	if (_batch.empty())
+		return 0;
+
+	// Write consecutive messages for the same channel at once
+	std::size_t count = _batch.size();
+	for (std::size_t i = 0; i < count;) {
+		std::size_t n = 1;
+		while (i + n < count && _batch[i + n]->channel == _batch[i]->channel)
+			n++;
+		_batch[i]->channel->writeBatch(&_batch[i], n);
+		i += n;
+	}
+	for (auto stream : _batch)
+		delete stream;
+	_batch.clear();
+
+	_written.store(_dequeuePos);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_waiters.load() > 0) {
+		Mutex::ScopedLock lock(_mutex);
+		_drained.broadcast();
+	}
+	return count;
+}
+
+
+void AsyncLogWriter::waitForMessages()
+{
+	// The writer publishes its sleeping state before checking 
+	// the ring, so either it sees the new message or the
+	// producer sees it sleeping.
+	Mutex::ScopedLock lock(_mutex);
+	_sleeping.store(true);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while (empty() && !cancelled())
+		_cond.wait(_mutex);
+	_sleeping.store(false);
+}
+
+
+void AsyncLogWriter::waitForSpace()
+{
+	// Producers register as waiting before checking for space,
+	// so either the writer sees them waiting or they see the
+	// freed slot.
+	Mutex::ScopedLock lock(_mutex);
+	_waiters.fetch_add(1);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	_cond.signal();
+	while (full() && !cancelled())
+		_drained.wait(_mutex);
+	_waiters.fetch_sub(1);
+}
+
+
+void AsyncLogWriter::wakeup()
+{
+	// Pairs with the fence in waitForMessages() so the
+	// pushed message is ordered before the sleeping check
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_sleeping.load()) {
+		Mutex::ScopedLock lock(_mutex);
+		_cond.signal();
+	}
+}
+
+
+//
+// Log Stream
+//
+
+
+LogStream::LogStream(LogLevel level, const char* realm, int line, const void* ptr, const char* channel) : 
+	level(level), line(line), realm(realm), address(ptr ? util::memAddress(ptr) : ""), ts(time::now()), channel(nullptr), enabled(true), binary(Logger::binary())
+{
+#ifndef SCY_DISABLE_LOGGING
+	if (channel)
+		this->channel = Logger::instance().get(channel, false);
+#endif
+}
+
+
+LogStream::LogStream(LogLevel level, const char* realm, const std::string& address) :
+	level(level), line(0), realm(realm), address(address), ts(time::now()), channel(nullptr), enabled(true), binary(Logger::binary())
+{
+}
+
+	
+LogStream::LogStream(const LogStream& that) :
+	level(that.level), line(that.line), realm(that.realm), address(that.address), 
+	ts(that.ts), channel(that.channel), enabled(that.enabled), 
+	binary(that.binary), args(that.args)
+{
+	// try to avoid copy assign
+	message.str(that.message.str());
+}
+
+
+LogStream::~LogStream()
+{
+}
+
+
+void LogStream::text()
+{
+	if (!binary)
+		return;
+	logarg::decode(args.data(), args.size(), message);
+	args.clear();
+	binary = false;
+}
+
+
+namespace internal {
+	struct NullLogStream: public LogStream 
+	{
+		NullLogStream() { enabled = false; }
+	};
+}
+
+
+LogStream& LogStream::null()
+{
+	static internal::NullLogStream stream;
+	return stream;
+}
+
+
+//
+// Log Arguments
+//
+
+
+namespace logarg {
+
+
+namespace internal {
+
+	template<typename T>
+	inline void put(std::string& buf, Type type, T val)
+	{
+		buf.push_back(static_cast<char>(type));
+		buf.append(reinterpret_cast<const char*>(&val), sizeof(val));
+	}
+
+	inline void putString(std::string& buf, const char* data, std::size_t size)
+	{
+		put(buf, String, static_cast<UInt32>(size));
+		buf.append(data, size);
+	}
+
+	template<typename T>
+	inline bool get(const char*& data, const char* end, T& val)
+	{
+		if (static_cast<std::size_t>(end - data) < sizeof(val))
+			return false;
+		std::memcpy(&val, data, sizeof(val));
+		data += sizeof(val);
+		return true;
+	}
+
+}
+
+
+bool encode(std::string& buf, bool val)               { internal::put(buf, Bool, static_cast<UInt8>(val)); return true; }
+bool encode(std::string& buf, char val)               { internal::put(buf, Char, val); return true; }
+bool encode(std::string& buf, signed char val)        { internal::put(buf, Char, static_cast<char>(val)); return true; }
+bool encode(std::string& buf, unsigned char val)      { internal::put(buf, Char, static_cast<char>(val)); return true; }
+bool encode(std::string& buf, short val)              { internal::put(buf, Int, static_cast<Int64>(val)); return true; }
+bool encode(std::string& buf, unsigned short val)     { internal::put(buf, UInt, static_cast<UInt64>(val)); return true; }
+bool encode(std::string& buf, int val)                { internal::put(buf, Int, static_cast<Int64>(val)); return true; }
+bool encode(std::string& buf, unsigned int val)       { internal::put(buf, UInt, static_cast<UInt64>(val)); return true; }
+bool encode(std::string& buf, long val)               { internal::put(buf, Int, static_cast<Int64>(val)); return true; }
+bool encode(std::string& buf, unsigned long val)      { internal::put(buf, UInt, static_cast<UInt64>(val)); return true; }
+bool encode(std::string& buf, long long val)          { internal::put(buf, Int, static_cast<Int64>(val)); return true; }
+bool encode(std::string& buf, unsigned long long val) { internal::put(buf, UInt, static_cast<UInt64>(val)); return true; }
+bool encode(std::string& buf, float val)              { internal::put(buf, Double, static_cast<double>(val)); return true; }
+bool encode(std::string& buf, double val)             { internal::put(buf, Double, val); return true; }
+bool encode(std::string& buf, const void* val)        { internal::put(buf, Pointer, static_cast<UInt64>(reinterpret_cast<std::uintptr_t>(val))); return true; }
+
+
+bool encode(std::string& buf, const char* val)
+{
+	if (!val)
+		return encode(buf, static_cast<const void*>(val));
+	internal::putString(buf, val, std::strlen(val));
+	return true;
+}
+
+
+bool encode(std::string& buf, const std::string& val)
+{
+	internal::putString(buf, val.data(), val.size());
+	return true;
+}
+
+
+bool formatted(const std::ios& ios)
+{
+	return ios.flags() != (std::ios::skipws | std::ios::dec) || 
+		ios.width() != 0 || ios.precision() != 6 || ios.fill() != ' ';
+}
+
+
+bool decode(const char* data, std::size_t size, std::ostream& ost)
+{
+	const char* end = data + size;
+	while (data < end) {
+		Type type = static_cast<Type>(*data++);
+		switch (type) {
+		case Int: { 
+			Int64 val; 
+			if (!internal::get(data, end, val)) return false; 
+			ost << val; 
+			break; 
+		}
+		case UInt: { 
+			UInt64 val; 
+			if (!internal::get(data, end, val)) return false; 
+			ost << val; 
+			break; 
+		}
+		case Double: { 
+			double val; 
+			if (!internal::get(data, end, val)) return false; 
+			ost << val; 
+			break; 
+		}
+		case Bool: { 
+			UInt8 val; 
+			if (!internal::get(data, end, val)) return false; 
+			ost << (val != 0); 
+			break; 
+		}
+		case Char: { 
+			char val; 
+			if (!internal::get(data, end, val)) return false; 
+			ost << val; 
+			break; 
+		}
+		case Pointer: { 
+			UInt64 val; 
+			if (!internal::get(data, end, val)) return false; 
+			ost << reinterpret_cast<const void*>(static_cast<std::uintptr_t>(val)); 
+			break; 
+		}
+		case String: { 
+			UInt32 len; 
+			if (!internal::get(data, end, len) || static_cast<std::size_t>(end - data) < len) return false; 
+			ost.write(data, len); 
+			data += len; 
+			break; 
+		}
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+
+} // namespace logarg
+
+		
+//
+// Log Channel
+//
+
+
+LogChannel::LogChannel(const std::string& name, LogLevel level, const char* timeFormat) : 
+	_name(name), 
+	_level(level), 
+	_timeFormat(timeFormat)
+{
+}
+
+
+void LogChannel::setLevel(LogLevel level)
+{
+	_level = level;
+	Logger::instance().updateThreshold();
+}
+
+
+void LogChannel::write(const std::string& message, LogLevel level, const char* realm, const void* ptr) 
+{	
+	LogStream stream(level, realm, 0, ptr);
+	stream << message;
+	write(stream);
+}
+
+
+void LogChannel::write(const LogStream& stream)
+{
+	(void)stream;
+}
+
+
+void LogChannel::writeBatch(const LogStream* const* streams, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; i++)
+		write(*streams[i]);
+}
+
+
+void LogChannel::format(const LogStream& stream, std::ostream& ost)
+{ 
+	if (_timeFormat)
+		ost << time::formatLocal(stream.ts, _timeFormat);
+	ost << " [" << getStringFromLogLevel(stream.level) << "] ";
+	if (!stream.realm.empty() || !stream.address.empty()) {		
+		ost << "[";		
+		if (!stream.realm.empty())
+			ost << stream.realm;
+		if (stream.line > 0)
+			ost << "(" << stream.line << ")" ;
+		if (!stream.address.empty())
+			ost << ":" << stream.address;
+		ost << "] ";
+	}
+	if (stream.binary)
+		logarg::decode(stream.args.data(), stream.args.size(), ost);
+	else
+		ost << stream.message.str();
+	ost.flush();
+}
+
+
+//
+// Console Channel
+//
+
+
+ConsoleChannel::ConsoleChannel(const std::string& name, LogLevel level, const char* timeFormat) : 
+	LogChannel(name, level, timeFormat) 
+{
+}
+
+
+void ConsoleChannel::write(const LogStream& stream)
+{ 	
+	const LogStream* ptr = &stream;
+	writeBatch(&ptr, 1);
+}
+
+
+void ConsoleChannel::writeBatch(const LogStream* const* streams, std::size_t count)
+{ 	
+	std::ostringstream ss;
+	for (std::size_t i = 0; i < count; i++) {
+		if (this->level() <= streams[i]->level)
+			format(*streams[i], ss);
+	}
+	if (ss.tellp() <= 0)
+		return;
+
+	std::string s(ss.str());
+#if !defined(WIN32) || defined(_CONSOLE) || defined(_DEBUG)
+	std::cout.write(s.data(), s.size());
+#endif
+#if defined(_MSC_VER) && defined(_DEBUG) 
+	std::wstring temp(s.length(), L' ');
+	std::copy(s.begin(), s.end(), temp.begin());
+	OutputDebugString(temp.c_str());
+#endif
+}
+
+
+//
+// File Channel
+//
+
+
+FileChannel::FileChannel(const std::string& name,
+						 const std::string& path, 
+						 LogLevel level, 
+						 const char* timeFormat) : 
+	LogChannel(name, level, timeFormat),
+	_path(path)
+{
+}
+
+
+FileChannel::~FileChannel() 
+{
+	close();
+}
+
+
+void FileChannel::open() 
+{
+	// Ensure a path was set
+	if (_path.empty())
+		throw std::runtime_error("Log file path must be set.");
+	
+	// Create directories if needed
+	fs::mkdirr(fs::dirname(_path));
+	
+	// Open the file stream
+	_fstream.close();
+	_fstream.open(_path.c_str(), std::ios::out | std::ios::app);	
+
+	// Throw on failure
+	if (!_fstream.is_open())
+		throw std::runtime_error("Failed to open log file: " + _path);
+}
+
+
+void FileChannel::close() 
+{ 
+	_fstream.close();
+}
+
+
+void FileChannel::write(const LogStream& stream)
+{	
+	const LogStream* ptr = &stream;
+	writeBatch(&ptr, 1);
+}
+
+
+void FileChannel::writeBatch(const LogStream* const* streams, std::size_t count)
+{	
+	std::ostringstream ss;
+	for (std::size_t i = 0; i < count; i++) {
+		if (this->level() <= streams[i]->level) {
+			format(*streams[i], ss);
+			ss << '\n';
+		}
+	}
+	if (ss.tellp() <= 0)
+		return;
+	
+	if (!_fstream.is_open())	
+		open();
+	
+	std::string s(ss.str());
+	_fstream.write(s.data(), s.size());
+	_fstream.flush();
+
+#if defined(_CONSOLE) || defined(_DEBUG)
+	std::cout << s;
+#endif
+#if defined(_MSC_VER) && defined(_DEBUG) 
+	std::wstring temp(s.length(), L' ');
+	std::copy(s.begin(), s.end(), temp.begin());
+	OutputDebugString(temp.c_str());
+#endif
+}
+
+
+void FileChannel::setPath(const std::string& path) 
+{ 
+	_path = path; 
+	open();
+}
+
+
+std::string FileChannel::path() const 
+{ 
+	return _path;
+}
+
+
+//
+// Rotating File Channel
+//
+
+
+RotatingFileChannel::RotatingFileChannel(const std::string& name,
+	                                     const std::string& dir, 
+										 LogLevel level, 
+										 const std::string& extension, 
+										 int rotationInterval, 
+										 const char* timeFormat) : 
+	LogChannel(name, level, timeFormat),
+	_fstream(nullptr),
+	_dir(dir),
+	_extension(extension),
+	_rotationInterval(rotationInterval),
+	_rotatedAt(0)
+{
+	// The initial log file will be opened on the first call to rotate()
+}
+	
+
+RotatingFileChannel::~RotatingFileChannel() 
+{
+	if (_fstream) {
+		_fstream->close();
+		delete _fstream;	
+	}
+}
+
+
+void RotatingFileChannel::write(const LogStream& stream)
+{	
+	const LogStream* ptr = &stream;
+	writeBatch(&ptr, 1);
+}
+
+
+void RotatingFileChannel::writeBatch(const LogStream* const* streams, std::size_t count)
+{	
+	std::ostringstream ss;
+	for (std::size_t i = 0; i < count; i++) {
+		if (this->level() > streams[i]->level)
+			continue;
+
+		// Write pending messages to the current file before rotating
+		if (_fstream == nullptr || streams[i]->ts - _rotatedAt > _rotationInterval) {
+			if (_fstream && ss.tellp() > 0) {
+				std::string s(ss.str());
+				_fstream->write(s.data(), s.size());
+				ss.str("");
+			}
+			rotate();
+		}
+		format(*streams[i], ss);
+	}
+	if (ss.tellp() <= 0)
+		return;
+
+	std::string s(ss.str());
+	_fstream->write(s.data(), s.size());
+	_fstream->flush();
+	
+#if defined(_CONSOLE) && defined(_DEBUG)
+	cout << s;
+#endif
+#if defined(_MSC_VER) && defined(_DEBUG) 
+	std::wstring temp(s.length(), L' ');
+	std::copy(s.begin(), s.end(), temp.begin());
+	OutputDebugString(temp.c_str());
+#endif
+}
+
+
+void RotatingFileChannel::rotate() 
+{
+	if (_fstream) {
+		_fstream->close();
+		delete _fstream;
+	}
+
+	// Always try to create the directory
+	fs::mkdirr(_dir);
+
+	// Open the next log file
+	_filename = util::format("%s_%ld.%s", _name.c_str(), static_cast<long>(Timestamp().epochTime()), _extension.c_str());
+
+	std::string path(_dir);
+	fs::addnode(path, _filename);
+	_fstream = new std::ofstream(path);	
+	_rotatedAt = time::now();
+}
+
+
+#if 0
+// ---------------------------------------------------------------------
+// Evented File Channel
+//
+EventedFileChannel::EventedFileChannel(const std::string& name,
+						 const std::string& dir, 
+						 LogLevel level, 
+						 const std::string& extension, 
+						 int rotationInterval, 
+						 const char* timeFormat) : 
+	FileChannel(name, dir, level, extension, rotationInterval, timeFormat)
+{
+}
+
+
+EventedFileChannel::~EventedFileChannel() 
+{
+}
+
+
+void EventedFileChannel::write(const LogStream& stream, LogLevel level, const char* realm, const void* ptr) 
+{	
+	if (this->level() > level)
+		return;
+
+	FileChannel::write(message, level, ptr);	
+	OnLogStream.emit(this, message, level, ptr);
+}
+#endif
+
+
+
+} // namespace scy
\ No newline at end of file
@@ -0,0 +1,271 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/loopgroup.h"
+#include "scy/timerwheel.h"
+#include "scy/bufferpool.h"
+#include "scy/memory.h"
+#include "scy/logger.h"
+
+#if defined(WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+using std::endl;
+
+
+namespace scy {
+
+
+namespace internal {
+
+	static void pinThread(int cpu)
+	{
+#if defined(WIN32)
+		if (!::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR(1) << cpu))
+			WarnL << "Cannot pin loop thread to core " << cpu << endl;
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if (::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) != 0)
+			WarnL << "Cannot pin loop thread to core " << cpu << endl;
+#else
+		(void)cpu; // Thread affinity is not supported
+#endif
+	}
+
+}
+
+
+LoopGroup::LoopGroup(int size, bool pinThreads) :
+	_next(0),
+	_size(size > 0 ? size : numCores()),
+	_pinThreads(pinThreads),
+	_running(false),
+	_stopping(false),
+	_ready(0)
+{
+	TraceLS(this) << "Create: " << _size << endl;
+}
+
+
+LoopGroup::~LoopGroup()
+{
+	TraceLS(this) << "Destroy" << endl;
+	stop();
+}
+
+
+void LoopGroup::start()
+{
+	Mutex::ScopedLock lock(_mutex);
+	if (_running)
+		throw std::runtime_error("The loop group is already running");
+
+	TraceLS(this) << "Starting " << _size << " loops" << endl;
+
+	// The collector registers the default loop on creation,
+	// so make sure that happens here rather than on a loop thread
+	GarbageCollector::instance();
+	int cores = numCores();
+	_ready = 0;
+	_stopping = false;
+	for (int i = 0; i < _size; i++) {
+		auto worker = new Worker;
+		worker->index = i;
+		worker->cpu = _pinThreads ? i % cores : -1;
+		worker->loop = nullptr;
+		worker->dispatcher = nullptr;
+		worker->keepAlive = nullptr;
+		worker->tid = 0;
+		_workers.push_back(worker);
+		worker->thread.reset(new Thread(std::bind(&LoopGroup::runWorker, this, worker)));
+	}
+
+	// Wait until every loop can accept posted work
+	while (_ready < _size)
+		_cond.wait(_mutex);
+	_running = true;
+}
+
+
+void LoopGroup::stop()
+{
+	assert(!current() && "cannot stop the group from one of its loops");
+	std::vector<Worker*> workers;
+	{
+		Mutex::ScopedLock lock(_mutex);
+		if (!_running)
+			return;
+		_running = false;
+		workers.swap(_workers);
+	}
+
+	TraceLS(this) << "Stopping" << endl;
+	for (auto worker : workers) {
+		worker->dispatcher->post([worker]() {
+			worker->keepAlive->close();
+			uv_stop(worker->loop);
+		});
+	}
+	{
+		Mutex::ScopedLock lock(_mutex);
+		_stopping = true;
+		_cond.broadcast();
+	}
+	for (auto worker : workers) {
+		worker->thread->join();
+		delete worker;
+	}
+	TraceLS(this) << "Stopped" << endl;
+}
+
+
+void LoopGroup::runWorker(Worker* worker)
+{
+	if (worker->cpu >= 0)
+		internal::pinThread(worker->cpu);
+
+	uv::Loop* loop = new uv::Loop;
+	uv_loop_init(loop);
+	Application app(loop);
+
+	// The dispatcher and keep alive handle must be created on the loop thread
+	worker->loop = loop;
+	worker->tid = Thread::currentID();
+	worker->dispatcher = &SyncDispatcher::forLoop(loop);
+	worker->keepAlive = new SyncContext(loop, []() {});
+	GarbageCollector::instance().addLoop(loop);
+	{
+		Mutex::ScopedLock lock(_mutex);
+		_ready++;
+		_cond.broadcast();
+	}
+
+	TraceLS(this) << "Running loop " << worker->index << endl;
+	app.run();
+
+	// Wait until stop() is done posting to our dispatcher
+	{
+		Mutex::ScopedLock lock(_mutex);
+		while (!_stopping)
+			_cond.wait(_mutex);
+	}
+
+	// Free pointers retired on the loop, destroy the per-loop shared 
+	// objects and run close callbacks for handles closed on the way out
+	GarbageCollector::instance().removeLoop(loop);
+	TimerWheel::shutdown(loop);
+	SyncDispatcher::shutdown(loop);
+	BufferPool::shutdown(loop);
+	worker->dispatcher = nullptr;
+	delete worker->keepAlive;
+	worker->keepAlive = nullptr;
+	uv_run(loop, UV_RUN_NOWAIT);
+
+	if (uv_loop_close(loop) == 0)
+		delete loop;
+	else
+		WarnLS(this) << "Loop " << worker->index << " still owns handles; leaking it" << endl;
+}
+
+
+bool LoopGroup::running() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _running;
+}
+
+
+std::size_t LoopGroup::size() const
+{
+	return _size;
+}
+
+
+uv::Loop* LoopGroup::loop(std::size_t index) const
+{
+	assert(index < _workers.size());
+	return _workers[index]->loop;
+}
+
+
+uv::Loop* LoopGroup::next()
+{
+	return loop(_next++ % _size);
+}
+
+
+uv::Loop* LoopGroup::select(std::size_t hash) const
+{
+	return loop(hash % _size);
+}
+
+
+uv::Loop* LoopGroup::current() const
+{
+	unsigned long tid = Thread::currentID();
+	for (auto worker : _workers) {
+		if (worker->tid == tid)
+			return worker->loop;
+	}
+	return nullptr;
+}
+
+
+int LoopGroup::indexOf(uv::Loop* loop) const
+{
+	for (auto worker : _workers) {
+		if (worker->loop == loop)
+			return worker->index;
+	}
+	return -1;
+}
+
+
+void LoopGroup::post(std::size_t index, Closure fn)
+{
+	dispatcher(index).post(std::move(fn));
+}
+
+
+SyncDispatcher& LoopGroup::dispatcher(std::size_t index) const
+{
+	assert(index < _workers.size());
+	return *_workers[index]->dispatcher;
+}
+
+
+int LoopGroup::numCores()
+{
+	uv_cpu_info_t* info;
+	int count = 0;
+	if (uv_cpu_info(&info, &count) != 0)
+		return 1;
+	uv_free_cpu_info(info, count);
+	return count > 0 ? count : 1;
+}
+
+
+} // namespace scy
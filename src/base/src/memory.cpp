@@ -0,0 +1,395 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/memory.h"
+#include "scy/util.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+
+using std::endl;
+
+
+namespace scy {
+
+
+static Singleton<GarbageCollector> singleton;
+
+
+namespace internal {
+
+	static std::atomic<UInt64> nextCollectorID(1);
+
+	struct CurrentParticipant
+		// The participant registered by the calling thread, 
+		// tagged with the ID of the owning collector.
+	{
+		UInt64 id;
+		void* participant;
+	};
+
+	static thread_local CurrentParticipant current = { 0, nullptr };
+
+}
+	
+
+GarbageCollector::GarbageCollector() : 
+	_id(internal::nextCollectorID++),
+	_default(nullptr),
+	_epoch(1),
+	_retired(0),
+	_reclaimed(0),
+	_finalize(false)
+{
+	TraceL << "Create" << std::endl;
+
+	for (int i = 0; i < MaxLoops; i++)
+		_participants[i].store(nullptr);
+
+	addLoop(uv::defaultLoop());
+	_default = _participants[0].load();
+}
+
+	
+GarbageCollector::~GarbageCollector()
+{
+	TraceL << "Destroy: "
+			<< "\n\tPending: " << pending()
+			<< "\n\tRetired: " << retired()
+			<< "\n\tEpoch: " << epoch()
+			<< "\n\tFinalize: " << _finalize
+			<< std::endl;
+	
+	if (!_finalize)
+		finalize();
+
+	for (int i = 0; i < MaxLoops; i++) {
+		Participant* p = _participants[i].load();
+		if (!p)
+			continue;
+
+		// Loops which were never removed still reference their 
+		// participant from their handles, so it must be leaked.
+		if (p->active.load()) {
+			WarnL << "Loop " << p->loop << " was not removed" << std::endl;
+			assert(0 && "loop not removed");
+			continue;
+		}
+		delete p;
+	}
+}
+
+
+void GarbageCollector::addLoop(uv::Loop* loop)
+{
+	Mutex::ScopedLock lock(_mutex);
+	Participant* p = nullptr;
+	int index = 0;
+	for (; index < MaxLoops; index++) {
+		Participant* slot = _participants[index].load();
+		if (!slot || !slot->active.load()) {
+			p = slot;
+			break;
+		}
+		assert(slot->loop != loop && "loop already registered");
+	}
+	if (index == MaxLoops)
+		throw std::runtime_error("Cannot register more than MaxLoops event loops");
+
+	bool created = !p;
+	if (created) {
+		p = new Participant;
+		p->gc = this;
+	}
+	p->loop = loop;
+	p->tid = uv_thread_self();
+	p->observed.store(_epoch.load());
+	start(p);
+	p->active.store(true);
+	if (created)
+		_participants[index].store(p);
+
+	internal::current.id = _id;
+	internal::current.participant = p;
+}
+
+
+void GarbageCollector::removeLoop(uv::Loop* loop)
+{
+	Participant* p = nullptr;
+	{
+		Mutex::ScopedLock lock(_mutex);
+		for (int i = 0; i < MaxLoops; i++) {
+			Participant* slot = _participants[i].load();
+			if (slot && slot->active.load() && slot->loop == loop) {
+				p = slot;
+				break;
+			}
+		}
+	}
+	if (!p)
+		return;
+	assert(p->tid == uv_thread_self());
+
+	// Destructors may retire more pointers, which 
+	// land on this loop while it is still active
+	while (reclaim(p, 0, true) > 0);
+
+	Mutex::ScopedLock lock(_mutex);
+	p->active.store(false);
+	stop(p);
+	if (internal::current.participant == p)
+		internal::current.participant = nullptr;
+}
+
+
+void GarbageCollector::start(Participant* p)
+{
+	p->prepare = new uv_prepare_t;
+	p->prepare->data = p;
+	uv_prepare_init(p->loop, p->prepare);
+	uv_prepare_start(p->prepare, GarbageCollector::onPrepare);
+	uv_unref(reinterpret_cast<uv_handle_t*>(p->prepare));
+
+	p->timer = new uv_timer_t;
+	p->timer->data = p;
+	uv_timer_init(p->loop, p->timer);
+	uv_timer_start(p->timer, GarbageCollector::onTimer, ReclaimInterval, ReclaimInterval);
+	uv_unref(reinterpret_cast<uv_handle_t*>(p->timer));
+}
+
+
+void GarbageCollector::stop(Participant* p)
+{
+	uv_close(reinterpret_cast<uv_handle_t*>(p->prepare), [](uv_handle_t* handle) {
+		delete reinterpret_cast<uv_prepare_t*>(handle);
+	});
+	uv_close(reinterpret_cast<uv_handle_t*>(p->timer), [](uv_handle_t* handle) {
+		delete reinterpret_cast<uv_timer_t*>(handle);
+	});
+	p->prepare = nullptr;
+	p->timer = nullptr;
+}
+
+
+void GarbageCollector::retire(void* ptr, void (*deleter)(void*))
+{
+	Entry entry;
+	entry.ptr = ptr;
+	entry.deleter = deleter;
+	retire(entry);
+}
+
+
+void GarbageCollector::retire(std::shared_ptr<void> ptr)
+{
+	Entry entry;
+	entry.ptr = nullptr;
+	entry.deleter = nullptr;
+	entry.shared.swap(ptr);
+	retire(entry);
+}
+
+
+void GarbageCollector::retire(Entry& entry)
+{
+	Participant* p = _default;
+	if (internal::current.id == _id && internal::current.participant)
+		p = static_cast<Participant*>(internal::current.participant);
+
+	// Count first so pending() never underflows
+	_retired++;
+	
+	Mutex::ScopedLock lock(p->mutex);
+
+	// Read the epoch under the lock so batches stay in epoch order.
+	// Batches are capped so freeing one never stalls the loop.
+	UInt64 epoch = _epoch.load();
+	if (p->batches.empty() || p->batches.back().epoch != epoch ||
+		p->batches.back().entries.size() >= MaxReclaim) {
+		p->batches.push_back(Batch());
+		p->batches.back().epoch = epoch;
+		p->batches.back().head = 0;
+	}
+	p->batches.back().entries.push_back(std::move(entry));
+}
+
+
+void GarbageCollector::quiescent(Participant* p)
+{
+	p->observed.store(_epoch.load());
+	if (_retired.load() == _reclaimed.load())
+		return;
+
+	// Advance the epoch once every participant has seen it. We are
+	// still at a quiescent point, so the new epoch is seen at once.
+	UInt64 epoch = p->observed.load();
+	if (minObserved() == epoch)
+		_epoch.compare_exchange_strong(epoch, epoch + 1);
+	p->observed.store(_epoch.load());
+
+	// Free batches retired before every participant's
+	// last quiescent point, and come back on the next 
+	// iteration if the reclaim limit was reached
+	if (reclaim(p, minObserved(), false) == MaxReclaim)
+		uv_timer_start(p->timer, GarbageCollector::onTimer, 0, ReclaimInterval);
+}
+
+
+std::size_t GarbageCollector::reclaim(Participant* p, UInt64 safe, bool all)
+{
+	std::vector<Entry> victims;
+	{
+		Mutex::ScopedLock lock(p->mutex);
+		std::size_t done = 0;
+		while (done < p->batches.size() && victims.size() < MaxReclaim) {
+			Batch& batch = p->batches[done];
+			if (!all && batch.epoch >= safe)
+				break;
+
+			std::size_t count = std::min<std::size_t>(MaxReclaim - victims.size(), batch.entries.size() - batch.head);
+			auto first = batch.entries.begin() + batch.head;
+			std::move(first, first + count, std::back_inserter(victims));
+			batch.head += count;
+			if (batch.head < batch.entries.size())
+				break;
+			done++;
+		}
+		p->batches.erase(p->batches.begin(), p->batches.begin() + done);
+	}
+	if (victims.empty())
+		return 0;
+
+	TraceL << "Deleting: " << victims.size() << ": " << p->loop << std::endl;
+	
+	// Delete outside the lock since destructors may retire
+	for (auto& entry : victims) {
+		if (entry.deleter)
+			entry.deleter(entry.ptr);
+		entry.shared.reset();
+	}
+	_reclaimed += victims.size();
+	return victims.size();
+}
+
+
+UInt64 GarbageCollector::minObserved() const
+{
+	UInt64 min = std::numeric_limits<UInt64>::max();
+	for (int i = 0; i < MaxLoops; i++) {
+		Participant* p = _participants[i].load();
+		if (p && p->active.load())
+			min = std::min<UInt64>(min, p->observed.load());
+	}
+	return min;
+}
+
+
+void GarbageCollector::finalize()
+{
+	TraceL << "Finalize" << std::endl;	
+	
+	// Ensure the loop is not running and that the 
+	// calling thread is the main thread.
+	assert(_default->tid == uv_thread_self());
+	assert(!_finalize);
+	_finalize = true;
+	
+	// Make sure uv_stop doesn't prevent cleanup.
+	uv::Loop* loop = _default->loop;
+	loop->stop_flag = 0;
+
+	// Delete everything retired on the default loop, running the loop 
+	// so handles closed by destructors finish closing.
+	std::size_t count;
+	do {
+		count = reclaim(_default, 0, true);
+		uv_run(loop, UV_RUN_NOWAIT);
+	} while (count > 0);
+
+	{
+		Mutex::ScopedLock lock(_mutex);
+		_default->active.store(false);
+		stop(_default);
+	}
+	uv_run(loop, UV_RUN_NOWAIT);
+
+	TraceL << "Finalize: OK: " << pending() << std::endl;
+}
+		
+
+void GarbageCollector::onPrepare(uv_prepare_t* handle)
+{
+	auto p = static_cast<Participant*>(handle->data);
+	p->gc->quiescent(p);
+}
+
+
+void GarbageCollector::onTimer(uv_timer_t*)
+{
+	// Waking the loop is enough, since the 
+	// prepare handle runs on every iteration
+}
+	
+
+unsigned long GarbageCollector::tid()
+{
+	return _default->tid;
+}
+
+
+UInt64 GarbageCollector::epoch() const
+{
+	return _epoch.load();
+}
+
+
+std::size_t GarbageCollector::pending() const
+{
+	return static_cast<std::size_t>(_retired.load() - _reclaimed.load());
+}
+
+
+UInt64 GarbageCollector::retired() const
+{
+	return _retired.load();
+}
+
+
+UInt64 GarbageCollector::reclaimed() const
+{
+	return _reclaimed.load();
+}
+	
+
+void GarbageCollector::destroy()
+{
+	singleton.destroy();
+}
+
+
+GarbageCollector& GarbageCollector::instance() 
+{
+	return *singleton.get();
+}
+
+
+} // namespace scy::uv
\ No newline at end of file
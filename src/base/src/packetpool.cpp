@@ -0,0 +1,297 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/packetpool.h"
+#include "scy/mutex.h"
+
+#include <atomic>
+#include <new>
+#include <cassert>
+
+
+namespace scy {
+
+
+namespace internal {
+
+	const std::size_t kMinClassShift = 6; // 64 byte blocks
+	const std::size_t kNumClasses = 13; // 64 bytes to 256 KB
+	const std::size_t kThreadCacheBytes = 512 * 1024;
+	const std::size_t kCentralCacheBytes = 2 * 1024 * 1024;
+	const UInt32 kOversizedClass = 0xFFFFFFFF;
+	const UInt32 kBlockMagic = 0x504B5450;
+
+	struct PoolBlockHeader
+		// Precedes each block. 16 bytes keeps the payload aligned.
+	{
+		UInt32 sizeClass;
+		UInt32 magic;
+		UInt64 reserved;
+	};
+
+	struct PoolFreeBlock
+	{
+		PoolFreeBlock* next;
+	};
+
+	struct PoolFreeList
+	{
+		PoolFreeBlock* head;
+		std::size_t count;
+
+		void push(PoolFreeBlock* block)
+		{
+			block->next = head;
+			head = block;
+			count++;
+		}
+
+		PoolFreeBlock* pop()
+		{
+			PoolFreeBlock* block = head;
+			if (block) {
+				head = block->next;
+				count--;
+			}
+			return block;
+		}
+	};
+
+	struct PoolCentralCache
+		// Shared free lists which thread caches spill to and refill from.
+	{
+		Mutex mutex;
+		PoolFreeList lists[kNumClasses];
+
+		PoolCentralCache()
+		{
+			for (std::size_t i = 0; i < kNumClasses; i++) {
+				lists[i].head = nullptr;
+				lists[i].count = 0;
+			}
+		}
+	};
+
+	static PoolCentralCache& centralCache()
+	{
+		// Never freed, so thread caches can flush
+		// to it during static destruction.
+		static PoolCentralCache* cache = new PoolCentralCache;
+		return *cache;
+	}
+
+	static std::size_t classSize(std::size_t cls)
+	{
+		return std::size_t(1) << (cls + kMinClassShift);
+	}
+
+	static std::size_t threadCacheLimit(std::size_t cls)
+		// Maximum number of cached blocks per thread for the class.
+	{
+		std::size_t limit = kThreadCacheBytes / classSize(cls);
+		return limit < 4 ? 4 : limit > 64 ? 64 : limit;
+	}
+
+	static std::size_t centralCacheLimit(std::size_t cls)
+		// Maximum number of blocks the central cache keeps for the
+		// class, so a burst of large clones does not pin its memory.
+	{
+		return kCentralCacheBytes / classSize(cls);
+	}
+
+	static std::atomic<UInt64> hits(0);
+	static std::atomic<UInt64> misses(0);
+	static std::atomic<UInt64> oversized(0);
+	static std::atomic<UInt64> released(0);
+
+	static void spill(PoolFreeList& list, std::size_t cls, std::size_t keep)
+		// Moves blocks from the list to the central cache until keep
+		// blocks remain. Blocks beyond the central limit are freed.
+	{
+		PoolFreeList excess = { nullptr, 0 };
+		{
+			PoolCentralCache& central = centralCache();
+			Mutex::ScopedLock lock(central.mutex);
+			const std::size_t limit = centralCacheLimit(cls);
+			while (list.count > keep) {
+				PoolFreeBlock* block = list.pop();
+				if (central.lists[cls].count < limit)
+					central.lists[cls].push(block);
+				else
+					excess.push(block);
+			}
+		}
+		if (excess.count)
+			released.fetch_add(excess.count, std::memory_order_relaxed);
+		while (PoolFreeBlock* block = excess.pop())
+			::operator delete(block);
+	}
+
+	// Set once the thread cache is destroyed at thread exit. Blocks
+	// freed by later thread_local destructors bypass the dead cache.
+	static thread_local bool threadCacheDestroyed = false;
+
+	struct PoolThreadCache
+		// Per-thread free lists, returned to the central
+		// cache when the thread exits.
+	{
+		PoolFreeList lists[kNumClasses];
+
+		PoolThreadCache()
+		{
+			for (std::size_t i = 0; i < kNumClasses; i++) {
+				lists[i].head = nullptr;
+				lists[i].count = 0;
+			}
+		}
+
+		~PoolThreadCache()
+		{
+			threadCacheDestroyed = true;
+			for (std::size_t i = 0; i < kNumClasses; i++)
+				spill(lists[i], i, 0);
+		}
+	};
+
+	static thread_local PoolThreadCache threadCache;
+
+	static std::size_t sizeClassFor(std::size_t size)
+		// Returns the size class holding size bytes, or
+		// kNumClasses if the size is too large to pool.
+	{
+		std::size_t cls = 0;
+		while (cls < kNumClasses && classSize(cls) < size)
+			cls++;
+		return cls;
+	}
+
+} // namespace internal
+
+
+void* PacketPool::allocate(std::size_t size)
+{
+	using namespace internal;
+
+	const std::size_t total = size + sizeof(PoolBlockHeader);
+	const std::size_t cls = sizeClassFor(total);
+	PoolBlockHeader* header;
+
+	// Large blocks go straight to the system allocator
+	if (cls == kNumClasses) {
+		oversized.fetch_add(1, std::memory_order_relaxed);
+		header = reinterpret_cast<PoolBlockHeader*>(::operator new(total));
+		header->sizeClass = kOversizedClass;
+	}
+	else {
+		PoolFreeBlock* block;
+		if (threadCacheDestroyed) {
+			PoolCentralCache& central = centralCache();
+			Mutex::ScopedLock lock(central.mutex);
+			block = central.lists[cls].pop();
+		}
+		else {
+			PoolFreeList& list = threadCache.lists[cls];
+
+			// Refill half of the thread cache from the central cache
+			if (!list.head) {
+				PoolCentralCache& central = centralCache();
+				Mutex::ScopedLock lock(central.mutex);
+				std::size_t n = threadCacheLimit(cls) / 2;
+				while (n-- > 0) {
+					PoolFreeBlock* refill = central.lists[cls].pop();
+					if (!refill)
+						break;
+					list.push(refill);
+				}
+			}
+			block = list.pop();
+		}
+
+		if (block) {
+			hits.fetch_add(1, std::memory_order_relaxed);
+			header = reinterpret_cast<PoolBlockHeader*>(block);
+		}
+		else {
+			misses.fetch_add(1, std::memory_order_relaxed);
+			header = reinterpret_cast<PoolBlockHeader*>(::operator new(classSize(cls)));
+		}
+		header->sizeClass = static_cast<UInt32>(cls);
+	}
+
+	header->magic = kBlockMagic;
+	return header + 1;
+}
+
+
+void PacketPool::deallocate(void* ptr)
+{
+	using namespace internal;
+
+	if (!ptr)
+		return;
+
+	PoolBlockHeader* header = reinterpret_cast<PoolBlockHeader*>(ptr) - 1;
+	assert(header->magic == kBlockMagic && "not a pooled block");
+	header->magic = 0;
+
+	if (header->sizeClass == kOversizedClass) {
+		::operator delete(header);
+		return;
+	}
+
+	const std::size_t cls = header->sizeClass;
+	assert(cls < kNumClasses);
+	if (threadCacheDestroyed) {
+		PoolFreeList list = { nullptr, 0 };
+		list.push(reinterpret_cast<PoolFreeBlock*>(header));
+		spill(list, cls, 0);
+		return;
+	}
+
+	PoolFreeList& list = threadCache.lists[cls];
+	list.push(reinterpret_cast<PoolFreeBlock*>(header));
+
+	// Spill half of an overfull thread cache to the central cache
+	const std::size_t limit = threadCacheLimit(cls);
+	if (list.count > limit)
+		spill(list, cls, limit / 2);
+}
+
+
+PacketPool::Stats PacketPool::stats()
+{
+	Stats stats;
+	stats.hits = internal::hits.load(std::memory_order_relaxed);
+	stats.misses = internal::misses.load(std::memory_order_relaxed);
+	stats.oversized = internal::oversized.load(std::memory_order_relaxed);
+	stats.released = internal::released.load(std::memory_order_relaxed);
+	return stats;
+}
+
+
+void PacketPool::resetStats()
+{
+	internal::hits = 0;
+	internal::misses = 0;
+	internal::oversized = 0;
+	internal::released = 0;
+}
+
+
+} // namespace scy
@@ -0,0 +1,410 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "scy/packetqueue.h"
+
+
+using std::endl;
+
+
+namespace scy {
+
+
+namespace internal {
+
+	const std::size_t kMaxPacketBatch = 64;
+
+	template<class QueueT>
+	bool emitBatch(QueueT& queue, PacketBatch& batch)
+	{
+		if (!batch.empty()) {
+			if (!queue.cancelled())
+				queue.PacketStreamAdapter::emitBatch(batch);
+			for (auto packet : batch)
+				delete packet;
+		}
+		return !batch.empty();
+	}
+
+}
+
+
+//
+// Synchronization Packet Queue
+//
+
+
+SyncPacketQueue::SyncPacketQueue(uv::Loop* loop, int maxSize) : 
+	SyncQueue<IPacket>(loop, maxSize), 
+	PacketProcessor(this->emitter)
+{	
+	TraceLS(this) << "Create" << endl;
+}
+
+
+SyncPacketQueue::SyncPacketQueue(int maxSize) : 
+	SyncQueue<IPacket>(uv::defaultLoop(), maxSize), 
+	PacketProcessor(this->emitter)
+{	
+	TraceLS(this) << "Create" << endl;
+}
+	
+
+SyncPacketQueue::~SyncPacketQueue()
+{
+	TraceLS(this) << "Destroy" << endl;
+}
+
+
+void SyncPacketQueue::process(IPacket& packet)
+{
+	if (cancelled()) {
+		WarnLS(this) << "Process late packet" << endl;
+		assert(0);
+		return;
+	}
+	
+	push(packet.clone());
+}
+
+
+void SyncPacketQueue::dispatch(IPacket& packet)
+{	
+	// Emit should never be called after closure.
+	// Any late packets should have been dealt with  
+	// and dropped by the run() function.
+	if (cancelled()) {
+		WarnLS(this) << "Dispatch late packet" << endl;
+		assert(0);
+		return;
+	}
+	
+	PacketStreamAdapter::emit(packet);
+}
+
+
+bool SyncPacketQueue::dispatchNext()
+{
+	PacketBatch batch;
+	popBatch(batch.packets, internal::kMaxPacketBatch);
+	return internal::emitBatch(*this, batch);
+}
+
+
+bool SyncPacketQueue::droppable(const IPacket& packet) const
+{
+	return !packet.flags.has(PacketFlags::KeyFrame);
+}
+
+
+void SyncPacketQueue::onStreamStateChange(const PacketStreamState& state)
+{
+	TraceLS(this) << "Stream state: " << state << endl;
+	
+	switch (state.id()) {
+	//case PacketStreamState::None:
+	//case PacketStreamState::Active:
+	//case PacketStreamState::Resetting:
+	//case PacketStreamState::Stopping:
+	//case PacketStreamState::Stopped:
+	case PacketStreamState::Closed:
+	case PacketStreamState::Error:
+		SyncQueue<IPacket>::cancel();
+		break;
+	}
+}
+
+
+//
+// Asynchronous Packet Queue
+//
+
+
+AsyncPacketQueue::AsyncPacketQueue(int maxSize) : 
+	AsyncQueue<IPacket>(maxSize), 
+	PacketProcessor(this->emitter)
+{	
+	TraceLS(this) << "Create" << endl;
+}
+	
+
+AsyncPacketQueue::~AsyncPacketQueue()
+{
+	TraceLS(this) << "Destroy" << endl;
+}
+
+
+void AsyncPacketQueue::process(IPacket& packet)
+{
+	if (cancelled()) {
+		WarnLS(this) << "Process late packet" << endl;
+		assert(0);
+		return;
+	}
+	
+	push(packet.clone());
+}
+
+
+void AsyncPacketQueue::dispatch(IPacket& packet)
+{
+	if (cancelled()) {
+		WarnLS(this) << "Dispatch late packet" << endl;
+		assert(0);
+		return;
+	}
+
+	PacketStreamAdapter::emit(packet);
+}
+
+
+bool AsyncPacketQueue::dispatchNext()
+{
+	PacketBatch batch;
+	popBatch(batch.packets, internal::kMaxPacketBatch);
+	return internal::emitBatch(*this, batch);
+}
+
+
+bool AsyncPacketQueue::droppable(const IPacket& packet) const
+{
+	return !packet.flags.has(PacketFlags::KeyFrame);
+}
+
+
+void AsyncPacketQueue::onStreamStateChange(const PacketStreamState& state)
+{
+	TraceLS(this) << "Stream state: " << state << endl;
+	
+	switch (state.id()) {
+	case PacketStreamState::Active:
+		break;
+		
+	case PacketStreamState::Stopped:
+		break;
+
+	case PacketStreamState::Error:
+	case PacketStreamState::Closed:
+		// Flush queued items, some protocols can't afford dropped packets
+		flush();	
+		assert(empty());
+		cancel();
+		_thread.join();
+		break;
+
+	//case PacketStreamState::Resetting:
+	//case PacketStreamState::None:
+	//case PacketStreamState::Stopping:
+	}
+}
+
+
+//
+// Packet Stage Queue
+//
+
+
+PacketStageQueue::PacketStageQueue(int capacity) : 
+	PacketProcessor(this->emitter),
+	_ring(capacity),
+	_pending(0),
+	_waiters(0),
+	_sleeping(false),
+	_cancelled(false),
+	_workerID(0),
+	_joined(false),
+	_thread(std::bind(&PacketStageQueue::run, this))
+{
+	TraceLS(this) << "Create" << endl;
+}
+
+
+PacketStageQueue::~PacketStageQueue()
+{
+	TraceLS(this) << "Destroy" << endl;
+	cancel();
+	join();
+
+	IPacket* packet;
+	while (_ring.pop(packet))
+		delete packet;
+}
+
+
+void PacketStageQueue::process(IPacket& packet)
+{
+	if (cancelled()) {
+		WarnLS(this) << "Process late packet" << endl;
+		return;
+	}
+
+	IPacket* copy = packet.clone();
+	_pending++;
+	while (!_ring.push(copy)) {
+		wait([this]() { return !_ring.full(); });
+		if (cancelled()) {
+			_pending--;
+			delete copy;
+			return;
+		}
+	}
+	
+	// The worker publishes its sleeping state before checking
+	// the ring, so either it sees the packet or we see it sleeping
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_sleeping.load()) {
+		Mutex::ScopedLock lock(_mutex);
+		_packets.signal();
+	}
+}
+
+
+void PacketStageQueue::run()
+{
+	_workerID.store(Thread::currentID());
+	IPacket* packet;
+	while (!cancelled()) {
+		if (!_ring.pop(packet)) {
+			waitForPackets();
+			continue;
+		}
+
+		// Wake the producer before emitting so the 
+		// stages work on their packets in parallel
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_waiters.load() > 0) {
+			Mutex::ScopedLock lock(_mutex);
+			_space.broadcast();
+		}
+
+		try {
+			emit(*packet);
+		}
+		catch (std::exception& exc) {
+			ErrorLS(this) << "Stage error: " << exc.what() << endl;
+			if (onerror)
+				onerror(exc);
+		}
+		delete packet;
+
+		if (--_pending == 0 && _waiters.load() > 0) {
+			Mutex::ScopedLock lock(_mutex);
+			_space.broadcast();
+		}
+	}
+}
+
+
+void PacketStageQueue::flush()
+{
+	// The worker can't wait for itself
+	if (worker())
+		return;
+
+	wait([this]() { return _pending.load() == 0; });
+}
+
+
+void PacketStageQueue::cancel()
+{
+	_cancelled.store(true);
+	Mutex::ScopedLock lock(_mutex);
+	_packets.signal();
+	_space.broadcast();
+}
+
+
+bool PacketStageQueue::cancelled() const
+{
+	return _cancelled.load();
+}
+
+
+std::size_t PacketStageQueue::size() const
+{
+	return _ring.size();
+}
+
+
+void PacketStageQueue::join()
+{
+	if (!worker() && !_joined.exchange(true))
+		_thread.join();
+}
+
+
+bool PacketStageQueue::worker() const
+{
+	return Thread::currentID() == _workerID.load();
+}
+
+
+void PacketStageQueue::waitForPackets()
+{
+	Mutex::ScopedLock lock(_mutex);
+	_sleeping.store(true);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while (_ring.empty() && !cancelled())
+		_packets.wait(_mutex);
+	_sleeping.store(false);
+}
+
+
+void PacketStageQueue::wait(const std::function<bool()>& ready)
+{
+	// Waiters register before checking their condition, 
+	// so either the worker sees them waiting or they see 
+	// the worker's progress
+	Mutex::ScopedLock lock(_mutex);
+	_waiters++;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while (!ready() && !cancelled())
+		_space.wait(_mutex);
+	_waiters--;
+}
+
+
+void PacketStageQueue::onStreamStateChange(const PacketStreamState& state)
+{
+	TraceLS(this) << "Stream state: " << state << endl;
+	
+	switch (state.id()) {
+	case PacketStreamState::Closed:
+		// Pass queued packets to the next stage before stopping, 
+		// the stream delivers states to stages in pipeline order
+		flush();
+		// fall through
+
+	case PacketStreamState::Error:
+		// Don't flush on error since the erroring stage may be 
+		// the one delivering this state
+		cancel();
+		join();
+		break;
+
+	default:
+		// The stream passes the state to the next stage after this
+		// queue, so let the worker finish the packets queued before 
+		// the state. The next stage is then idle until the source
+		// thread queues another packet.
+		flush();
+		break;
+	}
+}
+
+} // namespace scy
\ No newline at end of file
@@ -0,0 +1,1604 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/packetstream.h"
+#include "scy/packetqueue.h"
+#include "scy/memory.h"
+#include <algorithm>
+#include <typeinfo>
+#include <cstdlib>
+#include <ostream>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
+
+
+using std::endl;
+
+
+namespace scy {
+
+
+namespace internal {
+
+	// Streams which are processing packets on the current thread,
+	// so close() doesn't wait on packets in its own call stack.
+	static thread_local std::vector<const PacketStream*> processing;
+
+	struct ProcessScope
+	{
+		const PacketStream* stream;
+		std::atomic<int>& count;
+
+		ProcessScope(const PacketStream* stream, std::atomic<int>& count) : 
+			stream(stream), count(count) 
+		{
+			count++;
+			processing.push_back(stream);
+		}
+
+		~ProcessScope() 
+		{
+			processing.pop_back();
+			count--;
+		}
+	};
+
+	// Time spent inside probes nested in the current probe, 
+	// which is subtracted so each probe records its own time.
+	static thread_local UInt64 probeTime = 0;
+
+	inline int histogramBucket(UInt64 ns)
+	{
+		int bucket = 0;
+		while (ns && bucket < PacketAdapterStats::NumBuckets - 1) {
+			ns >>= 1;
+			bucket++;
+		}
+		return bucket;
+	}
+
+	std::string className(const PacketStreamAdapter* adapter)
+	{
+		const char* name = typeid(*adapter).name();
+#ifdef __GNUC__
+		int status = 0;
+		char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+		if (demangled) {
+			std::string res(demangled);
+			std::free(demangled);
+			return res;
+		}
+#endif
+		return name;
+	}
+
+	void printJSONString(std::ostream& ost, const std::string& str)
+	{
+		ost << '"';
+		for (auto ch : str) {
+			if (ch == '"' || ch == '\\')
+				ost << '\\';
+			ost << ch;
+		}
+		ost << '"';
+	}
+
+}
+
+
+//
+// Packet Probe
+//
+
+
+class PacketProbe: public PacketProcessor
+	/// PacketProbe forwards packets to a stream processor and 
+	/// records its PacketAdapterStats.
+{
+public:
+	PacketProbe(PacketProcessor* target) : 
+		PacketProcessor(emitter),
+		target(target),
+		packets(0),
+		bytes(0),
+		time(0)
+	{
+		for (auto& count : histogram)
+			count = 0;
+	}
+
+	struct Scope
+		/// Records the time spent by the target processor,
+		/// excluding the time spent by probes it emits to.
+	{
+		PacketProbe& probe;
+		UInt64 start;
+		UInt64 outer;
+
+		Scope(PacketProbe& probe) : 
+			probe(probe), start(uv_hrtime()), outer(internal::probeTime)
+		{
+			internal::probeTime = 0;
+		}
+
+		~Scope()
+		{
+			UInt64 elapsed = uv_hrtime() - start;
+			UInt64 own = elapsed > internal::probeTime ? elapsed - internal::probeTime : 0;
+			probe.time.fetch_add(own, std::memory_order_relaxed);
+			probe.histogram[internal::histogramBucket(own)].fetch_add(1, std::memory_order_relaxed);
+			internal::probeTime = outer + elapsed;
+		}
+	};
+
+	virtual void process(IPacket& packet)
+	{
+		packets.fetch_add(1, std::memory_order_relaxed);
+		bytes.fetch_add(packet.size(), std::memory_order_relaxed);
+		Scope scope(*this);
+		target->process(packet);
+	}
+
+	virtual void processBatch(PacketBatch& batch)
+	{
+		std::size_t size = 0;
+		for (auto packet : batch)
+			size += packet->size();
+		packets.fetch_add(batch.size(), std::memory_order_relaxed);
+		bytes.fetch_add(size, std::memory_order_relaxed);
+		Scope scope(*this);
+		target->processBatch(batch);
+	}
+
+	virtual bool batched() const { return target->batched(); }
+	virtual bool accepts(IPacket& packet) { return target->accepts(packet); }
+	virtual bool threadSafe() const { return target->threadSafe(); }
+
+	PacketProcessor* target;
+	std::atomic<UInt64> packets;
+	std::atomic<UInt64> bytes;
+	std::atomic<UInt64> time;
+	std::atomic<UInt64> histogram[PacketAdapterStats::NumBuckets];
+	PacketSignal emitter;
+};
+
+
+PacketStream::PacketStream(const std::string& name) : 
+	_clientData(nullptr),
+	_closeOnError(false),
+	_instrumented(false),
+	_name(name),
+	_chain(nullptr),
+	_stateID(PacketStreamState::None),
+	_queuedStates(0),
+	_processing(0)
+{
+	TraceLS(this) << "Create" << endl;
+	
+	//_base = std::make_shared<PacketStream>(this);
+	//_base = std::shared_ptr<PacketStream>(new PacketStream(this), 
+		//std::default_delete<PacketStream>()
+		// NOTE: No longer using GC for deleting PacketStream 
+		// since we don't want to force use of the event loop.
+		//deleter::Deferred<PacketStream>()
+		//);
+}
+
+
+PacketStream::~PacketStream()
+{
+	TraceLS(this) << "Destroy" << endl;
+	
+	close();
+			
+	// Delete managed adapters
+	reset();
+
+	// Nullify the stream pointer 
+	/*_base->setStream(nullptr);*/
+	
+	TraceLS(this) << "Destroy" << endl;
+	
+	// The event machine should always be complete
+	assert(stateEquals(PacketStreamState::None)
+		|| stateEquals(PacketStreamState::Closed)
+		|| stateEquals(PacketStreamState::Error));
+
+	// Make sure all adapters have been cleaned up
+	assert(_sources.empty());
+	assert(_processors.empty());
+
+	//TraceLS(this) << "Destroy: OK" << endl;
+}
+
+
+void PacketStream::start()
+{	
+	TraceLS(this) << "Start" << endl;
+	
+	//Mutex::ScopedLock lock(_mutex);
+	if (stateEquals(PacketStreamState::Active)) {
+		TraceLS(this) << "Start: Already active" << endl;
+		//assert(0);
+		return;
+	}
+	
+	// Setup the delegate chain
+	setup();
+
+	// Setup default (thread-based) runner if none set yet
+	//if (!_runner)
+	//	setRunner(std::make_shared<Thread>());
+		
+	// Set state to Active
+	setState(this, PacketStreamState::Active);
+	
+	// Lock the processor mutex to synchronize multi source streams
+	Mutex::ScopedLock lock(_procMutex);
+
+	// Start synchronized sources
+	startSources();
+}
+
+
+void PacketStream::stop()
+{
+	TraceLS(this) << "Stop" << endl;
+	
+	//Mutex::ScopedLock lock(_mutex);
+	if (stateEquals(PacketStreamState::Stopped) ||
+		stateEquals(PacketStreamState::Stopping) ||
+		stateEquals(PacketStreamState::Closed)) {
+		TraceLS(this) << "Stop: Already stopped" << endl;
+		//assert(0);
+		return;
+	}
+
+	setState(this, PacketStreamState::Stopping);		
+	setState(this, PacketStreamState::Stopped);
+	
+	// Lock the processor mutex to synchronize multi source streams
+	Mutex::ScopedLock lock(_procMutex);
+
+	// Stop synchronized sources
+	stopSources();
+
+	TraceLS(this) << "Stop: OK" << endl;
+}
+
+
+void PacketStream::pause()
+{
+	TraceLS(this) << "Pause" << endl;
+	//Mutex::ScopedLock lock(_mutex);
+	setState(this, PacketStreamState::Paused);
+}
+
+
+void PacketStream::resume()
+{
+	TraceLS(this) << "Resume" << endl;
+	//Mutex::ScopedLock lock(_mutex);
+	if (!stateEquals(PacketStreamState::Paused)) {
+		TraceLS(this) << "Resume: Not paused" << endl;
+		return;
+	}
+	
+	setState(this, PacketStreamState::Active);
+}
+
+
+/*
+void PacketStream::reset()
+{
+	TraceLS(this) << "Reset" << endl;
+	
+	//Mutex::ScopedLock lock(_mutex);
+	setState(this, PacketStreamState::Resetting);
+	setState(this, PacketStreamState::Active);
+}
+*/
+
+
+void PacketStream::close()
+{
+	//Mutex::ScopedLock lock(_mutex);
+	if (stateEquals(PacketStreamState::None) ||
+		stateEquals(PacketStreamState::Closed)) {
+		//TraceLS(this) << "Already closed" << endl;
+		//assert(0);
+		return;
+	}
+	
+	// Stop the stream gracefully (if running)
+	if (!stateEquals(PacketStreamState::Stopped) &&
+		!stateEquals(PacketStreamState::Stopping))
+		stop();
+
+	TraceLS(this) << "Closing" << endl;
+
+	// Queue the Closed state
+	setState(this, PacketStreamState::Closed);
+
+	// New packets are proxied from here on, but packets may 
+	// still be inside the processor chain on source threads
+	waitForProcessing();
+
+	// Drain pipeline stages in order while the chain is still attached
+	std::vector<PacketStageQueue*> stages;
+	{
+		Mutex::ScopedLock lock(_mutex);
+		for (auto& stage : _stages)
+			stages.push_back(stage.second.get());
+	}
+	for (auto stage : stages)
+		stage->flush();
+
+	{
+		// Lock the processor mutex to synchronize multi source streams
+		Mutex::ScopedLock lock(_procMutex);
+
+		// Teardown the adapter delegate chain
+		teardown();
+
+		// Wait for thread-based runners to stop running in order
+		// to ensure safe destruction of stream adapters. 
+		// This call does nothing for non thread-based runners.
+		//waitForRunner();
+	
+		// Synchronize any pending states
+		// This should be safe since the adapters won't be receiving
+		// any more incoming packets after teardown.
+		// This call is essential when using the event loop otherwise
+		// failing to close some handles could result in deadlock.
+		// See SyncQueue::cancel()
+		synchronizeStates();
+			
+		// Clear and delete managed adapters
+		// Note: Can't call this because if closeOnCleanup is true 
+		// we may be inside a queue loop which will be destroyed by
+		// the call to reset()
+		//reset();
+	}
+
+	// Send the Closed signal
+	Close.emit(this);
+	
+	TraceLS(this) << "Close: OK" << endl;
+}
+
+
+void PacketStream::write(char* data, std::size_t len)
+{
+	//Mutex::ScopedLock lock(_mutex);
+	RawPacket p(data, len);
+	process(p);
+}
+
+
+void PacketStream::write(const char* data, std::size_t len)
+{
+	//Mutex::ScopedLock lock(_mutex);
+	RawPacket p(data, len);
+	process(p);
+}
+
+void PacketStream::write(IPacket& packet)
+{
+	//Mutex::ScopedLock lock(_mutex);
+	process(packet);
+}
+
+
+void PacketStream::write(PacketBatch& batch)
+{
+	processBatch(batch);
+}
+
+
+bool PacketStream::locked() const
+{
+	//Mutex::ScopedLock lock(_mutex);
+	return stateEquals(PacketStreamState::Locked);
+}
+
+
+bool PacketStream::stateEquals(unsigned int id) const
+{
+	return _stateID.load() == id;
+}
+	
+
+#if 0
+
+
+
+void PacketStream::attachSource(PacketStreamAdapter* source, bool freePointer, bool syncState)
+{
+	//Mutex::ScopedLock lock(_mutex);
+	attachSource(source, freePointer, syncState);
+}
+
+
+void PacketStream::attachSource(PacketSignal& source)
+{
+	//Mutex::ScopedLock lock(_mutex);
+	attachSource(new PacketStreamAdapter(source), true, false);
+}
+
+
+bool PacketStream::detachSource(PacketStreamAdapter* source) 
+{
+	//Mutex::ScopedLock lock(_mutex);
+	return detachSource(source);
+}
+
+
+bool PacketStream::detachSource(PacketSignal& source) 
+{
+	//Mutex::ScopedLock lock(_mutex);
+	return detachSource(source);
+}
+
+
+void PacketStream::attach(PacketProcessor* proc, int order, bool freePointer) 
+{
+	//Mutex::ScopedLock lock(_mutex);
+	attach(proc, order, freePointer);
+}
+
+
+bool PacketStream::detach(PacketProcessor* proc) 
+{
+	//Mutex::ScopedLock lock(_mutex);
+	return detach(proc);
+}
+
+
+void PacketStream::synchronizeOutput(uv::Loop* loop)
+{
+	//Mutex::ScopedLock lock(_mutex);
+	synchronizeOutput(loop);
+}
+
+
+PacketStream& PacketStream::base() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	if (!_base)
+		throw std::runtime_error("Packet stream context not initialized.");
+	return *_base;
+}
+
+
+PacketStream::PacketStream(PacketStream* stream) : 
+	_stream(stream),
+	_closeOnError(false)
+{
+	TraceLS(this) << "Create" << endl;
+}
+
+
+PacketStream::~PacketStream()
+{
+	TraceLS(this) << "Destroy" << endl;
+	
+	// The event machine should always be complete
+	assert(stateEquals(PacketStreamState::None)
+		|| stateEquals(PacketStreamState::Closed)
+		|| stateEquals(PacketStreamState::Error));
+
+	// Make sure all adapters have been cleaned up
+	assert(_sources.empty());
+	assert(_processors.empty());
+
+	TraceLS(this) << "Destroy: OK" << endl;
+}
+
+
+const std::exception_ptr& PacketStream::error()
+{
+	//Mutex::ScopedLock lock(_mutex);
+	return error();
+}
+#endif
+
+
+//bool PacketStream::async() const
+//{
+//	return false; //_runner && _runner->async();
+//}
+
+
+bool PacketStream::lock()
+{
+	//Mutex::ScopedLock lock(_mutex);
+	if (!stateEquals(PacketStreamState::None))
+		return false;
+
+	setState(this, PacketStreamState::Locked);
+	return true;
+}
+	
+	
+bool PacketStream::active() const
+{
+	//Mutex::ScopedLock lock(_mutex);
+	return stateEquals(PacketStreamState::Active);
+}
+
+	
+bool PacketStream::closed() const
+{
+	//Mutex::ScopedLock lock(_mutex);
+	return stateEquals(PacketStreamState::Closed)
+		|| stateEquals(PacketStreamState::Error);
+}
+
+	
+bool PacketStream::stopped() const
+{
+	//Mutex::ScopedLock lock(_mutex);
+	return stateEquals(PacketStreamState::Stopping) 
+		|| stateEquals(PacketStreamState::Stopped);
+}
+	
+
+void PacketStream::setClientData(void* data)
+{
+	Mutex::ScopedLock lock(_mutex);
+	_clientData = data;
+}
+
+
+void* PacketStream::clientData() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _clientData;
+}
+	
+
+void PacketStream::closeOnError(bool flag)
+{
+	//Mutex::ScopedLock lock(_mutex);
+	_closeOnError = flag;
+}
+
+
+std::string PacketStream::name() const
+{
+	Mutex::ScopedLock lock(_mutex);	
+	return _name;
+}
+
+
+//
+// Packet Stream Base
+//
+	
+
+
+void PacketStream::synchronizeStates()
+{		
+	// Process queued internal states first
+	while (_queuedStates.load() > 0) {
+		PacketStreamState state;
+		{
+			Mutex::ScopedLock lock(_mutex);
+			if (_states.empty())
+				break;
+			state = _states.front();
+			_states.pop_front();
+			_queuedStates--;
+		}	
+
+		TraceLS(this) << "Set queued state: " << state << endl;
+		
+		// Send the stream state to packet adapters.
+		// This is done inside the processor thread context so  
+		// packet adapters do not need to consider thread safety.
+		// Stage queues receive the state before their stage and
+		// drain their worker, so the stage's processors receive the
+		// state after the packets queued before it, and never while
+		// they are processing a packet on the worker thread.
+		auto adapters = this->adapters();
+		for (auto& ref : adapters) {
+			auto adapter = dynamic_cast<PacketStreamAdapter*>(ref->ptr);
+			if (adapter) {
+				if (ref->stage > 0) {
+					Mutex::ScopedLock lock(_mutex);
+					adapter = stageInput(*ref, false);
+				}
+				adapter->onStreamStateChange(state);
+				if (adapter != ref->ptr)
+					ref->ptr->onStreamStateChange(state);
+			}
+			else assert(0);
+		}
+	}
+}
+
+
+void PacketStream::process(IPacket& packet)
+{	
+	//TraceLS(this) << "Processing packet: " 
+	//	<< state() << ": " << packet.className() << endl;	
+	//assert(Thread::currentID() == _runner->tid());
+	
+	internal::ProcessScope scope(this, _processing);
+
+	try {	
+
+		// Process the packet if the stream is active
+		PacketProcessor* firstProc = nullptr;
+		if (stateEquals(PacketStreamState::Active) && !packet.flags.has(PacketFlags::NoModify)) {
+			const Chain* chain = _chain.load();
+			if (chain && !chain->processors.empty()) {
+				if (chain->serialize) {
+					
+					// Lock the processor mutex to synchronize multi source streams
+					Mutex::ScopedLock lock(_procMutex);
+					firstProc = processChain(*chain, packet);
+				}
+				else
+					firstProc = processChain(*chain, packet);
+			}
+		}
+
+		// Otherwise just proxy and emit the packet
+		// TODO: Should we pass the packet to the PacketSyncQueue if
+		// synchronizeOutput was used?
+		if (!firstProc) {
+			TraceLS(this) << "Proxying packet: " << state() << ": " << packet.className() << endl;
+			emit(packet);
+		}
+	}
+				
+	// Catch any exceptions thrown within the processor  
+	catch (std::exception& exc) {
+		onProcessorError(exc);
+	}	
+	
+	//TraceLS(this) << "End process chain: " 
+	//	<< state() << ": " << packet.className() << endl;	
+}
+
+
+void PacketStream::onProcessorError(const std::exception& exc)
+{
+	ErrorLS(this) << "Processor error: " << exc.what() << endl;
+		
+	// Set the stream Error state. No need for queueState
+	// as we are currently inside the processor context.
+	setState(this, PacketStreamState::Error, exc.what());
+		
+	// Capture the exception so it can be rethrown elsewhere.
+	// The Error signal will be sent on next call to emit()
+	_error = std::current_exception();
+	/*stream()->*/Error.emit(this, _error);
+
+	//_syncError = true;
+	if (_closeOnError) {
+		TraceLS(this) << "Close on error" << endl;
+		this->close();
+	}
+}
+
+
+PacketProcessor* PacketStream::processChain(const Chain& chain, IPacket& packet)
+{
+	// Sync queued states
+	if (_queuedStates.load() > 0) {
+		if (chain.serialize)
+			synchronizeStates();
+		else {
+			Mutex::ScopedLock lock(_procMutex);
+			synchronizeStates();
+		}
+	}
+
+	// Send the packet to the first processor in the chain
+	PacketProcessor* firstProc = chain.processors[0];
+	if (firstProc->accepts(packet) && stateEquals(PacketStreamState::Active)) {
+		//TraceLS(this) << "Starting process chain: " 
+		//	<< firstProc << ": " << packet.className() << endl;
+		firstProc->process(packet);
+		// If all went well the packet was processed and emitted...
+		return firstProc;
+	}
+				
+	// Proxy packets which are rejected by the first processor
+	//WarnLS(this) << "Source packet rejected: " 
+	//	<< firstProc << ": " << packet.className() << endl;
+	return nullptr;
+}
+
+
+void PacketStream::processBatch(PacketBatch& batch)
+{	
+	internal::ProcessScope scope(this, _processing);
+
+	try {
+		// Batches are only useful if the first processor accepts them,
+		// otherwise process packets one by one
+		const Chain* chain = _chain.load();
+		if (!stateEquals(PacketStreamState::Active) || !chain || 
+			chain->processors.empty() || !chain->processors[0]->batched()) {
+			for (auto packet : batch)
+				process(*packet);
+			return;
+		}
+		
+		if (chain->serialize) {
+
+			// Lock the processor mutex to synchronize multi source streams
+			Mutex::ScopedLock lock(_procMutex);
+			processChain(*chain, batch);
+		}
+		else
+			processChain(*chain, batch);
+	}
+				
+	// Catch any exceptions thrown within the processor  
+	catch (std::exception& exc) {
+		onProcessorError(exc);
+	}	
+}
+
+
+void PacketStream::processChain(const Chain& chain, PacketBatch& batch)
+{
+	// Sync queued states
+	if (_queuedStates.load() > 0) {
+		if (chain.serialize)
+			synchronizeStates();
+		else {
+			Mutex::ScopedLock lock(_procMutex);
+			synchronizeStates();
+		}
+	}
+
+	// Send runs of accepted packets to the first processor, and proxy
+	// rejected packets in between so packet order is preserved
+	PacketProcessor* firstProc = chain.processors[0];
+	PacketBatch run;
+	run.packets.reserve(batch.size());
+	for (std::size_t i = 0; i <= batch.size(); i++) {
+		IPacket* packet = i < batch.size() ? batch.packets[i] : nullptr;
+		if (packet && firstProc->accepts(*packet) && 
+			!packet->flags.has(PacketFlags::NoModify)) {
+			run.push(packet);
+			continue;
+		}
+		if (!run.empty()) {
+			if (stateEquals(PacketStreamState::Active))
+				firstProc->processBatch(run);
+			run.clear();
+		}
+		if (packet)
+			emit(*packet);
+	}
+}
+
+
+void PacketStream::publishChain()
+{
+	std::unique_ptr<Chain> chain(new Chain);
+	for (auto& proc : _processors)
+		chain->processors.push_back(probe(*proc, false));
+
+	// Packets enter a pipelined first stage through its queue
+	if (!_processors.empty() && _processors[0]->stage > 0) {
+		for (auto& stage : _stages) {
+			if (stage.first == _processors[0]->ptr)
+				chain->processors[0] = stage.second.get();
+		}
+	}
+	chain->serialize = _sources.size() > 1 && 
+		!chain->processors.empty() && !chain->processors[0]->threadSafe();
+	
+	// A packet may still be reading a superseded snapshot, so they
+	// are only freed once no packet is being processed. Packets are 
+	// counted before they load the chain, so either the count is seen
+	// here or the packet loads the new snapshot.
+	_chain.store(chain.get());
+	if (_processing.load() == 0)
+		_chains.clear();
+	_chains.push_back(std::move(chain));
+}
+
+
+PacketProcessor* PacketStream::stageInput(const PacketAdapterReference& proc, bool create)
+{
+	if (proc.stage <= 0)
+		return probe(proc, create);
+
+	for (auto& stage : _stages) {
+		if (stage.first == proc.ptr)
+			return stage.second.get();
+	}
+	if (!create)
+		return reinterpret_cast<PacketProcessor*>(proc.ptr);
+
+	// The stage queue emits to the first processor of the stage
+	std::unique_ptr<PacketStageQueue> queue(new PacketStageQueue(proc.stage));
+	queue->emitter.attach(packetDelegate(probe(proc), &PacketProcessor::process));
+	queue->onerror = [this](const std::exception& exc) {
+		onProcessorError(exc);
+	};
+	_stages.push_back(std::make_pair(proc.ptr, std::move(queue)));
+	return _stages.back().second.get();
+}
+
+
+PacketProcessor* PacketStream::probe(const PacketAdapterReference& proc, bool create)
+{
+	auto target = reinterpret_cast<PacketProcessor*>(proc.ptr);
+	for (auto& probe : _probes) {
+		if (probe->target == target)
+			return probe.get();
+	}
+	if (!create || !_instrumented)
+		return target;
+
+	_probes.push_back(std::unique_ptr<PacketProbe>(new PacketProbe(target)));
+	return _probes.back().get();
+}
+
+
+void PacketStream::waitForProcessing()
+{
+	int own = static_cast<int>(std::count(
+		internal::processing.begin(), internal::processing.end(), this));
+	int times = 0;
+	while (_processing.load() > own) {
+		scy::sleep(1);
+		if (times++ > 5000) {
+			assert(0 && "deadlock; processor blocked?"); // 5 secs
+		}
+	}
+}
+
+
+//void PacketStream::sync(IPacket& packet)
+//{
+//}
+
+
+void PacketStream::emit(IPacket& packet)
+{
+	TraceLS(this) << "Emit: " << packet.size() << endl;
+
+	//PacketStream* stream = this->stream();
+	//const PacketStreamState& state = this->state();
+
+	/*
+	// Synchronize the error if required
+	if (_syncError && state.equals(PacketStreamState::Error)) {
+		_syncError = false;
+		if (stream)
+			stream->Error.emit(stream, error());
+
+		if (_closeOnError) {
+			TraceLS(this) << "Close on error" << endl;
+			stream->close();
+			return;
+		}
+	}
+	*/
+
+	// Ensure the stream is still running
+	if (!stateEquals(PacketStreamState::Active)) {
+		TraceLS(this) << "Dropping late packet: " << state() << endl;
+		return;
+	}
+
+	try {
+		// Emit the result packet
+		if (emitter.enabled()) {
+			emitter.emit(this, packet);	
+		}
+		else
+			TraceLS(this) << "Dropping packet: No emitter: " << state() << endl;
+	}
+	catch (std::exception& exc) {
+		ErrorL << "Emit error: " << exc.what() << std::endl;	
+				
+		// Set the stream Error state. No need for queueState
+		// as we are currently inside the processor context.
+		setState(this, PacketStreamState::Error, exc.what());
+		
+		// Capture the exception so it can be rethrown elsewhere.
+		// The Error signal will be sent on next call to emit()
+		_error = std::current_exception();
+		/*stream()->*/Error.emit(this, _error);
+
+		//_syncError = true;
+		if (_closeOnError) {
+			TraceLS(this) << "Close on error" << endl;
+			this->close();
+		}
+	}
+
+	TraceLS(this) << "Emit: OK: " << packet.size() << endl;
+}
+
+
+void PacketStream::setup()
+{
+	try {	
+		Mutex::ScopedLock lock(_mutex);		
+		
+		// Setup the processor chain
+		// Processors which begin a pipeline stage receive 
+		// packets through their stage queue.
+		// Processors which accept batches receive them directly from
+		// the previous processor.
+		// Instrumented processors receive packets through their probe.
+		PacketProcessor* lastProc = nullptr;
+		PacketProcessor* thisProc = nullptr;
+		for (auto& proc : _processors) {
+			thisProc = reinterpret_cast<PacketProcessor*>(proc->ptr);
+			PacketProcessor* input = stageInput(*proc);
+			if (lastProc) {
+				lastProc->getEmitter().attach(packetDelegate(input, &PacketProcessor::process));
+				lastProc->setBatchTarget(input->batched() ? input : nullptr);
+			}
+			lastProc = thisProc;
+		}
+		publishChain();
+
+		// The last processor will emit the packet to the application
+		if (lastProc) {
+			lastProc->getEmitter().attach(packetDelegate(this, &PacketStream::emit));
+			lastProc->setBatchTarget(nullptr);
+		}
+
+		// Attach source emitters to the PacketStream::process method
+		for (auto& source : _sources) {
+			source->ptr->getEmitter().attach(packetDelegate(this, &PacketStream::process));
+		}	
+	}
+	catch (std::exception& exc) {
+		ErrorLS(this) << "Cannot start stream: " << exc.what() << endl;
+		setState(this, PacketStreamState::Error, exc.what());
+		throw exc;
+	}
+}
+
+
+void PacketStream::teardown()
+{
+	TraceLS(this) << "Teardown" << endl;
+			
+	Mutex::ScopedLock lock(_mutex);		
+	TraceLS(this) << "Stopping: Detach" << endl;
+
+	// Detach the processor chain first
+	PacketProcessor* lastProc = nullptr;
+	PacketProcessor* thisProc = nullptr;
+	for (auto& proc : _processors) {
+		thisProc = reinterpret_cast<PacketProcessor*>(proc->ptr);
+		if (lastProc) {
+			lastProc->getEmitter().detach(packetDelegate(stageInput(*proc, false), &PacketProcessor::process));
+			lastProc->setBatchTarget(nullptr);
+		}
+		lastProc = thisProc;
+	}
+	if (lastProc)
+		lastProc->getEmitter().detach(packetDelegate(this, &PacketStream::emit));
+
+	// Detach sources
+	for (auto& source : _sources) {
+		source->ptr->getEmitter().detach(packetDelegate(this, &PacketStream::process));
+	}
+
+	TraceLS(this) << "Teardown: OK" << endl;
+}
+
+
+void PacketStream::reset()
+{
+	TraceLS(this) << "Cleanup" << endl;		
+	
+	assert(stateEquals(PacketStreamState::None)
+		|| stateEquals(PacketStreamState::Closed));
+
+	Mutex::ScopedLock lock(_mutex);
+
+	// Stop stage workers before their processors are freed
+	_stages.clear();
+	_probes.clear();
+
+	auto sit = _sources.begin();
+	while (sit != _sources.end()) {
+		//TraceLS(this) << "Remove source: " << (*sit)->ptr << endl; // << ": " << (*sit).freePointer
+		//if ((*sit).freePointer) {
+//#ifdef _DEBUG			
+			//delete (*sit)->ptr;
+//#else
+//			deleteLater<PacketStreamAdapter>((*sit)->ptr);
+//#endif
+		//}
+		sit = _sources.erase(sit);
+	}	
+	
+	auto pit = _processors.begin();
+	while (pit != _processors.end()) {
+		//TraceLS(this) << "Remove processor: " << (*pit)->ptr << endl; //<< ": " << (*pit).freePointer
+		//if ((*pit).freePointer) {
+//#ifdef _DEBUG
+			//delete (*pit)->ptr;
+//#else
+//			deleteLater<PacketStreamAdapter>((*pit)->ptr);
+//#endif
+		//}
+		pit = _processors.erase(pit);
+	}
+
+	_chain.store(nullptr);
+	_chains.clear();
+
+	//TraceLS(this) << "Cleanup: OK" << endl;		
+}
+
+
+void PacketStream::attachSource(PacketStreamAdapter* source, bool freePointer, bool syncState)
+{
+	//TraceLS(this) << "Attach source: " << source << endl;	
+	attachSource(std::make_shared<PacketAdapterReference>(source, freePointer ? 
+		new ScopedRawPointer<PacketStreamAdapter>(source) : nullptr, 0, syncState)); //freePointer, 
+}
+	
+
+void PacketStream::attachSource(PacketAdapterReference::Ptr ref)
+{
+	assertNotActive();
+
+	Mutex::ScopedLock lock(_mutex);
+	_sources.push_back(ref);
+	std::sort(_sources.begin(), _sources.end(), PacketAdapterReference::compareOrder);
+	publishChain();
+}
+
+
+void PacketStream::attachSource(PacketSignal& source)
+{
+	//TraceLS(this) << "Attach source signal: " << &source << endl;	
+	assertNotActive();
+	
+	// TODO: unique_ptr for exception safe pointer creation so we
+	// don't need to do state checks here as well as attachSource(PacketStreamAdapter*)
+	attachSource(new PacketStreamAdapter(source), true, false);
+}
+
+
+bool PacketStream::detachSource(PacketStreamAdapter* source) 
+{
+	//TraceLS(this) << "Detach source adapter: " << source << endl;	
+	assertNotActive();
+
+	Mutex::ScopedLock lock(_mutex);
+	for (auto it = _sources.begin(); it != _sources.end(); ++it) {
+		if ((*it)->ptr == source) {
+			(*it)->ptr->getEmitter().detach(packetDelegate(this, &PacketStream::process));
+			TraceLS(this) << "Detached source adapter: " << source << endl;
+			
+			// Note: The PacketStream is no longer responsible
+			// for deleting the managed pointer.
+			_sources.erase(it);
+			publishChain();
+			return true;
+		}
+	}
+	return false;
+}
+
+
+bool PacketStream::detachSource(PacketSignal& source) 
+{
+	//TraceLS(this) << "Detach source signal: " << &source << endl;
+	assertNotActive();
+
+	Mutex::ScopedLock lock(_mutex);
+	for (auto it = _sources.begin(); it != _sources.end(); ++it) {
+		if (&(*it)->ptr->getEmitter() == &source) {
+			(*it)->ptr->getEmitter().detach(packetDelegate(this, &PacketStream::process));
+			TraceLS(this) << "Detached source signal: " << &source << endl;
+
+			// Free the PacketStreamAdapter wrapper instance,
+			// not the referenced PacketSignal.
+			//assert((*it).freePointer);
+			//delete (*it)->ptr;
+			_sources.erase(it);
+			publishChain();
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void PacketStream::attach(PacketProcessor* proc, int order, bool freePointer) 
+{
+	//TraceLS(this) << "Attach processor: " << proc << endl;
+	assert(order >= 0 && order <= 101);
+	assertNotActive();
+
+	Mutex::ScopedLock lock(_mutex);
+	//_processors.push_back(std::make_shared<PacketAdapterReference>(proc, 
+	//	order == 0 ? _processors.size() : order, freePointer));
+	
+	_processors.push_back(std::make_shared<PacketAdapterReference>(proc, 
+		freePointer ? new ScopedRawPointer<PacketStreamAdapter>(proc) : nullptr, order == 0 ? _processors.size() : order)); //freePointer, 
+
+	sort(_processors.begin(), _processors.end(), PacketAdapterReference::compareOrder);
+	publishChain();
+}
+
+
+void PacketStream::attachStage(PacketProcessor* proc, int order, bool freePointer, int capacity) 
+{
+	//TraceLS(this) << "Attach stage: " << proc << endl;
+	assert(order >= 0 && order <= 101);
+	assert(capacity > 0);
+	assertNotActive();
+
+	Mutex::ScopedLock lock(_mutex);
+	_processors.push_back(std::make_shared<PacketAdapterReference>(proc, 
+		freePointer ? new ScopedRawPointer<PacketStreamAdapter>(proc) : nullptr, 
+		order == 0 ? _processors.size() : order, false, capacity));
+
+	sort(_processors.begin(), _processors.end(), PacketAdapterReference::compareOrder);
+	publishChain();
+}
+
+
+bool PacketStream::detach(PacketProcessor* proc) 
+{
+	//TraceLS(this) << "Detach processor: " << proc << endl;
+	assertNotActive();
+
+	Mutex::ScopedLock lock(_mutex);
+	for (auto it = _processors.begin(); it != _processors.end(); ++it) {
+		if ((*it)->ptr == proc) {
+			TraceLS(this) << "Detached processor: " << proc << endl;
+
+			// Note: The PacketStream is no longer responsible
+			// for deleting the managed pointer.
+			_processors.erase(it);
+			publishChain();
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void PacketStream::attach(PacketAdapterReference::Ptr ref)
+{
+	assertNotActive();
+
+	Mutex::ScopedLock lock(_mutex);
+	_processors.push_back(ref);
+	std::sort(_processors.begin(), _processors.end(), PacketAdapterReference::compareOrder);
+	publishChain();
+}
+
+
+void PacketStream::startSources() 
+{
+	//Mutex::ScopedLock lock(_mutex);
+	auto sources = this->sources();
+	for (auto& source : sources) {	
+		if (source->syncState) {				
+			auto startable = dynamic_cast<async::Startable*>(source->ptr);
+			if (startable) {
+				TraceLS(this) << "Start source: " << startable << endl;
+				startable->start();
+			}
+			else assert(0 && "unknown synchronizable");
+#if 0
+			auto runnable = dynamic_cast<async::Runnable*>(source);
+			if (runnable) {
+				TraceLS(this) << "Starting runnable: " << source << endl;
+				runnable->run();
+			}
+#endif
+		}
+	}
+}
+
+
+void PacketStream::stopSources()
+{
+	//Mutex::ScopedLock lock(_mutex);
+	auto sources = this->sources();
+	for (auto& source : sources) {	
+		if (source->syncState) {
+			auto startable = dynamic_cast<async::Startable*>(source->ptr);
+			if (startable) {
+				TraceLS(this) << "Stop source: " << startable << endl;
+				startable->stop();
+			}
+			else assert(0 && "unknown synchronizable");
+#if 0
+			auto runnable = dynamic_cast<async::Runnable*>(source);
+			if (runnable) {
+				TraceLS(this) << "Stop runnable: " << source << endl;
+				runnable->cancel();
+			}
+#endif
+		}
+	}
+}
+
+
+bool PacketStream::waitForRunner()
+{	
+	/*
+	TraceLS(this) << "Wait for sync: " 
+		<< times << ": "
+		<< !_runner->cancelled() << ": "
+		<< _runner->running()
+		<< endl;
+
+	if (!_runner || !_runner->async())
+		return false;
+
+	//assert(Thread::currentID() != _runner->tid());
+	
+	TraceLS(this) << "Wait for sync" << endl;
+	int times = 0;
+	while (!_runner->cancelled() || _runner->running()) { //!_runner->cancelled() || 
+		TraceLS(this) << "Wait for sync: " 
+			<< times << ": "
+			<< !_runner->cancelled() << ": "
+			<< _runner->running()
+			<< endl;
+		scy::sleep(10);
+		if (times++ > 500) {
+			assert(0 && "deadlock; calling inside stream scope?"); // 5 secs
+		}
+	}
+		*/
+	
+	TraceLS(this) << "Wait for sync: OK" << endl;
+	return true;
+}
+
+
+bool PacketStream::waitForStateSync(PacketStreamState::ID state)
+{
+	int times = 0;
+	TraceLS(this) << "Wait for sync state: " << state << endl;
+	while (!stateEquals(state) || hasQueuedState(state)) {
+		TraceLS(this) << "Wait for sync state: " << state << ": " << times << endl;
+		scy::sleep(10);
+		if (times++ > 500) {
+			assert(0 && "deadlock; calling inside stream scope?"); // 5 secs
+		}
+	}
+	TraceLS(this) << "Wait for sync state: " << state << ": OK" << endl;
+	return true;
+}
+
+
+bool PacketStream::hasQueuedState(PacketStreamState::ID state) const
+{
+	Mutex::ScopedLock lock(_mutex);
+	for (auto const& st : _states) {
+		if (st.id() == state) 
+			return true;
+	}
+	return false;
+}
+
+
+void PacketStream::assertNotActive()
+{
+	if (stateEquals(PacketStreamState::Active)) {
+		assert(0 && "cannot modify active stream");
+		throw std::runtime_error("Stream error: Cannot modify an active stream.");
+	}
+}
+
+
+void PacketStream::synchronizeOutput(uv::Loop* loop)
+{
+	assertNotActive();
+	
+	// Add a SyncPacketQueue as the final processor so output 
+	// packets will be synchronized when they hit the emit() method
+	attach(new SyncPacketQueue(loop), 101, true);
+}
+
+
+void PacketStream::onStateChange(PacketStreamState& state, const PacketStreamState& oldState)
+{	
+	TraceLS(this) << "On state change: " << oldState << " => " << state << endl;
+	_stateID.store(state.id());
+	
+	// Queue state for passing to adapters 
+	Mutex::ScopedLock lock(_mutex);
+	_states.push_back(state);
+	_queuedStates++;
+}
+
+
+const std::exception_ptr& PacketStream::error()
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _error;
+}
+
+
+int PacketStream::numSources() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _sources.size();
+}
+
+
+int PacketStream::numProcessors() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _processors.size();
+}
+
+
+int PacketStream::numAdapters() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _sources.size() + _processors.size();
+}
+
+
+PacketAdapterVec PacketStream::adapters() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	PacketAdapterVec res(_sources);
+	res.insert(res.end(), _processors.begin(), _processors.end());
+	return res;
+}
+
+
+PacketAdapterVec PacketStream::sources() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _sources;
+}
+
+
+PacketAdapterVec PacketStream::processors() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _processors;
+}
+
+
+void PacketStream::instrument(bool flag)
+{
+	assertNotActive();
+	Mutex::ScopedLock lock(_mutex);
+	_instrumented = flag;
+}
+
+
+bool PacketStream::instrumented() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _instrumented;
+}
+
+
+PacketStatsVec PacketStream::stats() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	PacketStatsVec res;
+	for (auto& proc : _processors) {
+		auto it = std::find_if(_probes.begin(), _probes.end(), 
+			[&](const std::unique_ptr<PacketProbe>& probe) { return probe->target == proc->ptr; });
+		if (it == _probes.end())
+			continue;
+		const PacketProbe& probe = **it;
+
+		PacketAdapterStats stats;
+		stats.name = internal::className(proc->ptr);
+		stats.order = proc->order;
+		stats.packets = probe.packets.load(std::memory_order_relaxed);
+		stats.bytes = probe.bytes.load(std::memory_order_relaxed);
+		stats.time = probe.time.load(std::memory_order_relaxed);
+		for (int i = 0; i < PacketAdapterStats::NumBuckets; i++)
+			stats.histogram[i] = probe.histogram[i].load(std::memory_order_relaxed);
+
+		// Packet queues report their overflow drops and depth,
+		// and pipeline stages the depth of their stage queue
+		auto queue = dynamic_cast<RunnableQueue<IPacket>*>(proc->ptr);
+		if (queue) {
+			stats.dropped = queue->dropped();
+			stats.queueDepth = queue->size();
+		}
+		for (auto& stage : _stages) {
+			if (stage.first == proc->ptr)
+				stats.queueDepth += stage.second->size();
+		}
+		res.push_back(stats);
+	}
+	return res;
+}
+
+
+void PacketStream::printStats(std::ostream& ost) const
+{
+	auto stats = this->stats();
+	ost << '[';
+	for (std::size_t i = 0; i < stats.size(); i++) {
+		if (i > 0)
+			ost << ',';
+		stats[i].print(ost);
+	}
+	ost << ']';
+}
+
+
+/*
+PacketStream* PacketStream::stream() const
+{
+	Mutex::ScopedLock lock(_mutex);
+	return _stream;
+}
+
+
+void PacketStream::setStream(PacketStream* stream)
+{
+	Mutex::ScopedLock lock(_mutex);
+	assert(!_stream || stream == nullptr);
+	_stream = stream;
+}
+*/
+
+
+//
+// Packet Adapter Stats
+//
+
+
+PacketAdapterStats::PacketAdapterStats() : 
+	order(0),
+	packets(0),
+	bytes(0),
+	dropped(0),
+	time(0),
+	queueDepth(0)
+{
+	for (auto& count : histogram)
+		count = 0;
+}
+
+
+UInt64 PacketAdapterStats::percentile(double percent) const
+{
+	UInt64 calls = 0;
+	for (auto count : histogram)
+		calls += count;
+	if (!calls)
+		return 0;
+
+	UInt64 rank = static_cast<UInt64>(calls * percent / 100.0);
+	UInt64 seen = 0;
+	for (int i = 0; i < NumBuckets; i++) {
+		seen += histogram[i];
+		if (seen > rank || seen == calls)
+			return 1ULL << i;
+	}
+	return 1ULL << (NumBuckets - 1);
+}
+
+
+void PacketAdapterStats::print(std::ostream& ost) const
+{
+	ost << "{\"name\":";
+	internal::printJSONString(ost, name);
+	ost << ",\"order\":" << order
+		<< ",\"packets\":" << packets
+		<< ",\"bytes\":" << bytes
+		<< ",\"dropped\":" << dropped
+		<< ",\"queueDepth\":" << queueDepth
+		<< ",\"time\":" << time
+		<< ",\"histogram\":{";
+
+	// Buckets are keyed by their upper bound in nanoseconds
+	bool first = true;
+	for (int i = 0; i < NumBuckets; i++) {
+		if (!histogram[i])
+			continue;
+		if (!first)
+			ost << ',';
+		ost << '"' << (1ULL << i) << "\":" << histogram[i];
+		first = false;
+	}
+	ost << "}}";
+}
+
+
+//
+// Packet Stream Adapter
+//
+
+
+PacketStreamAdapter::PacketStreamAdapter(PacketSignal& emitter) :
+	_emitter(emitter),
+	_batchTarget(nullptr)
+{
+}
+
+
+void PacketStreamAdapter::emit(char* data, std::size_t len, unsigned flags)
+{
+	RawPacket p(data, len, flags);
+	emit(p);
+}
+
+
+void PacketStreamAdapter::emit(const char* data, std::size_t len, unsigned flags)
+{
+	RawPacket p(data, len, flags);
+	emit(p);
+}
+
+
+void PacketStreamAdapter::emit(const std::string& str, unsigned flags)
+{
+	RawPacket p(str.c_str(), str.length(), flags);
+	emit(p);
+}
+
+
+void PacketStreamAdapter::emit(IPacket& packet)
+{
+	getEmitter().emit(this, packet);
+}
+
+
+void PacketStreamAdapter::emitBatch(PacketBatch& batch)
+{
+	if (_batchTarget)
+		_batchTarget->processBatch(batch);
+	else {
+		for (auto packet : batch)
+			emit(*packet);
+	}
+}
+
+
+PacketSignal& PacketStreamAdapter::getEmitter()
+{
+	return _emitter;
+}
+
+
+void PacketStreamAdapter::setBatchTarget(PacketProcessor* target)
+{
+	_batchTarget = target;
+}
+
+
+} // namespace scy
\ No newline at end of file
@@ -0,0 +1,163 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#include "scy/syncdispatcher.h"
+#include "scy/logger.h"
+#include "scy/thread.h"
+
+#include <map>
+
+
+using std::endl;
+
+
+namespace scy {
+
+
+namespace internal {
+
+	static Mutex loopDispatchersMutex;
+	static std::map<uv::Loop*, SyncDispatcher*> loopDispatchers;
+
+}
+
+
+SyncDispatcher::SyncDispatcher(uv::Loop* loop) :
+	_loop(loop),
+	_sync(loop, std::bind(&SyncDispatcher::run, this)),
+	_pending(false),
+	_posted(0),
+	_completed(0),
+	_waiting(0)
+{
+	uv_unref(_sync.handle().ptr());
+}
+
+
+SyncDispatcher::~SyncDispatcher()
+{
+	close();
+}
+
+
+void SyncDispatcher::post(Closure fn)
+{
+	_posted++;
+	_queue.push(std::move(fn));
+
+	// Only the first post since the loop last woke needs to signal
+	if (!_pending.load() && !_pending.exchange(true))
+		_sync.post();
+}
+
+
+void SyncDispatcher::run()
+{
+	// Clear the flag before draining so posts made 
+	// while we run schedule another wakeup
+	_pending.store(false);
+
+	Closure fn;
+	int count = 0;
+	while (count < MaxBatch && _queue.pop(fn)) {
+		count++;
+		try {
+			fn();
+		}
+		catch (std::exception& exc) {
+			ErrorLS(this) << "Closure error: " << exc.what() << endl;
+		}
+		fn.reset();
+	}
+	_completed += count;
+
+	if (_waiting.load() > 0) {
+		Mutex::ScopedLock lock(_mutex);
+		_cond.broadcast();
+	}
+
+	// Yield to the loop and continue on the next iteration
+	if (count == MaxBatch && !_queue.empty() && !_pending.exchange(true))
+		_sync.post();
+}
+
+
+void SyncDispatcher::waitForSync()
+{
+	if (_sync.tid() == Thread::currentID()) {
+		while (!_queue.empty())
+			run();
+		return;
+	}
+
+	UInt64 target = _posted.load();
+	_waiting++;
+	{
+		Mutex::ScopedLock lock(_mutex);
+		while (_completed.load() < target)
+			_cond.wait(_mutex);
+	}
+	_waiting--;
+}
+
+
+void SyncDispatcher::close()
+{
+	_sync.close();
+}
+
+
+uv::Loop* SyncDispatcher::loop() const
+{
+	return _loop;
+}
+
+
+SyncDispatcher& SyncDispatcher::forLoop(uv::Loop* loop)
+{
+	Mutex::ScopedLock lock(internal::loopDispatchersMutex);
+	auto& dispatcher = internal::loopDispatchers[loop];
+	if (!dispatcher)
+		dispatcher = new SyncDispatcher(loop);
+	return *dispatcher;
+}
+
+
+void SyncDispatcher::shutdown()
+{
+	Mutex::ScopedLock lock(internal::loopDispatchersMutex);
+	for (auto& kv : internal::loopDispatchers)
+		delete kv.second;
+	internal::loopDispatchers.clear();
+}
+
+
+void SyncDispatcher::shutdown(uv::Loop* loop)
+{
+	Mutex::ScopedLock lock(internal::loopDispatchersMutex);
+	auto it = internal::loopDispatchers.find(loop);
+	if (it != internal::loopDispatchers.end()) {
+		delete it->second;
+		internal::loopDispatchers.erase(it);
+	}
+}
+
+
+} // namespace scy
@@ -0,0 +1,274 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#include "scy/taskpool.h"
+#include "scy/logger.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+
+using std::endl;
+
+
+namespace scy {
+
+
+TaskPool::TaskPool(int numWorkers) : 
+	TaskRunner(Deferred()),
+	_numQueued(0),
+	_stopping(false),
+	_nextWorker(0)
+{
+	if (numWorkers <= 0)
+		numWorkers = std::max<int>(1, std::thread::hardware_concurrency());
+
+	for (int i = 0; i < numWorkers; i++) {
+		std::unique_ptr<Worker> worker(new Worker);
+		worker->numPinned = 0;
+		_workers.push_back(std::move(worker));
+	}
+
+	// Workers steal from each other, so start them once all exist
+	for (int i = 0; i < numWorkers; i++)
+		_workers[i]->thread.start(std::bind(&TaskPool::work, this, i));
+
+	setRunner(std::make_shared<Thread>());
+}
+
+
+TaskPool::~TaskPool()
+{
+	// Stop handing out tasks before stopping the workers
+	if (_runner) {
+		_runner->cancel();
+		wakeUp();
+		auto thread = std::dynamic_pointer_cast<Thread>(_runner);
+		if (thread && thread->tid() != Thread::currentID())
+			thread->join();
+	}
+
+	_stopping = true;
+	{
+		Mutex::ScopedLock lock(_workMutex);
+		_work.broadcast();
+	}
+	for (auto& worker : _workers)
+		worker->thread.join();
+
+	// Tasks left on worker queues are deleted by TaskRunner::clear()
+	_runner = nullptr;
+}
+
+
+bool TaskPool::start(Task* task)
+{
+	return start(task, -1);
+}
+
+
+bool TaskPool::start(Task* task, int worker)
+{
+	if (worker >= numWorkers())
+		throw std::runtime_error("Cannot start task: Invalid worker");
+
+	// Set the affinity first since the task may be due at once
+	if (worker >= 0) {
+		Mutex::ScopedLock lock(_poolMutex);
+		_affinity[task] = worker;
+	}
+	return TaskRunner::start(task);
+}
+
+
+int TaskPool::numWorkers() const
+{
+	return static_cast<int>(_workers.size());
+}
+
+
+void TaskPool::run()
+{
+	do {
+		// Hand due tasks to the workers
+		for (;;) {
+			Task* task = nullptr;
+			bool reap = false;
+			{
+				Mutex::ScopedLock lock(_poolMutex);
+				task = next();
+				if (!task)
+					break;
+				reap = !dispatch(task);
+			}
+			if (reap) {
+				TraceLS(this) << "Destroy task: " << task << endl;
+				delete task;
+			}
+		}
+
+		// Dispatch the Idle signal
+		Idle.emit(this);
+	} 
+	while (wait());
+}
+
+
+bool TaskPool::dispatch(Task* task)
+{
+	// Tasks destroyed while on a worker are reaped by the worker
+	if (_running.count(task))
+		return true;
+
+	if (task->destroyed()) {
+		_affinity.erase(task);
+		return !remove(task);
+	}
+	if (task->cancelled())
+		return true;
+
+	_running.insert(task);
+	auto it = _affinity.find(task);
+	if (it != _affinity.end()) {
+		Worker& worker = *_workers[it->second];
+		{
+			Mutex::ScopedLock lock(worker.mutex);
+			worker.pinned.push_back(task);
+		}
+		worker.numPinned++;
+
+		// Only the pinned worker can take the task
+		Mutex::ScopedLock lock(_workMutex);
+		_work.broadcast();
+	}
+	else {
+		Worker& worker = *_workers[_nextWorker++ % _workers.size()];
+		{
+			Mutex::ScopedLock lock(worker.mutex);
+			worker.tasks.push_back(task);
+		}
+		_numQueued++;
+
+		Mutex::ScopedLock lock(_workMutex);
+		_work.signal();
+	}
+	return true;
+}
+
+
+void TaskPool::work(int index)
+{
+	Worker& worker = *_workers[index];
+	while (!_stopping) {
+		Task* task = take(index);
+		if (task) {
+			execute(task);
+			continue;
+		}
+
+		Mutex::ScopedLock lock(_workMutex);
+		while (!_stopping && !_numQueued.load() && !worker.numPinned.load())
+			_work.wait(_workMutex);
+	}
+}
+
+
+Task* TaskPool::take(int index)
+{
+	Task* task = nullptr;
+
+	// Workers run their own tasks in the order they were queued
+	Worker& worker = *_workers[index];
+	{
+		Mutex::ScopedLock lock(worker.mutex);
+		if (!worker.pinned.empty()) {
+			task = worker.pinned.front();
+			worker.pinned.pop_front();
+			worker.numPinned--;
+			return task;
+		}
+		if (!worker.tasks.empty()) {
+			task = worker.tasks.front();
+			worker.tasks.pop_front();
+			_numQueued--;
+			return task;
+		}
+	}
+
+	// Steal the most recently queued task of another worker
+	for (std::size_t i = 1; i < _workers.size(); i++) {
+		Worker& other = *_workers[(index + i) % _workers.size()];
+		Mutex::ScopedLock lock(other.mutex);
+		if (!other.tasks.empty()) {
+			task = other.tasks.back();
+			other.tasks.pop_back();
+			_numQueued--;
+			return task;
+		}
+	}
+	return nullptr;
+}
+
+
+void TaskPool::execute(Task* task)
+{
+	// Check once more that the task has not been cancelled
+	if (!task->cancelled() && !task->destroyed()) {
+		TraceLS(this) << "Run task: " << task << endl;
+		try {
+			task->run();
+		}
+		catch (std::exception& exc) {
+			ErrorLS(this) << "Task error: " << task << ": " << exc.what() << endl;
+		}
+
+		onRun(task);
+
+		// Cancel the task if not repeating
+		if (!task->repeating())
+			task->cancel();
+	}
+
+	// The pool mutex keeps the dispatcher from reaping the task 
+	// if it is destroyed while being queued again
+	bool reap = false;
+	{
+		Mutex::ScopedLock lock(_poolMutex);
+		_running.erase(task);
+		if (task->destroyed()) {
+			_affinity.erase(task);
+			reap = remove(task);
+		}
+		else
+			requeue(task);
+	}
+
+	if (reap) {
+		TraceLS(this) << "Destroy task: " << task << endl;
+		delete task;
+	}
+	else
+		wakeUp();
+}
+
+
+} // namespace scy
@@ -0,0 +1,483 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/taskrunner.h"
+#include "scy/logger.h"
+#include "scy/memory.h"
+#include "scy/singleton.h"
+#include "scy/platform.h"
+#include "scy/synccontext.h"
+#include "scy/thread.h"
+
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <assert.h>
+
+
+using std::endl;
+
+
+namespace scy {
+
+
+namespace internal {
+
+	// Repeating tasks which are always due are polled at this 
+	// interval so they don't keep the runner busy
+	const Int64 kTaskPollInterval = 1;
+
+	inline UInt64 taskTime()
+	{
+		return uv_hrtime() / 1000000;
+	}
+
+	std::atomic<UInt32> nextTaskID(1);
+
+}
+
+
+//
+// Task Runner
+//
+
+
+TaskRunner::TaskRunner(async::Runner::Ptr runner) : 
+	_sequence(0)
+{	
+	if (runner)
+		setRunner(runner);
+	else
+		setRunner(std::make_shared<Thread>());
+}
+
+
+TaskRunner::TaskRunner(Deferred) : 
+	_sequence(0)
+{
+}
+
+
+TaskRunner::~TaskRunner()
+{	
+	Shutdown.emit(this);
+	//Idler::stop();
+	if (_runner) {
+		_runner->cancel();
+		wakeUp();
+
+		// Thread based runners may be blocked waiting for a task
+		auto thread = std::dynamic_pointer_cast<Thread>(_runner);
+		if (thread && thread->tid() != Thread::currentID())
+			thread->join();
+	}
+	clear();
+}
+
+
+bool TaskRunner::start(Task* task)
+{
+	add(task);
+
+	//if (task->_cancelled) {
+		//task->_cancelled = false;
+		//task->start();
+		TraceLS(this) << "Start task: " << task << endl;
+		onStart(task);
+		//_wakeUp.set();
+		return true;
+	//}
+	//return false;
+}
+
+
+bool TaskRunner::cancel(Task* task)
+{		
+	//if (!task->_cancelled) {
+		//task->_cancelled = true;
+		//task->cancel();
+		//TraceLS(this) << "Cancelled task: " << task << endl;
+		//onCancel(task);
+		//_wakeUp.set();
+		//return true;
+	//}
+	
+	if (!task->cancelled()) {
+		task->cancel();
+		TraceLS(this) << "Cancel task: " << task << endl;
+		onCancel(task);
+		//_wakeUp.set();
+		return true;
+	}
+	
+	return false;
+}
+
+
+bool TaskRunner::destroy(Task* task)
+{
+	TraceLS(this) << "Abort task: " << task << endl;
+	
+	// If the task exists then set the destroyed flag,
+	// and queue it so it is deleted on the next iteration.
+	bool managed = false;
+	{
+		Mutex::ScopedLock lock(_mutex);
+		auto it = _tasks.find(task->id());
+		if (it != _tasks.end() && it->second.task == task) {
+			TraceLS(this) << "Abort managed task: " << task << endl;
+			task->_destroyed = true;
+			queue(task, 0);
+			managed = true;
+		}
+	}
+		
+	// Otherwise destroy the pointer.
+	if (managed)
+		wakeUp();
+	else {
+		TraceLS(this) << "Delete unmanaged task: " << task << endl;
+		delete task;
+	}
+
+	return true; // hmmm
+}
+	
+
+bool TaskRunner::add(Task* task)
+{
+	TraceLS(this) << "Add task: " << task << endl;
+
+	// Get the due time before locking since tasks may lock 
+	// or throw when they can't be scheduled
+	Int64 remaining = task->remaining();
+	{
+		Mutex::ScopedLock lock(_mutex);	
+		auto it = _tasks.find(task->id());
+		if (it != _tasks.end()) {
+			if (it->second.task == task)
+				return false;
+			throw std::runtime_error("Cannot add task: Duplicate task ID");
+		}
+		TaskEntry& entry = _tasks[task->id()];
+		entry.task = task;
+		entry.generation = 0;
+		queue(task, remaining);
+		onAdd(task);
+	}
+	wakeUp();
+	return true;
+}
+
+
+bool TaskRunner::remove(Task* task)
+{	
+	TraceLS(this) << "Remove task: " << task << endl;
+
+	// Queued entries of the task are skipped once it is removed
+	Mutex::ScopedLock lock(_mutex);
+	auto it = _tasks.find(task->id());
+	if (it != _tasks.end() && it->second.task == task) {
+		_tasks.erase(it);
+		onRemove(task);
+		return true;
+	}
+	return false;
+}
+
+
+bool TaskRunner::exists(Task* task) const
+{	
+	Mutex::ScopedLock lock(_mutex);
+	auto it = _tasks.find(task->id());
+	return it != _tasks.end() && it->second.task == task;
+}
+
+
+Task* TaskRunner::get(UInt32 id) const
+{
+	Mutex::ScopedLock lock(_mutex);
+	auto it = _tasks.find(id);
+	return it != _tasks.end() ? it->second.task : nullptr;
+}
+
+
+Task* TaskRunner::next()
+{
+	Mutex::ScopedLock lock(_mutex);
+
+	// Move due tasks from the deadline heap to the ready queue
+	UInt64 now = internal::taskTime();
+	while (!_deadlines.empty() && _deadlines.front().due <= now) {
+		std::pop_heap(_deadlines.begin(), _deadlines.end(), std::greater<QueuedTask>());
+		_ready.push_back(_deadlines.back());
+		_deadlines.pop_back();
+	}
+
+	// Skip entries of removed or requeued tasks
+	while (!_ready.empty()) {
+		QueuedTask queued = _ready.front();
+		_ready.pop_front();
+		auto it = _tasks.find(queued.id);
+		if (it != _tasks.end() && it->second.generation == queued.generation)
+			return it->second.task;
+	}
+	return nullptr;
+}
+
+
+void TaskRunner::requeue(Task* task)
+{
+	if (task->cancelled())
+		return;
+
+	Int64 remaining = task->remaining();
+	Mutex::ScopedLock lock(_mutex);
+	auto it = _tasks.find(task->id());
+	if (it != _tasks.end() && it->second.task == task)
+		queue(task, std::max(remaining, internal::kTaskPollInterval));
+}
+
+
+void TaskRunner::queue(Task* task, Int64 remaining)
+{
+	TaskEntry& entry = _tasks[task->id()];
+	QueuedTask queued;
+	queued.due = internal::taskTime() + std::max<Int64>(remaining, 0);
+	queued.sequence = _sequence++;
+	queued.id = task->id();
+	queued.generation = ++entry.generation;
+	if (remaining <= 0)
+		_ready.push_back(queued);
+	else {
+		_deadlines.push_back(queued);
+		std::push_heap(_deadlines.begin(), _deadlines.end(), std::greater<QueuedTask>());
+	}
+}
+
+
+bool TaskRunner::wait()
+{
+	Int64 timeout = -1;
+	{
+		Mutex::ScopedLock lock(_mutex);
+		if (_runner->cancelled())
+			return false;
+		if (!_ready.empty())
+			timeout = 0;
+		else if (!_deadlines.empty()) {
+			UInt64 now = internal::taskTime();
+			timeout = _deadlines.front().due > now ? _deadlines.front().due - now : 0;
+		}
+
+		// Block thread based runners until woken or the next task is due
+		if (_runner->async()) {
+			if (timeout < 0)
+				_wakeUp.wait(_mutex);
+			else if (timeout > 0)
+				_wakeUp.tryWait(_mutex, static_cast<long>(timeout));
+			return !_runner->cancelled();
+		}
+	}
+
+	// Event loop runners return to the loop
+	if (_timer) {
+		if (timeout < 0)
+			_timer->stop();
+		else
+			_timer->start(std::max<Int64>(timeout, 1), 0);
+	}
+	return false;
+}
+
+
+void TaskRunner::wakeUp()
+{
+	if (!_runner)
+		return;
+	if (_runner->async()) {
+		Mutex::ScopedLock lock(_mutex);
+		_wakeUp.signal();
+	}
+	else {
+		auto context = std::dynamic_pointer_cast<SyncContext>(_runner);
+		if (context && !context->closed())
+			context->post();
+	}
+}
+
+
+void TaskRunner::clear()
+{
+	Mutex::ScopedLock lock(_mutex);
+	for (auto it = _tasks.begin(); it != _tasks.end(); ++it) {	
+		TraceLS(this) << "Clear: Destroying task: " << it->second.task << endl;
+		delete it->second.task;
+	}
+	_tasks.clear();
+	_ready.clear();
+	_deadlines.clear();
+}
+
+
+void TaskRunner::setRunner(async::Runner::Ptr runner)
+{
+	TraceLS(this) << "Set async: " << runner << endl;
+
+	Mutex::ScopedLock lock(_mutex);
+	assert(!_runner);
+	_runner = runner;
+	_runner->setRepeating(true);
+
+	// SyncContext runners are only called when posted, so a
+	// timer wakes them when the next task is due
+	auto context = std::dynamic_pointer_cast<SyncContext>(runner);
+	if (context) {
+		_timer.reset(new Timer(context->handle().loop()));
+		_timer->Timeout += sdelegate(this, &TaskRunner::onTimeout);
+	}
+	_runner->start(*this);
+}
+
+
+void TaskRunner::run()
+{
+	do {
+		// Run tasks until none are due
+		while (Task* task = next()) {
+
+			// Check once more that the task has not been cancelled
+			if (!task->cancelled()) {
+				TraceLS(this) << "Run task: " << task << endl;
+				task->run();
+
+				onRun(task);
+
+				// Cancel the task if not repeating
+				if (!task->repeating())
+					task->cancel();
+			}
+						
+			// Destroy the task if required
+			if (task->destroyed()) {
+				TraceLS(this) << "Destroy task: " << task << endl;
+				remove(task);
+				delete task;
+			}
+			else
+				requeue(task);
+		}
+
+		// Dispatch the Idle signal
+		//TraceLS(this) << "idle: "<< Idle.ndelegates() << endl;
+		Idle.emit(this);
+	} 
+	while (wait());
+}
+
+
+void TaskRunner::onTimeout(void*)
+{
+	run();
+}
+
+
+void TaskRunner::onAdd(Task*) 
+{
+}
+
+
+void TaskRunner::onStart(Task*) 
+{
+}
+
+
+void TaskRunner::onCancel(Task*) 
+{
+}
+
+
+void TaskRunner::onRemove(Task*) 
+{
+}
+
+
+void TaskRunner::onRun(Task*) 
+{
+}
+
+
+TaskRunner& TaskRunner::getDefault() 
+{
+	static Singleton<TaskRunner> sh;
+	return *sh.get();
+}
+
+
+//
+// Async Task
+//
+
+
+Task::Task(bool repeat) : 
+	_id(internal::nextTaskID++),
+	_repeating(repeat),
+	_destroyed(false)
+{ 	
+}
+
+
+Task::~Task()
+{
+	//assert(destroyed());
+}
+
+
+void Task::destroy()			
+{
+	_destroyed = true;
+}
+
+
+UInt32 Task::id() const
+{
+	return _id;
+}
+
+
+Int64 Task::remaining() const
+{
+	return 0;
+}
+
+
+bool Task::destroyed() const						 
+{ 
+	return _destroyed;
+}
+
+
+bool Task::repeating() const						 
+{ 
+	return _repeating;
+}
+
+
+} // namespace scy
@@ -0,0 +1,448 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#include "scy/timerwheel.h"
+#include "scy/logger.h"
+#include "scy/mutex.h"
+
+#include <algorithm>
+#include <map>
+#include <assert.h>
+
+
+using std::endl;
+
+
+namespace scy {
+
+
+namespace internal {
+
+	static Mutex loopWheelsMutex;
+	static std::map<uv::Loop*, TimerWheel*> loopWheels;
+
+	inline void initSlot(TimerWheel::Link& slot)
+	{
+		slot.prev = slot.next = &slot;
+	}
+
+	inline bool slotEmpty(const TimerWheel::Link& slot)
+	{
+		return slot.next == &slot;
+	}
+
+	inline void spliceSlot(TimerWheel::Link& slot, TimerWheel::Link& list)
+		// Moves all nodes in slot to the empty list.
+	{
+		initSlot(list);
+		if (slotEmpty(slot))
+			return;
+		list.next = slot.next;
+		list.prev = slot.prev;
+		list.next->prev = &list;
+		list.prev->next = &list;
+		initSlot(slot);
+	}
+
+	const Int64 kMaxDelta = (Int64(1) << (TimerWheel::NumLevels * TimerWheel::LevelBits)) - 1;
+
+}
+
+
+//
+// Timer Wheel Entry
+//
+
+
+TimerWheel::Entry::Entry(std::function<void()> callback) :
+	callback(callback),
+	_wheel(nullptr),
+	_timeout(0),
+	_expires(0)
+{
+	prev = next = nullptr;
+}
+
+
+TimerWheel::Entry::Entry(const Entry& r) :
+	callback(r.callback),
+	_wheel(r._wheel),
+	_timeout(r._timeout),
+	_expires(r._expires)
+{
+	prev = next = nullptr;
+}
+
+
+TimerWheel::Entry::Entry(Entry&& r) :
+	callback(std::move(r.callback)),
+	_wheel(r._wheel),
+	_timeout(r._timeout),
+	_expires(r._expires)
+{
+	prev = next = nullptr;
+	if (r.active())
+		replace(r);
+}
+
+
+TimerWheel::Entry::~Entry()
+{
+	cancel();
+}
+
+
+TimerWheel::Entry& TimerWheel::Entry::operator = (const Entry& r)
+{
+	if (this != &r) {
+		cancel();
+		callback = r.callback;
+		_wheel = r._wheel;
+		_timeout = r._timeout;
+		_expires = r._expires;
+	}
+	return *this;
+}
+
+
+TimerWheel::Entry& TimerWheel::Entry::operator = (Entry&& r)
+{
+	if (this != &r) {
+		cancel();
+		callback = std::move(r.callback);
+		_wheel = r._wheel;
+		_timeout = r._timeout;
+		_expires = r._expires;
+		if (r.active())
+			replace(r);
+	}
+	return *this;
+}
+
+
+void TimerWheel::Entry::start(TimerWheel& wheel, Int64 timeout)
+{
+	wheel.schedule(*this, timeout);
+}
+
+
+void TimerWheel::Entry::restart()
+{
+	if (_wheel)
+		_wheel->schedule(*this, _timeout);
+}
+
+
+void TimerWheel::Entry::cancel()
+{
+	if (active())
+		_wheel->cancel(*this);
+}
+
+
+bool TimerWheel::Entry::active() const
+{
+	return next != nullptr;
+}
+
+
+bool TimerWheel::Entry::expired() const
+{
+	return _wheel && _wheel->now() >= _expires;
+}
+
+
+Int64 TimerWheel::Entry::remaining() const
+{
+	return _wheel ? std::max<Int64>(_expires - _wheel->now(), 0) : 0;
+}
+
+
+Int64 TimerWheel::Entry::timeout() const
+{
+	return _timeout;
+}
+
+
+TimerWheel* TimerWheel::Entry::wheel() const
+{
+	return _wheel;
+}
+
+
+void TimerWheel::Entry::unlink()
+{
+	prev->next = next;
+	next->prev = prev;
+	prev = next = nullptr;
+}
+
+
+void TimerWheel::Entry::replace(Entry& r)
+{
+	prev = r.prev;
+	next = r.next;
+	prev->next = this;
+	next->prev = this;
+	r.prev = r.next = nullptr;
+}
+
+
+//
+// Timer Wheel
+//
+
+
+TimerWheel::TimerWheel(uv::Loop* loop) :
+	_handle(loop, new uv_timer_t),
+	_current(0),
+	_due(-1),
+	_size(0)
+{
+	for (int level = 0; level < NumLevels; level++) {
+		for (int i = 0; i < LevelSize; i++)
+			internal::initSlot(_slots[level][i]);
+	}
+
+	_handle.ptr()->data = this;
+	int err = uv_timer_init(_handle.loop(), _handle.ptr<uv_timer_t>());
+	if (err < 0)
+		_handle.setAndThrowError("Cannot initialize timer wheel", err);
+	_handle.unref(); // unref by default, like Timer
+
+	_current = now();
+}
+
+
+TimerWheel::~TimerWheel()
+{
+	// Detach outstanding entries so their 
+	// owners can still be safely destroyed
+	for (int level = 0; level < NumLevels; level++) {
+		for (int i = 0; i < LevelSize; i++) {
+			Link& slot = _slots[level][i];
+			while (!internal::slotEmpty(slot)) {
+				auto entry = static_cast<Entry*>(slot.next);
+				entry->unlink();
+				entry->_wheel = nullptr;
+			}
+		}
+	}
+	_size = 0;
+}
+
+
+void TimerWheel::schedule(Entry& entry, Int64 timeout)
+{
+	if (entry.active())
+		entry._wheel->cancel(entry);
+
+	// Catch up with the loop time while the wheel
+	// is idle so we don't replay empty ticks later
+	Int64 now = this->now();
+	if (_size == 0 && _current < now)
+		_current = now;
+
+	entry._wheel = this;
+	entry._timeout = timeout;
+	entry._expires = now + std::max<Int64>(timeout, 0);
+	insert(entry, _current + 1);
+	_size++;
+
+	if (_due < 0 || std::max(entry._expires, _current + 1) < _due)
+		arm();
+}
+
+
+void TimerWheel::cancel(Entry& entry)
+{
+	if (!entry.active())
+		return;
+
+	assert(entry._wheel == this);
+	entry.unlink();
+	_size--;
+	if (_size == 0)
+		arm();
+}
+
+
+Int64 TimerWheel::now() const
+{
+	return static_cast<Int64>(uv_now(_handle.loop()));
+}
+
+
+std::size_t TimerWheel::size() const
+{
+	return _size;
+}
+
+
+uv::Loop* TimerWheel::loop() const
+{
+	return _handle.loop();
+}
+
+
+uv::Handle& TimerWheel::handle()
+{
+	return _handle;
+}
+
+
+void TimerWheel::insert(Entry& entry, Int64 earliest)
+{
+	// Overdue entries expire at the earliest tick, and entries
+	// beyond the outer level are parked in its furthest slot
+	// and reinserted when they cascade.
+	Int64 expires = std::max(entry._expires, earliest);
+	Int64 delta = std::min(expires - _current, internal::kMaxDelta);
+	expires = _current + delta;
+
+	int level = 0;
+	while (level < NumLevels - 1 && delta >= (Int64(1) << ((level + 1) * LevelBits)))
+		level++;
+	Link& slot = _slots[level][(expires >> (level * LevelBits)) & LevelMask];
+
+	entry.prev = slot.prev;
+	entry.next = &slot;
+	slot.prev->next = &entry;
+	slot.prev = &entry;
+}
+
+
+void TimerWheel::cascade(int level)
+{
+	Link list;
+	internal::spliceSlot(_slots[level][(_current >> (level * LevelBits)) & LevelMask], list);
+	while (!internal::slotEmpty(list)) {
+		auto entry = static_cast<Entry*>(list.next);
+		entry->unlink();
+		insert(*entry, _current);
+	}
+}
+
+
+void TimerWheel::advance(Int64 now)
+{
+	while (_current < now) {
+		if (_size == 0) {
+			_current = now;
+			break;
+		}
+
+		_current++;
+		if ((_current & LevelMask) == 0) {
+			for (int level = 1; level < NumLevels; level++) {
+				cascade(level);
+				if (((_current >> (level * LevelBits)) & LevelMask) != 0)
+					break;
+			}
+		}
+
+		// Callbacks may start, cancel or destroy any entry,
+		// including those remaining in the expired list
+		Link expired;
+		internal::spliceSlot(_slots[0][_current & LevelMask], expired);
+		while (!internal::slotEmpty(expired)) {
+			auto entry = static_cast<Entry*>(expired.next);
+			entry->unlink();
+			_size--;
+
+			// Invoke a copy since the callback may destroy its entry
+			auto callback = entry->callback;
+			if (!callback)
+				continue;
+			try {
+				callback();
+			}
+			catch (std::exception& exc) {
+				ErrorLS(this) << "Timeout callback error: " << exc.what() << endl;
+			}
+		}
+	}
+}
+
+
+void TimerWheel::arm()
+{
+	if (_size == 0) {
+		_due = -1;
+		uv_timer_stop(_handle.ptr<uv_timer_t>());
+		return;
+	}
+
+	// Wake for the next occupied slot of the inner level, 
+	// or the next time the inner level wraps and cascades
+	Int64 next = _current + 1;
+	while ((next & LevelMask) != 0 && internal::slotEmpty(_slots[0][next & LevelMask]))
+		next++;
+	if (next == _due)
+		return;
+
+	_due = next;
+	int err = uv_timer_start(_handle.ptr<uv_timer_t>(), [](uv_timer_t* req) {
+		reinterpret_cast<TimerWheel*>(req->data)->onTick();
+	}, static_cast<UInt64>(std::max<Int64>(next - now(), 0)), 0);
+	if (err < 0)
+		_handle.setAndThrowError("Invalid timer wheel timer", err);
+}
+
+
+void TimerWheel::onTick()
+{
+	_due = -1;
+	advance(now());
+	arm();
+}
+
+
+TimerWheel& TimerWheel::forLoop(uv::Loop* loop)
+{
+	Mutex::ScopedLock lock(internal::loopWheelsMutex);
+	auto& wheel = internal::loopWheels[loop];
+	if (!wheel)
+		wheel = new TimerWheel(loop);
+	return *wheel;
+}
+
+
+void TimerWheel::shutdown()
+{
+	Mutex::ScopedLock lock(internal::loopWheelsMutex);
+	for (auto& kv : internal::loopWheels)
+		delete kv.second;
+	internal::loopWheels.clear();
+}
+
+
+void TimerWheel::shutdown(uv::Loop* loop)
+{
+	Mutex::ScopedLock lock(internal::loopWheelsMutex);
+	auto it = internal::loopWheels.find(loop);
+	if (it != internal::loopWheels.end()) {
+		delete it->second;
+		internal::loopWheels.erase(it);
+	}
+}
+
+
+} // namespace scy
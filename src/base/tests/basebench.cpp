@@ -0,0 +1,943 @@
+#include "scy/base.h"
+#include "scy/logger.h"
+#include "scy/binarylog.h"
+#include "scy/platform.h"
+#include "scy/filesystem.h"
+#include "scy/buffer.h"
+#include "scy/bufferscan.h"
+#include "scy/base64.h"
+#include "scy/hex.h"
+#include "scy/random.h"
+#include "scy/signal.h"
+#include "scy/variadicsignal.h"
+#include "scy/queue.h"
+#include "scy/packetstream.h"
+#include "scy/thread.h"
+#include "scy/taskrunner.h"
+#include "scy/taskpool.h"
+#include "scy/timer.h"
+#include "scy/time.h"
+#include "scy/datetime.h"
+#include "scy/timerwheel.h"
+#include "scy/syncdispatcher.h"
+#include "scy/ipc.h"
+#include "scy/memory.h"
+#include "scy/util.h"
+
+#include "uv.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <algorithm>
+#include <ctime>
+
+
+using std::cout;
+using std::endl;
+using namespace scy;
+
+
+namespace scy {
+
+
+class Benchmarks
+	/// Micro-benchmarks for performance sensitive base primitives.
+	/// Results are printed as nanoseconds per operation, and as
+	/// MB/s for byte oriented benchmarks.
+{
+public:
+	Benchmarks()
+	{
+		benchBufferScan();
+		benchBase64();
+		benchRandom();
+		benchSignal();
+		benchQueueLatency();
+		benchDisabledLogging();
+		benchTimeFormat();
+		benchAsyncLogWriter();
+		benchBinaryLogging();
+		benchPacketStream();
+		benchPacketPipeline();
+		benchPacketBatch();
+		benchTaskRunner();
+		benchTaskPool();
+		benchTimerWheel();
+		benchSyncDispatcher();
+		benchGarbageCollector();
+	}
+
+	template<class Fn>
+	double measure(const char* name, std::size_t bytes, int iterations, Fn fn)
+	{
+		fn(); // warm up
+
+		UInt64 start = uv_hrtime();
+		for (int i = 0; i < iterations; i++)
+			fn();
+		UInt64 elapsed = uv_hrtime() - start;
+
+		double nsPerOp = static_cast<double>(elapsed) / iterations;
+		cout << "  " << std::left << std::setw(40) << name
+			<< std::right << std::setw(12) << std::fixed << std::setprecision(1) << nsPerOp << " ns/op";
+		if (bytes) {
+			double mbPerSec = (static_cast<double>(bytes) * iterations / (1024 * 1024)) / (elapsed / 1e9);
+			cout << std::setw(12) << mbPerSec << " MB/s";
+		}
+		cout << endl;
+		return nsPerOp;
+	}
+
+	// ============================================================================
+	// Buffer Scanning
+	//
+	// Compares the SIMD scanning modes against the scalar byte loops
+	// which BitReader used previously.
+	//
+	void benchBufferScan()
+	{
+		// Text protocol style input: long lines and space separated words
+		std::string lines;
+		while (lines.size() < 64 * 1024) {
+			lines.append("GET /some/long/resource/path/index.html?query=value&other=value HTTP/1.1\r\n");
+			lines.append("User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n");
+		}
+		std::string padded(std::string(1024, ' ') + "word");
+		std::string fields;
+		for (int i = 0; i < 64; i++)
+			fields.append(std::string(200, 'x') + ":");
+
+		const scan::Mode best = scan::detectMode();
+		const scan::Mode modes[] = { scan::Scalar, scan::SSE2, scan::AVX2 };
+		for (auto mode : modes) {
+			if (mode > best)
+				break;
+			scan::setMode(mode);
+			cout << "BitReader scanning: " << scan::modeString(mode) << endl;
+
+			measure("readLine", lines.size(), 200, [&]() {
+				BitReader reader(lines.data(), lines.size());
+				std::string line;
+				while (reader.available()) {
+					line.clear();
+					reader.readLine(line);
+				}
+			});
+
+			measure("readNextWord", lines.size(), 200, [&]() {
+				BitReader reader(lines.data(), lines.size());
+				std::string word;
+				while (reader.available()) {
+					word.clear();
+					reader.readNextWord(word);
+					reader.skip(reader.available() ? 1 : 0);
+				}
+			});
+
+			measure("readToNext", fields.size(), 20000, [&]() {
+				BitReader reader(fields.data(), fields.size());
+				std::string field;
+				while (reader.available()) {
+					field.clear();
+					reader.readToNext(field, ':');
+					reader.skip(reader.available() ? 1 : 0);
+				}
+			});
+
+			measure("skipToChar", lines.size(), 2000, [&]() {
+				BitReader reader(lines.data(), lines.size());
+				reader.skipToChar('\0');
+			});
+
+			measure("skipWhitespace", padded.size(), 200000, [&]() {
+				BitReader reader(padded.data(), padded.size());
+				reader.skipWhitespace();
+			});
+		}
+		scan::setMode(best);
+	}
+
+	// ============================================================================
+	// Base64 and Hex
+	//
+	// Encodes and decodes a video frame sized buffer in each mode, 
+	// one shot and in packet sized chunks with the streaming coders.
+	//
+	void benchBase64()
+	{
+		const std::size_t frameSize = 256 * 1024;
+		const std::size_t chunkSize = 1400;
+		std::string frame(frameSize, '\0');
+		for (std::size_t i = 0; i < frameSize; i++)
+			frame[i] = static_cast<char>(i * 131 + i / 7);
+		std::vector<char> buf(base64::encodedLength(frameSize, base64::LINE_LENGTH));
+		std::vector<char> out(frameSize + 3);
+		std::string text = base64::encode(frame);
+
+		const base64::Mode best = base64::detectMode();
+		const base64::Mode modes[] = { base64::Scalar, base64::SSSE3, base64::AVX2 };
+		for (auto mode : modes) {
+			if (mode > best)
+				break;
+			base64::setMode(mode);
+			cout << "Base64 coding: " << base64::modeString(mode) << endl;
+
+			measure("encode", frameSize, 200, [&]() {
+				base64::encode(frame.data(), frame.size(), &buf[0], base64::LINE_LENGTH);
+			});
+
+			measure("encode chunked", frameSize, 200, [&]() {
+				base64::Encoder enc;
+				std::size_t len = 0;
+				for (std::size_t pos = 0; pos < frameSize; pos += chunkSize)
+					len += enc.encode(frame.data() + pos, std::min(chunkSize, frameSize - pos), &buf[len]);
+				enc.finalize(&buf[len]);
+			});
+
+			measure("encode to string", frameSize, 200, [&]() {
+				base64::encode(frame);
+			});
+
+			measure("decode", text.size(), 200, [&]() {
+				base64::decode(text.data(), text.size(), &out[0]);
+			});
+
+			measure("decode chunked", text.size(), 200, [&]() {
+				base64::Decoder dec;
+				std::size_t len = 0;
+				for (std::size_t pos = 0; pos < text.size(); pos += chunkSize)
+					len += dec.decode(text.data() + pos, std::min(chunkSize, text.size() - pos), &out[len]);
+			});
+		}
+		base64::setMode(best);
+
+		std::vector<char> digits(frameSize * 2);
+		cout << "Hex coding" << endl;
+		measure("encode", frameSize, 200, [&]() {
+			hex::encode(frame.data(), frame.size(), &digits[0]);
+		});
+	}
+
+	// ============================================================================
+	// Random Numbers
+	//
+	// Compares the generators used for frame masks, message ids and
+	// nonces. The seeded Random mirrors what randomNumber() and
+	// randomString() did per call before the thread local generators.
+	//
+	void benchRandom()
+	{
+		Random legacy;
+		UInt32 sink = 0;
+		char nonce[16];
+		cout << "Random numbers" << endl;
+		measure("Random::next", 0, 1000000, [&]() {
+			sink += legacy.next();
+		});
+		measure("seeded Random::next", 0, 20000, [&]() {
+			Random rnd;
+			rnd.seed();
+			sink += rnd.next();
+		});
+		measure("FastRandom::local().next", 0, 1000000, [&]() {
+			sink += FastRandom::local().next();
+		});
+		measure("SecureRandom::local().next", 0, 1000000, [&]() {
+			sink += SecureRandom::local().next();
+		});
+		measure("Random::getSeed 16 bytes", 16, 20000, [&]() {
+			Random::getSeed(nonce, sizeof(nonce));
+		});
+		measure("SecureRandom::local().fill 16 bytes", 16, 1000000, [&]() {
+			SecureRandom::local().fill(nonce, sizeof(nonce));
+		});
+		measure("util::randomString(16)", 0, 200000, [&]() {
+			util::randomString(16);
+		});
+		if (sink == 1)
+			cout << "" << endl; // Keep the results alive
+	}
+
+	// ============================================================================
+	// Signals
+	//
+	// Compares emission and attach cost of the virtual Signal family
+	// with VariadicSignal.
+	//
+	struct SignalReceiver
+	{
+		int counter;
+		SignalReceiver() : counter(0) {}
+		void onSignal(int& val) { counter += val; }
+	};
+
+	void benchSignal()
+	{
+		const int numDelegates = 8;
+		const int iterations = 1000000;
+		std::vector<SignalReceiver> receivers(numDelegates);
+		SignalReceiver extra;
+
+		Signal<int&> legacy;
+		VariadicSignal<int&> variadic;
+		for (auto& r : receivers) {
+			legacy += delegate(&r, &SignalReceiver::onSignal);
+			variadic += vdelegate(&r, &SignalReceiver::onSignal);
+		}
+
+		int val = 1;
+		cout << "Signal emission: " << numDelegates << " delegates" << endl;
+		measure("Signal<int&>::emit", 0, iterations, [&]() {
+			legacy.emit(this, val);
+		});
+		measure("VariadicSignal<int&>::emit", 0, iterations, [&]() {
+			variadic.emit(this, val);
+		});
+
+		cout << "Signal attach and detach" << endl;
+		measure("Signal<int&>", 0, iterations / 10, [&]() {
+			legacy += delegate(&extra, &SignalReceiver::onSignal);
+			legacy -= delegate(&extra, &SignalReceiver::onSignal);
+		});
+		measure("VariadicSignal<int&>", 0, iterations / 10, [&]() {
+			variadic += vdelegate(&extra, &SignalReceiver::onSignal);
+			variadic -= vdelegate(&extra, &SignalReceiver::onSignal);
+		});
+	}
+
+	// ============================================================================
+	// Queue Latency
+	//
+	// Measures enqueue to dispatch latency of AsyncQueue against the
+	// previous RunnableQueue consumer, which polled a locked deque and
+	// slept for 1ms after each item or 50ms when idle.
+	//
+	struct Stamp
+	{
+		UInt64 time;
+		Stamp() : time(uv_hrtime()) {}
+	};
+
+	struct PollingQueue
+	{
+		std::deque<Stamp*> queue;
+		Mutex mutex;
+		std::atomic<bool> exit;
+		std::function<void(Stamp&)> ondispatch;
+
+		PollingQueue() : exit(false) {}
+
+		void push(Stamp* item)
+		{
+			Mutex::ScopedLock lock(mutex);
+			queue.push_back(item);
+		}
+
+		bool dispatchNext()
+		{
+			Stamp* next;
+			{
+				Mutex::ScopedLock lock(mutex);
+				if (queue.empty())
+					return false;
+				next = queue.front();
+				queue.pop_front();
+			}
+			ondispatch(*next);
+			delete next;
+			return true;
+		}
+
+		void run()
+		{
+			while (!exit)
+				scy::sleep(dispatchNext() ? 1 : 50);
+		}
+	};
+
+	struct LatencyQueue: public AsyncQueue<Stamp>
+	{
+		virtual ~LatencyQueue() { cancel(); _thread.join(); }
+	};
+
+	void printLatency(const char* name, std::vector<UInt64>& samples)
+	{
+		std::sort(samples.begin(), samples.end());
+		cout << "  " << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1)
+			<< "p50 " << std::setw(10) << samples[samples.size() / 2] / 1000.0 << " us"
+			<< "   p99 " << std::setw(10) << samples[(samples.size() * 99) / 100] / 1000.0 << " us" << endl;
+	}
+
+	template<class QueueT>
+	void pushPaced(QueueT& queue, std::atomic<int>& dispatched, int count)
+	{
+		// Items are pushed at intervals so the consumer goes idle between them
+		for (int i = 0; i < count; i++) {
+			queue.push(new Stamp);
+			while (dispatched.load() <= i)
+				scy::sleep(1);
+			scy::sleep(2);
+		}
+	}
+
+	void benchQueueLatency()
+	{
+		const int count = 200;
+		cout << "Queue enqueue to dispatch latency: " << count << " items" << endl;
+		{
+			std::vector<UInt64> samples;
+			std::atomic<int> dispatched(0);
+			samples.reserve(count);
+			PollingQueue queue;
+			queue.ondispatch = [&](Stamp& item) { samples.push_back(uv_hrtime() - item.time); dispatched++; };
+			Thread consumer(std::bind(&PollingQueue::run, &queue));
+			pushPaced(queue, dispatched, count);
+			queue.exit = true;
+			consumer.join();
+			printLatency("Polling deque (previous)", samples);
+		}
+		{
+			std::vector<UInt64> samples;
+			std::atomic<int> dispatched(0);
+			samples.reserve(count);
+			LatencyQueue queue;
+			queue.ondispatch = [&](Stamp& item) { samples.push_back(uv_hrtime() - item.time); dispatched++; };
+			pushPaced(queue, dispatched, count);
+			printLatency("AsyncQueue", samples);
+		}
+	}
+
+	// ============================================================================
+	// Disabled Logging
+	//
+	// Measures the cost of log statements below the channel level,
+	// which previously allocated and formatted a LogStream.
+	//
+	void benchDisabledLogging()
+	{
+		Logger::instance().add(new ConsoleChannel("bench", LWarn));
+		cout << "Disabled log statements" << endl;
+		int val = 0;
+		measure("TraceL", 0, 1000000, [&]() {
+			TraceL << "Disabled message: " << val++ << endl;
+		});
+		measure("TraceLS(this)", 0, 1000000, [&]() {
+			TraceLS(this) << "Disabled message: " << val++ << endl;
+		});
+		measure("traceL(realm, this)", 0, 1000000, [&]() {
+			traceL("Benchmarks", this) << "Disabled message: " << val++ << endl;
+		});
+		Logger::instance().remove("bench");
+	}
+
+	// ============================================================================
+	// Time Formatting
+	//
+	// Compares the per thread format cache used by log channels and
+	// HTTP responses with formatting every call.
+	//
+	void benchTimeFormat()
+	{
+		cout << "Time formatting" << endl;
+		measure("print(toLocal(now))", 0, 200000, [&]() {
+			time::print(time::toLocal(time::now()), "%H:%M:%S");
+		});
+		measure("formatLocal(now)", 0, 200000, [&]() {
+			time::formatLocal(time::now(), "%H:%M:%S");
+		});
+		measure("DateTimeFormatter HTTP_FORMAT", 0, 200000, [&]() {
+			DateTimeFormatter::format(Timestamp(), DateTimeFormat::HTTP_FORMAT);
+		});
+		measure("formatUTC(now, RFC1123Format)", 0, 200000, [&]() {
+			time::formatUTC(Timestamp().epochTime(), time::RFC1123Format);
+		});
+		measure("uv_hrtime", 0, 1000000, [&]() {
+			uv_hrtime();
+		});
+		measure("time::ticks", 0, 1000000, [&]() {
+			time::ticks();
+		});
+	}
+
+	// ============================================================================
+	// Async Log Writer
+	//
+	// Measures the producer cost and drain time of bursts of 
+	// messages written through AsyncLogWriter.
+	//
+	struct NullChannel: public LogChannel
+	{
+		NullChannel() : LogChannel("null", LTrace) {}
+		virtual void write(const LogStream&) {}
+	};
+
+	void benchAsyncLogWriter()
+	{
+		const int burst = 10000;
+		NullChannel channel;
+		AsyncLogWriter writer(burst);
+		cout << "AsyncLogWriter bursts: " << burst << " messages" << endl;
+		measure("write and flush", 0, 20, [&]() {
+			for (int i = 0; i < burst; i++) {
+				LogStream* stream = new LogStream(LTrace, "Benchmarks", 0);
+				stream->channel = &channel;
+				*stream << "Burst message: " << i;
+				writer.write(stream);
+			}
+			writer.flush();
+		});
+	}
+
+	// ============================================================================
+	// Binary Logging
+	//
+	// Compares the cost of writing a message through the text file
+	// channel with the binary channel, which defers formatting.
+	//
+	void benchLogChannel(const char* name, LogChannel* channel)
+	{
+		Logger* previous = &Logger::instance();
+		Logger::setInstance(new Logger, false);
+		Logger::instance().setWriter(new LogWriter);
+		Logger::instance().add(channel);
+		int val = 0;
+		measure(name, 0, 100000, [&]() {
+			InfoL << "Benchmark message: " << val++ << ", " << 1.5 << ", " << "value" << endl;
+		});
+		Logger::instance().remove(channel->name(), false);
+		Logger::setInstance(previous);
+	}
+
+	void benchBinaryLogging()
+	{
+		std::string dir(getCwd());
+		fs::addnode(dir, "benchlogs");
+		std::string path(dir);
+		fs::addnode(path, "bench.log");
+
+		cout << "Log channel write" << endl;
+		{
+			FileChannel channel("text", path);
+			benchLogChannel("FileChannel", &channel);
+		}
+		fs::unlink(path);
+		{
+			BinaryFileChannel channel("binary", dir);
+			benchLogChannel("BinaryFileChannel", &channel);
+			path = channel.path();
+		}
+		fs::unlink(path);
+		fs::rmdir(dir);
+	}
+
+	// ============================================================================
+	// Packet Stream
+	//
+	// Measures the per packet cost of PacketStream::process through 
+	// a single processor, from one source thread and from several.
+	//
+	struct NullPacketProcessor: public PacketProcessor
+	{
+		PacketSignal emitter;
+		std::atomic<int> count;
+		NullPacketProcessor() : PacketProcessor(emitter), count(0) {}
+		virtual void process(IPacket&) { count++; }
+		virtual bool threadSafe() const { return true; }
+	};
+
+	void benchPacketStream()
+	{
+		const int numThreads = 4;
+		const int numPackets = 100000;
+		PacketSignal sources[numThreads];
+		PacketStream stream;
+		for (auto& source : sources)
+			stream.attachSource(source);
+		stream.attach(new NullPacketProcessor, 0, true);
+		stream.start();
+
+		cout << "PacketStream process" << endl;
+		measure("1 thread", 0, numPackets, [&]() {
+			RawPacket p("hello", 5);
+			sources[0].emit(nullptr, p);
+		});
+
+		// Packets per thread are timed together, so report the time per packet
+		std::vector<std::unique_ptr<Thread>> threads;
+		UInt64 start = uv_hrtime();
+		for (auto& source : sources) {
+			PacketSignal* signal = &source;
+			threads.push_back(std::unique_ptr<Thread>(new Thread([signal, numPackets]() {
+				for (int i = 0; i < numPackets; i++) {
+					RawPacket p("hello", 5);
+					signal->emit(nullptr, p);
+				}
+			})));
+		}
+		for (auto& thread : threads)
+			thread->join();
+		double nsPerOp = static_cast<double>(uv_hrtime() - start) / (numThreads * numPackets);
+		cout << "  " << std::left << std::setw(40) << "4 threads"
+			<< std::right << std::setw(12) << std::fixed << std::setprecision(1) << nsPerOp << " ns/op" << endl;
+		stream.close();
+	}
+
+	// ============================================================================
+	// Packet Pipeline
+	//
+	// Compares a chain of CPU bound processors running on the writing
+	// thread with the same chain split into pipeline stages.
+	//
+	struct BusyPacketProcessor: public PacketProcessor
+	{
+		PacketSignal emitter;
+		UInt64 busy;
+		BusyPacketProcessor(UInt64 busy) : PacketProcessor(emitter), busy(busy) {}
+		virtual void process(IPacket& packet) 
+		{ 
+			UInt64 until = uv_hrtime() + busy;
+			while (uv_hrtime() < until)
+				;
+			emit(packet); 
+		}
+	};
+
+	std::atomic<int> numPipelinePackets;
+	void onPipelinePacket(void*, IPacket&) { numPipelinePackets++; }
+
+	void benchPacketPipeline()
+	{
+		const int numStages = 3;
+		const int numPackets = 2000;
+		const UInt64 busy = 20000; // 20us per processor
+		cout << "PacketStream " << numStages << " processors of 20us" << endl;
+		for (int pipelined = 0; pipelined < 2; pipelined++) {
+			PacketStream stream;
+			for (int i = 0; i < numStages; i++) {
+				if (pipelined)
+					stream.attachStage(new BusyPacketProcessor(busy), i + 1, true);
+				else
+					stream.attach(new BusyPacketProcessor(busy), i + 1, true);
+			}
+			stream.emitter += packetDelegate(this, &Benchmarks::onPipelinePacket);
+			stream.start();
+			numPipelinePackets = 0;
+
+			UInt64 start = uv_hrtime();
+			for (int i = 0; i < numPackets; i++) {
+				RawPacket p("hello", 5);
+				stream.write(p);
+			}
+			while (numPipelinePackets < numPackets)
+				scy::sleep(1);
+			double nsPerOp = static_cast<double>(uv_hrtime() - start) / numPackets;
+			cout << "  " << std::left << std::setw(40) << (pipelined ? "pipelined stages" : "single thread")
+				<< std::right << std::setw(12) << std::fixed << std::setprecision(1) << nsPerOp << " ns/op" << endl;
+			stream.close();
+		}
+	}
+
+	// ============================================================================
+	// Packet Batch
+	//
+	// Compares writing packets one at a time with writing them in
+	// batches through a chain of batch aware processors.
+	//
+	struct BatchNullPacketProcessor: public PacketProcessor
+	{
+		PacketSignal emitter;
+		BatchNullPacketProcessor() : PacketProcessor(emitter) {}
+		virtual void process(IPacket& packet) { emit(packet); }
+		virtual void processBatch(PacketBatch& batch) { emitBatch(batch); }
+		virtual bool batched() const { return true; }
+	};
+
+	void benchPacketBatch()
+	{
+		const int numProcessors = 4;
+		const int numPackets = 100000;
+		const int batchSize = 32;
+		PacketStream stream;
+		for (int i = 0; i < numProcessors; i++)
+			stream.attach(new BatchNullPacketProcessor, i + 1, true);
+		stream.start();
+
+		std::vector<RawPacket> packets(batchSize, RawPacket("hello", 5));
+		PacketBatch batch;
+		for (auto& packet : packets)
+			batch.push(&packet);
+
+		cout << "PacketStream " << numProcessors << " processors" << endl;
+		measure("per packet", 0, numPackets, [&]() {
+			RawPacket p("hello", 5);
+			stream.write(p);
+		});
+
+		// Each batch writes batchSize packets, so report the time per packet
+		UInt64 start = uv_hrtime();
+		for (int i = 0; i < numPackets / batchSize; i++)
+			stream.write(batch);
+		double nsPerOp = static_cast<double>(uv_hrtime() - start) / (numPackets / batchSize * batchSize);
+		cout << "  " << std::left << std::setw(40) << "batches of 32"
+			<< std::right << std::setw(12) << std::fixed << std::setprecision(1) << nsPerOp << " ns/op" << endl;
+		stream.close();
+	}
+
+	// ============================================================================
+	// Task Runner
+	//
+	// Runs periodic tasks for a fixed duration, and reports the CPU
+	// time used by the process and how late tasks run on average.
+	//
+	struct PeriodicTask: public Task
+	{
+		Int64 period;       // milliseconds
+		UInt64 due;         // nanoseconds
+		UInt64 lateness;    // nanoseconds
+		int runs;
+
+		PeriodicTask(Int64 period) : 
+			Task(true), period(period), due(uv_hrtime() + period * 1000000), lateness(0), runs(0) 
+		{
+		}
+
+		virtual Int64 remaining() const
+		{
+			UInt64 now = uv_hrtime();
+			return due > now ? static_cast<Int64>((due - now + 999999) / 1000000) : 0;
+		}
+
+		virtual void run()
+		{
+			UInt64 now = uv_hrtime();
+			if (now < due)
+				return; // woken early
+			lateness += now - due;
+			runs++;
+			due += period * 1000000;
+		}
+	};
+
+	void benchTaskRunner()
+	{
+		const int numTasks = 2000;
+		const int duration = 500; // milliseconds
+		std::vector<PeriodicTask*> tasks;
+		std::clock_t cpu = std::clock();
+		{
+			TaskRunner runner;
+			for (int i = 0; i < numTasks; i++) {
+				tasks.push_back(new PeriodicTask(10 + i % 40));
+				runner.start(tasks.back());
+			}
+			scy::sleep(duration);
+
+			UInt64 lateness = 0;
+			int runs = 0;
+			for (auto task : tasks)
+				runner.cancel(task);
+			scy::sleep(10);
+			for (auto task : tasks) {
+				lateness += task->lateness;
+				runs += task->runs;
+			}
+			double cpuPercent = 100.0 * (std::clock() - cpu) / CLOCKS_PER_SEC / (duration / 1000.0);
+			cout << "TaskRunner " << numTasks << " periodic tasks" << endl;
+			cout << "  " << std::left << std::setw(40) << "cpu"
+				<< std::right << std::setw(12) << std::fixed << std::setprecision(1) << cpuPercent << " %" << endl;
+			cout << "  " << std::left << std::setw(40) << "mean lateness"
+				<< std::right << std::setw(12) << std::fixed << std::setprecision(1) 
+				<< (runs ? static_cast<double>(lateness) / runs : 0.0) << " ns" << endl;
+		}
+	}
+
+	// ============================================================================
+	// Task Pool
+	//
+	// Compares CPU bound tasks on a single TaskRunner thread with
+	// the same tasks on a TaskPool with one worker per core.
+	//
+	struct BusyTask: public Task
+	{
+		UInt64 busy;        // nanoseconds
+		std::atomic<int>& done;
+
+		BusyTask(UInt64 busy, std::atomic<int>& done) : busy(busy), done(done) {}
+
+		virtual void run()
+		{
+			UInt64 until = uv_hrtime() + busy;
+			while (uv_hrtime() < until)
+				;
+			done++;
+		}
+	};
+
+	void benchTaskPool()
+	{
+		const int numTasks = 400;
+		const UInt64 busy = 1000000; // 1ms per task
+		cout << "TaskRunner " << numTasks << " tasks of 1ms" << endl;
+		for (int pooled = 0; pooled < 2; pooled++) {
+			std::atomic<int> done(0);
+			std::unique_ptr<TaskRunner> runner(pooled ? new TaskPool : new TaskRunner);
+			UInt64 start = uv_hrtime();
+			for (int i = 0; i < numTasks; i++)
+				runner->start(new BusyTask(busy, done));
+			while (done < numTasks)
+				scy::sleep(1);
+			double nsPerOp = static_cast<double>(uv_hrtime() - start) / numTasks;
+			cout << "  " << std::left << std::setw(40) 
+				<< (pooled ? "task pool (" + util::itostr(static_cast<TaskPool*>(runner.get())->numWorkers()) + " workers)" : std::string("single thread"))
+				<< std::right << std::setw(12) << std::fixed << std::setprecision(1) << nsPerOp << " ns/op" << endl;
+		}
+	}
+
+	// ============================================================================
+	// Timer Wheel
+	//
+	// Restarts one of many outstanding timeouts per operation, as when
+	// transactions are resent or permissions refreshed.
+	//
+	void benchTimerWheel()
+	{
+		const int numTimeouts = 100000;
+		cout << "Restart with " << numTimeouts << " pending timeouts" << endl;
+		{
+			std::vector<std::unique_ptr<Timer>> timers;
+			for (int i = 0; i < numTimeouts; i++) {
+				timers.push_back(std::unique_ptr<Timer>(new Timer));
+				timers.back()->start(60000 + i, 0);
+			}
+			int i = 0;
+			measure("uv timer per timeout", 0, numTimeouts, [&]() {
+				i = (i + 7919) % numTimeouts;
+				timers[i]->start(60000 + i, 0);
+			});
+		}
+		uv_run(uv::defaultLoop(), UV_RUN_NOWAIT); // close timer handles
+		{
+			TimerWheel wheel;
+			std::vector<TimerWheel::Entry> entries(numTimeouts);
+			for (int i = 0; i < numTimeouts; i++)
+				entries[i].start(wheel, 60000 + i);
+			int i = 0;
+			measure("timer wheel", 0, numTimeouts, [&]() {
+				i = (i + 7919) % numTimeouts;
+				entries[i].start(wheel, 60000 + i);
+			});
+		}
+	}
+
+	// ============================================================================
+	// Sync Dispatcher
+	//
+	// Posts callbacks from producer threads to the loop thread and 
+	// reports the end to end time per callback.
+	//
+	template<class PostFn>
+	void postToLoop(const char* name, PostFn post)
+	{
+		const int numProducers = 4;
+		const int numPosts = 50000;
+		std::atomic<int> received(0);
+		SyncContext keepAlive(uv::defaultLoop(), []() {});
+		UInt64 start = uv_hrtime();
+		std::vector<std::unique_ptr<Thread>> producers;
+		for (int p = 0; p < numProducers; p++) {
+			producers.push_back(std::unique_ptr<Thread>(new Thread([&]() {
+				for (int i = 0; i < numPosts; i++)
+					post(received);
+			})));
+		}
+		while (received < numProducers * numPosts)
+			uv_run(uv::defaultLoop(), UV_RUN_ONCE);
+		double nsPerOp = static_cast<double>(uv_hrtime() - start) / (numProducers * numPosts);
+		for (auto& producer : producers)
+			producer->join();
+		keepAlive.close();
+		uv_run(uv::defaultLoop(), UV_RUN_NOWAIT);
+		cout << "  " << std::left << std::setw(40) << name
+			<< std::right << std::setw(12) << std::fixed << std::setprecision(1) << nsPerOp << " ns/op" << endl;
+	}
+
+	void benchSyncDispatcher()
+	{
+		cout << "Cross thread posting (4 producers)" << endl;
+		{
+			ipc::ActionSyncQueue queue;
+			postToLoop("ipc::SyncQueue action", [&](std::atomic<int>& received) {
+				queue.push(new ipc::Action([&received](const ipc::Action&) { received++; }, nullptr, "payload"));
+			});
+			queue.close();
+		}
+		{
+			SyncDispatcher dispatcher;
+			postToLoop("SyncDispatcher closure", [&](std::atomic<int>& received) {
+				dispatcher.post([&received]() { received++; });
+			});
+		}
+		uv_run(uv::defaultLoop(), UV_RUN_NOWAIT);
+	}
+
+	// ============================================================================
+	// Garbage Collector
+	//
+	// Retires a burst of pointers, as on a mass disconnect, and reports 
+	// the retire cost and the longest loop iteration spent freeing them,
+	// against freeing the whole burst in one go.
+	//
+	void benchGarbageCollector()
+	{
+		const int numPointers = 100000;
+		cout << "Deferred deletion of " << numPointers << " pointers" << endl;
+		GarbageCollector& gc = GarbageCollector::instance();
+		std::vector<std::string*> pointers;
+		for (int i = 0; i < numPointers; i++)
+			pointers.push_back(new std::string(64, 'x'));
+
+		UInt64 start = uv_hrtime();
+		for (auto ptr : pointers)
+			gc.deleteLater(ptr);
+		double retireNs = static_cast<double>(uv_hrtime() - start) / numPointers;
+
+		SyncContext keepAlive(uv::defaultLoop(), []() {});
+		UInt64 longest = 0;
+		while (gc.pending() > 0) {
+			start = uv_hrtime();
+			uv_run(uv::defaultLoop(), UV_RUN_NOWAIT);
+			longest = std::max<UInt64>(longest, uv_hrtime() - start);
+		}
+		keepAlive.close();
+		uv_run(uv::defaultLoop(), UV_RUN_NOWAIT);
+
+		for (auto& ptr : pointers)
+			ptr = new std::string(64, 'x');
+		start = uv_hrtime();
+		for (auto ptr : pointers)
+			delete ptr;
+		UInt64 burst = uv_hrtime() - start;
+
+		cout << "  " << std::left << std::setw(40) << "retire" 
+			<< std::right << std::setw(12) << std::fixed << std::setprecision(1) << retireNs << " ns/op" << endl;
+		cout << "  " << std::left << std::setw(40) << "longest reclaim iteration" 
+			<< std::right << std::setw(12) << longest / 1000.0 << " us" << endl;
+		cout << "  " << std::left << std::setw(40) << "free whole burst" 
+			<< std::right << std::setw(12) << burst / 1000.0 << " us" << endl;
+	}
+};
+
+
+} // namespace scy
+
+
+int main(int argc, char** argv)
+{
+	{
+		scy::Benchmarks run;
+	}
+	return 0;
+}
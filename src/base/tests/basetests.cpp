@@ -0,0 +1,2735 @@
+#include "scy/base.h"
+#include "scy/logger.h"
+#include "scy/binarylog.h"
+#include "scy/idler.h"
+#include "scy/signal.h"
+#include "scy/variadicsignal.h"
+#include "scy/buffer.h"
+#include "scy/bufferscan.h"
+#include "scy/base64.h"
+#include "scy/hex.h"
+#include "scy/random.h"
+#include "scy/bufferpool.h"
+#include "scy/packetpool.h"
+#include "scy/platform.h"
+#include "scy/collection.h"
+#include "scy/application.h"
+#include "scy/packetstream.h"
+#include "scy/packetqueue.h"
+#include "scy/sharedlibrary.h"
+#include "scy/filesystem.h"
+#include "scy/process.h"
+#include "scy/timer.h"
+#include "scy/time.h"
+#include "scy/datetime.h"
+#include "scy/taskrunner.h"
+#include "scy/taskpool.h"
+#include "scy/timerwheel.h"
+#include "scy/ipc.h"
+#include "scy/syncdispatcher.h"
+#include "scy/loopgroup.h"
+#include "scy/memory.h"
+#include "scy/util.h"
+
+#include <assert.h>
+#include <iomanip>
+#include <set>
+
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace scy;
+
+
+namespace scy {
+
+
+class Tests
+{
+public:
+	Application& app;
+
+	Tests(Application& app) : app(app)
+	{	
+		testSignalSnapshot();
+		testVariadicSignal();
+		testBufferPool();
+		testBufferChain();
+		testBufferScan();
+		testBase64();
+		testRandom();
+		testPacketPool();
+		testLogLevels();
+		testAsyncLogWriter();
+		testBinaryLogChannel();
+		testTimeFormat();
+		testTimerWheel();
+		testTaskRunner();
+		testTaskPool();
+		testAsyncQueue();
+		testQueueOverflow();
+		testPacketStreamProcessing();
+		testPacketStreamPipeline();
+		testPacketBatch();
+		testPacketStreamStats();
+		testGarbageCollector();
+		testSyncDispatcher();
+		testLoopGroup();
+		testVersionStringComparison();
+
+#if 0
+		testSignal();
+		runFSTest();
+		testBuffer();
+		testNVCollection();
+		runPluginTest();
+		testLogger();
+		runPlatformTests();
+		runExceptionTest();
+		runSchedulerTaskTest();
+		testTimer();
+		testIdler();
+		testSyncDelegate();
+		testProcess();
+		testRunner();
+		testThread();
+		
+		testSyncQueue();
+		testPacketStream();
+		testMultiPacketStream();
+		runPacketSignalTest();
+		runSocketTests();
+		runGarbageCollectorTests();
+		runSignalReceivers();
+		testIPC();
+		testMultiPacketStream();
+#endif
+		
+		//scy::pause();
+	}
+	
+	void testBuffer()
+	{
+		ByteOrder orders[2] = { ByteOrder::Host,
+								ByteOrder::Network };
+		for (size_t i = 0; i < 2; i++) {
+			Buffer buffer(1024);
+			BitReader reader(buffer, orders[i]);
+			BitWriter writer(buffer, orders[i]);
+			assert(orders[i] == reader.order());
+			assert(orders[i] == writer.order());
+
+			// Write and read UInt8.
+			UInt8 wu8 = 1;
+			writer.putU8(wu8);
+			UInt8 ru8;
+			reader.getU8(ru8);
+			assert(wu8 == ru8);
+			assert(writer.position() == 1);
+			assert(reader.position() == 1);		
+
+			// Write and read UInt16.
+			UInt16 wu16 = (1 << 8) + 1;
+			writer.putU16(wu16);
+			UInt16 ru16;
+			reader.getU16(ru16);
+			assert(wu16 == ru16);
+			assert(writer.position() == 3);
+			assert(reader.position() == 3);
+		
+			// Write and read UInt24.
+			UInt32 wu24 = (3 << 16) + (2 << 8) + 1;
+			writer.putU24(wu24);
+			UInt32 ru24;
+			reader.getU24(ru24);
+			assert(wu24 == ru24);
+			assert(writer.position() == 6);
+			assert(reader.position() == 6);
+		
+			// Write and read UInt32.
+			UInt32 wu32 = (4 << 24) + (3 << 16) + (2 << 8) + 1;
+			writer.putU32(wu32);
+			UInt32 ru32;
+			reader.getU32(ru32);
+			assert(wu32 == ru32);
+			assert(writer.position() == 10);
+			assert(reader.position() == 10);
+		
+			// Write and read UInt64.
+			UInt32 another32 = (8 << 24) + (7 << 16) + (6 << 8) + 5;
+			UInt64 wu64 = (static_cast<UInt64>(another32) << 32) + wu32;
+			writer.putU64(wu64);
+			UInt64 ru64;
+			reader.getU64(ru64);
+			assert(wu64 == ru64);
+			assert(writer.position() == 18);
+			assert(reader.position() == 18);
+
+			// Write and read string.
+			std::string write_string("hello");
+			writer.put(write_string);
+			std::string read_string;
+			reader.get(read_string, write_string.size());
+			assert(write_string == read_string);
+			assert(writer.position() == 23);
+			assert(reader.position() == 23);
+
+			// Write and read bytes
+			char write_bytes[] = "foo";
+			writer.put(write_bytes, 3);
+			char read_bytes[3];
+			reader.get(read_bytes, 3);
+			for (int i = 0; i < 3; ++i) {
+			  assert(write_bytes[i] == read_bytes[i]);
+			}
+			assert(writer.position() == 26);
+			assert(reader.position() == 26);
+
+			// TODO: Test overflow
+		
+			/*
+			try {
+				reader.getU8(ru8);
+				assert(0 && "must throw");
+			}
+			catch (std::out_of_range& exc) {
+			}		
+			*/
+		}
+	}
+	
+	void testBufferPool()
+	{
+		auto pool = new BufferPool(1024, 4);
+		assert(pool->numBlocks() == 0);
+
+		// Blocks are allocated a slab at a time
+		PooledBuffer* block = pool->acquire();
+		assert(pool->numSlabs() == 1);
+		assert(pool->numFree() == 3);
+		assert(block->capacity() == 1024);
+		assert(block->refCount() == 1);
+		std::memcpy(block->data(), "hello", 5);
+		block->setSize(5);
+
+		// Packets share the block by reference
+		RawPacket* packet;
+		{
+			RawPacket slice(block, block->data() + 1, 4);
+			assert(block->refCount() == 2);
+			packet = reinterpret_cast<RawPacket*>(slice.clone());
+			assert(block->refCount() == 3);
+			assert(packet->data() == block->data() + 1);
+		}
+		assert(block->refCount() == 2);
+
+		// Writers can retain outstanding blocks by data pointer
+		assert(pool->retain(block->data() + 1, 4) == block);
+		assert(block->refCount() == 3);
+		block->release();
+		assert(pool->retain(block->data() + 1020, 8) == nullptr);
+		assert(pool->retain("hello", 5) == nullptr);
+
+		// The block returns to the pool with the last reference
+		block->release();
+		assert(pool->numFree() == 3);
+		assert(std::string(packet->data(), packet->size()) == "ello");
+		delete packet;
+		assert(pool->numFree() == 4);
+
+		// Released blocks are recycled
+		PooledBuffer* next = pool->acquire();
+		assert(next == block);
+		assert(next->size() == 0);
+		next->release();
+		assert(pool->numSlabs() == 1);
+
+		// The pool is freed with its last reference
+		pool->release();
+
+		// Requests are served from the smallest size class which fits
+		std::vector<std::size_t> sizes;
+		sizes.push_back(4096);
+		sizes.push_back(256);
+		sizes.push_back(1024);
+		pool = new BufferPool(sizes, 8192);
+		assert(pool->blockSize() == 4096);
+		PooledBuffer* small = pool->acquire(100);
+		PooledBuffer* medium = pool->acquire(257);
+		PooledBuffer* large = pool->acquire(4096);
+		assert(small->capacity() == 256);
+		assert(medium->capacity() == 1024);
+		assert(large->capacity() == 4096);
+		assert(pool->acquire(4097) == nullptr);
+		assert(pool->numSlabs() == 3);
+		assert(pool->numBlocks() == 32 + 8 + 2);
+		assert(pool->retain(small->data() + 200, 56) == small);
+		assert(pool->retain(medium->data() + 1000, 24) == medium);
+		assert(pool->retain(large->data() + 4000, 100) == nullptr);
+		assert(small->refCount() == 2 && medium->refCount() == 2);
+		small->release();
+		medium->release();
+		for (auto b : { small, medium, large })
+			b->release();
+		assert(pool->numFree() == pool->numBlocks());
+		pool->release();
+
+		// Idle slabs are given back once too much memory is free
+		pool = new BufferPool(1024, 2);
+		pool->setMaxFree(2048);
+		PooledBuffer* blocks[4];
+		for (auto& b : blocks)
+			b = pool->acquire();
+		assert(pool->numSlabs() == 2);
+		for (auto b : blocks)
+			b->release();
+		assert(pool->numSlabs() == 1);
+		assert(pool->numFree() == 2);
+		assert(pool->trim() == 2048);
+		assert(pool->numSlabs() == 0);
+		pool->release();
+
+		// Reads continue in the tail of blocks holding retained data
+		pool = new BufferPool(1024, 4);
+		{
+			ReceiveBuffer recv(pool, 1024, 256);
+			MutableBuffer space = recv.prepare();
+			assert(space.size() == 1024);
+			MutableBuffer data = recv.commit(600);
+			assert(bufferCast<char*>(data) == recv.block()->data());
+			assert(recv.block()->size() == 600);
+
+			// Unretained data is overwritten by the next read
+			assert(bufferCast<char*>(recv.prepare()) == recv.block()->data());
+			recv.commit(600);
+			PooledBuffer* first = recv.block();
+			first->duplicate();
+			space = recv.prepare();
+			assert(recv.block() == first);
+			assert(bufferCast<char*>(space) == first->data() + 600);
+			assert(space.size() == 424);
+			recv.commit(300);
+
+			// A fresh block is taken once the tail is too small
+			space = recv.prepare();
+			assert(recv.block() != first);
+			assert(space.size() == 1024);
+			first->release();
+			assert(pool->numFree() == 3);
+		}
+		assert(pool->numFree() == 4);
+		pool->release();
+	}
+
+	void testBufferChain()
+	{
+		std::string payload(256, 'x');
+
+		// Adjacent copied segments are coalesced, references are not copied
+		BufferChain chain;
+		BitWriter writer(chain);
+		writer.putU16(0xABCD);
+		writer.put("hdr");
+		writer.putRef(payload.data(), payload.size());
+		writer.put("\r\n");
+		assert(chain.count() == 3);
+		assert(chain.size() == 5 + payload.size() + 2);
+		assert(writer.position() == chain.size());
+		assert(bufferCast<const char*>(chain.segment(1)) == payload.data());
+
+		// Copied bytes can be updated in place
+		assert(writer.updateU16(0x1234, 0));
+		assert(!writer.updateU16(0x1234, 6)); // referenced segment
+		std::string flat = chain.toString();
+		assert(flat.size() == chain.size());
+		assert(flat[0] == 0x12 && flat[1] == 0x34);
+		assert(flat.substr(2, 3) == "hdr");
+
+		// Copies keep copied segments valid
+		BufferChain copy(chain);
+		chain.clear();
+		assert(copy.toString() == flat);
+
+		// Chain packets are sent as is and clone to a flat RawPacket
+		BufferChainPacket packet;
+		packet.chain.append(copy);
+		IPacket* clone = packet.clone();
+		assert(clone->size() == flat.size());
+		assert(std::string(clone->data(), clone->size()) == flat);
+		delete clone;
+
+		// Chains spill past their inline storage, and keep their
+		// contents when copied, moved and assigned
+		BufferChain big;
+		std::string expect;
+		for (int i = 0; i < 40; i++) {
+			std::string part(BufferChain::InlineBytes / 8, char('a' + i % 26));
+			big.write(part);
+			big.append(payload.data(), 8);
+			expect += part + payload.substr(0, 8);
+		}
+		assert(big.count() == 80);
+		assert(big.toString() == expect);
+		BufferChain moved(std::move(big));
+		assert(big.empty() && big.count() == 0);
+		assert(moved.toString() == expect);
+		big = moved;
+		assert(big.toString() == expect);
+		copy = std::move(moved);
+		assert(copy.toString() == expect);
+		copy.append(copy);
+		assert(copy.toString() == expect + expect);
+	}
+		
+	
+	void testBufferScan()
+	{
+		// All scanning modes must agree with the scalar loops,
+		// including matches at every offset around block edges
+		const scan::Mode best = scan::detectMode();
+		for (int mode = scan::Scalar; mode <= best; mode++) {
+			scan::setMode(static_cast<scan::Mode>(mode));
+			assert(scan::mode() == mode);
+			for (std::size_t len = 0; len < 80; len++) {
+				for (std::size_t pos = 0; pos <= len; pos++) {
+					std::string data(len, 'a');
+					if (pos < len)
+						data[pos] = ':';
+					assert(scan::findChar(data.data(), len, ':') == pos);
+					assert(scan::findNotChar(data.data(), len, 'a') == pos);
+					if (pos < len)
+						data[pos] = "\t\r\n "[pos % 4];
+					assert(scan::findWordEnd(data.data(), len) == pos);
+				}
+			}
+
+			std::string text("  GET /index.html HTTP/1.1\r\nHost: sourcey.com\r\n\r\n");
+			BitReader reader(text.data(), text.size());
+			std::string val;
+			assert(reader.readNextWord(val) == 3 && val == "GET");
+			val.clear();
+			assert(reader.readNextWord(val) == 11 && val == "/index.html");
+			val.clear();
+			assert(reader.readLine(val) == 11 && val == " HTTP/1.1\r");
+			val.clear();
+			assert(reader.readToNext(val, ':') == 4 && val == "Host");
+			assert(reader.skipToNextLine() == 15);
+			assert(reader.skipToChar('x') == 2);
+			assert(reader.available() == 0);
+		}
+		scan::setMode(best);
+	}
+
+
+	void testBase64()
+	{
+		const char* plain[] = { "", "f", "fo", "foo", "foob", "fooba", "foobar" };
+		const char* coded[] = { "", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy" };
+
+		std::string data;
+		for (int i = 0; i < 1000; i++)
+			data += static_cast<char>(i * 7 + i / 256);
+
+		// All modes must produce the same output, including for 
+		// messages split at every offset around group edges
+		const base64::Mode best = base64::detectMode();
+		for (int mode = base64::Scalar; mode <= best; mode++) {
+			base64::setMode(static_cast<base64::Mode>(mode));
+			assert(base64::mode() == mode);
+			for (int i = 0; i < 7; i++) {
+				assert(base64::encode(std::string(plain[i]), 0) == coded[i]);
+				assert(base64::decode(std::string(coded[i])) == plain[i]);
+			}
+
+			// 334 groups with a line feed after every 18
+			std::string text = base64::encode(data);
+			assert(text.size() == 1336 + 18);
+			assert(text[72] == '\n' && text[text.size() - 1] == '=');
+			assert(base64::decode(text) == data);
+			
+			for (std::size_t split = 0; split < 100; split++) {
+				base64::Encoder enc;
+				std::vector<char> buf(base64::encodedLength(data.size(), base64::LINE_LENGTH));
+				std::size_t len = enc.encode(data.data(), split, &buf[0]);
+				len += enc.encode(data.data() + split, data.size() - split, &buf[len]);
+				len += enc.finalize(&buf[len]);
+				assert(std::string(&buf[0], len) == text);
+
+				base64::Decoder dec;
+				std::vector<char> out(base64::decodedLength(text.size()));
+				len = dec.decode(text.data(), split, &out[0]);
+				len += dec.decode(text.data() + split, text.size() - split, &out[len]);
+				assert(std::string(&out[0], len) == data);
+			}
+		}
+		base64::setMode(best);
+
+		assert(hex::encode(std::string("\x01\xab\xff")) == "01abff");
+		std::string digits(data.size() * 2, '\0');
+		assert(hex::encode(data.data(), data.size(), &digits[0], true) == digits.size());
+		for (std::size_t i = 0; i < data.size(); i++) {
+			const unsigned char c = static_cast<unsigned char>(data[i]);
+			assert(digits[i * 2] == "0123456789ABCDEF"[c >> 4]);
+			assert(digits[i * 2 + 1] == "0123456789ABCDEF"[c & 0xF]);
+		}
+	}
+
+
+	void testRandom()
+	{
+		// Equal seeds give equal sequences
+		FastRandom a(42), b(42), c(43);
+		bool differs = false;
+		for (int i = 0; i < 100; i++) {
+			const UInt64 value = a.next64();
+			assert(value == b.next64());
+			differs |= value != c.next64();
+		}
+		assert(differs);
+
+		// Bounded values stay in range and cover it
+		int counts[10] = { 0 };
+		for (int i = 0; i < 10000; i++) {
+			const UInt32 value = a.next(10);
+			assert(value < 10);
+			counts[value]++;
+			const double d = a.nextDouble();
+			assert(d >= 0.0 && d < 1.0);
+		}
+		for (int i = 0; i < 10; i++)
+			assert(counts[i] > 800 && counts[i] < 1200);
+		assert(a.next(1) == 0);
+
+		// Odd lengths are filled up to the last byte
+		char buf[13];
+		std::memset(buf, 0, sizeof(buf));
+		while (buf[12] == 0)
+			a.fill(buf, sizeof(buf));
+
+		// Secure bytes come from the buffer in small pieces,
+		// across refills, and straight from the system when large
+		SecureRandom& rnd = SecureRandom::local();
+		std::set<std::string> seen;
+		for (int i = 0; i < SecureRandom::BufferSize / 16 * 3; i++)
+			assert(seen.insert(rnd.bytes(16)).second);
+		std::string large = rnd.bytes(SecureRandom::BufferSize * 2);
+		assert(large.size() == SecureRandom::BufferSize * 2);
+		assert(large.find(std::string(16, '\0')) == std::string::npos);
+		assert(rnd.bytes(0).empty());
+		assert(util::randomString(24).size() == 24);
+		assert(util::randomNumber() <= 0x7FFFFFFF);
+
+		// Each thread has its own generators
+		UInt64 mine = FastRandom::local().next64(), theirs = 0;
+		FastRandom* other = nullptr;
+		Thread thread([&]() {
+			other = &FastRandom::local();
+			theirs = other->next64();
+		});
+		thread.join();
+		assert(other != &FastRandom::local());
+		assert(mine != theirs);
+	}
+		
+	
+	struct PoolBlockHolder
+	{
+		void* block;
+		PoolBlockHolder() : block(nullptr) {}
+		~PoolBlockHolder() { PacketPool::deallocate(block); }
+	};
+
+	void testPacketPool()
+	{
+		PacketPool::resetStats();
+
+		// The first clone allocates, later clones reuse freed blocks
+		RawPacket packet("hello", 5);
+		for (int i = 0; i < 10; i++) {
+			IPacket* clone = packet.clone();
+			assert(std::string(clone->data(), clone->size()) == "hello");
+			delete clone;
+		}
+		PacketPool::Stats stats = PacketPool::stats();
+		assert(stats.misses <= 3); // packet, data and initial copy
+		assert(stats.hits >= 18);
+
+		// Blocks freed on another thread are reused
+		std::vector<IPacket*> packets;
+		for (int i = 0; i < 100; i++)
+			packets.push_back(packet.clone());
+		Thread consumer;
+		consumer.start([](void* arg) {
+			auto vec = reinterpret_cast<std::vector<IPacket*>*>(arg);
+			for (auto p : *vec)
+				delete p;
+		}, &packets);
+		consumer.join();
+
+		PacketPool::resetStats();
+		for (int i = 0; i < 10; i++)
+			delete packet.clone();
+		assert(PacketPool::stats().misses == 0);
+
+		// Oversized data bypasses the pool
+		std::string large(PacketPool::kMaxBlockSize, 'x');
+		RawPacket big(large.data(), large.size());
+		assert(PacketPool::stats().oversized == 1);
+
+		// A burst of large blocks is given back to the system once 
+		// the shared free list for their size class is full
+		std::vector<void*> blocks;
+		for (int i = 0; i < 100; i++)
+			blocks.push_back(PacketPool::allocate(100 * 1024)); // 16 shared 128 KB blocks
+		Thread burst;
+		burst.start([](void* arg) {
+			for (auto p : *reinterpret_cast<std::vector<void*>*>(arg))
+				PacketPool::deallocate(p);
+		}, &blocks);
+		burst.join();
+		assert(PacketPool::stats().released >= 100 - 16);
+
+		// Blocks freed by thread_local destructors which run after 
+		// the thread cache is destroyed go to the shared free list
+		Thread exiting;
+		exiting.start([](void*) {
+			static thread_local PoolBlockHolder holder; // outlives the thread cache
+			holder.block = PacketPool::allocate(100 * 1024);
+		}, nullptr);
+		exiting.join();
+		PacketPool::resetStats();
+		Thread refill;
+		refill.start([](void*) {
+			std::vector<void*> held;
+			for (int i = 0; i < 20; i++)
+				held.push_back(PacketPool::allocate(100 * 1024));
+			for (auto p : held)
+				PacketPool::deallocate(p);
+		}, nullptr);
+		refill.join();
+		assert(PacketPool::stats().hits == 16);
+	}
+		
+	
+	// ============================================================================
+	// Signal Test
+	//
+	Signal<int&> TestSignal;
+
+	void testSignal()
+	{
+		int val = 0;
+		TestSignal += sdelegate(this, &Tests::testSignalCallback);
+		TestSignal += delegate(this, &Tests::testSignalCallbackNoSender);
+		TestSignal.emit(this, val);
+		assert(val == 2);
+	}
+
+	void testSignalCallback(void* sender, int& val) 
+	{
+		assert(sender == this);
+		val++;
+	}
+
+	void testSignalCallbackNoSender(int& val) 
+	{
+		val++;
+	}
+
+	// ============================================================================
+	// Signal Snapshot Test
+	//
+	Signal<int&> SnapshotSignal;
+	std::vector<int> snapshotOrder;
+
+	void testSignalSnapshot()
+	{
+		// Delegates are called in priority order and may
+		// detach themselves and others during emission
+		int val = 0;
+		SnapshotSignal += delegate(this, &Tests::onSnapshotLow, -1);
+		SnapshotSignal += delegate(this, &Tests::onSnapshotDetach, 1);
+		SnapshotSignal += delegate(this, &Tests::onSnapshotHigh, 2);
+		assert(SnapshotSignal.ndelegates() == 3);
+		SnapshotSignal.emit(this, val);
+		assert(snapshotOrder.size() == 2);
+		assert(snapshotOrder[0] == 2 && snapshotOrder[1] == 1);
+		assert(SnapshotSignal.ndelegates() == 1);
+		SnapshotSignal.emit(this, val);
+		assert(snapshotOrder.size() == 3 && snapshotOrder[2] == 2);
+		SnapshotSignal -= this;
+		assert(SnapshotSignal.ndelegates() == 0);
+
+		// Emission is safe while other threads attach and detach
+		std::atomic<bool> done(false);
+		Thread writer([&]() {
+			while (!done) {
+				SnapshotSignal += delegate(this, &Tests::onSnapshotCount);
+				SnapshotSignal -= delegate(this, &Tests::onSnapshotCount);
+			}
+		});
+		val = 0;
+		for (int i = 0; i < 100000; i++)
+			SnapshotSignal.emit(this, val);
+		done = true;
+		writer.join();
+		SnapshotSignal.clear();
+		assert(SnapshotSignal.ndelegates() == 0);
+	}
+
+	void onSnapshotHigh(int&) { snapshotOrder.push_back(2); }
+	void onSnapshotLow(int&) { snapshotOrder.push_back(-1); }
+	void onSnapshotCount(int& val) { val++; }
+
+	void onSnapshotDetach(int&)
+	{
+		snapshotOrder.push_back(1);
+		SnapshotSignal -= delegate(this, &Tests::onSnapshotDetach, 1);
+		SnapshotSignal -= delegate(this, &Tests::onSnapshotLow, -1);
+	}
+
+	// ============================================================================
+	// Variadic Signal Test
+	//
+	VariadicSignal<int&, const std::string&> VSignal;
+
+	void testVariadicSignal()
+	{
+		// Member functions with and without a sender, and lambdas
+		int val = 0;
+		std::string captured(64, 'x'); // forces a heap stored functor
+		VSignal += vdelegate(this, &Tests::onVariadic);
+		VSignal += svdelegate(this, &Tests::onVariadicSender, 1);
+		int id = VSignal.attach([&val](int& v, const std::string& s) { v += 10; });
+		int id2 = VSignal.attach([captured](int& v, const std::string& s) { v += 100; });
+		assert(VSignal.ndelegates() == 4);
+		VSignal.emit(this, val, "hello");
+		assert(val == 112);
+
+		// Attaching an equal delegate replaces it
+		VSignal += vdelegate(this, &Tests::onVariadic);
+		assert(VSignal.ndelegates() == 4);
+
+		// Detach by delegate, id and instance
+		VSignal -= vdelegate(this, &Tests::onVariadic);
+		assert(VSignal.ndelegates() == 3);
+		assert(VSignal.detach(id));
+		assert(VSignal.detach(id2));
+		assert(!VSignal.detach(id2));
+		VSignal -= this;
+		assert(VSignal.ndelegates() == 0);
+
+		// Forwarding to and from the Signal family
+		Signal2<int&, const std::string&> legacy;
+		legacy += delegate(this, &Tests::onVariadic);
+		VSignal.forward(legacy);
+		val = 0;
+		VSignal.emit(this, val, "hello");
+		assert(val == 1);
+		VSignal -= &legacy;
+		assert(VSignal.ndelegates() == 0);
+
+		VariadicSignal<int&, const std::string&> receiver;
+		receiver += vdelegate(this, &Tests::onVariadic);
+		legacy.clear();
+		legacy += sdelegate(&receiver, &VariadicSignal<int&, const std::string&>::emit);
+		val = 0;
+		legacy.emit(this, val, "hello");
+		assert(val == 1);
+	}
+
+	void onVariadic(int& val, const std::string& str)
+	{
+		assert(str == "hello");
+		val++;
+	}
+
+	void onVariadicSender(void* sender, int& val, const std::string& str)
+	{
+		assert(sender == this);
+		val++;
+	}
+	
+
+	// ============================================================================
+	// Collection Test
+	//
+	void testNVCollection()
+	{
+		NVCollection nvc;
+		assert(nvc.empty());
+		assert(nvc.size() == 0);
+	
+		nvc.set("name", "value");
+		assert(!nvc.empty());
+		assert(nvc["name"] == "value");
+		assert(nvc["Name"] == "value");
+	
+		nvc.set("name2", "value2");
+		assert(nvc.get("name2") == "value2");
+		assert(nvc.get("NAME2") == "value2");
+	
+		assert(nvc.size() == 2);
+	
+		try
+		{
+			std::string value = nvc.get("name3");
+			assert(0 && "not found - must throw");
+		}
+		catch (std::exception&)
+		{
+		}
+ 
+		try
+		{
+			std::string value = nvc["name3"];
+			assert(0 && "not found - must throw");
+		}
+		catch (std::exception&)
+		{
+		}
+	
+		assert(nvc.get("name", "default") == "value");
+		assert(nvc.get("name3", "default") == "default");
+
+		assert(nvc.has("name"));
+		assert(nvc.has("name2"));
+		assert(!nvc.has("name3"));	
+	
+		nvc.add("name3", "value3");
+		assert(nvc.get("name3") == "value3");
+	
+		nvc.add("name3", "value31");
+		
+		nvc.add("Connection", "value31");
+	
+		NVCollection::ConstIterator it = nvc.find("Name3");
+		assert(it != nvc.end());
+		std::string v1 = it->second;
+		assert(it->first == "name3");
+		++it;
+		assert(it != nvc.end());
+		std::string v2 = it->second;
+		assert(it->first == "name3");
+	
+		assert((v1 == "value3" && v2 == "value31") || (v1 == "value31" && v2 == "value3"));
+	
+		nvc.erase("name3");
+		assert(!nvc.has("name3"));
+		assert(nvc.find("name3") == nvc.end());
+	
+		it = nvc.begin();
+		assert(it != nvc.end());
+		++it;
+		assert(it != nvc.end());
+		++it;
+		assert(it == nvc.end());
+	
+		nvc.clear();
+		assert(nvc.empty());
+	
+		assert(nvc.size() == 0);
+	}
+
+
+	// ============================================================================
+	// FileSystem Test
+	//
+	void runFSTest() 
+	{
+		std::string path(scy::getExePath());
+		DebugL << "Executable path: " << path << endl;
+		assert(fs::exists(path));
+
+		std::string junkPath(path + "junkname.huh");
+		DebugL << "Junk path: " << junkPath << endl;
+		assert(!fs::exists(junkPath));
+
+		std::string dir(fs::dirname(path));
+		DebugL << "Dir name: " << dir << endl;	
+		assert(fs::exists(dir));			
+		assert(fs::exists(dir + "/"));
+		assert(fs::exists(dir + "\\"));
+		assert(fs::dirname(dir) == dir);
+		assert(fs::dirname(dir + "/") == dir);
+		assert(fs::dirname(dir + "\\") == dir);
+	}
+
+#if 0
+	// ============================================================================
+	// Plugin Test
+	//
+	typedef int (*GimmeFiveFunc)();
+
+	void runPluginTest() 
+	{
+		DebugL << "Starting" << endl;
+		// TODO: Use getExePath
+		std::string path("D:/dev/projects/Sourcey/LibSourcey/build/install/libs/TestPlugin/TestPlugind.dll");
+		
+		try
+		{
+			//
+			// Load the shared library
+			SharedLibrary lib;
+			lib.open(path);
+			
+			// 
+			// Get plugin descriptor and exports
+			PluginDetails* info;
+			lib.sym("exports", reinterpret_cast<void**>(&info));
+			cout << "Plugin Info: " 
+				<< "\n\tAPIVersion: " << info->abiVersion 
+				<< "\n\tFileName: " << info->fileName 
+				<< "\n\tClassName: " << info->className 
+				<< "\n\tPluginName: " << info->pluginName 
+				<< "\n\tPluginVersion: " << info->pluginVersion
+				<< endl;
+			
+			//
+			// Version checking 
+			if (info->abiVersion != SCY_PLUGIN_ABI_VERSION)
+				throw std::runtime_error(util::format("Module version mismatch. Expected %s, got %s.", SCY_PLUGIN_ABI_VERSION, info->abiVersion));
+			
+			//
+			// Instantiate the plugin
+			TestPlugin* plugin = reinterpret_cast<TestPlugin*>(info->initializeFunc());
+
+			//
+			// Run test methods
+			//plugin->setValue("abracadabra");
+			//assert(plugin->sValue() == "abracadabra");
+		
+			//
+			// Call a C function 
+			GimmeFiveFunc gimmeFive;
+			lib.sym("gimmeFive", reinterpret_cast<void**>(&gimmeFive));
+			assert(gimmeFive() == 5);	
+
+			//
+			// Cleanup and close the library
+			cout << "Cleanup" << endl;
+			//delete plugin;
+			cout << "Cleanup 1" << endl;
+			lib.close();
+			cout << "Cleanup 2" << endl;
+		}
+		catch (std::exception& exc)
+		{
+			ErrorL << "Error: " << exc.what() << endl;
+			assert(0);
+		}
+		
+		cout << "Ending" << endl;
+	}
+#endif
+
+
+	// ============================================================================
+	// Platform Test
+	//
+	void runPlatformTests() 
+	{
+		cout << "executable path: " << scy::getExePath() << endl;
+		cout << "current working directory: " << scy::getCwd() << endl;
+	}
+
+	// ============================================================================
+	// Time Format Test
+	//
+	void testTimeFormat() 
+	{
+		// Cached text must match a full format, and the same text 
+		// is handed out until the time changes
+		std::time_t now = time::now();
+		const std::string& local = time::formatLocal(now, "%H:%M:%S");
+		assert(local == time::print(time::toLocal(now), "%H:%M:%S"));
+		assert(&time::formatLocal(now, "%H:%M:%S") == &local);
+		assert(time::formatLocal(now + 1, "%H:%M:%S") == time::print(time::toLocal(now + 1), "%H:%M:%S"));
+		assert(time::formatUTC(now) == time::print(time::toUTC(now)));
+
+		// RFC 1123 dates must match the HTTP format of DateTimeFormatter
+		for (std::time_t t = 0; t < 400 * 86400; t += 86400 + 3671) {
+			assert(time::formatUTC(t, time::RFC1123Format) == 
+				DateTimeFormatter::format(Timestamp::fromEpochTime(t), DateTimeFormat::HTTP_FORMAT));
+		}
+
+		// Formats are matched by value, and evicted formats still work
+		std::string fmt("%Y %H");
+		assert(time::formatUTC(now, fmt.c_str()) == time::print(time::toUTC(now), "%Y %H"));
+		for (int i = 0; i < 20; i++) {
+			std::string other(util::itostr(i) + " %S");
+			assert(time::formatUTC(now, other.c_str()) == time::print(time::toUTC(now), other.c_str()));
+		}
+		assert(time::formatUTC(now, "%Y %H") == time::print(time::toUTC(now), "%Y %H"));
+
+		UInt64 start = time::ticks();
+		scy::sleep(20);
+		UInt64 elapsed = time::ticks() - start;
+		assert(elapsed >= 10 && elapsed < 1000);
+	}
+
+	// ============================================================================
+	// Logger Test
+	//
+	void testLogger() 
+	{
+		// Test default synchronous writer
+		Logger::instance().setWriter(new LogWriter);		
+		clock_t start = clock();
+		for (unsigned i = 0; i < 1000; i++) 
+			TraceL << "Test message: " << i << endl;
+		cout << "#### synchronous test completed after: " << (clock() - start) << endl;
+		
+		// Test asynchronous writer (approx 10x faster)
+		Logger::instance().setWriter(new AsyncLogWriter);		
+		start = clock();
+		for (unsigned i = 0; i < 1000; i++) 
+			TraceL << "Test message: " << i << endl;
+		cout << "#### asynchronous test completed after: " << (clock() - start) << endl;
+
+		// Test function logging
+		start = clock();
+		for (unsigned i = 0; i < 1000; i++) 
+			TraceLS(this) << "Test message: " << i << endl;
+		cout << "#### asynchronous function logging completed after: " << (clock() - start) << endl;
+		
+		// Test function and mem address logging
+		start = clock();
+		for (unsigned i = 0; i < 1000; i++) 
+			TraceLS(this) << "Test message: " << i << endl;
+		cout << "#### asynchronous function and mem address logging completed after: " << (clock() - start) << endl;
+	}
+
+	// ============================================================================
+	// Log Level Test
+	//
+	struct CountingChannel: public LogChannel
+	{
+		int count;
+		CountingChannel(LogLevel level) : LogChannel("counting", level), count(0) {}
+		virtual void write(const LogStream& stream) { if (level() <= stream.level) count++; }
+	};
+
+	int evaluated;
+	int evaluate() { return ++evaluated; }
+
+	void testLogLevels()
+	{
+		Logger* previous = &Logger::instance();
+		Logger::setInstance(new Logger, false);
+		Logger::instance().setWriter(new LogWriter);
+
+		// Nothing is enabled without channels
+		assert(!Logger::enabled(LFatal));
+		
+		auto channel = new CountingChannel(LInfo);
+		Logger::instance().add(channel);
+		assert(!Logger::enabled(LDebug));
+		assert(Logger::enabled(LInfo));
+
+		// Disabled statements do not evaluate their operands
+		evaluated = 0;
+		TraceL << "Test message: " << evaluate() << endl;
+		DebugLS(this) << "Test message: " << evaluate() << endl;
+		assert(evaluated == 0);
+		assert(&traceL("Tests", this) == &LogStream::null());
+		traceL("Tests", this) << "Test message: " << evaluate() << endl;
+		assert(channel->count == 0);
+
+		InfoL << "Test message: " << evaluate() << endl;
+		assert(channel->count == 1);
+
+		// Channel level changes are applied immediately
+		channel->setLevel(LTrace);
+		assert(Logger::enabled(LTrace));
+		TraceLS(this) << "Test message: " << evaluate() << endl;
+		assert(channel->count == 2);
+
+		Logger::instance().remove("counting");
+		assert(!Logger::enabled(LFatal));
+		Logger::setInstance(previous);
+	}
+
+	// ============================================================================
+	// Async Log Writer Test
+	//
+	struct BatchCountingChannel: public CountingChannel
+	{
+		std::atomic<int> batches;
+		BatchCountingChannel() : CountingChannel(LTrace), batches(0) {}
+		virtual void writeBatch(const LogStream* const* streams, std::size_t count) 
+		{ 
+			batches++;
+			LogChannel::writeBatch(streams, count);
+		}
+	};
+
+	void writeMessages(AsyncLogWriter& writer, LogChannel& channel, int numThreads, int numMessages)
+	{
+		std::vector<std::unique_ptr<Thread>> producers;
+		for (int t = 0; t < numThreads; t++) {
+			producers.push_back(std::unique_ptr<Thread>(new Thread([&writer, &channel, numMessages]() {
+				for (int i = 0; i < numMessages; i++) {
+					LogStream* stream = new LogStream(LTrace, "Tests", 0);
+					stream->channel = &channel;
+					*stream << "Test message: " << i;
+					writer.write(stream);
+				}
+			})));
+		}
+		for (auto& producer : producers)
+			producer->join();
+	}
+
+	void testAsyncLogWriter()
+	{
+		const int numThreads = 4;
+		const int numMessages = 5000;
+
+		// Messages are written in batches
+		{
+			BatchCountingChannel channel;
+			AsyncLogWriter writer(numThreads * numMessages);
+			writeMessages(writer, channel, numThreads, numMessages);
+			writer.flush();
+			assert(channel.count == numThreads * numMessages);
+			assert(channel.batches <= channel.count);
+			assert(writer.dropped() == 0);
+		}
+
+		// Messages are dropped when the ring is full
+		{
+			BatchCountingChannel channel;
+			AsyncLogWriter writer(16, AsyncLogWriter::Drop);
+			writeMessages(writer, channel, numThreads, numMessages);
+			writer.flush();
+			assert(channel.count + writer.dropped() == numThreads * numMessages);
+		}
+
+		// Producers block until there is room
+		{
+			BatchCountingChannel channel;
+			AsyncLogWriter writer(16, AsyncLogWriter::Block);
+			writeMessages(writer, channel, numThreads, numMessages);
+			writer.flush();
+			assert(channel.count == numThreads * numMessages);
+			assert(writer.dropped() == 0);
+		}
+	}
+
+
+	// ============================================================================
+	// Binary Log Channel Test
+	//
+	struct RecordingBinaryChannel: public BinaryFileChannel
+	{
+		std::vector<std::string> paths;
+		std::ostringstream text;
+		RecordingBinaryChannel(const std::string& dir, std::size_t fileSize, int maxFiles = 0) : 
+			BinaryFileChannel("recording", dir, LTrace, fileSize, "blog", maxFiles) {}
+		virtual void write(const LogStream& stream) 
+		{ 
+			// Record the text output of the default formatter
+			format(stream, text);
+			text << '\n';
+			BinaryFileChannel::write(stream);
+		}
+		virtual void open() 
+		{ 
+			BinaryFileChannel::open(); 
+			paths.push_back(_path);
+		}
+	};
+
+	void testBinaryLogChannel()
+	{
+		const int numMessages = 500;
+		std::string dir(getCwd());
+		fs::addnode(dir, "binarylog");
+		std::string expected;
+		std::vector<std::string> paths;
+		
+		Logger* previous = &Logger::instance();
+		Logger::setInstance(new Logger, false);
+		Logger::instance().setWriter(new LogWriter);
+		{
+			// Small files are used to force rotation
+			auto channel = new RecordingBinaryChannel(dir, 4096);
+			Logger::instance().add(channel);
+			assert(Logger::binary());
+
+			std::string str("str");
+			for (int i = 0; i < numMessages; i++) {
+				InfoL << "Message " << i << ": " << 1.5 << ", " << true << ", " << 'x' << ", " << str << endl;
+				TraceLS(this) << "Pointer: " << static_cast<const void*>(this) << endl;
+			}
+
+			// Manipulators fall back to text formatting
+			InfoL << "Hex: " << 42 << " " << std::hex << 255 << " " 
+				<< std::setw(4) << std::setfill('0') << 7 << endl;
+			InfoL << "Fixed: " << std::setprecision(2) << std::fixed << 1.0 / 3 << endl;
+			expected = channel->text.str();
+			paths = channel->paths;
+			Logger::instance().remove("recording");
+			assert(!Logger::binary());
+		}
+		Logger::setInstance(previous);
+		assert(paths.size() > 1);
+		assert(expected.find("Message 42: 1.5, 1, x, str") != std::string::npos);
+		assert(expected.find("Hex: 42 ff 0007") != std::string::npos);
+		assert(expected.find("Fixed: 0.33") != std::string::npos);
+
+		// Decoded files match the text output
+		std::ostringstream decoded;
+		std::size_t count = 0;
+		BinaryLogReader reader;
+		for (auto& path : paths) {
+			count += reader.read(path, decoded);
+			fs::unlink(path);
+		}
+		assert(count == numMessages * 2 + 2);
+		assert(decoded.str() == expected);
+
+		// Only the newest files are kept
+		Logger::setInstance(new Logger, false);
+		Logger::instance().setWriter(new LogWriter);
+		{
+			auto channel = new RecordingBinaryChannel(dir, 4096, 2);
+			Logger::instance().add(channel);
+			for (int i = 0; i < numMessages; i++)
+				InfoL << "Message " << i << endl;
+			paths = channel->paths;
+			Logger::instance().remove("recording");
+		}
+		Logger::setInstance(previous);
+		assert(paths.size() > 2);
+		std::vector<std::string> names;
+		fs::readdir(dir, names);
+		assert(names.size() == 2);
+		assert(!fs::exists(paths[0]));
+		assert(fs::exists(paths.back()));
+		for (auto& path : paths) {
+			if (fs::exists(path))
+				fs::unlink(path);
+		}
+		fs::rmdir(dir);
+	}
+
+
+	// ============================================================================
+	// Process Test
+	//	
+	void testProcess()
+	{
+		try 
+		{
+			Process proc;
+		
+			char* args[3];
+			args[0] = "C:/Windows/notepad.exe";
+			args[1] = "runspot";
+			args[2] = NULL;
+		
+			proc.options.args = args;
+			proc.options.file = args[0];
+			proc.onexit = std::bind(&Tests::processExit, this, std::placeholders::_1);
+			proc.spawn();
+		
+			runLoop();
+		}
+		catch (std::exception& exc)
+		{
+			cerr << "Process error: " << exc.what() << endl;
+			assert(0);
+		}
+	}
+
+	void processExit(Int64 exitStatus)
+	{
+		cout << "On process exit: " << exitStatus << endl;
+	}
+	
+
+	// ============================================================================
+	// Thread Tests
+	//	
+	bool threadRan;
+
+	void testThread()
+	{
+		threadRan = false;
+		Thread async([](void* arg) {
+			auto self = reinterpret_cast<Tests*>(arg);	
+			self->threadRan = true;
+		}, this);
+
+		while (!threadRan) {			
+			scy::sleep(10); // wait for thread
+		}
+		
+		cout << "Thread Ran" << endl;
+		assert(async.started());
+		assert(!async.running());
+	}
+
+
+	/*
+	// ============================================================================
+	// Sync Delegate
+	//
+	NullSignal SyncText;
+
+	void testSyncDelegate()
+	{
+		SyncText += syncDelegate(this, &Tests::onSyncSignal);
+
+		Thread async([](void* arg) {
+			cout << "Sending Sync Callback" << endl;
+
+			auto self = reinterpret_cast<Tests*>(arg);
+			self->SyncText.emit(self);
+		}, this);
+		
+		scy::sleep(50); // wait for thread
+		assert(!SyncText.delegates().empty());
+
+		runLoop();
+	}
+	
+	void onSyncSignal(void* sender)
+	{
+		// This method is called inside the event loop context.
+
+		assert(sender == this);		
+		cout << "Received Sync Callback" << endl;
+
+		// Remove the delegate
+		SyncText -= syncDelegate(this, &Tests::onSyncSignal);
+
+		// Cleanup now to remove the redundant delegate, 
+		// and dereference the event loop.
+		SyncText.cleanup();
+		assert(SyncText.delegates().empty());
+	}
+	*/
+
+	
+	// ============================================================================
+	// Timer Test
+	//
+	const static int numTimerTicks = 5;
+	bool timerRestarted;
+	
+	void testTimer() 
+	{
+		cout << "Starting" << endl;
+		Timer timer;
+		//timer.Timeout += sdelegate(this, &Tests::timerCallback);
+		timer.start(10, 10);
+
+		timerRestarted = false;
+		
+		runLoop();
+		cout << "Ending" << endl;
+	}
+
+	void timerCallback(void* sender)
+	{
+		auto timer = reinterpret_cast<Timer*>(sender);
+		cout << "On timeout: " << timer->count() << endl;
+		if (timer->count() == numTimerTicks) {
+			if (!timerRestarted) {
+				timerRestarted = true;
+				timer->restart(); // restart once, count returns to 0
+			}
+			else
+				timer->stop(); // event loop will be released
+		}
+	}
+	
+	// ============================================================================
+	// Timer Wheel Test
+	//
+	void testTimerWheel() 
+	{
+		// Timeouts are relative to the cached loop time,
+		// which earlier tests may have left behind
+		uv_update_time(uv::defaultLoop());
+		TimerWheel wheel(uv::defaultLoop());
+		Int64 start = wheel.now();
+		std::vector<std::pair<Int64, Int64>> fired; // timeout, elapsed
+
+		// Entries fire in expiry order, including those 
+		// which cascade in from the outer levels
+		const Int64 timeouts[] = { 300, 5, 40, 270, 0, 120, 600, 5 };
+		std::vector<TimerWheel::Entry> entries(8);
+		for (int i = 0; i < 8; i++) {
+			Int64 timeout = timeouts[i];
+			entries[i].callback = [&, timeout]() {
+				fired.push_back(std::make_pair(timeout, wheel.now() - start));
+			};
+			entries[i].start(wheel, timeout);
+		}
+		assert(wheel.size() == 8);
+
+		// Moved entries take over their place in the wheel
+		TimerWheel::Entry moved(std::move(entries[3]));
+		assert(moved.active());
+		assert(!entries[3].active());
+		assert(wheel.size() == 8);
+
+		// Cancelled entries don't fire, and copies aren't scheduled
+		entries[5].cancel();
+		TimerWheel::Entry copy(entries[6]);
+		assert(!entries[5].active());
+		assert(!copy.active());
+		assert(copy.remaining() > 500);
+		assert(wheel.size() == 7);
+
+		// Entries may restart themselves
+		int restarts = 0;
+		TimerWheel::Entry repeating;
+		repeating.callback = [&]() {
+			if (++restarts < 3)
+				repeating.restart();
+		};
+		repeating.start(wheel, 10);
+
+		// Timeouts beyond the outer level are parked
+		TimerWheel::Entry distant([]() { assert(0); });
+		distant.start(wheel, Int64(1) << 33);
+		assert(distant.active());
+		distant.cancel();
+
+		wheel.handle().ref(); // keep the loop alive
+		while (wheel.size())
+			uv_run(uv::defaultLoop(), UV_RUN_ONCE);
+
+		const Int64 expected[] = { 0, 5, 5, 40, 270, 300, 600 };
+		assert(fired.size() == 7);
+		for (std::size_t i = 0; i < fired.size(); i++) {
+			cout << "Timer wheel: " << fired[i].first << ": " << fired[i].second << endl;
+			assert(fired[i].first == expected[i]);
+			assert(fired[i].second >= expected[i]);
+			assert(fired[i].second < expected[i] + 50);
+		}
+		assert(restarts == 3);
+		assert(entries[6].expired());
+		assert(copy.expired());
+		wheel.handle().unref();
+	}
+	
+	// ============================================================================
+	// Idler Test
+	//
+	const static int wantIdlerTicks = 5;
+	int idlerTicks;
+	Idler idler;
+	
+	void testIdler() 
+	{
+		idlerTicks = 0;
+		idler.start(std::bind(&Tests::idlerCallback, this));
+		runLoop();
+	}
+
+	void idlerCallback()
+	{
+		cout << "On idle" << endl;
+		if (++idlerTicks == numTimerTicks) {
+			idler.cancel(); // event loop will be released
+		}
+	}
+
+	// ============================================================================
+	// Task Runner Test
+	//
+	struct DeadlineTask: public Task
+	{
+		UInt64 due; // milliseconds
+		std::function<void()> callback;
+		std::atomic<int> runs;
+
+		DeadlineTask(Int64 delay, std::function<void()> callback = nullptr, bool repeat = false) : 
+			Task(repeat), due(uv_hrtime() / 1000000 + delay), callback(callback), runs(0)
+		{
+		}
+
+		virtual Int64 remaining() const
+		{
+			Int64 remaining = static_cast<Int64>(due - uv_hrtime() / 1000000);
+			return remaining > 0 ? remaining : 0;
+		}
+
+		virtual void run()
+		{
+			runs++;
+			if (callback)
+				callback();
+		}
+	};
+
+	void testTaskRunner() 
+	{
+		// Tasks run in deadline order once they are due
+		{
+			std::vector<int> order;
+			std::atomic<int> done(0);
+			UInt64 start = uv_hrtime();
+			{
+				TaskRunner runner;
+				DeadlineTask* tasks[3] = { 
+					new DeadlineTask(60, [&]() { order.push_back(60); done++; }),
+					new DeadlineTask(20, [&]() { order.push_back(20); done++; }),
+					new DeadlineTask(40, [&]() { order.push_back(40); done++; })
+				};
+				for (auto task : tasks)
+					runner.start(task);
+				assert(runner.get(tasks[1]->id()) == tasks[1]);
+				assert(runner.exists(tasks[2]));
+				assert(!runner.get(0));
+				for (int i = 0; i < 500 && done < 3; i++)
+					scy::sleep(5);
+				assert(done == 3);
+			}
+			assert(order.size() == 3 && order[0] == 20 && order[1] == 40 && order[2] == 60);
+			assert((uv_hrtime() - start) / 1000000 >= 60);
+		}
+
+		// Repeating tasks which are always due are polled, and 
+		// destroyed tasks are removed by the runner
+		{
+			TaskRunner runner;
+			auto task = new DeadlineTask(0, nullptr, true);
+			UInt32 id = task->id();
+			runner.start(task);
+			scy::sleep(50);
+			assert(task->runs >= 2 && task->runs <= 60);
+			runner.destroy(task);
+			for (int i = 0; i < 100 && runner.get(id); i++)
+				scy::sleep(1);
+			assert(!runner.get(id));
+		}
+
+		// Runners waiting for a distant task shut down promptly
+		{
+			UInt64 start = uv_hrtime();
+			{
+				TaskRunner runner;
+				runner.start(new DeadlineTask(100000));
+				scy::sleep(10);
+			}
+			assert((uv_hrtime() - start) / 1000000 < 1000);
+		}
+
+		// Event loop runners are woken by a timer
+		{
+			std::vector<int> order;
+			auto context = std::make_shared<SyncContext>(uv::defaultLoop());
+			auto runner = new TaskRunner(context);
+			runner->start(new DeadlineTask(20, [&]() { order.push_back(20); }));
+			runner->start(new DeadlineTask(10, [&]() { order.push_back(10); }));
+			runner->start(new DeadlineTask(30, [&]() { 
+				order.push_back(30); 
+				context->close(); // event loop will be released
+			}));
+			uv_run(uv::defaultLoop(), UV_RUN_DEFAULT);
+			assert(order.size() == 3 && order[0] == 10 && order[1] == 20 && order[2] == 30);
+			delete runner;
+		}
+	}
+
+	void testTaskPool() 
+	{
+		// Tasks run in parallel on the workers
+		{
+			Mutex mutex;
+			std::set<unsigned long> threads;
+			std::atomic<int> done(0);
+			UInt64 start = uv_hrtime();
+			TaskPool pool(4);
+			assert(pool.numWorkers() == 4);
+			for (int i = 0; i < 8; i++) {
+				pool.start(new DeadlineTask(0, [&]() { 
+					scy::sleep(20);
+					Mutex::ScopedLock lock(mutex);
+					threads.insert(Thread::currentID());
+					done++;
+				}));
+			}
+			for (int i = 0; i < 500 && done < 8; i++)
+				scy::sleep(2);
+			assert(done == 8);
+			assert((uv_hrtime() - start) / 1000000 < 150);
+			Mutex::ScopedLock lock(mutex);
+			assert(threads.size() > 1);
+		}
+
+		// Tasks with affinity always run on their worker, and idle
+		// workers steal tasks queued behind a busy worker
+		{
+			std::atomic<unsigned long> pinnedThread(0);
+			std::atomic<bool> moved(false);
+			std::atomic<int> done(0);
+			std::atomic<bool> blocked(true);
+			TaskPool pool(2);
+			auto pinned = new DeadlineTask(0, [&]() {
+				unsigned long tid = Thread::currentID();
+				unsigned long expected = 0;
+				if (!pinnedThread.compare_exchange_strong(expected, tid) && expected != tid)
+					moved = true;
+			}, true);
+			pool.start(pinned, 1);
+			pool.start(new DeadlineTask(0, [&]() { 
+				while (blocked) 
+					scy::sleep(1); 
+			}), 0);
+			scy::sleep(10);
+			for (int i = 0; i < 20; i++)
+				pool.start(new DeadlineTask(0, [&]() { done++; }));
+			for (int i = 0; i < 500 && done < 20; i++)
+				scy::sleep(2);
+			assert(done == 20); // worker 0 is still blocked
+			blocked = false;
+			scy::sleep(20);
+			assert(pinned->runs > 2 && !moved);
+
+			// Destroyed tasks are removed once they leave their worker
+			UInt32 id = pinned->id();
+			pool.destroy(pinned);
+			for (int i = 0; i < 100 && pool.get(id); i++)
+				scy::sleep(1);
+			assert(!pool.get(id));
+		}
+	}
+
+	
+	// ============================================================================
+	// IPC Test
+	//
+	const static int want_x_ipc_callbacks = 5;
+	int num_ipc_callbacks;
+	
+	void testIPC() 
+	{
+		cout << "Test IPC" << endl;
+		num_ipc_callbacks = 0;
+		ipc::ActionSyncQueue ipc;
+		
+		// Actions pushed from another thread have all run
+		// on the loop once waitForSync() returns
+		Thread pusher([&]() {
+			for (int i = 0; i < want_x_ipc_callbacks; i++)
+				ipc.push(new ipc::Action(std::bind(&Tests::ipcCallback, this, std::placeholders::_1), &ipc, "test" + util::itostr(i + 1)));
+			ipc.waitForSync();
+			assert(num_ipc_callbacks == want_x_ipc_callbacks);
+		});
+		runLoop();
+		pusher.join();
+		cout << "Test IPC: OK" << endl;
+	}
+
+	void ipcCallback(const ipc::Action& action)
+	{
+		cout << "Got IPC callback: " << action.data << endl;
+		if (++num_ipc_callbacks == want_x_ipc_callbacks)
+			reinterpret_cast<ipc::ActionSyncQueue*>(action.arg)->close();
+	}
+		
+	// ============================================================================
+	// SyncDispatcher Test
+	//	
+	void testSyncDispatcher() 
+	{
+		const int numProducers = 4;
+		const int numClosures = 20000;
+		std::vector<int> last(numProducers, -1);
+		std::atomic<int> done(0);
+		{
+			SyncDispatcher dispatcher;
+			SyncContext keepAlive(uv::defaultLoop(), []() {});
+
+			// Closures from each producer run in order on the loop thread,
+			// and have all run by the time waitForSync() returns
+			unsigned long loopID = Thread::currentID();
+			std::vector<std::unique_ptr<Thread>> producers;
+			for (int p = 0; p < numProducers; p++) {
+				producers.push_back(std::unique_ptr<Thread>(new Thread([&, p]() {
+					for (int i = 0; i < numClosures; i++) {
+						dispatcher.post([&, p, i]() {
+							assert(Thread::currentID() == loopID);
+							assert(last[p] == i - 1);
+							last[p] = i;
+						});
+					}
+					dispatcher.waitForSync();
+					assert(last[p] == numClosures - 1);
+					dispatcher.post([&]() { done++; }); // wakes the loop
+				})));
+			}
+			while (done < numProducers)
+				uv_run(uv::defaultLoop(), UV_RUN_ONCE);
+			for (auto& producer : producers)
+				producer->join();
+
+			// Large closures are stored on the heap
+			std::string payload(256, 'x');
+			std::vector<char> big(1024, 'y');
+			bool ran = false;
+			dispatcher.post([&ran, payload, big]() { ran = payload.size() == 256 && big.size() == 1024; });
+			dispatcher.waitForSync(); // runs inline on the loop thread
+			assert(ran);
+			keepAlive.close();
+		}
+		uv_run(uv::defaultLoop(), UV_RUN_NOWAIT);
+	}
+
+	// ============================================================================
+	// Loop Group Test
+	//
+	void testLoopGroup() 
+	{
+		const int numLoops = 3;
+		const int numClosures = 1000;
+		LoopGroup group(numLoops, false);
+		group.start();
+		assert(group.running());
+		assert(group.size() == numLoops);
+		assert(group.current() == nullptr);
+
+		// Closures run in order on the thread of the loop they were posted to
+		std::vector<int> last(numLoops, -1);
+		std::atomic<int> fired(0);
+		std::vector<TimerWheel::Entry> timers(numLoops);
+		for (int l = 0; l < numLoops; l++) {
+			assert(group.indexOf(group.loop(l)) == l);
+			for (int i = 0; i < numClosures; i++) {
+				group.post(l, [&, l, i]() {
+					assert(Thread::currentID() != Thread::mainID);
+					assert(group.current() == group.loop(l));
+					assert(last[l] == i - 1);
+					last[l] = i;
+				});
+			}
+
+			// Per-loop shared objects work on group loops
+			group.post(l, [&, l]() {
+				timers[l].callback = [&]() { fired++; };
+				timers[l].start(TimerWheel::forLoop(group.current()), 1);
+			});
+		}
+		for (int l = 0; l < numLoops; l++) {
+			group.dispatcher(l).waitForSync();
+			assert(last[l] == numClosures - 1);
+		}
+		while (fired < numLoops)
+			scy::sleep(1);
+
+		// Loops are handed out in round-robin or hashed order
+		uv::Loop* first = group.next();
+		assert(group.next() != first);
+		assert(group.next() != first);
+		assert(group.next() == first);
+		assert(group.select(7) == group.select(7));
+		assert(group.select(7) == group.loop(7 % numLoops));
+
+		group.stop();
+		assert(!group.running());
+	}
+
+	// ============================================================================
+	// SyncQueue Test
+	//	
+	void testSyncQueue() 
+	{
+		runLoop();
+	}
+
+	// ============================================================================
+	// AsyncQueue Test
+	//
+	struct TestItem
+	{
+		int producer;
+		int seq;
+		TestItem(int producer, int seq) : producer(producer), seq(seq) {}
+	};
+
+	struct TestAsyncQueue: public AsyncQueue<TestItem>
+	{
+		TestAsyncQueue() : AsyncQueue<TestItem>(0) {}
+		virtual ~TestAsyncQueue() { cancel(); _thread.join(); }
+	};
+
+	void testAsyncQueue() 
+	{
+		// Items from each producer are dispatched in order
+		const int numProducers = 4;
+		const int numItems = 10000;
+		std::atomic<int> dispatched(0);
+		std::vector<int> last(numProducers, -1);
+		{
+			TestAsyncQueue queue;
+			queue.ondispatch = [&](TestItem& item) {
+				assert(item.seq == last[item.producer] + 1);
+				last[item.producer] = item.seq;
+				dispatched++;
+			};
+
+			std::vector<std::unique_ptr<Thread>> producers;
+			for (int p = 0; p < numProducers; p++) {
+				producers.push_back(std::unique_ptr<Thread>(new Thread([&queue, p, numItems]() {
+					for (int i = 0; i < numItems; i++)
+						queue.push(new TestItem(p, i));
+				})));
+			}
+			for (auto& producer : producers)
+				producer->join();
+
+			// The idle consumer is woken without polling
+			while (dispatched < numProducers * numItems)
+				scy::sleep(1);
+			queue.push(new TestItem(0, numItems));
+			while (dispatched < numProducers * numItems + 1)
+				scy::sleep(1);
+			assert(queue.empty());
+		}
+		assert(dispatched == numProducers * numItems + 1);
+	}
+
+	// ============================================================================
+	// Queue Overflow Test
+	//
+	struct OverflowQueue: public RunnableQueue<TestItem>
+	{
+		// Every fourth item is a key frame
+		OverflowQueue(int limit) : RunnableQueue<TestItem>(limit) {}
+		bool droppable(const TestItem& item) const { return item.seq % 4 != 0; }
+		using RunnableQueue<TestItem>::dispatchNext;
+	};
+
+	int highWatermarks;
+	int lowWatermarks;
+
+	void onHighWatermark(void*) { highWatermarks++; }
+	void onLowWatermark(void*) { lowWatermarks++; }
+
+	std::vector<int> runOverflowQueue(OverflowPolicy policy, const std::vector<int>& seqs, UInt64& dropped)
+	{
+		std::vector<int> received;
+		OverflowQueue queue(4);
+		queue.setOverflowPolicy(policy);
+		queue.ondispatch = [&](TestItem& item) { received.push_back(item.seq); };
+		queue.HighWatermark += sdelegate(this, &Tests::onHighWatermark);
+		queue.LowWatermark += sdelegate(this, &Tests::onLowWatermark);
+		for (auto seq : seqs)
+			queue.push(new TestItem(0, seq));
+		queue.flush();
+		assert(!queue.overflowed());
+		dropped = queue.dropped();
+		return received;
+	}
+
+	void testQueueOverflow() 
+	{
+		UInt64 dropped;
+		highWatermarks = lowWatermarks = 0;
+		std::vector<int> input;
+		for (int i = 0; i < 10; i++)
+			input.push_back(i);
+
+		// The oldest items are discarded as new items are pushed
+		std::vector<int> received = runOverflowQueue(DropOldest, input, dropped);
+		assert(received == std::vector<int>({ 6, 7, 8, 9 }));
+		assert(dropped == 6);
+		assert(highWatermarks == 1 && lowWatermarks == 1);
+
+		// The queue stays bounded while the consumer is stalled
+		{
+			const int numProducers = 4;
+			const int numItems = 1000;
+			OverflowQueue queue(16);
+			for (int i = 0; i < numItems; i++) {
+				queue.push(new TestItem(0, i));
+				assert(queue.size() <= 16);
+			}
+			assert(queue.dropped() == numItems - 16);
+			std::vector<std::unique_ptr<Thread>> producers;
+			for (int p = 0; p < numProducers; p++) {
+				producers.push_back(std::unique_ptr<Thread>(new Thread([&queue, numItems]() {
+					for (int i = 0; i < numItems; i++)
+						queue.push(new TestItem(0, i));
+				})));
+			}
+			for (auto& producer : producers)
+				producer->join();
+			assert(queue.size() <= 16);
+			assert(queue.dropped() + queue.size() == (numProducers + 1) * numItems);
+		}
+
+		// Items pushed while full are discarded
+		received = runOverflowQueue(DropNewest, input, dropped);
+		assert(received == std::vector<int>({ 0, 1, 2, 3 }));
+		assert(dropped == 6);
+		assert(highWatermarks == 2 && lowWatermarks == 2);
+
+		// Key frames are always queued, and dependent items are 
+		// discarded until the next key frame
+		received = runOverflowQueue(DropNonKeyframe, input, dropped);
+		assert(received == std::vector<int>({ 0, 1, 2, 3, 4, 8 }));
+		assert(dropped == 4);
+		{
+			OverflowQueue queue(4);
+			queue.setOverflowPolicy(DropNonKeyframe);
+			for (int i = 0; i < 6; i++)
+				queue.push(new TestItem(0, i));
+			queue.push(new TestItem(0, 6));
+			assert(queue.size() == 5);
+			assert(queue.dropped() == 2);
+
+			// Skipping ends once the consumer drains the queue
+			queue.flush();
+			queue.push(new TestItem(0, 7));
+			queue.push(new TestItem(0, 9));
+			assert(queue.size() == 2);
+			assert(queue.dropped() == 2);
+		}
+
+		// Streams which never flag a key frame fall back to 
+		// discarding the oldest items rather than stalling
+		{
+			std::vector<int> received;
+			RunnableQueue<TestItem> queue(4);
+			queue.setOverflowPolicy(DropNonKeyframe);
+			queue.ondispatch = [&](TestItem& item) { received.push_back(item.seq); };
+			for (int i = 0; i < 10; i++)
+				queue.push(new TestItem(0, i));
+			assert(queue.size() == 4);
+			queue.flush();
+			assert(received == std::vector<int>({ 6, 7, 8, 9 }));
+			for (int i = 10; i < 20; i++)
+				queue.push(new TestItem(0, i));
+			queue.flush();
+			assert(received.size() == 8);
+			assert(received.back() == 19);
+			assert(queue.dropped() == 12);
+		}
+
+		// Producers time out while the consumer is stalled
+		{
+			OverflowQueue queue(2);
+			queue.setOverflowPolicy(BlockProducer, 20);
+			queue.push(new TestItem(0, 0));
+			queue.push(new TestItem(0, 1));
+			Stopwatch sw;
+			sw.start();
+			queue.push(new TestItem(0, 2));
+			assert(sw.elapsedMilliseconds() >= 15);
+			assert(queue.dropped() == 1);
+			assert(queue.size() == 2);
+		}
+
+		// Producers wait for the consumer rather than dropping
+		{
+			const int numItems = 1000;
+			int count = 0;
+			OverflowQueue queue(8);
+			queue.setOverflowPolicy(BlockProducer, 0);
+			queue.ondispatch = [&](TestItem& item) { assert(item.seq == count++); };
+			Thread producer([&queue, numItems]() {
+				for (int i = 0; i < numItems; i++)
+					queue.push(new TestItem(0, i));
+			});
+			while (count < numItems) {
+				if (!queue.dispatchNext())
+					scy::sleep(1);
+			}
+			producer.join();
+			assert(queue.dropped() == 0);
+			assert(queue.empty());
+		}
+	}
+
+	// ============================================================================
+	// Packet Stream Tests
+	//	
+	struct TestPacketSource: public PacketSource, public async::Startable
+	{
+		Thread runner;
+		//Idler runner;
+		PacketSignal emitter;
+
+		TestPacketSource() : 
+			PacketSource(emitter)
+		{
+			runner.setRepeating(true);
+		}
+
+		void start() 
+		{
+			DebugLS(this) << "Start" << endl;	
+			runner.start([](void* arg) {
+				auto self = reinterpret_cast<TestPacketSource*>(arg);
+				DebugL << "Emitting" << endl;	
+				RawPacket p("hello", 5);
+				self->emitter.emit(self, p);
+			}, this);
+		}
+
+		void stop() 
+		{
+			DebugLS(this) << "Stop" << endl;	
+			runner.cancel();
+			//runner.close();
+			DebugLS(this) << "Stop: OK" << endl;	
+		}
+	};	
+
+	struct TestPacketProcessor: public PacketProcessor
+	{
+		PacketSignal emitter;
+
+		TestPacketProcessor() : 
+			PacketProcessor(emitter)
+		{
+		}
+
+		void process(IPacket& packet) 
+		{
+			DebugLS(this) << "Process: " << packet.className() << endl;			
+			emit(packet);
+		}
+	};
+	
+	void onPacketStreamOutput(void* sender, IPacket& packet) 
+	{
+		DebugLS(this) << ">>>>>>>>>>> On packet: " << packet.className() << endl;
+	}
+
+	void testPacketStream() 
+	{
+		PacketStream stream;	
+		//stream.setRunner(std::make_shared<Thread>());
+		stream.attachSource(new TestPacketSource, true, true);
+		//stream.attach(new AsyncPacketQueue, 0, true);
+		stream.attach(new TestPacketProcessor, 1, true);
+		//stream.attach(new SyncPacketQueue, 2, true);
+		stream.synchronizeOutput(uv::defaultLoop());
+		//stream.emitter += packetDelegate(this, &Tests::onPacketStreamOutput);	
+		stream.start();
+
+		// TODO: Test pause/resume functionality
+					
+		app.waitForShutdown([](void* arg) {
+			auto stream = reinterpret_cast<PacketStream*>(arg);
+			DebugL << "########## Shutdown" << endl;
+			stream->close();
+			//reinterpret_cast<TestPacketSource*>(stream->base().sources()[0].ptr)->stop();
+			DebugL << "########## Shutdown: After" << endl;
+		}, &stream);		
+		
+		DebugL << "########## Exiting" << endl;
+		stream.close();
+	}
+	
+	void onChildPacketStreamOutput(void* sender, IPacket& packet) 
+	{
+		DebugLS(this) << ">>>>>>>>>>> On child packet: " << packet.className() << endl;
+	}
+	
+	struct ChildStreams
+	{
+		PacketStream* s1;
+		PacketStream* s2;
+		PacketStream* s3;
+	};
+
+
+	void testMultiPacketStream() 
+	{
+		PacketStream stream;	
+		//stream.setRunner(std::make_shared<Thread>());
+		stream.attachSource(new TestPacketSource, true, true);
+		//stream.attach(new AsyncPacketQueue, 0, true);
+		stream.attach(new TestPacketProcessor, 1, true);
+		//stream.emitter += packetDelegate(this, &Tests::onPacketStreamOutput);	
+		stream.start();
+		
+		// The second PacketStream receives packets from the first one
+		// and synchronizes output packets with the default event loop.
+		ChildStreams children;
+		children.s1 = new PacketStream;
+		//children.s1->setRunner(std::make_shared<Idler>()); // Use Idler
+		children.s1->attachSource(stream.emitter);
+		children.s1->attach(new AsyncPacketQueue, 0, true);
+		children.s1->attach(new SyncPacketQueue, 1, true);
+		children.s1->synchronizeOutput(uv::defaultLoop());
+		//children.s1->emitter += packetDelegate(this, &Tests::onChildPacketStreamOutput);	
+		children.s1->start();
+
+		children.s2 = new PacketStream;
+		children.s2->attachSource(stream.emitter);
+		children.s2->attach(new AsyncPacketQueue, 0, true);
+		children.s2->synchronizeOutput(uv::defaultLoop());
+		//children.s2->emitter += packetDelegate(this, &Tests::onChildPacketStreamOutput);	
+		children.s2->start();
+		
+		children.s3 = new PacketStream;
+		children.s3->attachSource(stream.emitter);
+		children.s3->attach(new AsyncPacketQueue, 0, true);
+		//children.s3->synchronizeOutput(uv::defaultLoop());
+		//children.s3->emitter += packetDelegate(this, &Tests::onChildPacketStreamOutput);	
+		children.s3->start();
+					
+		app.waitForShutdown([](void* arg) {
+			auto streams = reinterpret_cast<ChildStreams*>(arg);
+			//streams->s1->attachSource(stream.emitter);
+			if (streams->s1) delete streams->s1;
+			if (streams->s2) delete streams->s2;
+			if (streams->s3) delete streams->s3;
+			TraceL << "DESTROYED *********************************************************" << endl;
+		}, &children);
+
+		TraceLS(this) << "ENDING *********************************************************" << endl;
+	}
+
+	struct CountingPacketProcessor: public PacketProcessor
+	{
+		PacketSignal emitter;
+		int count; // not atomic; multi source chains are serialized
+
+		CountingPacketProcessor() : 
+			PacketProcessor(emitter), count(0)
+		{
+		}
+
+		void process(IPacket& packet) 
+		{
+			count++;
+			emit(packet);
+		}
+	};
+
+	struct SnapshotPacketStream: public PacketStream
+	{
+		std::size_t numChains() const { return _chains.size(); }
+	};
+
+	std::atomic<int> numStreamPackets;
+
+	void onCountPacket(void*, IPacket&) 
+	{
+		numStreamPackets++;
+	}
+
+	void testPacketStreamProcessing() 
+	{
+		const int numSources = 4;
+		const int numPackets = 10000;
+		PacketSignal sources[numSources];
+		numStreamPackets = 0;
+
+		SnapshotPacketStream stream;
+		for (auto& source : sources)
+			stream.attachSource(source);
+		auto proc = new CountingPacketProcessor;
+		stream.attach(proc, 0, true);
+		stream.emitter += packetDelegate(this, &Tests::onCountPacket);
+		stream.start();
+
+		// Sources emit concurrently into the stream
+		std::vector<std::unique_ptr<Thread>> threads;
+		for (auto& source : sources) {
+			PacketSignal* signal = &source;
+			threads.push_back(std::unique_ptr<Thread>(new Thread([signal, numPackets]() {
+				for (int i = 0; i < numPackets; i++) {
+					RawPacket p("hello", 5);
+					signal->emit(nullptr, p);
+				}
+			})));
+		}
+		for (auto& thread : threads)
+			thread->join();
+		assert(proc->count == numSources * numPackets);
+		assert(numStreamPackets == numSources * numPackets);
+
+		// Packets written after closure are not processed
+		stream.close();
+		RawPacket p("hello", 5);
+		stream.write(p);
+		assert(proc->count == numSources * numPackets);
+		assert(numStreamPackets == numSources * numPackets);
+
+		// Superseded chain snapshots are freed while no packet is processed
+		CountingPacketProcessor extra;
+		for (int i = 0; i < 100; i++) {
+			stream.attach(&extra, 1, false);
+			stream.detach(&extra);
+		}
+		assert(stream.numChains() == 1);
+	}
+
+	struct StageProcessor: public PacketProcessor
+	{
+		PacketSignal emitter;
+		std::set<unsigned long> threads;
+		std::atomic<bool> busy;
+		int delay;
+		int next;
+		int last;
+		int states;
+		bool ordered;
+		bool raced;
+
+		StageProcessor(int delay = 0) : 
+			PacketProcessor(emitter), busy(false), delay(delay), 
+			next(0), last(-1), states(0), ordered(true), raced(false)
+		{
+		}
+
+		void process(IPacket& packet) 
+		{
+			busy = true;
+			threads.insert(Thread::currentID());
+			int seq = *reinterpret_cast<const int*>(packet.data());
+			if (seq <= last)
+				ordered = false;
+			last = seq;
+			next++;
+			if (delay)
+				scy::sleep(delay);
+			busy = false;
+			emit(packet);
+		}
+
+		void onStreamStateChange(const PacketStreamState&) 
+		{
+			if (busy)
+				raced = true;
+			states++;
+		}
+	};
+
+	void testPacketStreamPipeline() 
+	{
+		const int numPackets = 200;
+		numStreamPackets = 0;
+
+		// Three stages: the first runs on the writing thread, and a 
+		// slow last stage with a small queue applies backpressure
+		PacketStream stream;
+		auto capture = new StageProcessor;
+		auto encode = new StageProcessor;
+		auto packetize = new StageProcessor(1);
+		stream.attach(capture, 1, true);
+		stream.attachStage(encode, 2, true);
+		stream.attachStage(packetize, 3, true, 4);
+		stream.emitter += packetDelegate(this, &Tests::onCountPacket);
+		stream.start();
+
+		for (int i = 0; i < numPackets; i++) {
+			RawPacket p(reinterpret_cast<const char*>(&i), sizeof(i));
+			stream.write(p);
+		}
+		for (int i = 0; i < 500 && numStreamPackets < numPackets; i++)
+			scy::sleep(10);
+		assert(numStreamPackets == numPackets);
+
+		// Each stage runs on its own thread and sees packets in order
+		assert(capture->next == numPackets && capture->ordered);
+		assert(encode->next == numPackets && encode->ordered);
+		assert(packetize->next == numPackets && packetize->ordered);
+		assert(capture->threads.size() == 1 && *capture->threads.begin() == Thread::currentID());
+		assert(encode->threads.size() == 1 && packetize->threads.size() == 1);
+		assert(*encode->threads.begin() != *packetize->threads.begin());
+		assert(*encode->threads.begin() != Thread::currentID());
+
+		// Closing while packets are in flight stops the stages
+		std::atomic<bool> writing(true);
+		Thread writer([&]() {
+			for (int i = numPackets; writing; i++) {
+				RawPacket p(reinterpret_cast<const char*>(&i), sizeof(i));
+				stream.write(p);
+			}
+		});
+		scy::sleep(20);
+
+		// States are passed to each stage between its packets.
+		// Packets written while paused skip the processors.
+		int states = packetize->states;
+		stream.pause();
+		stream.resume();
+		for (int i = 0; i < 500 && packetize->states < states + 2; i++)
+			scy::sleep(1);
+		assert(encode->states == states + 2 && packetize->states == states + 2);
+		assert(!encode->raced && !packetize->raced);
+		stream.close();
+		writing = false;
+		writer.join();
+		assert(encode->ordered && packetize->ordered);
+
+		// Packets in flight are drained through every stage
+		assert(packetize->next == encode->next && encode->next == capture->next);
+	}
+
+	struct BatchPacketProcessor: public PacketProcessor
+	{
+		PacketSignal emitter;
+		std::atomic<int> batches;
+		std::atomic<int> packets;
+
+		BatchPacketProcessor() : 
+			PacketProcessor(emitter), batches(0), packets(0)
+		{
+		}
+
+		void process(IPacket& packet) 
+		{
+			packets++;
+			emit(packet);
+		}
+
+		void processBatch(PacketBatch& batch) 
+		{
+			batches++;
+			packets += batch.size();
+			emitBatch(batch);
+		}
+
+		bool batched() const { return true; }
+	};
+
+	void testPacketBatch() 
+	{
+		// Batches written to the stream are passed through 
+		// processors which accept them in one call
+		{
+			numStreamPackets = 0;
+			PacketStream stream;
+			auto first = new BatchPacketProcessor;
+			auto second = new BatchPacketProcessor;
+			stream.attach(first, 1, true);
+			stream.attach(second, 2, true);
+			stream.emitter += packetDelegate(this, &Tests::onCountPacket);
+			stream.start();
+
+			std::vector<RawPacket> packets(10, RawPacket("hello", 5));
+			PacketBatch batch;
+			for (auto& packet : packets)
+				batch.push(&packet);
+			stream.write(batch);
+			assert(first->batches == 1 && first->packets == 10);
+			assert(second->batches == 1 && second->packets == 10);
+			assert(numStreamPackets == 10);
+
+			// Packets which must not be modified split the batch
+			packets[5].flags.set(PacketFlags::NoModify);
+			stream.write(batch);
+			assert(first->batches == 3 && first->packets == 19);
+			assert(numStreamPackets == 20);
+		}
+
+		// Queues emit waiting packets in batches
+		{
+			const int numPackets = 1000;
+			numStreamPackets = 0;
+			PacketStream stream;
+			auto proc = new BatchPacketProcessor;
+			stream.attach(new AsyncPacketQueue, 1, true);
+			stream.attach(proc, 2, true);
+			stream.emitter += packetDelegate(this, &Tests::onCountPacket);
+			stream.start();
+			for (int i = 0; i < numPackets; i++) {
+				RawPacket p("hello", 5);
+				stream.write(p);
+			}
+			for (int i = 0; i < 500 && numStreamPackets < numPackets; i++)
+				scy::sleep(10);
+			assert(proc->packets == numPackets);
+			assert(proc->batches > 0 && proc->batches <= numPackets);
+			assert(numStreamPackets == numPackets);
+		}
+	}
+
+	struct SlowPacketProcessor: public PacketProcessor
+	{
+		PacketSignal emitter;
+
+		SlowPacketProcessor() : PacketProcessor(emitter) {}
+
+		void process(IPacket& packet) 
+		{
+			scy::sleep(1);
+			emit(packet);
+		}
+	};
+
+	void testPacketStreamStats() 
+	{
+		// Streams record nothing unless instrumented
+		{
+			PacketStream stream;
+			stream.attach(new CountingPacketProcessor, 1, true);
+			stream.start();
+			stream.write("hello", 5);
+			assert(stream.stats().empty());
+		}
+
+		// Each processor records its own time, excluding later processors
+		{
+			const int numPackets = 20;
+			numStreamPackets = 0;
+			PacketStream stream;
+			stream.instrument(true);
+			stream.attach(new BatchPacketProcessor, 1, true);
+			stream.attach(new SlowPacketProcessor, 2, true);
+			stream.attach(new CountingPacketProcessor, 3, true);
+			stream.emitter += packetDelegate(this, &Tests::onCountPacket);
+			stream.start();
+			for (int i = 0; i < numPackets; i++)
+				stream.write("hello", 5);
+			std::vector<RawPacket> packets(10, RawPacket("hello", 5));
+			PacketBatch batch;
+			for (auto& packet : packets)
+				batch.push(&packet);
+			stream.write(batch);
+			assert(numStreamPackets == numPackets + 10);
+
+			auto stats = stream.stats();
+			assert(stats.size() == 3);
+			for (auto& s : stats) {
+				assert(s.packets == numPackets + 10);
+				assert(s.bytes == (numPackets + 10) * 5);
+			}
+			assert(stats[0].order == 1 && stats[2].order == 3);
+			assert(stats[2].name.find("CountingPacketProcessor") != std::string::npos);
+			assert(stats[1].time >= (numPackets + 10) * 1000000ULL);
+			assert(stats[0].time < stats[1].time);
+			assert(stats[1].percentile(50) >= 1000000ULL);
+
+			UInt64 calls = 0;
+			for (auto count : stats[0].histogram)
+				calls += count;
+			assert(calls == numPackets + 1); // the batch is one call
+
+			std::ostringstream ost;
+			stream.printStats(ost);
+			assert(ost.str().find("\"packets\":30") != std::string::npos);
+			assert(ost.str()[0] == '[');
+		}
+
+		// Queues report their overflow drops
+		{
+			PacketStream stream;
+			stream.instrument(true);
+			auto queue = new AsyncPacketQueue(8);
+			queue->setOverflowPolicy(DropNewest);
+			stream.attach(queue, 1, true);
+			stream.attach(new SlowPacketProcessor, 2, true);
+			stream.start();
+			for (int i = 0; i < 100; i++)
+				stream.write("hello", 5);
+			auto stats = stream.stats();
+			assert(stats.size() == 2);
+			assert(stats[0].packets == 100);
+			assert(stats[0].dropped > 0);
+			assert(stats[0].queueDepth <= 8);
+		}
+	}
+	
+	
+
+	/*
+	// ============================================================================
+	// Packet Signal Tests
+	//
+	PacketSignal BroadcastPacket;
+
+	void onBroadcastPacket(void* sender, DataPacket& packet)
+	{
+		TraceL << "On Packet: " << packet.className() << endl;
+	}
+	
+	void runPacketSignalTest() 
+	{
+		TraceL << "Running Packet Signal Test" << endl;
+		BroadcastPacket += packetDelegate(this, &Tests::onBroadcastPacket, 0);
+		DataPacket packet;
+		BroadcastPacket.emit(this, packet);
+		//util::pause();
+		TraceL << "Running Packet Signal Test: END" << endl;
+	}
+	
+
+	// ============================================================================
+	// Garbage Collector Tests
+	//
+	void runGarbageCollectorTests() {
+		TraceL << "Running Garbage Collector Test" << endl;
+		
+		//for (unsigned i = 0; i < 100; i++) { 
+			char* ptr = new char[1000];
+		
+			Poco::Thread* ptr1 = new Poco::Thread;
+		
+			TaskRunner::getDefault().deleteLater<char*>(ptr);
+			//TaskRunner::getDefault().deleteLater<Poco::Thread>(ptr1);
+		//}
+
+		//util::pause();
+		TraceL << "Running Garbage Collector Test: END" << endl;
+	}
+	
+	*/
+
+	struct Tracked
+	{
+		std::atomic<int>& count;
+		unsigned long tid;
+		Tracked(std::atomic<int>& count) : count(count), tid(Thread::currentID()) {}
+		~Tracked() { assert(Thread::currentID() == tid); count++; }
+	};
+
+	void testGarbageCollector() 
+	{
+		GarbageCollector& gc = GarbageCollector::instance();
+		SyncContext keepAlive(uv::defaultLoop(), []() {});
+
+		// Retired pointers are only freed once the loop passes a 
+		// quiescent point, over several iterations for large bursts
+		const int numPointers = GarbageCollector::MaxReclaim * 3;
+		std::atomic<int> freed(0);
+		UInt64 retired = gc.retired();
+		UInt64 reclaimed = gc.reclaimed();
+		UInt64 epoch = gc.epoch();
+		for (int i = 0; i < numPointers; i++)
+			deleteLater(new Tracked(freed));
+		deleteLater(std::make_shared<Tracked>(freed));
+		assert(gc.retired() == retired + numPointers + 1);
+		assert(gc.pending() >= numPointers + 1);
+		assert(freed == 0);
+
+		// Each iteration frees at most MaxReclaim pointers
+		int iterations = 0;
+		while (freed < numPointers + 1) {
+			int before = freed;
+			uv_run(uv::defaultLoop(), UV_RUN_ONCE);
+			assert(freed - before <= GarbageCollector::MaxReclaim);
+			iterations++;
+		}
+		assert(iterations >= 3);
+		assert(gc.epoch() > epoch);
+		assert(gc.reclaimed() >= reclaimed + numPointers + 1);
+
+		// Pointers retired on group loops are freed on the retiring loop 
+		// once every loop, including the default loop, has moved on
+		const int numLoops = 2;
+		{
+			std::atomic<int> groupFreed(0);
+			LoopGroup group(numLoops, false);
+			group.start();
+			for (int l = 0; l < numLoops; l++) {
+				group.post(l, [&]() {
+					for (int i = 0; i < 100; i++)
+						deleteLater(new Tracked(groupFreed));
+				});
+			}
+			while (groupFreed < numLoops * 100)
+				uv_run(uv::defaultLoop(), UV_RUN_ONCE);
+			group.stop();
+		}
+
+		// Stopping a loop frees its pending pointers on the loop thread,
+		// even though the idle default loop holds the epoch back
+		{
+			std::atomic<int> groupFreed(0);
+			std::atomic<int> posted(0);
+			LoopGroup group(numLoops, false);
+			group.start();
+			for (int l = 0; l < numLoops; l++) {
+				group.post(l, [&]() {
+					for (int i = 0; i < 100; i++)
+						deleteLater(new Tracked(groupFreed));
+					posted++;
+				});
+			}
+			while (posted < numLoops)
+				scy::sleep(1);
+			group.stop();
+			assert(groupFreed == numLoops * 100);
+		}
+		keepAlive.close();
+		uv_run(uv::defaultLoop(), UV_RUN_NOWAIT);
+	}
+
+
+	/*
+	// ============================================================================
+	// Timer Task Tests
+	//
+	void onTimerTask(void* sender)
+	{
+		TraceL << "Timer Task Timout" << endl;
+		ready.set();
+	}
+
+	void runTimerTaskTest() 
+	{
+		TraceL << "Running Timer Task Test" << endl;
+		TimerTask* task = new TimerTask(runner, 1000, 1000);
+		task->Timeout += sdelegate(this, &Tests::onTimerTask);
+		task->start();
+		ready.wait();
+		ready.wait();
+		task->destroy();
+		//util::pause();
+		TraceL << "Running Timer Task Test: END" << endl;
+	}
+	
+	
+	// ============================================================================
+	// Signal Tests
+	//
+	struct SignalBroadcaster
+	{
+		SignalBroadcaster() {}
+		~SignalBroadcaster() {}
+	
+		Signal<int&>	TestSignal;
+	};
+
+	struct SignalReceiver
+	{
+		SignalBroadcaster& klass;
+		SignalReceiver(SignalBroadcaster& klass) : klass(klass)
+		{
+			DebugL << "SignalReceiver: Starting" << endl;
+			klass.TestSignal += sdelegate(this, &SignalReceiver::onSignal);
+		}
+
+		~SignalReceiver()
+		{
+			DebugL << "SignalReceiver: Destroying" << endl;	
+			klass.TestSignal -= sdelegate(this, &SignalReceiver::onSignal);
+		}
+
+		void onSignal(void*, int& value)
+		{
+			DebugL << "SignalReceiver: Callback: " << value << endl;	
+		}
+	};
+	 
+	void runSignalReceivers() {
+		{
+			SignalBroadcaster broadcaster; //("Thread1");
+			{
+				SignalReceiver receiver(broadcaster);
+			}
+		}
+		//util::pause();
+	}
+	
+	// ============================================================================
+	// Exception Test
+	//
+	void runExceptionTest() 
+	{
+		try
+		{
+			throw FileException("That's not a file!");
+			assert(0 && "must throw");
+		}
+		catch (FileException& exc)
+		{
+			cout << "Message: " << exc << endl;
+		}
+		catch (Exception&)
+		{
+			assert(0 && "bad cast");
+		}
+
+		try
+		{
+			throw IOException();
+			assert(0 && "must throw");
+		}
+		catch (IOException& exc)
+		{
+			cout << "Message: " << exc << endl;
+			assert(std::string(exc.what()) == "IO error");
+		}
+		catch (Exception&)
+		{
+			assert(0 && "bad cast");
+		}
+	}
+	*/
+
+	// ============================================================================
+	// Version String Comparison
+	//	
+	void testVersionStringComparison() 
+	{
+		assert((util::Version("3.7.8.0") == util::Version("3.7.8.0")) == true);
+		assert((util::Version("3.7.8.0") == util::Version("3.7.8")) == true);
+		assert((util::Version("3.7.8.0") < util::Version("3.7.8")) == false);
+		assert((util::Version("3.7.9") < util::Version("3.7.8")) == false);
+		assert((util::Version("3") < util::Version("3.7.9")) == true);
+		assert((util::Version("1.7.9") < util::Version("3.1")) == true);
+		
+		cout << "Printing version (3.7.8.0): " << util::Version("3.7.8.0") << endl;
+	}
+
+	void runLoop() {
+		DebugL << "#################### Running" << endl;
+		app.run();
+		DebugL << "#################### Ended" << endl;
+	}
+
+	void runCleanup() {
+		DebugL << "#################### Finalizing" << endl;
+		app.finalize();
+		DebugL << "#################### Exiting" << endl;
+	}
+	
+};
+
+
+} // namespace scy
+
+
+int main(int argc, char** argv) 
+{	
+	Logger::instance().add(new ConsoleChannel("debug", LTrace));
+	//Logger::instance().setWriter(new AsyncLogWriter);	
+	
+	{
+#ifdef _MSC_VER
+		_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
+#endif
+
+		// Create the test application
+		Application app;
+	
+		// Initialize the GarbageCollector in the main thread
+		GarbageCollector::instance();
+
+		// Run tests
+		{
+			scy::Tests run(app);	
+		}	
+	
+		// Wait for user intervention before finalizing
+		scy::pause();
+			
+		// Finalize the application to free all memory
+		app.finalize();
+	}
+
+	// Cleanup singleton instances
+	GarbageCollector::destroy();
+	Logger::destroy();
+	return 0;
+}
@@ -0,0 +1,255 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/net/socketadapter.h"
+#include "scy/net/socket.h"
+
+
+using std::endl;
+
+
+namespace scy {
+namespace net {
+
+
+SocketAdapter::SocketAdapter(SocketAdapter* sender, SocketAdapter* receiver) : 
+	 _sender(sender)
+{
+	//TraceLS(this) << "Create" << endl;	
+	assert(sender != this);
+	//assert(receiver != this);
+
+	if (receiver)
+		addReceiver(receiver);
+}
+	
+
+SocketAdapter::~SocketAdapter()
+{
+	//TraceLS(this) << "Destroy" << endl;	
+	
+#if 0
+	// Delete child adapters
+	// In order to prevent deletion, the outside 
+	// application must nullify the adapter pointers
+	if (_recvAdapter)
+		delete _recvAdapter;
+	if (_sender)
+		delete _sender;
+#endif
+}
+
+	
+int SocketAdapter::send(const char* data, std::size_t len, int flags)
+{
+	assert(_sender); // should have output adapter if default impl is used
+	if (!_sender) return -1;
+	return _sender->send(data, len, flags);
+}
+
+
+int SocketAdapter::send(const char* data, std::size_t len, const Address& peerAddress, int flags)
+{
+	assert(_sender); // should have output adapter if default impl is used
+	if (!_sender) return -1;
+	return _sender->send(data, len, peerAddress, flags);
+}
+
+
+int SocketAdapter::send(const BufferChain& chain, int flags)
+{
+	if (chain.count() == 1) {
+		ConstBuffer seg = chain.segment(0);
+		return send(bufferCast<const char*>(seg), seg.size(), flags);
+	}
+
+	Buffer buf;
+	chain.flatten(buf);
+	return send(buf.data(), buf.size(), flags);
+}
+
+
+int SocketAdapter::send(const BufferChain& chain, const Address& peerAddress, int flags)
+{
+	if (chain.count() == 1) {
+		ConstBuffer seg = chain.segment(0);
+		return send(bufferCast<const char*>(seg), seg.size(), peerAddress, flags);
+	}
+
+	Buffer buf;
+	chain.flatten(buf);
+	return send(buf.data(), buf.size(), peerAddress, flags);
+}
+
+
+namespace internal {
+
+	PooledBuffer* writeScratch(const IPacket& packet, BufferPool* pool)
+		// Serializes the packet into a scratch block from the socket's
+		// buffer pool, sized once from the exact packet size. Returns
+		// nullptr if the size is unknown or larger than the largest
+		// block, or if the packet wrote less than it reported.
+	{
+		std::size_t size = packet.size();
+		if (!pool || size == 0)
+			return nullptr;
+
+		PooledBuffer* block = pool->acquire(size);
+		if (!block)
+			return nullptr;
+
+		MutableBuffer buf(block->data(), size);
+		std::size_t written = packet.write(buf);
+		if (written == 0) {
+			block->release();
+			return nullptr;
+		}
+		block->setSize(written);
+		return block;
+	}
+
+}
+
+
+int SocketAdapter::sendPacket(const IPacket& packet, int flags)
+{	
+	// Try to cast as RawPacket so we can send without copying any data.
+	auto raw = dynamic_cast<const RawPacket*>(&packet);
+	if (raw)
+		return send((const char*)raw->data(), raw->size(), flags);
+	
+	// Dynamically generated packets are serialized into a pooled
+	// scratch block, which the socket retains until the write completes.
+	PooledBuffer* block = internal::writeScratch(packet, bufferPool());
+	if (block) {
+		int res = send(block->data(), block->size(), flags);
+		block->release();
+		return res;
+	}
+	
+	// Oversized and unsized packets are written to a buffer
+	// chain so large payloads can be sent without copying.
+	BufferChain chain;
+	packet.write(chain);
+	return send(chain, flags);
+}
+
+
+int SocketAdapter::sendPacket(const IPacket& packet, const Address& peerAddress, int flags)
+{	
+	// Try to cast as RawPacket so we can send without copying any data.
+	auto raw = dynamic_cast<const RawPacket*>(&packet);
+	if (raw)
+		return send((const char*)raw->data(), raw->size(), peerAddress, flags);
+	
+	// Dynamically generated packets are serialized into a pooled
+	// scratch block, which the socket retains until the write completes.
+	PooledBuffer* block = internal::writeScratch(packet, bufferPool());
+	if (block) {
+		int res = send(block->data(), block->size(), peerAddress, flags);
+		block->release();
+		return res;
+	}
+	
+	// Oversized and unsized packets are written to a buffer
+	// chain so large payloads can be sent without copying.
+	BufferChain chain;
+	packet.write(chain);
+	return send(chain, peerAddress, flags);
+}
+
+
+void SocketAdapter::sendPacket(IPacket& packet)
+{
+	int res = sendPacket(packet, 0);
+	if (res < 0)
+		throw std::runtime_error("Invalid socket operation");
+}
+
+
+void SocketAdapter::onSocketConnect()
+{
+	Connect.emit(self());
+}
+
+
+void SocketAdapter::onSocketRecv(const MutableBuffer& buffer, const Address& peerAddress)
+{
+	Recv.emit(self(), buffer, peerAddress);
+}
+
+
+void SocketAdapter::onSocketError(const scy::Error& error) //const Error& error
+{
+	Error.emit(self(), error);
+}
+
+
+void SocketAdapter::onSocketClose()
+{
+	Close.emit(self());
+}
+
+
+void SocketAdapter::addReceiver(SocketAdapter* adapter, int priority) 
+{	
+	Connect += delegate(adapter, &net::SocketAdapter::onSocketConnect, priority);
+	Recv += delegate(adapter, &net::SocketAdapter::onSocketRecv, priority);
+	Error += delegate(adapter, &net::SocketAdapter::onSocketError, priority);
+	Close += delegate(adapter, &net::SocketAdapter::onSocketClose, priority);
+}
+
+
+void SocketAdapter::removeReceiver(SocketAdapter* adapter)  
+{	
+	Connect -= delegate(adapter, &net::SocketAdapter::onSocketConnect);
+	Recv -= delegate(adapter, &net::SocketAdapter::onSocketRecv);
+	Error -= delegate(adapter, &net::SocketAdapter::onSocketError);
+	Close -= delegate(adapter, &net::SocketAdapter::onSocketClose);
+}
+
+
+void SocketAdapter::setSender(SocketAdapter* adapter, bool freeExisting)
+{
+	if (_sender == adapter) return;
+	if (_sender && freeExisting)
+		delete _sender;
+	_sender = adapter;
+}
+
+
+SocketAdapter* SocketAdapter::sender()
+{
+	return _sender;
+}
+
+
+uv::Loop* SocketAdapter::loop() const
+{
+	return _sender ? _sender->loop() : uv::defaultLoop();
+}
+
+
+BufferPool* SocketAdapter::bufferPool() const
+{
+	return _sender ? _sender->bufferPool() : nullptr;
+}
+
+
+} } // namespace scy::net
\ No newline at end of file
@@ -0,0 +1,456 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/net/udpsocket.h"
+#include "scy/net/types.h"
+#include "scy/logger.h"
+
+
+using namespace std;
+
+
+namespace scy {
+namespace net {
+
+	
+#if 0
+UDPSocket::UDPSocket() : 
+	net::Socket(new UDPSocket, false)
+{
+}
+
+
+UDPSocket::UDPSocket(UDPSocket* base, bool shared) : 
+	net::Socket(base, shared) 
+{
+}
+
+
+UDPSocket::UDPSocket(const Socket& socket) : 
+	net::Socket(socket)
+{
+	if (!dynamic_cast<UDPSocket*>(_base))
+		throw std::runtime_error("Cannot assign incompatible socket");
+}
+	
+
+UDPSocket& UDPSocket::base() const
+{
+	return static_cast<UDPSocket&>(*_base);
+}
+#endif
+
+
+//
+// UDP Base
+//
+
+
+UDPSocket::UDPSocket(uv::Loop* loop) :
+	uv::Handle(loop), 
+	_pool(BufferPool::forLoop(loop)),
+	_recvBuffer(_pool, 262144, 65536)
+{
+	TraceLS(this) << "Create" << endl;
+	_pool->duplicate();
+	init();
+}
+
+
+UDPSocket::~UDPSocket()
+{
+	TraceLS(this) << "Destroy" << endl;
+	_pool->release();
+}
+
+
+void UDPSocket::init() 
+{
+	if (ptr()) return;
+	
+	TraceLS(this) << "Init" << endl;
+	uv_udp_t* udp = new uv_udp_t;
+	udp->data = this; //instance();
+	_closed = false;
+	_ptr = reinterpret_cast<uv_handle_t*>(udp);
+	int r = uv_udp_init(loop(), udp);
+	if (r)
+		setUVError("Cannot initialize UDP socket", r);
+}
+
+
+void UDPSocket::connect(const Address& peerAddress) 
+{
+	_peer = peerAddress;
+
+	// Send the Connected signal to mimic TCP behaviour  
+	// since socket implementations are interchangable.
+	//emitConnect();
+	onSocketConnect();
+}
+
+
+void UDPSocket::close()
+{
+	TraceLS(this) << "Closing" << endl;	
+	recvStop();
+	uv::Handle::close();
+}
+
+
+void UDPSocket::bind(const Address& address, unsigned flags) 
+{	
+	TraceLS(this) << "Binding on " << address << endl;
+
+	int r;
+	switch (address.af()) {
+	case AF_INET:
+		r = uv_udp_bind(ptr<uv_udp_t>(), address.addr(), flags);
+		break;
+	//case AF_INET6:
+	//	r = uv_udp_bind6(ptr<uv_udp_t>(), address.addr(), flags);
+	//	break;
+	default:
+		throw std::runtime_error("Unexpected address family");
+	}
+
+	// Throw and exception of error
+	if (r)
+		setAndThrowError("Cannot bind UDP socket", r); 
+	
+	// Open the receiver channel
+	recvStart();
+}
+
+
+int UDPSocket::send(const char* data, std::size_t len, int flags) 
+{	
+	assert(_peer.valid());
+	return send(data, len, _peer, flags);
+}
+
+
+namespace internal {
+	struct SendRequest 
+	{
+		uv_udp_send_t req;
+		uv_buf_t buf;
+		BufferChain chain; // owns copied segments for chain sends
+		PooledBuffer* block; // retained pooled data, if any
+	};
+}
+
+
+int UDPSocket::send(const char* data, std::size_t len, const Address& peerAddress, int /* flags */) 
+{	
+	TraceLS(this) << "Send: " << len << ": " << peerAddress << endl;
+	assert(Thread::currentID() == tid());
+	//assert(len <= net::MAX_UDP_PACKET_SIZE);
+
+	if (_peer.valid() && _peer != peerAddress) {
+		ErrorLS(this) << "Peer not authorized: " << peerAddress << endl;
+		return -1;
+	}
+
+	if (!peerAddress.valid()) {
+		ErrorLS(this) << "Peer not valid: " << peerAddress << endl;
+		return -1;
+	}
+	
+	int r;	
+	auto sr = new internal::SendRequest;
+	sr->buf = uv_buf_init((char*)data, len);
+	sr->block = _pool->retain(data, len); // keep pooled data alive until sent
+	r = uv_udp_send(&sr->req, ptr<uv_udp_t>(), &sr->buf, 1, peerAddress.addr(), UDPSocket::afterSend);
+
+#if 0
+	switch (peerAddress.af()) {
+	case AF_INET:
+		r = uv_udp_send(&sr->req, ptr<uv_udp_t>(), &sr->buf, 1, peerAddress.addr(), UDPSocket::afterSend);
+		break;
+	case AF_INET6:
+		r = uv_udp_send6(&sr->req, ptr<uv_udp_t>(), &sr->buf, 1,
+			*reinterpret_cast<const sockaddr_in6*>(peerAddress.addr()), UDPSocket::afterSend);
+		break;
+	default:
+		throw std::runtime_error("Unexpected address family");
+	}
+#endif
+	if (r) {
+		ErrorLS(this) << "Send failed: " << uv_err_name(r) << endl;
+		if (sr->block)
+			sr->block->release();
+		delete sr;
+		setUVError("Invalid UDP socket", r); 
+	}
+	
+	// R is -1 on error, otherwise return len
+	return r ? r : len;
+}
+
+
+int UDPSocket::send(const BufferChain& chain, int flags) 
+{	
+	assert(_peer.valid());
+	return send(chain, _peer, flags);
+}
+
+
+int UDPSocket::send(const BufferChain& chain, const Address& peerAddress, int /* flags */) 
+{	
+	TraceLS(this) << "Send chain: " << chain.size() << ": " << chain.count() << ": " << peerAddress << endl;
+	assert(Thread::currentID() == tid());
+
+	if (_peer.valid() && _peer != peerAddress) {
+		ErrorLS(this) << "Peer not authorized: " << peerAddress << endl;
+		return -1;
+	}
+
+	if (!peerAddress.valid()) {
+		ErrorLS(this) << "Peer not valid: " << peerAddress << endl;
+		return -1;
+	}
+	
+	int r;	
+	auto sr = new internal::SendRequest;
+	sr->chain = chain;
+	sr->block = nullptr;
+
+	// Send all segments as a single datagram; libuv copies the iovec array
+	const std::size_t nbufs = sr->chain.count();
+	uv_buf_t bufsml[16];
+	std::vector<uv_buf_t> bufvec;
+	uv_buf_t* bufs = bufsml;
+	if (nbufs > 16) {
+		bufvec.resize(nbufs);
+		bufs = bufvec.data();
+	}
+	for (std::size_t i = 0; i < nbufs; i++) {
+		ConstBuffer seg = sr->chain.segment(i);
+		bufs[i] = uv_buf_init((char*)bufferCast<const char*>(seg), seg.size());
+	}
+	r = uv_udp_send(&sr->req, ptr<uv_udp_t>(), bufs, nbufs, peerAddress.addr(), UDPSocket::afterSend);
+
+	if (r) {
+		ErrorLS(this) << "Send failed: " << uv_err_name(r) << endl;
+		if (sr->block)
+			sr->block->release();
+		delete sr;
+		setUVError("Invalid UDP socket", r); 
+	}
+	
+	// R is -1 on error, otherwise return len
+	return r ? r : chain.size();
+}
+
+	
+bool UDPSocket::setBroadcast(bool flag)
+{
+	if (!ptr()) return false;
+	return uv_udp_set_broadcast(ptr<uv_udp_t>(), flag ? 1 : 0) == 0;
+}
+
+
+bool UDPSocket::setMulticastLoop(bool flag)
+{
+	if (!ptr()) return false;
+	return uv_udp_set_broadcast(ptr<uv_udp_t>(), flag ? 1 : 0) == 0;
+}
+
+
+bool UDPSocket::setMulticastTTL(int ttl)
+{
+	assert(ttl > 0 && ttl < 255);
+	if (!ptr()) return false;
+	return uv_udp_set_broadcast(ptr<uv_udp_t>(), ttl) == 0;
+}
+
+
+bool UDPSocket::recvStart() 
+{
+	// UV_EALREADY means that the socket is already bound but that's okay
+	// TODO: No need for boolean value as this method can throw exceptions
+	// since it is called internally by bind().
+	int r = uv_udp_recv_start(ptr<uv_udp_t>(), UDPSocket::allocRecvBuffer, onRecv);
+	if (r && r != UV_EALREADY) {
+		setAndThrowError("Cannot start recv on invalid UDP socket", r);
+		return false;
+	}  
+	return true;
+}
+
+
+bool UDPSocket::recvStop() 
+{
+	// This method must not throw since it is called internally via libuv callbacks.
+	if (!ptr()) return false;
+	return uv_udp_recv_stop(ptr<uv_udp_t>()) == 0;
+}
+
+
+void UDPSocket::onRecv(const MutableBuffer& buf, const net::Address& address)
+{
+	TraceLS(this) << "Recv: " << buf.size() << endl;	
+	//emitRecv(buf, address);
+	onSocketRecv(buf, address);
+}
+
+
+void UDPSocket::setError(const scy::Error& err)
+{
+	uv::Handle::setError(err);
+}
+
+		
+const scy::Error& UDPSocket::error() const
+{
+	return uv::Handle::error();
+}
+
+
+net::Address UDPSocket::address() const
+{	
+	if (!active())
+		return net::Address();
+		//throw std::runtime_error("Invalid UDP socket: No address");
+	
+	struct sockaddr address;
+	int addrlen = sizeof(address);
+	int r = uv_udp_getsockname(ptr<uv_udp_t>(), &address, &addrlen);
+	if (r)
+		return net::Address();
+		//throwLastError("Invalid UDP socket: No address");
+
+	return Address(&address, addrlen);
+}
+
+
+net::Address UDPSocket::peerAddress() const
+{
+	if (!_peer.valid())
+		return net::Address();
+		//throw std::runtime_error("Invalid UDP socket: No peer address");
+	return _peer;
+}
+
+
+net::TransportType UDPSocket::transport() const 
+{ 
+	return net::UDP; 
+}
+	
+
+bool UDPSocket::closed() const
+{
+	return uv::Handle::closed();
+}
+
+
+//
+// Callbacks
+
+void UDPSocket::onRecv(uv_udp_t* handle, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned /* flags */) 
+{	
+	auto socket = static_cast<UDPSocket*>(handle->data);
+	TraceL << "On recv: " << nread << endl;
+			
+	if (nread < 0) {
+		//assert(0 && "unexpected error");	
+        TraceL << "Recv error: " << uv_err_name(nread)<< endl;
+		socket->setUVError("UDP error", nread);
+		return;
+	}
+	
+	if (nread == 0) {
+		assert(addr == NULL);
+		// Returning unused buffer, this is not an error
+		// 11/12/13: This happens on linux but not windows
+		//socket->setUVError("End of file", UV_EOF);
+		return;
+	}
+	
+	// The socket may be destroyed by the callback,
+	// so it must not be touched afterwards.
+	socket->onRecv(socket->_recvBuffer.commit(nread), net::Address(addr, sizeof(*addr)));
+}
+
+
+void UDPSocket::afterSend(uv_udp_send_t* req, int status) 
+{
+	auto sr = reinterpret_cast<internal::SendRequest*>(req);
+	auto socket = reinterpret_cast<UDPSocket*>(sr->req.handle->data);	
+	if (status) {		
+		ErrorL << "Send error: " << uv_err_name(status) << endl;
+		socket->setUVError("UDP send error", status);
+	}
+	if (sr->block)
+		sr->block->release();
+	delete sr;
+}
+
+
+void UDPSocket::allocRecvBuffer(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf)
+{
+	auto self = static_cast<UDPSocket*>(handle->data);	
+	//TraceL << "Allocating Buffer: " << suggested_size << endl;	
+	
+	// Receive into the free space of the current pooled block.
+	// XXX: libuv wants us to allocate 65536 bytes for UDP .. hmmm
+	MutableBuffer space = self->_recvBuffer.prepare();
+	buf->base = bufferCast<char*>(space);
+	buf->len = space.size();
+}
+
+
+void UDPSocket::onError(const scy::Error& error) 
+{		
+	ErrorLS(this) << "Error: " << error.message << endl;	
+	//emitError(error);
+	onSocketError(error);
+	close(); // close on error
+}
+
+
+void UDPSocket::onClose() 
+{		
+	ErrorLS(this) << "On close" << endl;	
+	//emitClose();
+	onSocketClose();
+}
+
+
+uv::Loop* UDPSocket::loop() const
+{
+	return uv::Handle::loop();
+}
+
+
+BufferPool* UDPSocket::bufferPool() const
+{
+	return _pool;
+}
+
+
+PooledBuffer* UDPSocket::recvBuffer()
+{
+	return _recvBuffer.block();
+}
+
+
+} } // namespace scy::net
\ No newline at end of file